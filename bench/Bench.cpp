@@ -0,0 +1,633 @@
+// hrawiz-bench: microbenchmarks for the DSP kernels and whole-file processing.
+//
+// Human-readable results go to stderr, JSON to stdout (or --output), so
+//   hrawiz-bench > results.json
+// records a run that can be diffed against an earlier release.
+
+#include "Signals.h"
+#include "audio/AudioIO.h"
+#include "audio/AudioProcessor.h"
+#include "audio/BlockProcessor.h"
+#include "audio/HFCompensation.h"
+#include "audio/Resampler.h"
+#include "dsp/FFT.h"
+#include "dsp/Kernels.h"
+#include "dsp/STFT.h"
+#include "util/Log.h"
+#include "util/TaskScheduler.h"
+#include "util/Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef HRAW_VERSION
+#define HRAW_VERSION "dev"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const int SAMPLE_RATES[] = {44100, 96000, 192000};
+
+// PLAN.md target: a 3-minute 44.1 kHz stereo file in under 10 seconds
+constexpr double PLAN_TARGET_AUDIO_SECONDS = 180.0;
+constexpr double PLAN_TARGET_WALL_SECONDS = 10.0;
+
+// Exit status when every case that was asked for had to be skipped
+constexpr int EXIT_SKIPPED = 77;
+
+struct Settings {
+    std::string filter;          // Only run cases whose name contains this
+    double minTime = 0.5;        // Seconds of measurement per case
+    double duration = 10.0;      // Seconds of synthetic audio for STFT/resampler/file cases
+    bool fullFile = false;       // Also run the 3-minute PLAN.md target
+    bool realtime = false;       // Also run the simulated audio host (takes `duration` of wall time)
+    std::string outputPath;      // JSON destination; stdout when empty
+};
+
+// Parameter value, already rendered as a JSON literal
+struct Param {
+    std::string key;
+    std::string json;
+};
+
+Param P(const std::string& key, const std::string& value) { return {key, "\"" + value + "\""}; }
+Param P(const std::string& key, int value) { return {key, std::to_string(value)}; }
+Param P(const std::string& key, double value) {
+    std::ostringstream ss;
+    ss << value;
+    return {key, ss.str()};
+}
+
+struct Result {
+    std::string name;
+    std::vector<Param> params;
+    size_t iterations = 0;
+    double minMs = 0.0;
+    double medianMs = 0.0;
+    double meanMs = 0.0;
+    double itemsPerSecond = 0.0;
+    std::string unit;
+    double realtimeFactor = 0.0;  // Audio seconds per wall second, 0 when not applicable
+    std::vector<Param> metrics;   // Case-specific outcomes, written after the timings
+    bool failed = false;          // The case missed its target; makes the run exit non-zero
+};
+
+// Keeps results alive so the optimizer can't drop the work
+volatile float sink = 0.0f;
+
+template <typename T>
+void Consume(const std::vector<T>& values) {
+    if (!values.empty()) sink = sink + static_cast<float>(std::abs(values[values.size() / 2]));
+}
+
+class Runner {
+public:
+    explicit Runner(const Settings& settings) : settings(settings) {}
+
+    bool Wants(const std::string& name) const {
+        return settings.filter.empty() || name.find(settings.filter) != std::string::npos;
+    }
+
+    // Time `body` until minTime has elapsed (and at least minIterations ran).
+    // `items` and `audioSeconds` describe one call of `body`.
+    void Run(const std::string& name, std::vector<Param> params, double items, const std::string& unit,
+             double audioSeconds, const std::function<void()>& body, size_t minIterations = 3) {
+        if (!Wants(name)) return;
+
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> times;
+        body();  // Warm-up: page in buffers, build FFT plans
+        const Clock::time_point start = Clock::now();
+        while (times.size() < minIterations ||
+               std::chrono::duration<double>(Clock::now() - start).count() < settings.minTime) {
+            const Clock::time_point t0 = Clock::now();
+            body();
+            times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+        }
+
+        Result result;
+        result.name = name;
+        result.params = std::move(params);
+        result.iterations = times.size();
+        std::sort(times.begin(), times.end());
+        result.minMs = times.front();
+        result.medianMs = times[times.size() / 2];
+        double total = 0.0;
+        for (double t : times) total += t;
+        result.meanMs = total / times.size();
+        result.unit = unit;
+        result.itemsPerSecond = items / (result.medianMs / 1000.0);
+        if (audioSeconds > 0.0) {
+            result.realtimeFactor = audioSeconds / (result.medianMs / 1000.0);
+        }
+
+        Add(std::move(result));
+    }
+
+    // Record a result timed by the case itself
+    void Add(Result result) {
+        Print(result);
+        results.push_back(std::move(result));
+    }
+
+    // A case this machine can't run meaningfully
+    void Skip(const std::string& name, const std::string& reason) {
+        std::cerr << std::left << std::setw(66) << name << std::right << " skipped: " << reason << std::endl;
+        ++skipped;
+    }
+
+    const std::vector<Result>& Results() const { return results; }
+
+    bool AllSkipped() const { return results.empty() && skipped > 0; }
+
+    bool AnyFailed() const {
+        return std::any_of(results.begin(), results.end(), [](const Result& r) { return r.failed; });
+    }
+
+private:
+    static void Print(const Result& result) {
+        std::ostringstream label;
+        label << result.name;
+        for (const Param& param : result.params) {
+            std::string value = param.json;
+            value.erase(std::remove(value.begin(), value.end(), '"'), value.end());
+            label << " " << param.key << "=" << value;
+        }
+        std::cerr << std::left << std::setw(66) << label.str() << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(11) << result.medianMs << " ms"
+                  << std::setprecision(0) << std::setw(14) << result.itemsPerSecond << " " << result.unit << "/s";
+        if (result.realtimeFactor > 0.0) {
+            std::cerr << std::setprecision(1) << std::setw(9) << result.realtimeFactor << "x realtime";
+        }
+        std::cerr << std::endl;
+        if (!result.metrics.empty()) {
+            std::cerr << "   ";
+            for (const Param& metric : result.metrics) std::cerr << " " << metric.key << "=" << metric.json;
+            std::cerr << (result.failed ? "  FAILED" : "") << std::endl;
+        }
+    }
+
+    const Settings& settings;
+    std::vector<Result> results;
+    size_t skipped = 0;
+};
+
+// Magnitude spectrum of one Hann-windowed FFTSIZE frame from the middle of `signal`
+std::vector<float> FrameMagnitude(const std::vector<float>& signal) {
+    const int size = HFCompensation::FFTSIZE;
+    STFT stft(size, HFCompensation::HOPSIZE);
+    const size_t start = signal.size() > static_cast<size_t>(size) ? (signal.size() - size) / 2 : 0;
+    std::vector<float> frame(signal.begin() + start, signal.begin() + start + size);
+    auto spectrum = stft.Forward(frame);
+
+    std::vector<float> magnitude(size / 2 + 1);
+    for (int i = 0; i < size / 2 + 1; ++i) {
+        magnitude[i] = std::abs(spectrum[0][i]);
+    }
+    return magnitude;
+}
+
+void BenchFFT(Runner& runner) {
+    const int size = HFCompensation::FFTSIZE;
+    FFT fft(size);
+    std::vector<float> input = SyntheticSignal::Generate(SyntheticSignal::Kind::Noise, 44100, size);
+    std::vector<std::complex<float>> spectrum = fft.Forward(input);
+
+    runner.Run("fft/forward", {P("size", size)}, 1, "transforms", 0.0, [&]() {
+        Consume(fft.Forward(input));
+    });
+    runner.Run("fft/inverse", {P("size", size)}, 1, "transforms", 0.0, [&]() {
+        Consume(fft.Inverse(spectrum));
+    });
+}
+
+void BenchSTFT(Runner& runner, const Settings& settings) {
+    for (int sampleRate : SAMPLE_RATES) {
+        if (!runner.Wants("stft/forward") && !runner.Wants("stft/inverse")) continue;
+
+        const size_t numSamples = static_cast<size_t>(settings.duration * sampleRate);
+        std::vector<float> signal =
+            SyntheticSignal::Generate(SyntheticSignal::Kind::HarmonicStack, sampleRate, numSamples);
+        STFT stft(HFCompensation::FFTSIZE, HFCompensation::HOPSIZE);
+        auto spectrogram = stft.Forward(signal);
+        const double frames = static_cast<double>(spectrogram.size());
+
+        runner.Run("stft/forward", {P("sample_rate", sampleRate), P("seconds", settings.duration)},
+                   frames, "frames", settings.duration, [&]() {
+            auto result = stft.Forward(signal);
+            sink = sink + (result.empty() ? 0.0f : std::abs(result[0][1]));
+        });
+        runner.Run("stft/inverse", {P("sample_rate", sampleRate), P("seconds", settings.duration)},
+                   frames, "frames", settings.duration, [&]() {
+            Consume(stft.Inverse(spectrogram));
+        });
+    }
+}
+
+void BenchResampler(Runner& runner, const Settings& settings) {
+    for (int sampleRate : SAMPLE_RATES) {
+        if (!runner.Wants("resampler/resample")) continue;
+
+        const size_t numSamples = static_cast<size_t>(settings.duration * sampleRate);
+        std::vector<float> signal =
+            SyntheticSignal::Generate(SyntheticSignal::Kind::LowpassNoise, sampleRate, numSamples);
+
+        runner.Run("resampler/resample", {P("sample_rate", sampleRate), P("target_rate", sampleRate * 2),
+                                          P("seconds", settings.duration)},
+                   static_cast<double>(numSamples) * 2, "samples", settings.duration, [&]() {
+            Consume(Resampler::Resample(signal, sampleRate, sampleRate * 2));
+        });
+    }
+}
+
+void BenchKernels(Runner& runner) {
+    // The kernels only take a few microseconds; time batches of calls
+    const int callsPerIteration = 64;
+    const int sampleRate = 44100;
+    HFCompensation hfc;
+
+    for (SyntheticSignal::Kind kind : SyntheticSignal::ALL) {
+        const std::string signalName = SyntheticSignal::Name(kind);
+        std::vector<float> magnitude = FrameMagnitude(
+            SyntheticSignal::Generate(kind, sampleRate, HFCompensation::FFTSIZE * 4));
+
+        std::vector<int> peaks = hfc.FindPeaks(magnitude);
+        std::vector<int> fundamentals = hfc.RemoveHarmonics(peaks);
+        std::vector<float> rebuild(magnitude.size(), 0.0f);
+        hfc.ProcessPeaks(fundamentals, magnitude, rebuild);
+
+        const std::vector<Param> params = {P("signal", signalName), P("sample_rate", sampleRate),
+                                           P("peaks", static_cast<int>(peaks.size()))};
+
+        runner.Run("hfc/find_peaks", params, callsPerIteration, "frames", 0.0, [&]() {
+            for (int i = 0; i < callsPerIteration; ++i) Consume(hfc.FindPeaks(magnitude));
+        });
+        runner.Run("hfc/remove_harmonics", params, callsPerIteration, "frames", 0.0, [&]() {
+            for (int i = 0; i < callsPerIteration; ++i) Consume(hfc.RemoveHarmonics(peaks));
+        });
+        runner.Run("hfc/process_peaks", params, callsPerIteration, "frames", 0.0, [&]() {
+            for (int i = 0; i < callsPerIteration; ++i) {
+                std::vector<float> out(magnitude.size(), 0.0f);
+                hfc.ProcessPeaks(fundamentals, magnitude, out);
+                Consume(out);
+            }
+        });
+        runner.Run("hfc/flatten_spectrum", params, callsPerIteration, "frames", 0.0, [&]() {
+            for (int i = 0; i < callsPerIteration; ++i) Consume(hfc.FlattenSpectrum(rebuild, 3));
+        });
+    }
+}
+
+// The whole per-frame rebuild at each FFT size with a specialized pipeline,
+// and one without (6144) for comparison
+void BenchFramePipeline(Runner& runner) {
+    const int callsPerIteration = 16;
+    const int sampleRate = 44100;
+    const int lowpassFreq = 16000;
+    HFCompensation hfc(1);
+
+    for (int size : {1024, 2048, 4096, 6144, 8192}) {
+        const bool specialized = size != 6144;
+        STFT stft(size, size / 2);
+        const std::vector<float> signal = SyntheticSignal::Generate(SyntheticSignal::Kind::HarmonicStack, sampleRate, size);
+        const std::vector<std::complex<float>> mid = stft.ForwardFrame(signal, 0);
+        const std::vector<std::complex<float>> side = stft.ForwardFrame(
+            SyntheticSignal::Generate(SyntheticSignal::Kind::Noise, sampleRate, size), 0);
+        const int lowpassIdx = HFCompensation::LowpassBin(sampleRate, lowpassFreq, size);
+        std::vector<std::complex<float>> midFrame, sideFrame;
+
+        for (HFCompensation::Engine engine : {HFCompensation::Engine::Harmonic,
+                                              HFCompensation::Engine::BandReplication}) {
+            const bool harmonic = engine == HFCompensation::Engine::Harmonic;
+            const std::vector<Param> params = {P("fft_size", size),
+                                               P("pipeline", specialized ? "specialized" : "generic"),
+                                               P("engine", harmonic ? "harmonic" : "band_replication")};
+            hfc.SetEngine(engine);
+            runner.Run("hfc/process_frame", params, callsPerIteration, "frames", 0.0, [&]() {
+                for (int i = 0; i < callsPerIteration; ++i) {
+                    midFrame = mid;
+                    sideFrame = side;
+                    hfc.ProcessFrame(midFrame, sideFrame, lowpassIdx, 1, i);
+                }
+                Consume(midFrame);
+            });
+        }
+    }
+}
+
+// The runtime-dispatched loops on one frame's worth of data, with whichever
+// build --simd (or the CPU) picked
+void BenchVectorKernels(Runner& runner) {
+    const int callsPerIteration = 64;
+    const int size = HFCompensation::FFTSIZE;
+    const int bins = size / 2 + 1;
+    const std::vector<Param> params = {P("simd", std::string(Kernels::Name(Kernels::Active()))), P("size", size)};
+
+    STFT stft(size, HFCompensation::HOPSIZE);
+    const std::vector<float> frame = SyntheticSignal::Generate(SyntheticSignal::Kind::Noise, 44100, size);
+    const std::vector<std::complex<float>> spectrum = stft.ForwardFrame(frame, 0);
+    const std::vector<float>& window = stft.Window();
+    std::vector<float> magnitude(bins), smoothed(bins), acc(size, 0.0f), windowSum(size, 0.0f);
+
+    runner.Run("kernels/magnitude", params, callsPerIteration, "frames", 0.0, [&]() {
+        for (int i = 0; i < callsPerIteration; ++i) Kernels::Magnitude(spectrum.data(), magnitude.data(), bins);
+        Consume(magnitude);
+    });
+    runner.Run("kernels/box_smooth", params, callsPerIteration, "frames", 0.0, [&]() {
+        for (int i = 0; i < callsPerIteration; ++i) Kernels::BoxSmooth(magnitude.data(), smoothed.data(), bins, 5);
+        Consume(smoothed);
+    });
+    runner.Run("kernels/overlap_add", params, callsPerIteration, "frames", 0.0, [&]() {
+        for (int i = 0; i < callsPerIteration; ++i) {
+            std::fill(windowSum.begin(), windowSum.end(), 0.0f);
+            Kernels::Accumulate(acc.data(), frame.data(), size);
+            Kernels::AccumulateSquares(windowSum.data(), window.data(), size);
+            Kernels::DivideNonZero(acc.data(), windowSum.data(), size);
+        }
+        Consume(acc);
+    });
+}
+
+void BenchProcessFile(Runner& runner, const Settings& settings, const fs::path& workDir) {
+    auto runFile = [&](const std::string& name, int sampleRate, double seconds, HFCompensation::Engine engine) {
+        if (!runner.Wants(name)) return;
+
+        const size_t numSamples = static_cast<size_t>(seconds * sampleRate);
+        const fs::path input = workDir / ("input_" + std::to_string(sampleRate) + ".wav");
+        const fs::path output = workDir / ("output_" + std::to_string(sampleRate) + ".wav");
+        {
+            AudioIO audioIO;
+            OutputFormat format;
+            format.bitDepth = 32;
+            audioIO.SaveFile(input.string(),
+                             SyntheticSignal::GenerateStereo(SyntheticSignal::Kind::LowpassNoise, sampleRate, numSamples),
+                             sampleRate, format);
+        }
+
+        AudioProcessor processor;
+        AudioProcessor::Options options;
+        options.engine = engine;
+        const bool harmonic = engine == HFCompensation::Engine::Harmonic;
+        // Long inputs go through the segmented path
+        const int segmented = processor.ShouldSegment(input.string(), options) ? 1 : 0;
+        runner.Run(name, {P("sample_rate", sampleRate), P("seconds", seconds),
+                          P("multiplier", options.sampleRateMultiplier), P("segmented", segmented),
+                          P("engine", harmonic ? "harmonic" : "band_replication")},
+                   static_cast<double>(numSamples), "samples", seconds, [&]() {
+            if (!processor.ProcessFile(input.string(), output.string(), options)) {
+                std::cerr << "ProcessFile failed for " << input << std::endl;
+            }
+        }, 1);
+
+        fs::remove(input);
+        fs::remove(output);
+    };
+
+    for (int sampleRate : SAMPLE_RATES) {
+        runFile("process_file", sampleRate, settings.duration, HFCompensation::Engine::Harmonic);
+        runFile("process_file", sampleRate, settings.duration, HFCompensation::Engine::BandReplication);
+    }
+    if (settings.fullFile) {
+        runFile("process_file/plan_target", 44100, PLAN_TARGET_AUDIO_SECONDS, HFCompensation::Engine::Harmonic);
+    }
+}
+
+// A simulated audio host driving BlockProcessor: callbacks of random sizes,
+// each issued when the previous block would start playing and due before
+// its own block would. Fails if any callback is late or the output underruns.
+void BenchRealtime(Runner& runner, const Settings& settings) {
+    const std::string name = "realtime/host";
+    if (!settings.realtime || !runner.Wants(name)) return;
+    // With one hardware thread the host and the worker take turns, and every
+    // wakeup can be a scheduler timeslice late whatever the processor does
+    if (std::thread::hardware_concurrency() < 2) {
+        runner.Skip(name, "needs two hardware threads, for the host and the worker");
+        return;
+    }
+
+    const int sampleRate = 44100;
+    const int multiplier = 2;
+    const int minBlock = 16;
+    const int maxBlock = 1024;
+    const size_t numSamples = static_cast<size_t>(settings.duration * sampleRate);
+    const std::vector<std::vector<float>> input =
+        SyntheticSignal::GenerateStereo(SyntheticSignal::Kind::LowpassNoise, sampleRate, numSamples);
+    std::vector<std::vector<float>> output(2, std::vector<float>(static_cast<size_t>(maxBlock) * multiplier));
+
+    BlockProcessor processor;
+    if (!processor.Prepare(sampleRate, maxBlock, multiplier)) {
+        std::cerr << "BlockProcessor::Prepare failed" << std::endl;
+        Result result;
+        result.name = name;
+        result.failed = true;
+        runner.Add(std::move(result));
+        return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> blockSize(minBlock, maxBlock);
+    std::vector<double> times;
+    size_t misses = 0;
+    double worstSlackMs = 1e9;
+    const Clock::time_point start = Clock::now();
+    auto at = [&](size_t sample) {  // When `sample` starts playing
+        return start + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(static_cast<double>(sample) / sampleRate));
+    };
+    for (size_t pos = 0; pos < numSamples;) {
+        const int block = static_cast<int>(std::min<size_t>(blockSize(gen), numSamples - pos));
+        std::this_thread::sleep_until(at(pos));
+
+        const float* in[2] = {input[0].data() + pos, input[1].data() + pos};
+        float* out[2] = {output[0].data(), output[1].data()};
+        const Clock::time_point t0 = Clock::now();
+        processor.Process(in, out, block);
+        const Clock::time_point t1 = Clock::now();
+
+        times.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+        const double slackMs = std::chrono::duration<double, std::milli>(at(pos + block) - t1).count();
+        worstSlackMs = std::min(worstSlackMs, slackMs);
+        if (slackMs < 0.0) ++misses;
+        Consume(output[0]);
+        pos += block;
+    }
+
+    Result result;
+    result.name = name;
+    result.params = {P("sample_rate", sampleRate), P("multiplier", multiplier), P("min_block", minBlock),
+                     P("max_block", maxBlock), P("seconds", settings.duration)};
+    result.iterations = times.size();
+    double total = 0.0;
+    for (double t : times) total += t;
+    const double maxMs = *std::max_element(times.begin(), times.end());
+    std::sort(times.begin(), times.end());
+    result.minMs = times.front();
+    result.medianMs = times[times.size() / 2];
+    result.meanMs = total / times.size();
+    result.unit = "callbacks";
+    result.itemsPerSecond = 1000.0 / result.medianMs;
+    result.realtimeFactor = settings.duration / (total / 1000.0);
+    result.metrics = {P("max_ms", maxMs), P("worst_slack_ms", worstSlackMs),
+                      P("deadline_misses", static_cast<int>(misses)),
+                      P("underrun_frames", static_cast<int>(processor.UnderrunFrames())),
+                      P("dropped_frames", static_cast<int>(processor.DroppedFrames())),
+                      P("latency_ms", processor.LatencySeconds() * 1000.0)};
+    result.failed = misses > 0 || processor.UnderrunFrames() > 0 || processor.DroppedFrames() > 0;
+    runner.Add(std::move(result));
+}
+
+std::string Timestamp() {
+    std::time_t now = std::time(nullptr);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    return buffer;
+}
+
+void WriteJson(std::ostream& out, const std::vector<Result>& results) {
+    out << std::setprecision(6);
+    out << "{\n";
+    out << "  \"tool\": \"hrawiz-bench\",\n";
+    out << "  \"version\": \"" << HRAW_VERSION << "\",\n";
+#ifdef __VERSION__
+    out << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+#endif
+    out << "  \"simd\": \"" << Kernels::Name(Kernels::Active()) << "\",\n";
+    out << "  \"threads\": " << TaskScheduler::Shared().NumThreads() << ",\n";
+    out << "  \"trace_enabled\": " << (Trace::ENABLED ? "true" : "false") << ",\n";
+    out << "  \"timestamp\": \"" << Timestamp() << "\",\n";
+    out << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\", \"params\": {";
+        for (size_t p = 0; p < r.params.size(); ++p) {
+            out << (p ? ", " : "") << "\"" << r.params[p].key << "\": " << r.params[p].json;
+        }
+        out << "}, \"iterations\": " << r.iterations
+            << ", \"min_ms\": " << r.minMs
+            << ", \"median_ms\": " << r.medianMs
+            << ", \"mean_ms\": " << r.meanMs
+            << ", \"items_per_second\": " << r.itemsPerSecond
+            << ", \"unit\": \"" << r.unit << "\"";
+        if (r.realtimeFactor > 0.0) {
+            out << ", \"realtime_factor\": " << r.realtimeFactor;
+        }
+        for (const Param& metric : r.metrics) {
+            out << ", \"" << metric.key << "\": " << metric.json;
+        }
+        if (!r.metrics.empty()) {
+            out << ", \"failed\": " << (r.failed ? "true" : "false");
+        }
+        if (r.name == "process_file" || r.name == "process_file/plan_target") {
+            // Projected wall time for the PLAN.md 3-minute file at this speed
+            out << ", \"projected_plan_target_s\": " << PLAN_TARGET_AUDIO_SECONDS / r.realtimeFactor
+                << ", \"plan_target_s\": " << PLAN_TARGET_WALL_SECONDS;
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void PrintUsage() {
+    std::cerr << "Usage: hrawiz-bench [options]\n"
+              << "  --filter <text>     Only run cases whose name contains <text>\n"
+              << "  --min-time <sec>    Measurement time per case (default 0.5)\n"
+              << "  --duration <sec>    Length of synthetic audio for STFT/resampler/file cases (default 10)\n"
+              << "  --full              Also process a 3-minute 44.1 kHz file (PLAN.md target)\n"
+              << "  --realtime          Also drive the streaming processor from a simulated audio host\n"
+              << "                      for --duration seconds; exits non-zero on missed deadlines.\n"
+              << "                      Skipped with one hardware thread (exit 77 if nothing else ran)\n"
+              << "  --simd <isa>        Force the DSP kernels: scalar, sse4.2, avx2 or avx512\n"
+              << "  --threads <n>       Threads for the task scheduler (default: one per hardware thread)\n"
+              << "  --output <path>     Write JSON results to <path> instead of stdout\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // Keep per-job log lines out of the results table
+    Log::SetLevel(LogLevel::Warn);
+
+    Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue) {
+            settings.filter = argv[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            settings.minTime = std::atof(argv[++i]);
+        } else if (arg == "--duration" && hasValue) {
+            settings.duration = std::max(1.0, std::atof(argv[++i]));
+        } else if (arg == "--full") {
+            settings.fullFile = true;
+        } else if (arg == "--realtime") {
+            settings.realtime = true;
+        } else if (arg == "--output" && hasValue) {
+            settings.outputPath = argv[++i];
+        } else if (arg == "--simd" && hasValue) {
+            Kernels::Isa isa;
+            if (!Kernels::Parse(argv[++i], isa) || !Kernels::Force(isa)) {
+                std::cerr << "Can't use DSP kernels '" << argv[i] << "' on this machine" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--threads" && hasValue) {
+            TaskScheduler::Config config;
+            config.numThreads = std::max(1, std::atoi(argv[++i]));
+            TaskScheduler::Configure(config);
+        } else {
+            PrintUsage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    std::error_code ec;
+    const fs::path workDir = fs::temp_directory_path() / ("hrawiz-bench-" + std::to_string(std::random_device{}()));
+    fs::create_directories(workDir, ec);
+    if (ec) {
+        std::cerr << "Cannot create " << workDir << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    Runner runner(settings);
+    BenchFFT(runner);
+    BenchSTFT(runner, settings);
+    BenchResampler(runner, settings);
+    BenchKernels(runner);
+    BenchFramePipeline(runner);
+    BenchVectorKernels(runner);
+    BenchProcessFile(runner, settings, workDir);
+    BenchRealtime(runner, settings);
+
+    fs::remove_all(workDir, ec);
+
+    if (settings.outputPath.empty()) {
+        WriteJson(std::cout, runner.Results());
+    } else {
+        std::ofstream out(settings.outputPath);
+        WriteJson(out, runner.Results());
+        if (!out) {
+            std::cerr << "Failed to write " << settings.outputPath << std::endl;
+            return 1;
+        }
+    }
+    if (runner.AllSkipped()) return EXIT_SKIPPED;
+    return runner.AnyFailed() ? 2 : 0;
+}
@@ -0,0 +1,263 @@
+/*
+ * Checks libhrawiz through its C interface only, built as C the way an
+ * embedding program would use it: settings versioning, the planar and
+ * interleaved calls, the errors they report and reusing one context.
+ * Prints each failed check and exits nonzero if any failed.
+ */
+
+#include "hrawiz.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE 44100
+#define NUM_FRAMES (SAMPLE_RATE * 2)
+#define SHORT_FRAMES (SAMPLE_RATE / 2)
+
+static int failures = 0;
+
+#define CHECK(condition)                                                     \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #condition);                                             \
+            ++failures;                                                      \
+        }                                                                    \
+    } while (0)
+
+#define CHECK_STATUS(call, expected)                                               \
+    do {                                                                           \
+        hraw_status status_ = (call);                                              \
+        if (status_ != (expected)) {                                               \
+            fprintf(stderr, "%s:%d: %s returned %d, expected %d\n", __FILE__,      \
+                    __LINE__, #call, (int)status_, (int)(expected));               \
+            ++failures;                                                            \
+        }                                                                          \
+    } while (0)
+
+/* A settings struct from a newer header, with a field this one lacks */
+typedef struct newer_settings {
+    hraw_settings known;
+    int future_field;
+} newer_settings;
+
+static float* Allocate(size_t count) {
+    float* buffer = (float*)malloc(count * sizeof(float));
+    if (!buffer) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return buffer;
+}
+
+/* Two tones with a little noise, different per channel */
+static void FillSignal(float* left, float* right, size_t frames) {
+    uint32_t state = 12345;
+    for (size_t i = 0; i < frames; ++i) {
+        state = state * 1664525u + 1013904223u;
+        const float noise = 0.01f * ((float)(state >> 8) / 16777216.0f - 0.5f);
+        left[i] = 0.3f * sinf(0.05f * (float)i) + noise;
+        right[i] = 0.2f * sinf(0.031f * (float)i) - noise;
+    }
+}
+
+static int SameSamples(const float* a, const float* b, size_t count) {
+    return memcmp(a, b, count * sizeof(float)) == 0;
+}
+
+static void TestVersion(void) {
+    CHECK(hraw_api_version() == HRAW_API_VERSION);
+    CHECK(hraw_version() != NULL && strlen(hraw_version()) > 0);
+}
+
+static void TestSettings(void) {
+    hraw_settings settings;
+    hraw_default_settings(&settings);
+    CHECK(settings.size == sizeof(hraw_settings));
+
+    /* Null settings mean the defaults */
+    hraw_context* ctx = hraw_context_create(NULL);
+    CHECK(ctx != NULL);
+    CHECK(hraw_output_rate(ctx, SAMPLE_RATE) == SAMPLE_RATE * settings.rate_multiplier);
+
+    /* An unset size is refused, at creation and later */
+    hraw_settings unset = settings;
+    unset.size = 0;
+    CHECK(hraw_context_create(&unset) == NULL);
+    CHECK(strlen(hraw_last_error(NULL)) > 0);
+    CHECK_STATUS(hraw_context_configure(ctx, &unset), HRAW_ERROR_INVALID_ARGUMENT);
+    CHECK(strlen(hraw_last_error(ctx)) > 0);
+
+    /* An older caller knows only the fields up to rate_multiplier; whatever
+       follows them in its memory must not be read */
+    hraw_settings older = settings;
+    older.size = (uint32_t)(offsetof(hraw_settings, rate_multiplier) + sizeof(older.rate_multiplier));
+    older.rate_multiplier = 3;
+    older.engine = 99;
+    older.file_format = 99;
+    CHECK_STATUS(hraw_context_configure(ctx, &older), HRAW_OK);
+    CHECK(hraw_output_rate(ctx, SAMPLE_RATE) == SAMPLE_RATE * 3);
+    CHECK(strcmp(hraw_last_error(ctx), "") == 0);
+
+    /* Fields of a newer caller this library doesn't know are ignored */
+    newer_settings newer;
+    memset(&newer, 0, sizeof(newer));
+    hraw_default_settings(&newer.known);
+    newer.known.size = (uint32_t)sizeof(newer);
+    newer.known.rate_multiplier = 4;
+    newer.future_field = 1;
+    CHECK_STATUS(hraw_context_configure(ctx, &newer.known), HRAW_OK);
+    CHECK(hraw_output_rate(ctx, SAMPLE_RATE) == SAMPLE_RATE * 4);
+
+    /* Invalid values leave the settings in effect alone */
+    hraw_settings invalid = settings;
+    invalid.rate_multiplier = 99;
+    CHECK_STATUS(hraw_context_configure(ctx, &invalid), HRAW_ERROR_INVALID_ARGUMENT);
+    invalid = settings;
+    invalid.engine = 99;
+    CHECK_STATUS(hraw_context_configure(ctx, &invalid), HRAW_ERROR_INVALID_ARGUMENT);
+    CHECK(hraw_output_rate(ctx, SAMPLE_RATE) == SAMPLE_RATE * 4);
+
+    hraw_context_destroy(ctx);
+}
+
+/* Planar and interleaved calls, the errors they report and a context
+   reused across calls of different lengths */
+static void TestProcessing(void) {
+    hraw_settings settings;
+    hraw_default_settings(&settings);
+    settings.enable_hfc = 1;
+    settings.seed = 7;
+    hraw_context* ctx = hraw_context_create(&settings);
+    CHECK(ctx != NULL);
+    if (!ctx) return;
+
+    float* left = Allocate(NUM_FRAMES);
+    float* right = Allocate(NUM_FRAMES);
+    float* interleaved = Allocate(NUM_FRAMES * 2);
+    FillSignal(left, right, NUM_FRAMES);
+    for (size_t i = 0; i < NUM_FRAMES; ++i) {
+        interleaved[2 * i] = left[i];
+        interleaved[2 * i + 1] = right[i];
+    }
+    const float* in[2] = {left, right};
+
+    const size_t expected = hraw_output_frames(ctx, NUM_FRAMES, 2);
+    CHECK(expected > 0);
+    CHECK(hraw_output_frames(ctx, 16, 2) == 0);
+    float* outLeft = Allocate(expected);
+    float* outRight = Allocate(expected);
+    float* firstLeft = Allocate(expected);
+    float* firstRight = Allocate(expected);
+    float* outInterleaved = Allocate(expected * 2);
+    float* out[2] = {outLeft, outRight};
+    size_t frames = 0;
+
+    /* Too small an output buffer: the needed size comes back, nothing is written */
+    for (size_t i = 0; i < expected; ++i) outLeft[i] = outRight[i] = -2.0f;
+    CHECK_STATUS(hraw_process_planar(ctx, in, 2, NUM_FRAMES, SAMPLE_RATE, out, expected - 1, &frames),
+                 HRAW_ERROR_BUFFER_TOO_SMALL);
+    CHECK(frames == expected);
+    CHECK(strlen(hraw_last_error(ctx)) > 0);
+    CHECK(outLeft[0] == -2.0f && outRight[expected - 1] == -2.0f);
+
+    CHECK_STATUS(hraw_process_planar(ctx, in, 2, NUM_FRAMES, SAMPLE_RATE, out, expected, &frames), HRAW_OK);
+    CHECK(frames == expected);
+    CHECK(strcmp(hraw_last_error(ctx), "") == 0);
+    memcpy(firstLeft, outLeft, expected * sizeof(float));
+    memcpy(firstRight, outRight, expected * sizeof(float));
+
+    /* The interleaved call gives the same samples */
+    CHECK_STATUS(hraw_process_interleaved(ctx, interleaved, 2, NUM_FRAMES, SAMPLE_RATE, outInterleaved,
+                                          expected, &frames),
+                 HRAW_OK);
+    CHECK(frames == expected);
+    int same = 1;
+    for (size_t i = 0; i < expected && same; ++i) {
+        same = outInterleaved[2 * i] == firstLeft[i] && outInterleaved[2 * i + 1] == firstRight[i];
+    }
+    CHECK(same);
+
+    /* A shorter input on the same context, then the first one again: the
+       buffers kept from earlier calls don't change the output */
+    const size_t shortExpected = hraw_output_frames(ctx, SHORT_FRAMES, 2);
+    CHECK(shortExpected > 0 && shortExpected < expected);
+    CHECK_STATUS(hraw_process_planar(ctx, in, 2, SHORT_FRAMES, SAMPLE_RATE, out, expected, &frames), HRAW_OK);
+    CHECK(frames == shortExpected);
+    CHECK_STATUS(hraw_process_planar(ctx, in, 2, NUM_FRAMES, SAMPLE_RATE, out, expected, &frames), HRAW_OK);
+    CHECK(SameSamples(outLeft, firstLeft, expected) && SameSamples(outRight, firstRight, expected));
+
+    /* Mono skips HFC, which needs stereo, but still runs */
+    const size_t monoExpected = hraw_output_frames(ctx, NUM_FRAMES, 1);
+    CHECK(monoExpected == NUM_FRAMES * (size_t)settings.rate_multiplier);
+    float* mono = Allocate(monoExpected);
+    CHECK_STATUS(hraw_process_planar(ctx, in, 1, NUM_FRAMES, SAMPLE_RATE, &mono, monoExpected, &frames), HRAW_OK);
+    free(mono);
+
+    /* Argument errors */
+    CHECK_STATUS(hraw_process_planar(NULL, in, 2, NUM_FRAMES, SAMPLE_RATE, out, expected, &frames),
+                 HRAW_ERROR_INVALID_ARGUMENT);
+    CHECK_STATUS(hraw_process_planar(ctx, NULL, 2, NUM_FRAMES, SAMPLE_RATE, out, expected, &frames),
+                 HRAW_ERROR_INVALID_ARGUMENT);
+    CHECK_STATUS(hraw_process_interleaved(ctx, interleaved, 0, NUM_FRAMES, SAMPLE_RATE, outInterleaved,
+                                          expected, &frames),
+                 HRAW_ERROR_INVALID_ARGUMENT);
+    CHECK_STATUS(hraw_process_interleaved(ctx, interleaved, 2, NUM_FRAMES, 0, outInterleaved, expected, &frames),
+                 HRAW_ERROR_INVALID_ARGUMENT);
+    CHECK_STATUS(hraw_process_planar(ctx, in, 2, 16, SAMPLE_RATE, out, expected, &frames), HRAW_ERROR_PROCESSING);
+    CHECK_STATUS(hraw_process_file(ctx, "/nonexistent/input.wav", "/nonexistent/output.wav"), HRAW_ERROR_IO);
+    CHECK(strlen(hraw_last_error(ctx)) > 0);
+
+    /* An input too long to stage makes the library throw inside; that must
+       come back as a status, and leave the context usable. Nothing reads
+       the input before the staging buffer is sized. */
+    settings.enable_hfc = 0;
+    CHECK_STATUS(hraw_context_configure(ctx, &settings), HRAW_OK);
+    const size_t huge = SIZE_MAX / 2;
+    CHECK(hraw_output_frames(ctx, huge, 2) == huge);
+    const hraw_status thrown = hraw_process_interleaved(ctx, interleaved, 2, huge, SAMPLE_RATE, outInterleaved,
+                                                        SIZE_MAX, &frames);
+    CHECK(thrown == HRAW_ERROR_PROCESSING || thrown == HRAW_ERROR_OUT_OF_MEMORY);
+    CHECK(strlen(hraw_last_error(ctx)) > 0);
+
+    settings.enable_hfc = 1;
+    CHECK_STATUS(hraw_context_configure(ctx, &settings), HRAW_OK);
+    CHECK_STATUS(hraw_process_planar(ctx, in, 2, NUM_FRAMES, SAMPLE_RATE, out, expected, &frames), HRAW_OK);
+    CHECK(SameSamples(outLeft, firstLeft, expected) && SameSamples(outRight, firstRight, expected));
+
+    /* A fresh context agrees with the reused one */
+    hraw_context* fresh = hraw_context_create(&settings);
+    CHECK(fresh != NULL);
+    if (fresh) {
+        CHECK_STATUS(hraw_process_planar(fresh, in, 2, NUM_FRAMES, SAMPLE_RATE, out, expected, &frames), HRAW_OK);
+        CHECK(SameSamples(outLeft, firstLeft, expected) && SameSamples(outRight, firstRight, expected));
+        hraw_context_destroy(fresh);
+    }
+
+    free(left);
+    free(right);
+    free(interleaved);
+    free(outLeft);
+    free(outRight);
+    free(firstLeft);
+    free(firstRight);
+    free(outInterleaved);
+    hraw_context_destroy(ctx);
+}
+
+int main(void) {
+    TestVersion();
+    TestSettings();
+    TestProcessing();
+    hraw_context_destroy(NULL);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All C API checks passed\n");
+    return 0;
+}
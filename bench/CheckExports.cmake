@@ -0,0 +1,51 @@
+# Fails unless LIBRARY exports exactly the functions HEADER declares with
+# HRAW_API: none missing, and nothing of the core, KissFFT or the C++
+# standard library leaking out.
+#   cmake -DNM=<nm> -DLIBRARY=<libhrawiz.so> -DHEADER=<hrawiz.h> -P CheckExports.cmake
+
+file(STRINGS ${HEADER} declarations REGEX "^HRAW_API ")
+set(expected)
+foreach(declaration IN LISTS declarations)
+    if(declaration MATCHES "(hraw_[a-z_]+)\\(")
+        list(APPEND expected ${CMAKE_MATCH_1})
+    endif()
+endforeach()
+list(SORT expected)
+
+execute_process(COMMAND ${NM} -D --defined-only ${LIBRARY}
+                OUTPUT_VARIABLE listing
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${NM} failed on ${LIBRARY}")
+endif()
+string(REPLACE "\n" ";" lines "${listing}")
+set(exported)
+foreach(line IN LISTS lines)
+    if(line MATCHES "^[0-9a-fA-F]* *[A-Za-z] ([^@ ]+)")
+        list(APPEND exported ${CMAKE_MATCH_1})
+    endif()
+endforeach()
+list(SORT exported)
+
+set(missing ${expected})
+if(exported)
+    list(REMOVE_ITEM missing ${exported})
+endif()
+set(leaked ${exported})
+if(expected)
+    list(REMOVE_ITEM leaked ${expected})
+endif()
+if(missing OR leaked)
+    set(report "${LIBRARY} exports the wrong symbols")
+    if(missing)
+        string(REPLACE ";" "\n  " missing "${missing}")
+        string(APPEND report "\nMissing:\n  ${missing}")
+    endif()
+    if(leaked)
+        string(REPLACE ";" "\n  " leaked "${leaked}")
+        string(APPEND report "\nUnexpected:\n  ${leaked}")
+    endif()
+    message(FATAL_ERROR "${report}")
+endif()
+list(LENGTH exported count)
+message(STATUS "${LIBRARY} exports the ${count} hraw_* functions only")
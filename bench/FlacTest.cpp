@@ -0,0 +1,176 @@
+// hrawiz-flac-test: FlacEncoder round trip.
+//
+//   hrawiz-flac-test <dir>   encode the cases into <dir> and decode them
+//
+// Each case is encoded with FlacEncoder::EncodeFile without dither, decoded
+// with libsndfile and must come back sample for sample as the input
+// quantized to the case's bit depth. Exits non-zero on any mismatch.
+// Files are removed once they pass.
+
+#include "Signals.h"
+#include "audio/FlacEncoder.h"
+#include "audio/SampleConvert.h"
+#include "util/Log.h"
+
+#include <sndfile.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Longer than a frame group, ending in a short frame
+const size_t LONG_SAMPLES = FlacEncoder::GROUP_SAMPLES + 3 * FlacEncoder::BLOCK_SIZE + 777;
+
+struct Case {
+    std::string name;
+    std::vector<std::vector<float>> channels;
+    int sampleRate;
+    int bitDepth;
+};
+
+std::vector<Case> Cases() {
+    using Kind = SyntheticSignal::Kind;
+    std::vector<Case> cases;
+    for (Kind kind : SyntheticSignal::ALL) {
+        for (int bitDepth : {16, 24}) {
+            cases.push_back({std::string(SyntheticSignal::Name(kind)) + "_" + std::to_string(bitDepth),
+                             SyntheticSignal::GenerateStereo(kind, 44100, LONG_SAMPLES), 44100, bitDepth});
+        }
+    }
+    for (int bitDepth : {16, 24}) {
+        cases.push_back({"mono_" + std::to_string(bitDepth),
+                         {SyntheticSignal::Generate(Kind::HarmonicStack, 48000, 3 * FlacEncoder::BLOCK_SIZE + 5)},
+                         48000, bitDepth});
+    }
+
+    // A single frame shorter than the block size
+    cases.push_back({"short_24", SyntheticSignal::GenerateStereo(Kind::Noise, 96000, 1000), 96000, 24});
+
+    // Silence, then a constant block, then full scale either way, which
+    // clamps, then noise: every subframe type in one stream
+    const size_t block = FlacEncoder::BLOCK_SIZE;
+    for (int bitDepth : {16, 24}) {
+        std::vector<std::vector<float>> channels = SyntheticSignal::GenerateStereo(Kind::Noise, 44100, 5 * block);
+        for (size_t i = 0; i < 3 * block; ++i) {
+            const float level = i < block ? 0.0f : i < 2 * block ? 0.25f : 1.0f;
+            channels[0][i] = level;
+            channels[1][i] = i < 2 * block ? level : -level;
+        }
+        cases.push_back({"constant_" + std::to_string(bitDepth), channels, 44100, bitDepth});
+    }
+    cases.push_back({"silent_16", {std::vector<float>(2 * block), std::vector<float>(2 * block)}, 44100, 16});
+    return cases;
+}
+
+// The input as the encoder stores it, clamped and rounded to `bitDepth`,
+// interleaved in 32-bit words the way libsndfile reads it back
+std::vector<int32_t> Quantize(const Case& c) {
+    const int numChannels = static_cast<int>(c.channels.size());
+    const size_t numFrames = c.channels[0].size();
+    std::vector<const float*> src;
+    for (const std::vector<float>& channel : c.channels) src.push_back(channel.data());
+
+    std::vector<int32_t> samples(numFrames * numChannels);
+    SampleConvert::DitherState state(SampleConvert::Dither::None, c.bitDepth);
+    SampleConvert::InterleaveDithered(src.data(), samples.data(), SampleConvert::Format::PCM32, numChannels,
+                                      numFrames, state);
+    return samples;
+}
+
+// Decode `path` and compare it with `c`; empty if it matches
+std::string Check(const fs::path& path, const Case& c) {
+    SF_INFO info;
+    std::memset(&info, 0, sizeof(info));
+    SNDFILE* file = sf_open(path.string().c_str(), SFM_READ, &info);
+    if (!file) {
+        return std::string("libsndfile can't open it: ") + sf_strerror(nullptr);
+    }
+
+    const int numChannels = static_cast<int>(c.channels.size());
+    const size_t numFrames = c.channels[0].size();
+    const int subtype = c.bitDepth == 16 ? SF_FORMAT_PCM_16 : SF_FORMAT_PCM_24;
+    std::ostringstream problem;
+    if ((info.format & SF_FORMAT_TYPEMASK) != SF_FORMAT_FLAC || (info.format & SF_FORMAT_SUBMASK) != subtype ||
+        info.channels != numChannels || info.samplerate != c.sampleRate ||
+        info.frames != static_cast<sf_count_t>(numFrames)) {
+        problem << "header says " << info.channels << " channels, " << info.frames << " frames at "
+                << info.samplerate << " Hz, format 0x" << std::hex << info.format;
+        sf_close(file);
+        return problem.str();
+    }
+
+    // One frame more than expected, to see the stream end where it should
+    std::vector<int> decoded((numFrames + 1) * numChannels);
+    const sf_count_t read = sf_readf_int(file, decoded.data(), static_cast<sf_count_t>(numFrames + 1));
+    const int error = sf_error(file);
+    sf_close(file);
+    if (error != SF_ERR_NO_ERROR || read != static_cast<sf_count_t>(numFrames)) {
+        problem << "decoded " << read << " frames" << (error != SF_ERR_NO_ERROR ? " with an error" : "");
+        return problem.str();
+    }
+
+    const std::vector<int32_t> expected = Quantize(c);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (decoded[i] != expected[i]) {
+            const int shift = 32 - c.bitDepth;
+            problem << "frame " << i / numChannels << " channel " << i % numChannels << " decoded as "
+                    << (decoded[i] >> shift) << ", encoded " << (expected[i] >> shift);
+            return problem.str();
+        }
+    }
+    return std::string();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Log::SetLevel(LogLevel::Warn);
+
+    if (argc != 2 || argv[1][0] == '-') {
+        std::cerr << "Usage: hrawiz-flac-test <dir>" << std::endl;
+        return 1;
+    }
+    const fs::path dir = argv[1];
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Cannot create " << dir << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    const std::vector<Case> cases = Cases();
+    int failures = 0;
+    for (const Case& c : cases) {
+        const fs::path path = dir / (c.name + ".flac");
+        std::string problem;
+        if (!FlacEncoder::EncodeFile(path.string(), c.channels, c.sampleRate, c.bitDepth,
+                                     SampleConvert::Dither::None)) {
+            problem = "encoding failed";
+        } else {
+            problem = Check(path, c);
+        }
+
+        std::cerr << std::left << std::setw(24) << c.name << std::right << (problem.empty() ? "ok  " : "FAIL")
+                  << "  " << c.channels.size() << "x" << c.channels[0].size() << " @ " << c.sampleRate << " Hz, "
+                  << c.bitDepth << " bits" << std::endl;
+        if (problem.empty()) {
+            fs::remove(path, ec);
+        } else {
+            std::cerr << "    " << problem << "; kept " << path << std::endl;
+            ++failures;
+        }
+    }
+
+    std::cerr << (failures ? "FAILED: " : "Passed: ") << cases.size() - failures << "/" << cases.size()
+              << " cases" << std::endl;
+    return failures ? 1 : 0;
+}
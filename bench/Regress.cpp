@@ -0,0 +1,552 @@
+// hrawiz-regress: golden-output and performance regression checks.
+//
+//   hrawiz-regress generate <dir>   process the synthetic corpus with a fixed
+//                                   seed and store outputs plus a baseline
+//   hrawiz-regress check <dir>      reprocess and compare against <dir>
+//   hrawiz-regress segments <dir>   render long inputs in <dir> both in
+//                                   segments and whole; files must match
+//
+// Outputs are compared bit for bit and, failing that, against a max-abs
+// tolerance. With --perf, throughput and peak RSS per case are compared
+// against the baseline with a configurable slack too; timings depend on
+// the machine and its load, so that is left to runs on a quiet machine.
+// Exits non-zero on any regression, and with EXIT_SKIPPED when `check` is
+// given no baseline directory (ctest, with HRAW_REGRESS_BASELINE unset).
+// Everything runs in memory; no network or external files are needed.
+
+#include "Signals.h"
+#include "audio/AnalysisCache.h"
+#include "audio/AudioIO.h"
+#include "audio/AudioProcessor.h"
+#include "dsp/Kernels.h"
+#include "util/Log.h"
+#include "util/Memory.h"
+#include "util/TaskScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef HRAW_VERSION
+#define HRAW_VERSION "dev"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const int SAMPLE_RATES[] = {44100, 48000};
+const char* const MANIFEST = "baseline.txt";
+
+constexpr uint32_t SEED = 20240501;
+constexpr double DURATION_SECONDS = 3.0;
+
+// Exit status when there was nothing to check against
+constexpr int EXIT_SKIPPED = 77;
+
+struct Settings {
+    std::string command;
+    fs::path dir;
+    double tolerance = 1e-5;   // Max abs sample difference still accepted
+    bool bitwise = false;      // Reject anything that isn't bit-identical
+    bool checkPerf = false;    // Also fail on throughput and memory regressions
+    double throughputSlack = 0.25;  // Allowed fractional throughput drop
+    double memorySlack = 0.25;      // Allowed fractional peak RSS growth
+    int runs = 3;              // Timed runs per case after a warm-up; the fastest counts
+    bool lowMemory = false;    // Process with the low-memory path
+    bool keep = false;         // generate leaves an existing baseline alone
+};
+
+// Outputs a few segments long, rendered by ProcessFile in segments and by
+// the stages on the whole file. The odd input lengths leave a short last
+// segment, and multipliers that don't divide the hop move segment reads off
+// the STFT frame grid; 16-bit and FLAC outputs check dither and encoder
+// state across the writer's joins.
+struct SegmentCase {
+    const char* name;
+    bool enableHFC;
+    int multiplier;
+    OutputFormat::Container container;
+    int bitDepth;
+};
+
+const SegmentCase SEGMENT_CASES[] = {
+    {"hfc_off_float", false, 1, OutputFormat::Container::WAV, 32},
+    {"hfc_off_wav16", false, 1, OutputFormat::Container::WAV, 16},
+    {"hfc_off_flac24", false, 1, OutputFormat::Container::FLAC, 24},
+    {"hfc_x2_float", true, 2, OutputFormat::Container::WAV, 32},
+    {"hfc_x3_float", true, 3, OutputFormat::Container::WAV, 32},
+};
+
+struct Case {
+    std::string name;
+    SyntheticSignal::Kind kind;
+    int sampleRate;
+};
+
+// One line of the manifest
+struct Baseline {
+    std::string name;
+    int numChannels = 0;
+    size_t numSamples = 0;
+    int sampleRate = 0;
+    double samplesPerSecond = 0.0;  // Input samples processed per wall second
+    long peakRssKb = 0;
+};
+
+struct Measurement {
+    AudioProcessor::AudioData output;
+    double samplesPerSecond = 0.0;
+    long peakRssKb = 0;
+    bool deterministic = true;  // Every timed run matched the first bit for bit
+};
+
+std::vector<Case> Corpus() {
+    std::vector<Case> cases;
+    for (SyntheticSignal::Kind kind : SyntheticSignal::ALL) {
+        for (int sampleRate : SAMPLE_RATES) {
+            cases.push_back({std::string(SyntheticSignal::Name(kind)) + "_" + std::to_string(sampleRate),
+                             kind, sampleRate});
+        }
+    }
+    return cases;
+}
+
+AudioProcessor::AudioData MakeInput(const Case& c) {
+    AudioProcessor::AudioData audio;
+    audio.sampleRate = c.sampleRate;
+    audio.numSamples = static_cast<size_t>(DURATION_SECONDS * c.sampleRate);
+    audio.channels = SyntheticSignal::GenerateStereo(c.kind, c.sampleRate, audio.numSamples);
+    audio.numChannels = static_cast<int>(audio.channels.size());
+    return audio;
+}
+
+bool Identical(const AudioProcessor::AudioData& a, const AudioProcessor::AudioData& b) {
+    if (a.channels.size() != b.channels.size()) return false;
+    for (size_t ch = 0; ch < a.channels.size(); ++ch) {
+        const std::vector<float>& x = a.channels[ch];
+        const std::vector<float>& y = b.channels[ch];
+        if (x.size() != y.size() || std::memcmp(x.data(), y.data(), x.size() * sizeof(float)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Measure(const Case& c, const Settings& settings, Measurement& result) {
+    using Clock = std::chrono::steady_clock;
+    AudioProcessor processor;
+    AudioProcessor::Options options;
+    options.seed = SEED;
+
+    AudioProcessor::AudioData input = MakeInput(c);
+    input.lowMemory = settings.lowMemory;
+    const bool perCasePeak = Memory::ResetPeakRss();
+    double bestSeconds = 0.0;
+
+    // Run 0 warms up and produces the output the timed runs must reproduce
+    for (int run = 0; run <= std::max(1, settings.runs); ++run) {
+        AudioProcessor::AudioData audio = input;
+        const Clock::time_point start = Clock::now();
+        const bool ok = processor.Process(audio, options);
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (!ok) {
+            std::cerr << c.name << ": processing failed" << std::endl;
+            return false;
+        }
+
+        if (run == 0) {
+            result.output = std::move(audio);
+        } else {
+            result.deterministic = result.deterministic && Identical(result.output, audio);
+            bestSeconds = run == 1 ? seconds : std::min(bestSeconds, seconds);
+        }
+    }
+
+    result.samplesPerSecond = input.numSamples / bestSeconds;
+    result.peakRssKb = static_cast<long>(Memory::PeakRss() / 1024);
+    if (!perCasePeak) {
+        result.peakRssKb = 0;  // A process-wide peak says nothing about this case
+    }
+    return true;
+}
+
+// References are the channels back to back as native float32
+bool WriteReference(const fs::path& path, const AudioProcessor::AudioData& audio) {
+    std::ofstream out(path, std::ios::binary);
+    for (const std::vector<float>& channel : audio.channels) {
+        out.write(reinterpret_cast<const char*>(channel.data()), channel.size() * sizeof(float));
+    }
+    return static_cast<bool>(out);
+}
+
+bool ReadReference(const fs::path& path, const Baseline& baseline, std::vector<std::vector<float>>& channels) {
+    std::ifstream in(path, std::ios::binary);
+    channels.assign(baseline.numChannels, std::vector<float>(baseline.numSamples));
+    for (std::vector<float>& channel : channels) {
+        in.read(reinterpret_cast<char*>(channel.data()), channel.size() * sizeof(float));
+    }
+    return static_cast<bool>(in);
+}
+
+bool WriteManifest(const fs::path& path, const std::vector<Baseline>& baselines) {
+    std::ofstream out(path);
+    out << "# hrawiz-regress baseline, regenerate with: hrawiz-regress generate <dir>\n";
+    out << "# name channels samples sample_rate samples_per_second peak_rss_kb\n";
+    out << "version " << HRAW_VERSION << "\n";
+    out << "seed " << SEED << "\n";
+    out << std::setprecision(9);
+    for (const Baseline& b : baselines) {
+        out << "case " << b.name << " " << b.numChannels << " " << b.numSamples << " " << b.sampleRate << " "
+            << b.samplesPerSecond << " " << b.peakRssKb << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+bool ReadManifest(const fs::path& path, std::vector<Baseline>& baselines) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        if (!(fields >> key) || key[0] == '#' || key == "version") continue;
+
+        if (key == "seed") {
+            uint32_t seed = 0;
+            fields >> seed;
+            if (seed != SEED) {
+                std::cerr << "Baseline was generated with seed " << seed << ", expected " << SEED << std::endl;
+                return false;
+            }
+        } else if (key == "case") {
+            Baseline b;
+            if (!(fields >> b.name >> b.numChannels >> b.numSamples >> b.sampleRate >> b.samplesPerSecond
+                        >> b.peakRssKb)) {
+                std::cerr << "Malformed manifest line: " << line << std::endl;
+                return false;
+            }
+            baselines.push_back(b);
+        }
+    }
+    return true;
+}
+
+int Generate(const Settings& settings) {
+    if (settings.keep && fs::exists(settings.dir / MANIFEST)) {
+        std::cerr << "Keeping the baseline in " << settings.dir << std::endl;
+        return 0;
+    }
+
+    std::error_code ec;
+    fs::create_directories(settings.dir, ec);
+    if (ec) {
+        std::cerr << "Cannot create " << settings.dir << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    std::vector<Baseline> baselines;
+    for (const Case& c : Corpus()) {
+        Measurement m;
+        if (!Measure(c, settings, m)) return 1;
+        if (!m.deterministic) {
+            std::cerr << c.name << ": output differs between runs, refusing to record it" << std::endl;
+            return 1;
+        }
+
+        Baseline b;
+        b.name = c.name;
+        b.numChannels = m.output.numChannels;
+        b.numSamples = m.output.numSamples;
+        b.sampleRate = m.output.sampleRate;
+        b.samplesPerSecond = m.samplesPerSecond;
+        b.peakRssKb = m.peakRssKb;
+        if (!WriteReference(settings.dir / (c.name + ".f32"), m.output)) {
+            std::cerr << "Failed to write reference for " << c.name << std::endl;
+            return 1;
+        }
+        baselines.push_back(b);
+        std::cerr << std::left << std::setw(24) << c.name << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(12) << b.samplesPerSecond << " samples/s" << std::setw(10) << b.peakRssKb << " KiB"
+                  << std::endl;
+    }
+
+    if (!WriteManifest(settings.dir / MANIFEST, baselines)) {
+        std::cerr << "Failed to write " << settings.dir / MANIFEST << std::endl;
+        return 1;
+    }
+    std::cerr << "Recorded " << baselines.size() << " cases in " << settings.dir << std::endl;
+    return 0;
+}
+
+int Check(const Settings& settings) {
+    if (settings.dir.empty()) {
+        std::cerr << "No baseline to check against; record one from a known-good build with "
+                  << "`hrawiz-regress generate <dir>` and pass <dir>" << std::endl;
+        return EXIT_SKIPPED;
+    }
+    std::vector<Baseline> baselines;
+    if (!ReadManifest(settings.dir / MANIFEST, baselines)) return 1;
+
+    const std::vector<Case> corpus = Corpus();
+    int failures = 0;
+    for (const Baseline& b : baselines) {
+        auto it = std::find_if(corpus.begin(), corpus.end(), [&](const Case& c) { return c.name == b.name; });
+        if (it == corpus.end()) {
+            std::cerr << b.name << ": no such case in this build" << std::endl;
+            ++failures;
+            continue;
+        }
+
+        Measurement m;
+        if (!Measure(*it, settings, m)) {
+            ++failures;
+            continue;
+        }
+
+        std::vector<std::string> problems;
+        std::string verdict;
+        if (!m.deterministic) {
+            problems.push_back("output differs between runs");
+        }
+        if (m.output.numChannels != b.numChannels || m.output.numSamples != b.numSamples ||
+            m.output.sampleRate != b.sampleRate) {
+            std::ostringstream ss;
+            ss << "shape " << m.output.numChannels << "x" << m.output.numSamples << " @ " << m.output.sampleRate
+               << " Hz, expected " << b.numChannels << "x" << b.numSamples << " @ " << b.sampleRate << " Hz";
+            problems.push_back(ss.str());
+        } else {
+            AudioProcessor::AudioData reference;
+            if (!ReadReference(settings.dir / (b.name + ".f32"), b, reference.channels)) {
+                problems.push_back("cannot read reference");
+            } else if (Identical(m.output, reference)) {
+                verdict = "bit-exact";
+            } else {
+                double maxDiff = 0.0;
+                for (size_t ch = 0; ch < reference.channels.size(); ++ch) {
+                    for (size_t i = 0; i < b.numSamples; ++i) {
+                        const double diff = std::abs(static_cast<double>(m.output.channels[ch][i]) -
+                                                     reference.channels[ch][i]);
+                        // NaN never compares greater, so catch it explicitly
+                        if (!(diff <= maxDiff)) maxDiff = std::isnan(diff) ? INFINITY : diff;
+                    }
+                }
+                std::ostringstream ss;
+                ss << std::scientific << std::setprecision(2) << "max diff " << maxDiff;
+                verdict = ss.str();
+                if (settings.bitwise || maxDiff > settings.tolerance) {
+                    problems.push_back(ss.str() + " exceeds " + (settings.bitwise ? "bitwise" : "tolerance"));
+                }
+            }
+        }
+
+        if (settings.checkPerf) {
+            const double minThroughput = b.samplesPerSecond * (1.0 - settings.throughputSlack);
+            if (m.samplesPerSecond < minThroughput) {
+                std::ostringstream ss;
+                ss << std::fixed << std::setprecision(0) << "throughput " << m.samplesPerSecond
+                   << " samples/s, baseline " << b.samplesPerSecond;
+                problems.push_back(ss.str());
+            }
+            // Skipped when either side couldn't measure a per-case peak
+            const double maxRss = b.peakRssKb * (1.0 + settings.memorySlack);
+            if (b.peakRssKb > 0 && m.peakRssKb > 0 && m.peakRssKb > maxRss) {
+                std::ostringstream ss;
+                ss << "peak RSS " << m.peakRssKb << " KiB, baseline " << b.peakRssKb << " KiB";
+                problems.push_back(ss.str());
+            }
+        }
+
+        std::cerr << std::left << std::setw(24) << b.name << std::right << (problems.empty() ? "ok  " : "FAIL")
+                  << "  " << verdict << std::fixed << std::setprecision(0) << ", " << m.samplesPerSecond
+                  << " samples/s, " << m.peakRssKb << " KiB" << std::endl;
+        for (const std::string& problem : problems) {
+            std::cerr << "    " << problem << std::endl;
+        }
+        if (!problems.empty()) ++failures;
+    }
+
+    if (baselines.empty()) {
+        std::cerr << "Baseline in " << settings.dir << " has no cases" << std::endl;
+        return 1;
+    }
+    std::cerr << (failures ? "FAILED: " : "Passed: ") << baselines.size() - failures << "/" << baselines.size()
+              << " cases" << std::endl;
+    return failures ? 1 : 0;
+}
+
+bool ReadFile(const fs::path& path, std::vector<char>& bytes) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Render each SegmentCase both ways and compare the files byte for byte.
+// The segmented render goes through ProcessFile with an analysis cache
+// attached, as the GUI runs it, so it must still choose to segment.
+int Segments(const Settings& settings) {
+    std::error_code ec;
+    fs::create_directories(settings.dir, ec);
+    if (ec) {
+        std::cerr << "Cannot create " << settings.dir << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    const int sampleRate = SAMPLE_RATES[0];
+    int failures = 0;
+    for (const SegmentCase& c : SEGMENT_CASES) {
+        AudioProcessor::Options options;
+        options.seed = SEED;
+        options.enableHFC = c.enableHFC;
+        options.sampleRateMultiplier = c.multiplier;
+        options.outputFormat.container = c.container;
+        options.outputFormat.bitDepth = c.bitDepth;
+
+        const size_t numSamples = (5 * AudioProcessor::SEGMENT_SAMPLES / 2) / c.multiplier + 1237;
+        const std::string extension = options.outputFormat.Extension();
+        const fs::path input = settings.dir / (std::string(c.name) + "_input.wav");
+        const fs::path segmented = settings.dir / (std::string(c.name) + "_segmented" + extension);
+        const fs::path whole = settings.dir / (std::string(c.name) + "_whole" + extension);
+        const auto channels = SyntheticSignal::GenerateStereo(SyntheticSignal::Kind::HarmonicStack, sampleRate,
+                                                              numSamples);
+        if (!AudioIO().SaveFile(input.string(), channels, sampleRate, 32)) {
+            std::cerr << c.name << ": cannot write " << input << std::endl;
+            return 1;
+        }
+
+        std::string problem;
+        AnalysisCache cache(static_cast<uint64_t>(1) << 30);
+        AudioProcessor segmenting;
+        segmenting.SetAnalysisCache(&cache);
+        AudioProcessor::AudioData audio;
+        AudioProcessor stages;
+        std::vector<char> a, b;
+        if (!segmenting.ShouldSegment(input.string(), options)) {
+            problem = "not segmented";
+        } else if (!segmenting.ProcessFile(input.string(), segmented.string(), options)) {
+            problem = "segmented render failed";
+        } else if (!stages.Decode(input.string(), audio, options) || !stages.Process(audio, options) ||
+                   !stages.Encode(whole.string(), audio, options)) {
+            problem = "whole-file render failed";
+        } else if (!ReadFile(segmented, a) || !ReadFile(whole, b)) {
+            problem = "cannot read the outputs back";
+        } else if (a != b) {
+            const auto mismatch = std::mismatch(a.begin(), a.end(), b.begin(), b.end());
+            std::ostringstream ss;
+            ss << "files differ from byte " << (mismatch.first - a.begin()) << " (" << a.size() << " and "
+               << b.size() << " bytes)";
+            problem = ss.str();
+        }
+
+        const size_t outputSamples = AudioProcessor::OutputLength(numSamples, 2, options);
+        std::cerr << std::left << std::setw(24) << c.name << std::right << (problem.empty() ? "ok  " : "FAIL")
+                  << "  " << outputSamples << " samples, "
+                  << (outputSamples + AudioProcessor::SEGMENT_SAMPLES - 1) / AudioProcessor::SEGMENT_SAMPLES
+                  << " segments" << std::endl;
+        if (!problem.empty()) {
+            std::cerr << "    " << problem << "; files kept in " << settings.dir << std::endl;
+            ++failures;
+        } else if (!settings.keep) {
+            fs::remove(input, ec);
+            fs::remove(segmented, ec);
+            fs::remove(whole, ec);
+        }
+    }
+
+    const size_t numCases = std::size(SEGMENT_CASES);
+    std::cerr << (failures ? "FAILED: " : "Passed: ") << numCases - failures << "/" << numCases << " cases"
+              << std::endl;
+    return failures ? 1 : 0;
+}
+
+void PrintUsage() {
+    std::cerr << "Usage: hrawiz-regress generate|check|segments <dir> [options]\n"
+              << "  --tolerance <x>         Max abs sample difference accepted (default 1e-5)\n"
+              << "  --bitwise               Require bit-identical output\n"
+              << "  --perf                  Also fail on a throughput drop or peak RSS growth against\n"
+              << "                          the baseline; timing-sensitive, run on a quiet machine\n"
+              << "  --no-perf               Skip throughput and memory checks (the default)\n"
+              << "  --throughput-slack <f>  Allowed throughput drop as a fraction (default 0.25)\n"
+              << "  --memory-slack <f>      Allowed peak RSS growth as a fraction (default 0.25)\n"
+              << "  --runs <n>              Timed runs per case, fastest counts (default 3)\n"
+              << "  --low-memory            Process with the low-memory path; output must still match\n"
+              << "  --simd <isa>            Force the DSP kernels: scalar, sse4.2, avx2 or avx512; all\n"
+              << "                          must match the same references bit for bit\n"
+              << "  --threads <n>           Threads for the task scheduler; any count must match bit for bit\n"
+              << "  --keep                  generate: leave an existing baseline in <dir> as it is;\n"
+              << "                          segments: keep the files that matched too\n"
+              << "Performance baselines are machine specific; generate them on the machine that checks.\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Log::SetLevel(LogLevel::Warn);
+
+    Settings settings;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--tolerance" && hasValue) {
+            settings.tolerance = std::atof(argv[++i]);
+        } else if (arg == "--bitwise") {
+            settings.bitwise = true;
+        } else if (arg == "--perf") {
+            settings.checkPerf = true;
+        } else if (arg == "--no-perf") {
+            settings.checkPerf = false;
+        } else if (arg == "--throughput-slack" && hasValue) {
+            settings.throughputSlack = std::atof(argv[++i]);
+        } else if (arg == "--memory-slack" && hasValue) {
+            settings.memorySlack = std::atof(argv[++i]);
+        } else if (arg == "--low-memory") {
+            settings.lowMemory = true;
+        } else if (arg == "--keep") {
+            settings.keep = true;
+        } else if (arg == "--runs" && hasValue) {
+            settings.runs = std::atoi(argv[++i]);
+        } else if (arg == "--simd" && hasValue) {
+            Kernels::Isa isa;
+            if (!Kernels::Parse(argv[++i], isa) || !Kernels::Force(isa)) {
+                std::cerr << "Can't use DSP kernels '" << argv[i] << "' on this machine" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--threads" && hasValue) {
+            TaskScheduler::Config config;
+            config.numThreads = std::max(1, std::atoi(argv[++i]));
+            TaskScheduler::Configure(config);
+        } else if (arg.compare(0, 2, "--") != 0 && arg != "-h") {
+            positional.push_back(arg);
+        } else {
+            PrintUsage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    if (positional.size() != 2 ||
+        (positional[0] != "generate" && positional[0] != "check" && positional[0] != "segments")) {
+        PrintUsage();
+        return 1;
+    }
+    settings.command = positional[0];
+    settings.dir = positional[1];
+
+    if (settings.command == "segments") return Segments(settings);
+    return settings.command == "generate" ? Generate(settings) : Check(settings);
+}
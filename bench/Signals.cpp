@@ -0,0 +1,114 @@
+#include "Signals.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr float LEVEL = 0.25f;
+constexpr double LOWPASS_HZ = 16000.0;
+
+// Direct-form I biquad, used in cascade for the band-limited noise
+struct Biquad {
+    double b0, b1, b2, a1, a2;
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+    // RBJ cookbook lowpass
+    Biquad(double cutoff, int sampleRate, double q) {
+        const double w0 = 2.0 * PI * cutoff / sampleRate;
+        const double alpha = std::sin(w0) / (2.0 * q);
+        const double cosw = std::cos(w0);
+        const double a0 = 1.0 + alpha;
+        b0 = (1.0 - cosw) / 2.0 / a0;
+        b1 = (1.0 - cosw) / a0;
+        b2 = b0;
+        a1 = -2.0 * cosw / a0;
+        a2 = (1.0 - alpha) / a0;
+    }
+
+    double Process(double x) {
+        double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+} // namespace
+
+const char* SyntheticSignal::Name(Kind kind) {
+    switch (kind) {
+        case Kind::Sine: return "sine";
+        case Kind::HarmonicStack: return "harmonic_stack";
+        case Kind::Noise: return "noise";
+        case Kind::LowpassNoise: return "lowpass_noise";
+    }
+    return "unknown";
+}
+
+std::vector<float> SyntheticSignal::Generate(Kind kind, int sampleRate, size_t numSamples, uint32_t seed) {
+    std::vector<float> signal(numSamples);
+
+    switch (kind) {
+        case Kind::Sine: {
+            const double step = 2.0 * PI * 1000.0 / sampleRate;
+            for (size_t i = 0; i < numSamples; ++i) {
+                signal[i] = LEVEL * static_cast<float>(std::sin(step * i));
+            }
+            break;
+        }
+        case Kind::HarmonicStack: {
+            const double fundamental = 220.0;
+            const int numHarmonics = static_cast<int>(std::min(LOWPASS_HZ, sampleRate * 0.45) / fundamental);
+            double norm = 0.0;
+            for (int k = 1; k <= numHarmonics; ++k) norm += 1.0 / k;
+            for (size_t i = 0; i < numSamples; ++i) {
+                double sum = 0.0;
+                const double phase = 2.0 * PI * fundamental * i / sampleRate;
+                for (int k = 1; k <= numHarmonics; ++k) {
+                    sum += std::sin(phase * k) / k;
+                }
+                signal[i] = LEVEL * static_cast<float>(sum / norm);
+            }
+            break;
+        }
+        case Kind::Noise:
+        case Kind::LowpassNoise: {
+            std::mt19937 gen(seed);
+            std::uniform_real_distribution<float> dist(-LEVEL, LEVEL);
+            for (auto& sample : signal) {
+                sample = dist(gen);
+            }
+            if (kind == Kind::LowpassNoise) {
+                // 4th-order Butterworth: two biquads with the Butterworth Q pair
+                const double cutoff = std::min(LOWPASS_HZ, sampleRate * 0.45);
+                Biquad first(cutoff, sampleRate, 0.54119610);
+                Biquad second(cutoff, sampleRate, 1.30656296);
+                for (auto& sample : signal) {
+                    sample = static_cast<float>(second.Process(first.Process(sample)));
+                }
+            }
+            break;
+        }
+    }
+
+    return signal;
+}
+
+std::vector<std::vector<float>> SyntheticSignal::GenerateStereo(Kind kind, int sampleRate, size_t numSamples,
+                                                                uint32_t seed) {
+    std::vector<std::vector<float>> channels;
+    channels.push_back(Generate(kind, sampleRate, numSamples, seed));
+    channels.push_back(Generate(kind, sampleRate, numSamples, seed + 1));
+
+    // Deterministic kinds come out identical on both sides; offset the right
+    // channel by a few milliseconds to give the side signal some content
+    if (kind == Kind::Sine || kind == Kind::HarmonicStack) {
+        const size_t offset = std::min(numSamples, static_cast<size_t>(sampleRate / 200));
+        std::rotate(channels[1].begin(), channels[1].begin() + offset, channels[1].end());
+    }
+    return channels;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Deterministic synthetic test signals for the benchmark and regression tools
+class SyntheticSignal {
+public:
+    enum class Kind {
+        Sine,           // 1 kHz tone
+        HarmonicStack,  // 220 Hz fundamental with 1/k harmonics up to 16 kHz
+        Noise,          // White noise
+        LowpassNoise    // White noise band-limited at 16 kHz, like a lossy source
+    };
+
+    static constexpr Kind ALL[] = {Kind::Sine, Kind::HarmonicStack, Kind::Noise, Kind::LowpassNoise};
+
+    static const char* Name(Kind kind);
+
+    // Peak level stays below -6 dBFS. The same seed always yields the same samples.
+    static std::vector<float> Generate(Kind kind, int sampleRate, size_t numSamples, uint32_t seed = 1);
+
+    // Stereo pair with decorrelated noise, so the side channel isn't silent
+    static std::vector<std::vector<float>> GenerateStereo(Kind kind, int sampleRate, size_t numSamples,
+                                                          uint32_t seed = 1);
+};
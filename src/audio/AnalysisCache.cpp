@@ -0,0 +1,241 @@
+#include "AnalysisCache.h"
+#include "../util/Log.h"
+#include "../util/Memory.h"
+#include "../util/Trace.h"
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t SPILL_MAGIC = 0x41575248;  // "HRWA"
+constexpr uint32_t SPILL_VERSION = 1;
+
+struct SpillHeader {
+    uint32_t magic = SPILL_MAGIC;
+    uint32_t version = SPILL_VERSION;
+    int32_t sampleRate = 0;
+    uint32_t numFrames = 0;
+    uint32_t numBins = 0;
+};
+
+template <typename T>
+bool WriteArray(FILE* file, const std::vector<T>& values) {
+    return values.empty() || std::fwrite(values.data(), sizeof(T), values.size(), file) == values.size();
+}
+
+template <typename T>
+bool ReadArray(FILE* file, std::vector<T>& values, size_t count) {
+    values.resize(count);
+    return count == 0 || std::fread(values.data(), sizeof(T), count, file) == count;
+}
+
+bool WritePeaks(FILE* file, const std::vector<int>& peaks) {
+    const uint32_t count = static_cast<uint32_t>(peaks.size());
+    return std::fwrite(&count, sizeof(count), 1, file) == 1 && WriteArray(file, peaks);
+}
+
+bool ReadPeaks(FILE* file, std::vector<int>& peaks, uint32_t maxCount) {
+    uint32_t count = 0;
+    return std::fread(&count, sizeof(count), 1, file) == 1 && count <= maxCount && ReadArray(file, peaks, count);
+}
+
+} // namespace
+
+AnalysisCache::AnalysisCache(uint64_t memoryCapacity, std::string spillDirectory, uint64_t spillCapacity)
+    : memoryCapacity(memoryCapacity), spillDirectory(std::move(spillDirectory)), spillCapacity(spillCapacity) {
+    if (this->spillDirectory.empty()) return;
+    std::error_code ec;
+    fs::create_directories(this->spillDirectory, ec);
+    if (ec) {
+        HRAW_LOG_WARN("Can't create analysis spill directory " << this->spillDirectory << ": " << ec.message()
+                      << "; keeping analyses in memory only");
+        this->spillDirectory.clear();
+    }
+}
+
+AnalysisCache::~AnalysisCache() {
+    Clear();
+    if (!spillDirectory.empty()) {
+        // Only succeeds if nothing else was put there
+        std::error_code ec;
+        fs::remove(spillDirectory, ec);
+    }
+}
+
+std::string AnalysisCache::DefaultSpillDirectory() {
+    char suffix[17];
+    std::snprintf(suffix, sizeof(suffix), "%08x%08x", std::random_device{}(), std::random_device{}());
+    std::error_code ec;
+    return (fs::temp_directory_path(ec) / (std::string("hrawiz-analysis-") + suffix)).string();
+}
+
+std::string AnalysisCache::SpillPath(uint64_t key) const {
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx.hfa", static_cast<unsigned long long>(key));
+    return (fs::path(spillDirectory) / name).string();
+}
+
+std::shared_ptr<const AnalysisCache::Analysis> AnalysisCache::Find(uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) return nullptr;
+
+    Entry& entry = it->second;
+    if (!entry.analysis) {
+        // Bring a spilled analysis back into memory
+        auto analysis = std::make_shared<Analysis>();
+        const std::string path = SpillPath(key);
+        if (!ReadAnalysis(path, *analysis)) {
+            HRAW_LOG_WARN("Failed to read spilled analysis " << path);
+            Remove(key);
+            return nullptr;
+        }
+        std::error_code ec;
+        fs::remove(path, ec);
+        spillBytes -= entry.bytes;
+        memoryBytes += entry.bytes;
+        entry.analysis = std::move(analysis);
+    }
+    entry.lastUse = ++clock;
+
+    // Evicting may spill others but never the entry just used
+    std::shared_ptr<const Analysis> analysis = entry.analysis;
+    Evict();
+    return analysis;
+}
+
+void AnalysisCache::Insert(uint64_t key, std::shared_ptr<const Analysis> analysis) {
+    if (!analysis) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    Remove(key);
+
+    Entry entry;
+    entry.bytes = analysis->Bytes();
+    entry.lastUse = ++clock;
+    entry.analysis = std::move(analysis);
+    memoryBytes += entry.bytes;
+    entries[key] = std::move(entry);
+    Evict();
+}
+
+void AnalysisCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!entries.empty()) Remove(entries.begin()->first);
+}
+
+size_t AnalysisCache::NumEntries() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+uint64_t AnalysisCache::MemoryBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memoryBytes;
+}
+
+uint64_t AnalysisCache::SpillBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return spillBytes;
+}
+
+void AnalysisCache::Remove(uint64_t key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) return;
+    if (it->second.analysis) {
+        memoryBytes -= it->second.bytes;
+    } else {
+        std::error_code ec;
+        fs::remove(SpillPath(key), ec);
+        spillBytes -= it->second.bytes;
+    }
+    entries.erase(it);
+}
+
+void AnalysisCache::Evict() {
+    // Least recently used entry held in memory (spilled == false) or on disk
+    auto oldest = [this](bool spilled) {
+        auto found = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if ((it->second.analysis == nullptr) != spilled) continue;
+            if (found == entries.end() || it->second.lastUse < found->second.lastUse) found = it;
+        }
+        return found;
+    };
+
+    while (memoryBytes > memoryCapacity) {
+        auto it = oldest(false);
+        if (it == entries.end()) break;
+        Entry& entry = it->second;
+        const std::string path = spillDirectory.empty() ? std::string() : SpillPath(it->first);
+        if (entry.bytes <= spillCapacity && !path.empty() && WriteAnalysis(path, *entry.analysis)) {
+            HRAW_LOG_DEBUG("Spilled analysis to " << path << " (" << entry.bytes / Memory::MIB << " MiB)");
+            entry.analysis.reset();
+            memoryBytes -= entry.bytes;
+            spillBytes += entry.bytes;
+        } else {
+            Remove(it->first);
+        }
+    }
+
+    while (spillBytes > spillCapacity) {
+        auto it = oldest(true);
+        if (it == entries.end()) break;
+        Remove(it->first);
+    }
+}
+
+bool AnalysisCache::WriteAnalysis(const std::string& path, const Analysis& analysis) {
+    HRAW_TRACE_SCOPE("spill analysis");
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    SpillHeader header;
+    header.sampleRate = analysis.sampleRate;
+    header.numFrames = static_cast<uint32_t>(analysis.mid.size());
+    header.numBins = analysis.mid.empty() ? 0 : static_cast<uint32_t>(analysis.mid[0].size());
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (uint32_t frame = 0; ok && frame < header.numFrames; ++frame) {
+        ok = analysis.mid[frame].size() == header.numBins && analysis.side[frame].size() == header.numBins &&
+             WriteArray(file, analysis.mid[frame]) && WriteArray(file, analysis.side[frame]) &&
+             WritePeaks(file, analysis.midPeaks[frame]) && WritePeaks(file, analysis.sidePeaks[frame]);
+    }
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+    return ok;
+}
+
+bool AnalysisCache::ReadAnalysis(const std::string& path, Analysis& analysis) {
+    HRAW_TRACE_SCOPE("read spilled analysis");
+    std::error_code ec;
+    const uint64_t fileBytes = fs::file_size(path, ec);
+    FILE* file = ec ? nullptr : std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    // Sizes are checked against the file before anything is allocated
+    SpillHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == SPILL_MAGIC &&
+              header.version == SPILL_VERSION &&
+              uint64_t(header.numFrames) * header.numBins * 2 * sizeof(std::complex<float>) <= fileBytes;
+    if (ok) {
+        analysis.sampleRate = header.sampleRate;
+        analysis.mid.resize(header.numFrames);
+        analysis.side.resize(header.numFrames);
+        analysis.midPeaks.resize(header.numFrames);
+        analysis.sidePeaks.resize(header.numFrames);
+    }
+    for (uint32_t frame = 0; ok && frame < header.numFrames; ++frame) {
+        ok = ReadArray(file, analysis.mid[frame], header.numBins) &&
+             ReadArray(file, analysis.side[frame], header.numBins) &&
+             ReadPeaks(file, analysis.midPeaks[frame], header.numBins) &&
+             ReadPeaks(file, analysis.sidePeaks[frame], header.numBins);
+    }
+    std::fclose(file);
+    return ok;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "HFCompensation.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Recently computed HFC analyses, keyed by AudioProcessor::AnalysisKey.
+//
+// Rerunning a file with only the cutoff changed finds its analysis here and
+// skips decoding, resampling, mid/side conversion and both forward STFTs.
+// Analyses past the memory capacity are written to the spill directory if
+// one is set and read back on the next hit, otherwise dropped, least
+// recently used first. Spill files last as long as the cache. Thread-safe;
+// an analysis handed out stays valid even if it is evicted meanwhile.
+class AnalysisCache {
+public:
+    using Analysis = HFCompensation::Analysis;
+
+    static constexpr uint64_t DEFAULT_SPILL_CAPACITY = 16ULL << 30;
+
+    // An empty `spillDirectory` keeps analyses in memory only
+    explicit AnalysisCache(uint64_t memoryCapacity, std::string spillDirectory = std::string(),
+                           uint64_t spillCapacity = DEFAULT_SPILL_CAPACITY);
+    ~AnalysisCache();
+
+    AnalysisCache(const AnalysisCache&) = delete;
+    AnalysisCache& operator=(const AnalysisCache&) = delete;
+
+    // A fresh directory under the system temp dir, for one cache's spill files
+    static std::string DefaultSpillDirectory();
+
+    // Null if `key` was never inserted or has been evicted
+    std::shared_ptr<const Analysis> Find(uint64_t key);
+
+    void Insert(uint64_t key, std::shared_ptr<const Analysis> analysis);
+
+    void Clear();
+
+    size_t NumEntries() const;
+    uint64_t MemoryBytes() const;
+    uint64_t SpillBytes() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const Analysis> analysis;  // Null while spilled
+        uint64_t bytes = 0;
+        uint64_t lastUse = 0;
+    };
+
+    uint64_t memoryCapacity;
+    std::string spillDirectory;
+    uint64_t spillCapacity;
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    uint64_t clock = 0;
+    uint64_t memoryBytes = 0;
+    uint64_t spillBytes = 0;
+
+    std::string SpillPath(uint64_t key) const;
+    void Remove(uint64_t key);
+    void Evict();
+
+    static bool WriteAnalysis(const std::string& path, const Analysis& analysis);
+    static bool ReadAnalysis(const std::string& path, Analysis& analysis);
+};
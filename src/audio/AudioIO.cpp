@@ -1,9 +1,15 @@
 #include "AudioIO.h"
+#include "FlacEncoder.h"
+#include "../util/CancellationToken.h"
+#include "../util/Log.h"
+#include "MappedAudioFile.h"
+#include "SampleConvert.h"
 #include <sndfile.h>
-#include <iostream>
+#include <cstdio>
 #include <cstring>
 #include <cmath>
 #include <limits>
+#include <algorithm>
 
 AudioIO::AudioIO() {
 }
@@ -16,33 +22,125 @@ bool AudioIO::LoadFile(const std::string& path,
                       int& sampleRate,
                       int& numChannels,
                       size_t& numSamples) {
+    return LoadRegion(path, 0, std::numeric_limits<size_t>::max(), channels, sampleRate, numChannels, numSamples);
+}
+
+bool AudioIO::LoadRegion(const std::string& path,
+                        size_t start,
+                        size_t count,
+                        std::vector<std::vector<float>>& channels,
+                        int& sampleRate,
+                        int& numChannels,
+                        size_t& totalFrames) {
+    // Uncompressed WAV/RF64/W64 is converted straight out of a memory mapping
+    // into the channel buffers, skipping libsndfile's interleaved copy
+    MappedAudioFile mapped;
+    if (mapped.Open(path)) {
+        sampleRate = mapped.GetSampleRate();
+        numChannels = mapped.GetNumChannels();
+        totalFrames = mapped.GetNumFrames();
+        start = std::min(start, totalFrames);
+        count = std::min(count, totalFrames - start);
+        
+        channels.resize(numChannels);
+        std::vector<float*> dst(numChannels);
+        for (int ch = 0; ch < numChannels; ++ch) {
+            channels[ch].resize(count);
+            dst[ch] = channels[ch].data();
+        }
+        
+        mapped.ReadFrames(start, count, dst.data());
+        return true;
+    }
+    
     SF_INFO sfinfo;
     memset(&sfinfo, 0, sizeof(sfinfo));
     
     SNDFILE* sndfile = sf_open(path.c_str(), SFM_READ, &sfinfo);
     if (!sndfile) {
-        std::cerr << "Error opening file: " << sf_strerror(nullptr) << std::endl;
+        HRAW_LOG_ERROR("Error opening file: " << sf_strerror(nullptr));
         return false;
     }
     
     sampleRate = sfinfo.samplerate;
     numChannels = sfinfo.channels;
-    numSamples = sfinfo.frames;
+    totalFrames = sfinfo.frames;
+    start = std::min(start, totalFrames);
+    count = std::min(count, totalFrames - start);
     
-    // Read all samples
-    std::vector<float> interleaved(numSamples * numChannels);
-    sf_count_t framesRead = sf_readf_float(sndfile, interleaved.data(), numSamples);
+    if (start > 0 && sf_seek(sndfile, static_cast<sf_count_t>(start), SEEK_SET) < 0) {
+        HRAW_LOG_ERROR("Error seeking to frame " << start << ": " << sf_strerror(sndfile));
+        sf_close(sndfile);
+        return false;
+    }
+    
+    channels.resize(numChannels);
+    for (int ch = 0; ch < numChannels; ++ch) {
+        channels[ch].resize(count);
+    }
+    
+    // Decode in blocks; 16-bit sources are read as int16 and converted here,
+    // which halves the size of the block buffer
+    const int subFormat = sfinfo.format & SF_FORMAT_SUBMASK;
+    const bool readShort = subFormat == SF_FORMAT_PCM_16 || subFormat == SF_FORMAT_PCM_S8 ||
+                           subFormat == SF_FORMAT_PCM_U8;
+    const SampleConvert::Format blockFormat = readShort ? SampleConvert::Format::PCM16
+                                                        : SampleConvert::Format::Float32;
+    
+    const size_t blockFrames = 65536;
+    std::vector<uint8_t> block(std::min(blockFrames, std::max<size_t>(count, 1)) * numChannels *
+                               SampleConvert::BytesPerSample(blockFormat));
+    std::vector<float*> dst(numChannels);
+    
+    size_t framesRead = 0;
+    while (framesRead < count) {
+        sf_count_t want = static_cast<sf_count_t>(std::min(blockFrames, count - framesRead));
+        sf_count_t got = readShort
+            ? sf_readf_short(sndfile, reinterpret_cast<short*>(block.data()), want)
+            : sf_readf_float(sndfile, reinterpret_cast<float*>(block.data()), want);
+        if (got <= 0) break;
+        
+        for (int ch = 0; ch < numChannels; ++ch) {
+            dst[ch] = channels[ch].data() + framesRead;
+        }
+        SampleConvert::Deinterleave(block.data(), blockFormat, dst.data(), numChannels, got);
+        framesRead += got;
+    }
     
-    if (framesRead != static_cast<sf_count_t>(numSamples)) {
-        std::cerr << "Error reading file: expected " << numSamples << " frames, got " << framesRead << std::endl;
+    if (framesRead != count) {
+        HRAW_LOG_ERROR("Error reading file: expected " << count << " frames, got " << framesRead);
         sf_close(sndfile);
         return false;
     }
     
-    // Deinterleave channels
-    DeinterleaveChannels(interleaved, channels, numChannels, numSamples);
+    sf_close(sndfile);
+    return true;
+}
+
+std::shared_ptr<const MappedAudioFile> AudioIO::Map(const std::string& path) {
+    auto mapped = std::make_shared<MappedAudioFile>();
+    if (!mapped->Open(path)) {
+        return nullptr;
+    }
+    return mapped;
+}
+
+bool AudioIO::ProbeFile(const std::string& path,
+                       int& sampleRate,
+                       int& numChannels,
+                       size_t& numSamples) {
+    SF_INFO sfinfo;
+    memset(&sfinfo, 0, sizeof(sfinfo));
     
+    SNDFILE* sndfile = sf_open(path.c_str(), SFM_READ, &sfinfo);
+    if (!sndfile) {
+        return false;
+    }
     sf_close(sndfile);
+    
+    sampleRate = sfinfo.samplerate;
+    numChannels = sfinfo.channels;
+    numSamples = static_cast<size_t>(sfinfo.frames);
     return true;
 }
 
@@ -50,102 +148,73 @@ bool AudioIO::SaveFile(const std::string& path,
                       const std::vector<std::vector<float>>& channels,
                       int sampleRate,
                       int bitDepth) {
+    OutputFormat format;
+    format.container = OutputFormat::Container::WAV;
+    format.bitDepth = bitDepth;
+    return SaveFile(path, channels, sampleRate, format);
+}
+
+bool AudioIO::SaveFile(const std::string& path,
+                      const std::vector<std::vector<float>>& channels,
+                      int sampleRate,
+                      const OutputFormat& format,
+                      const CancellationToken* cancel) {
     if (channels.empty() || channels[0].empty()) {
-        std::cerr << "No audio data to save" << std::endl;
+        HRAW_LOG_ERROR("No audio data to save");
         return false;
     }
     
-    std::cout << "SaveFile: channels.size() = " << channels.size() << std::endl;
-    std::cout << "SaveFile: channels[0].size() = " << channels[0].size() << std::endl;
-    if (channels.size() > 1) {
-        std::cout << "SaveFile: channels[1].size() = " << channels[1].size() << std::endl;
-    }
+    HRAW_LOG_DEBUG("SaveFile: " << channels.size() << " channels, channels[0].size() = " << channels[0].size());
     
-    SF_INFO sfinfo;
-    memset(&sfinfo, 0, sizeof(sfinfo));
-    sfinfo.samplerate = sampleRate;
-    sfinfo.channels = channels.size();
-    sfinfo.frames = 0;  // For write mode, this should be 0
+    // FLAC goes through the in-tree encoder, which encodes frame groups in parallel
+    if (format.container == OutputFormat::Container::FLAC) {
+        if (format.bitDepth != 16 && format.bitDepth != 24) {
+            HRAW_LOG_ERROR("FLAC output supports 16 or 24 bits, got " << format.bitDepth);
+            return false;
+        }
+        HRAW_LOG_DEBUG("SaveFile: Encoding FLAC (" << format.bitDepth << "-bit) at " << sampleRate << " Hz");
+        return FlacEncoder::EncodeFile(path, channels, sampleRate, format.bitDepth, format.dither, 0, cancel);
+    }
     
     // Store the actual frame count separately
-    sf_count_t framesToWrite = channels[0].size();
-    
-    // Use float format for better compatibility with our float data
-    sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
-    
-    // Validate the format
-    if (!sf_format_check(&sfinfo)) {
-        std::cerr << "Invalid format specification" << std::endl;
-        return false;
+    size_t framesToWrite = channels[0].size();
+    for (const auto& channel : channels) {
+        framesToWrite = std::min(framesToWrite, channel.size());
     }
+    const int numChannels = static_cast<int>(channels.size());
     
-    std::cout << "SaveFile: Writing " << framesToWrite << " frames at " << sfinfo.samplerate << " Hz" << std::endl;
-    std::cout << "SaveFile: Format = 0x" << std::hex << sfinfo.format << std::dec << std::endl;
+    HRAW_LOG_DEBUG("SaveFile: Writing " << framesToWrite << " frames at " << sampleRate << " Hz, "
+                   << format.bitDepth << "-bit WAV");
     
-    SNDFILE* sndfile = sf_open(path.c_str(), SFM_WRITE, &sfinfo);
-    if (!sndfile) {
-        std::cerr << "Error creating file: " << sf_strerror(nullptr) << std::endl;
+    AudioWriter writer;
+    if (!writer.Open(path, numChannels, sampleRate, format)) {
         return false;
     }
     
-    // Interleave channels and write
-    std::vector<float> interleaved = InterleaveChannels(channels);
-    std::cout << "SaveFile: Interleaved size = " << interleaved.size() << std::endl;
-    
-    // Check for NaN or infinite values and fix them
-    int nanCount = 0;
-    int infCount = 0;
-    int clampCount = 0;
-    for (size_t i = 0; i < interleaved.size(); ++i) {
-        if (std::isnan(interleaved[i])) {
-            interleaved[i] = 0.0f;
-            nanCount++;
-        } else if (std::isinf(interleaved[i])) {
-            interleaved[i] = interleaved[i] > 0 ? 1.0f : -1.0f;
-            infCount++;
-        } else if (interleaved[i] > 1.0f) {
-            interleaved[i] = 1.0f;
-            clampCount++;
-        } else if (interleaved[i] < -1.0f) {
-            interleaved[i] = -1.0f;
-            clampCount++;
+    // Check a few samples
+    if (Log::Enabled(LogLevel::Debug)) {
+        std::ostringstream samples;
+        for (size_t i = 0; i < std::min<size_t>(10, framesToWrite * numChannels); ++i) {
+            samples << " " << channels[i % numChannels][i / numChannels];
         }
+        Log::Write(LogLevel::Debug, "First few samples:" + samples.str());
     }
     
-    if (nanCount > 0 || infCount > 0 || clampCount > 0) {
-        std::cout << "Warning: Fixed " << nanCount << " NaN values, " << infCount 
-                  << " infinite values, and " << clampCount << " out-of-range values" << std::endl;
+    std::vector<const float*> src(numChannels);
+    for (int ch = 0; ch < numChannels; ++ch) {
+        src[ch] = channels[ch].data();
     }
-    
-    // Check a few samples
-    std::cout << "First few samples: ";
-    for (int i = 0; i < std::min(10, (int)interleaved.size()); ++i) {
-        std::cout << interleaved[i] << " ";
+    bool ok = writer.Write(src.data(), framesToWrite, cancel);
+    HRAW_LOG_DEBUG("SaveFile: Wrote " << writer.FramesWritten() << " frames");
+    if (!writer.Close()) {
+        ok = false;
     }
-    std::cout << std::endl;
-    
-    // Clear any error state
-    sf_error(sndfile);
     
-    // Write the data
-    sf_count_t framesWritten = sf_writef_float(sndfile, interleaved.data(), framesToWrite);
-    
-    // Get error immediately after write
-    int error = sf_error(sndfile);
-    if (error != SF_ERR_NO_ERROR) {
-        std::cerr << "Write error: " << sf_strerror(sndfile) << std::endl;
-    }
-    
-    std::cout << "SaveFile: Wrote " << framesWritten << " frames" << std::endl;
-    
-    if (framesWritten != framesToWrite) {
-        std::cerr << "Error writing file: expected " << framesToWrite << " frames, wrote " << framesWritten << std::endl;
-        sf_close(sndfile);
+    if (CancellationToken::IsCancelled(cancel)) {
+        HRAW_LOG_INFO("SaveFile: Cancelled");
         return false;
     }
-    
-    sf_close(sndfile);
-    return true;
+    return ok;
 }
 
 std::vector<float> AudioIO::InterleaveChannels(const std::vector<std::vector<float>>& channels) {
@@ -155,11 +224,12 @@ std::vector<float> AudioIO::InterleaveChannels(const std::vector<std::vector<flo
     size_t numSamples = channels[0].size();
     std::vector<float> interleaved(numChannels * numSamples);
     
-    for (size_t i = 0; i < numSamples; ++i) {
-        for (size_t ch = 0; ch < numChannels; ++ch) {
-            interleaved[i * numChannels + ch] = channels[ch][i];
-        }
+    std::vector<const float*> src(numChannels);
+    for (size_t ch = 0; ch < numChannels; ++ch) {
+        src[ch] = channels[ch].data();
     }
+    SampleConvert::Interleave(src.data(), interleaved.data(), SampleConvert::Format::Float32,
+                              static_cast<int>(numChannels), numSamples);
     
     return interleaved;
 }
@@ -169,13 +239,212 @@ void AudioIO::DeinterleaveChannels(const std::vector<float>& interleaved,
                                   int numChannels,
                                   size_t numSamples) {
     channels.resize(numChannels);
+    std::vector<float*> dst(numChannels);
     for (int ch = 0; ch < numChannels; ++ch) {
         channels[ch].resize(numSamples);
+        dst[ch] = channels[ch].data();
+    }
+    
+    SampleConvert::Deinterleave(interleaved.data(), SampleConvert::Format::Float32,
+                                dst.data(), numChannels, numSamples);
+}
+
+AudioWriter::AudioWriter() {
+}
+
+AudioWriter::~AudioWriter() {
+    if (sndfile) sf_close(sndfile);
+}
+
+bool AudioWriter::Open(const std::string& path, int numChannels, int sampleRate, const OutputFormat& format) {
+    this->format = format;
+    this->numChannels = numChannels;
+    
+    if (IsFlac()) {
+        if (format.bitDepth != 16 && format.bitDepth != 24) {
+            HRAW_LOG_ERROR("FLAC output supports 16 or 24 bits, got " << format.bitDepth);
+            return false;
+        }
+        ok = flac.Open(path, numChannels, sampleRate, format.bitDepth);
+        return ok;
+    }
+    
+    SF_INFO sfinfo;
+    memset(&sfinfo, 0, sizeof(sfinfo));
+    sfinfo.samplerate = sampleRate;
+    sfinfo.channels = numChannels;
+    sfinfo.frames = 0;  // For write mode, this should be 0
+    
+    // Pick the libsndfile subformat and the buffer layout we hand it. 24-bit
+    // goes through the int API, which takes samples in the top 24 bits.
+    int subFormat;
+    switch (format.bitDepth) {
+        case 16:
+            subFormat = SF_FORMAT_PCM_16;
+            blockFormat = SampleConvert::Format::PCM16;
+            break;
+        case 24:
+            subFormat = SF_FORMAT_PCM_24;
+            blockFormat = SampleConvert::Format::PCM32;
+            break;
+        case 32:
+            subFormat = SF_FORMAT_FLOAT;
+            blockFormat = SampleConvert::Format::Float32;
+            break;
+        default:
+            HRAW_LOG_ERROR("Unsupported output bit depth: " << format.bitDepth);
+            return false;
     }
     
-    for (size_t i = 0; i < numSamples; ++i) {
+    sfinfo.format = SF_FORMAT_WAV | subFormat;
+    
+    // Validate the format
+    if (!sf_format_check(&sfinfo)) {
+        HRAW_LOG_ERROR("Invalid format specification");
+        return false;
+    }
+    
+    sndfile = sf_open(path.c_str(), SFM_WRITE, &sfinfo);
+    if (!sndfile) {
+        HRAW_LOG_ERROR("Error creating file: " << sf_strerror(nullptr));
+        return false;
+    }
+    
+    // Clear any error state
+    sf_error(sndfile);
+    
+    dither = std::make_unique<SampleConvert::DitherState>(format.dither, format.IsFloat() ? 24 : format.bitDepth);
+    ok = true;
+    return true;
+}
+
+AudioWriter::Piece AudioWriter::Prepare(std::vector<std::vector<float>> samples, size_t streamStart) const {
+    Piece piece;
+    if (samples.empty()) return piece;
+    piece.numFrames = samples[0].size();
+    for (const auto& channel : samples) {
+        piece.numFrames = std::min(piece.numFrames, channel.size());
+    }
+    
+    std::vector<const float*> src(numChannels);
+    for (int ch = 0; ch < numChannels; ++ch) {
+        src[ch] = samples[ch].data();
+    }
+    
+    if (IsFlac()) {
+        piece.flac = FlacEncoder::EncodeChunk(src.data(), numChannels, piece.numFrames, streamStart,
+                                              format.bitDepth, format.dither);
+    } else if (format.IsFloat() || format.dither == SampleConvert::Dither::None) {
+        // Plain rounding needs no state from earlier samples
+        SampleConvert::DitherState state(format.dither, format.IsFloat() ? 24 : format.bitDepth);
+        piece.pcm.resize(piece.numFrames * numChannels * SampleConvert::BytesPerSample(blockFormat));
+        SampleConvert::InterleaveDithered(src.data(), piece.pcm.data(), blockFormat, numChannels,
+                                          piece.numFrames, state);
+        piece.nanCount = state.nanCount;
+        piece.clipCount = state.clipCount;
+    } else {
+        piece.samples = std::move(samples);
+    }
+    return piece;
+}
+
+bool AudioWriter::Write(Piece& piece, const CancellationToken* cancel) {
+    if (!ok) return false;
+    if (IsFlac()) {
+        if (CancellationToken::IsCancelled(cancel)) return false;
+        ok = flac.Append(piece.flac);
+        framesWritten += piece.flac.numSamples;
+        return ok;
+    }
+    
+    if (!piece.samples.empty()) {
+        std::vector<const float*> src(numChannels);
         for (int ch = 0; ch < numChannels; ++ch) {
-            channels[ch][i] = interleaved[i * numChannels + ch];
+            src[ch] = piece.samples[ch].data();
         }
+        return Write(src.data(), piece.numFrames, cancel);
+    }
+    
+    nanCount += piece.nanCount;
+    clipCount += piece.clipCount;
+    const size_t frameBytes = numChannels * SampleConvert::BytesPerSample(blockFormat);
+    for (size_t offset = 0; offset < piece.numFrames && ok; offset += BLOCK_FRAMES) {
+        if (CancellationToken::IsCancelled(cancel)) return false;
+        WriteBlock(piece.pcm.data() + offset * frameBytes, std::min(BLOCK_FRAMES, piece.numFrames - offset));
+    }
+    return ok;
+}
+
+bool AudioWriter::Write(const float* const* channels, size_t numFrames, const CancellationToken* cancel) {
+    if (!ok) return false;
+    if (IsFlac()) {
+        if (CancellationToken::IsCancelled(cancel)) return false;
+        FlacEncoder::Chunk chunk = FlacEncoder::EncodeChunk(channels, numChannels, numFrames, framesWritten,
+                                                            format.bitDepth, format.dither);
+        ok = flac.Append(chunk);
+        framesWritten += chunk.numSamples;
+        return ok;
     }
-}
\ No newline at end of file
+    
+    // Interleave, sanitize, dither and convert one block at a time, so the
+    // full-length interleaved copy never exists
+    std::vector<uint8_t> block(BLOCK_FRAMES * numChannels * SampleConvert::BytesPerSample(blockFormat));
+    std::vector<const float*> src(numChannels);
+    for (size_t offset = 0; offset < numFrames && ok; offset += BLOCK_FRAMES) {
+        if (CancellationToken::IsCancelled(cancel)) return false;
+        
+        const size_t count = std::min(BLOCK_FRAMES, numFrames - offset);
+        for (int ch = 0; ch < numChannels; ++ch) {
+            src[ch] = channels[ch] + offset;
+        }
+        SampleConvert::InterleaveDithered(src.data(), block.data(), blockFormat, numChannels, count, *dither);
+        WriteBlock(block.data(), count);
+    }
+    return ok;
+}
+
+bool AudioWriter::WriteBlock(const void* block, size_t numFrames) {
+    const sf_count_t count = static_cast<sf_count_t>(numFrames);
+    sf_count_t written = 0;
+    switch (blockFormat) {
+        case SampleConvert::Format::PCM16:
+            written = sf_writef_short(sndfile, static_cast<const short*>(block), count);
+            break;
+        case SampleConvert::Format::PCM32:
+            written = sf_writef_int(sndfile, static_cast<const int*>(block), count);
+            break;
+        default:
+            written = sf_writef_float(sndfile, static_cast<const float*>(block), count);
+            break;
+    }
+    
+    framesWritten += static_cast<size_t>(written);
+    if (written != count) {
+        HRAW_LOG_ERROR("Write error: " << sf_strerror(sndfile));
+        ok = false;
+    }
+    return ok;
+}
+
+bool AudioWriter::Close() {
+    if (IsFlac()) {
+        const bool closed = flac.Close();
+        ok = ok && closed;
+        return ok;
+    }
+    if (!sndfile) return false;
+    
+    nanCount += dither->nanCount;
+    clipCount += dither->clipCount;
+    if (nanCount > 0 || clipCount > 0) {
+        HRAW_LOG_WARN("Fixed " << nanCount << " NaN values and " << clipCount << " out-of-range values");
+    }
+    
+    if (sf_error(sndfile) != SF_ERR_NO_ERROR) {
+        HRAW_LOG_ERROR("Write error: " << sf_strerror(sndfile));
+        ok = false;
+    }
+    sf_close(sndfile);
+    sndfile = nullptr;
+    return ok;
+}
@@ -1,9 +1,32 @@
 #pragma once
 
+#include "FlacEncoder.h"
+#include "SampleConvert.h"
 #include <string>
 #include <vector>
 #include <memory>
 
+class CancellationToken;
+class MappedAudioFile;
+struct SNDFILE_tag;
+
+// Output file encoding, chosen per job
+struct OutputFormat {
+    enum class Container {
+        WAV,
+        FLAC
+    };
+    
+    Container container = Container::WAV;
+    int bitDepth = 32;  // 16 or 24 for integer PCM; 32 writes float WAV
+    SampleConvert::Dither dither = SampleConvert::Dither::TPDF;
+    
+    bool IsFloat() const { return bitDepth == 32 && container == Container::WAV; }
+    
+    // File extension matching the container, including the dot
+    const char* Extension() const { return container == Container::FLAC ? ".flac" : ".wav"; }
+};
+
 class AudioIO {
 public:
     AudioIO();
@@ -16,12 +39,42 @@ public:
                   int& numChannels,
                   size_t& numSamples);
     
-    // Save audio file
+    // Load `count` frames starting at frame `start`, clamped to the file;
+    // seeks instead of decoding what comes before. `channels` hold the frames
+    // read and `totalFrames` is the length of the whole file.
+    bool LoadRegion(const std::string& path,
+                    size_t start,
+                    size_t count,
+                    std::vector<std::vector<float>>& channels,
+                    int& sampleRate,
+                    int& numChannels,
+                    size_t& totalFrames);
+    
+    // Map an uncompressed WAV/RF64/W64 file without converting anything, so
+    // a consumer can convert the frames it needs as it gets to them. Null
+    // for other formats, which LoadFile and LoadRegion decode instead.
+    static std::shared_ptr<const MappedAudioFile> Map(const std::string& path);
+    
+    // Read only the header: format, channel count and length
+    bool ProbeFile(const std::string& path,
+                   int& sampleRate,
+                   int& numChannels,
+                   size_t& numSamples);
+    
+    // Save audio file as WAV at the given bit depth (16/24 PCM with TPDF dither, 32 float)
     bool SaveFile(const std::string& path,
                   const std::vector<std::vector<float>>& channels,
                   int sampleRate,
                   int bitDepth = 24);
     
+    // Save audio file in an explicit output format. Stops between blocks
+    // and returns false if `cancel` fires; the caller removes the partial file.
+    bool SaveFile(const std::string& path,
+                  const std::vector<std::vector<float>>& channels,
+                  int sampleRate,
+                  const OutputFormat& format,
+                  const CancellationToken* cancel = nullptr);
+    
 private:
     // Helper to interleave channels for libsndfile
     std::vector<float> InterleaveChannels(const std::vector<std::vector<float>>& channels);
@@ -31,4 +84,70 @@ private:
                              std::vector<std::vector<float>>& channels,
                              int numChannels,
                              size_t numSamples);
-};
\ No newline at end of file
+};
+
+// Writes one output file from pieces handed over in stream order, so a long
+// render never holds the whole output. Converting a piece for the file, the
+// slow part, happens in Prepare, which any thread may run ahead of Write.
+// The file is the one SaveFile writes for the same samples, byte for byte,
+// as long as every piece but the last is a multiple of PIECE_ALIGNMENT
+// frames.
+class AudioWriter {
+public:
+    static constexpr size_t PIECE_ALIGNMENT = FlacEncoder::GROUP_SAMPLES;
+    
+    // Samples made ready for the file. WAV with TPDF or noise-shaped dither
+    // keeps them as float until Write, as its dither runs in stream order.
+    struct Piece {
+        size_t numFrames = 0;
+        FlacEncoder::Chunk flac;
+        std::vector<uint8_t> pcm;                 // Interleaved, in the WAV block format
+        std::vector<std::vector<float>> samples;  // Still to convert
+        size_t nanCount = 0;
+        size_t clipCount = 0;
+    };
+    
+    AudioWriter();
+    ~AudioWriter();
+    AudioWriter(const AudioWriter&) = delete;
+    AudioWriter& operator=(const AudioWriter&) = delete;
+    
+    bool Open(const std::string& path, int numChannels, int sampleRate, const OutputFormat& format);
+    
+    // Convert `samples`, which start at frame `streamStart` of the file.
+    // Safe to call from several threads at once.
+    Piece Prepare(std::vector<std::vector<float>> samples, size_t streamStart) const;
+    
+    // Append a piece, or planar samples converted here. Stop between blocks
+    // and return false if `cancel` fires.
+    bool Write(Piece& piece, const CancellationToken* cancel = nullptr);
+    bool Write(const float* const* channels, size_t numFrames, const CancellationToken* cancel = nullptr);
+    
+    // Finish the file. False if anything failed since Open; the caller
+    // removes the partial file.
+    bool Close();
+    
+    size_t FramesWritten() const { return framesWritten; }
+    
+private:
+    OutputFormat format;
+    int numChannels = 0;
+    bool ok = false;
+    size_t framesWritten = 0;
+    size_t nanCount = 0;
+    size_t clipCount = 0;
+    
+    // WAV is converted and written this many frames at a time
+    static constexpr size_t BLOCK_FRAMES = 16384;
+    
+    // One of these is open
+    FlacEncoder::Writer flac;
+    SNDFILE_tag* sndfile = nullptr;
+    
+    // WAV samples as handed to libsndfile, and the stream's quantizer
+    SampleConvert::Format blockFormat = SampleConvert::Format::Float32;
+    std::unique_ptr<SampleConvert::DitherState> dither;
+    
+    bool IsFlac() const { return format.container == OutputFormat::Container::FLAC; }
+    bool WriteBlock(const void* block, size_t numFrames);
+};
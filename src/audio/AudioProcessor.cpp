@@ -1,10 +1,58 @@
 #include "AudioProcessor.h"
+#include "AnalysisCache.h"
 #include "AudioIO.h"
 #include "HFCompensation.h"
+#include "MappedAudioFile.h"
+#include "Overview.h"
 #include "Resampler.h"
-#include <iostream>
+#include "../util/CancellationToken.h"
+#include "../util/Hash.h"
+#include "../util/Log.h"
+#include "../util/Memory.h"
+#include "../util/TaskScheduler.h"
+#include "../util/Telemetry.h"
+#include "../util/Trace.h"
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <random>
+
+#ifndef HRAW_VERSION
+#define HRAW_VERSION "dev"
+#endif
+
+namespace {
+
+uint64_t ChannelBytes(const std::vector<float>& channel) {
+    return channel.capacity() * sizeof(float);
+}
+
+uint64_t ChannelBytes(const std::vector<std::vector<float>>& channels) {
+    uint64_t bytes = 0;
+    for (const auto& channel : channels) bytes += ChannelBytes(channel);
+    return bytes;
+}
+
+uint64_t ToMiB(uint64_t bytes) {
+    return (bytes + Memory::MIB - 1) / Memory::MIB;
+}
+
+// Upsampling factor a job applies
+size_t Multiplier(const AudioProcessor::Options& options) {
+    const bool upsample = options.enableHFC && options.sampleRateMultiplier > 1;
+    return upsample ? static_cast<size_t>(options.sampleRateMultiplier) : 1;
+}
+
+// Segments start on FLAC frame groups and on the STFT frame grid
+static_assert(AudioProcessor::SEGMENT_SAMPLES % AudioWriter::PIECE_ALIGNMENT == 0,
+              "Segments must be whole writer pieces");
+static_assert(AudioProcessor::SEGMENT_SAMPLES % HFCompensation::HOPSIZE == 0,
+              "Segments must start on a hop");
+
+} // namespace
 
 AudioProcessor::AudioProcessor() {
 }
@@ -12,103 +60,812 @@ AudioProcessor::AudioProcessor() {
 AudioProcessor::~AudioProcessor() {
 }
 
+size_t AudioProcessor::OutputLength(size_t numSamples, int numChannels, const Options& options) {
+    // The upsampled input, cut to whole STFT frames when HFC runs
+    const size_t upsampled = numSamples * Multiplier(options);
+    if (!options.enableHFC || numChannels != 2) return upsampled;
+    const size_t fft = HFCompensation::FFTSIZE;
+    const size_t hop = HFCompensation::HOPSIZE;
+    return upsampled < fft ? 0 : (upsampled - fft) / hop * hop + fft;
+}
+
+int AudioProcessor::OutputRate(int sampleRate, const Options& options) {
+    return sampleRate * static_cast<int>(Multiplier(options));
+}
+
 bool AudioProcessor::ProcessFile(const std::string& inputPath,
                                 const std::string& outputPath,
                                 bool enableHFC,
                                 int lowpassFreq,
                                 bool compressedMode,
                                 int sampleRateMultiplier,
-                                ProgressCallback progressCallback) {
-    // Load audio file
-    AudioData audio;
-    if (!LoadAudioFile(inputPath, audio)) {
-        std::cerr << "Failed to load audio file: " << inputPath << std::endl;
+                                JobProgress* progress) {
+    Options options;
+    options.enableHFC = enableHFC;
+    options.lowpassFreq = lowpassFreq;
+    options.compressedMode = compressedMode;
+    options.sampleRateMultiplier = sampleRateMultiplier;
+    return ProcessFile(inputPath, outputPath, options, progress);
+}
+
+bool AudioProcessor::ProcessFile(const std::string& inputPath,
+                                const std::string& outputPath,
+                                const Options& options,
+                                JobProgress* progress,
+                                const CancellationToken* cancel) {
+    bool success;
+    if (ShouldSegment(inputPath, options)) {
+        success = ProcessFileSegmented(inputPath, outputPath, options, progress, cancel);
+    } else {
+        AudioData audio;
+        success = Decode(inputPath, audio, options, progress, cancel) &&
+                  Process(audio, options, progress, cancel) &&
+                  Encode(outputPath, audio, options, progress, cancel);
+    }
+    SettleProgress(progress, success, cancel);
+    return success;
+}
+
+bool AudioProcessor::ShouldSegment(const std::string& inputPath, const Options& options) const {
+    // Overviews need the whole file in one piece. An analysis cache
+    // doesn't: long inputs bypass it, so it is neither searched nor filled
+    // for them. Their analysis would take most of the cache's budget, and
+    // segmenting is what keeps them on every core in bounded memory; a
+    // changed cutoff reruns the analysis for them instead.
+    if (inputOverview || outputOverview) {
+        return false;
+    }
+    int sampleRate = 0, numChannels = 0;
+    size_t numSamples = 0;
+    if (!AudioIO().ProbeFile(inputPath, sampleRate, numChannels, numSamples)) {
+        return false;
+    }
+    return OutputLength(numSamples, numChannels, options) >= 2 * SEGMENT_SAMPLES;
+}
+
+bool AudioProcessor::ProcessFileSegmented(const std::string& inputPath,
+                                          const std::string& outputPath,
+                                          const Options& options,
+                                          JobProgress* progress,
+                                          const CancellationToken* cancel) {
+    HRAW_TRACE_SCOPE("process segmented");
+    if (CancellationToken::IsCancelled(cancel)) {
         return false;
     }
     
-    std::cout << "Loaded audio: " << audio.numChannels << " channels, "
-              << audio.numSamples << " samples, " << audio.sampleRate << " Hz" << std::endl;
+    if (progress) progress->BeginStage(JobStage::Decoding);
+    int sampleRate = 0, numChannels = 0;
+    size_t totalFrames = 0;
+    if (!AudioIO().ProbeFile(inputPath, sampleRate, numChannels, totalFrames) || sampleRate <= 0) {
+        HRAW_LOG_ERROR("Failed to open audio file: " << inputPath);
+        if (progress) progress->EndStage(JobStage::Queued);
+        return false;
+    }
+    const size_t outputLength = OutputLength(totalFrames, numChannels, options);
+    if (outputLength == 0) {
+        HRAW_LOG_ERROR("Audio data is empty after processing");
+        if (progress) progress->EndStage(JobStage::Queued);
+        return false;
+    }
+    if (options.enableHFC && numChannels != 2) {
+        HRAW_LOG_WARN("HFC requires stereo input, skipping");
+    }
     
-    // For HF compensation, we upsample based on the multiplier
-    if (enableHFC && sampleRateMultiplier > 1) {
-        const int targetSampleRate = audio.sampleRate * sampleRateMultiplier;
-        std::cout << "Upsampling from " << audio.sampleRate << " Hz to " << targetSampleRate << " Hz ("
-                  << sampleRateMultiplier << "x)" << std::endl;
+    // Every segment must draw the same random variation
+    Options segmentOptions = options;
+    if (segmentOptions.seed == 0) {
+        std::random_device random;
+        while (segmentOptions.seed == 0) segmentOptions.seed = random();
+    }
+    
+    // Segment s covers output [s * SEGMENT_SAMPLES, (s + 1) * SEGMENT_SAMPLES).
+    // It reads from an FFT frame before that, starting on the file's STFT
+    // frame grid as RenderRegion does, to an FFT frame plus an interpolation
+    // step after, so each output sample sees the same frames and the same
+    // resampled input as in a whole-file render.
+    const size_t multiplier = Multiplier(options);
+    const size_t fft = HFCompensation::FFTSIZE;
+    const size_t hop = HFCompensation::HOPSIZE;
+    const size_t grid = hop / std::gcd(hop, multiplier);
+    const size_t numSegments = (outputLength + SEGMENT_SAMPLES - 1) / SEGMENT_SAMPLES;
+    HRAW_LOG_INFO("Processing " << inputPath << " in " << numSegments << " segments");
+    if (progress) {
+        progress->SetAudioDuration(static_cast<double>(totalFrames) / sampleRate);
+        progress->EndStage(JobStage::Queued);
+    }
+    
+    AudioWriter writer;
+    const int outputRate = OutputRate(sampleRate, options);
+    if (!writer.Open(outputPath, numChannels, outputRate, options.outputFormat)) {
+        HRAW_LOG_ERROR("Failed to save audio file: " << outputPath);
+        return false;
+    }
+    
+    // Render segment `index` into a piece for the writer
+    auto render = [&](size_t index, AudioWriter::Piece& piece) {
+        const size_t outBegin = index * SEGMENT_SAMPLES;
+        const size_t outEnd = std::min(outputLength, outBegin + SEGMENT_SAMPLES);
+        const size_t readStart = outBegin > fft ? (outBegin - fft) / multiplier / grid * grid : 0;
+        const size_t readEnd = std::min(totalFrames, (outEnd + multiplier - 1) / multiplier +
+                                                     (fft + multiplier - 1) / multiplier + 1);
         
-        // Upsample audio
-        audio.channels = Resampler::ResampleMultiChannel(audio.channels, audio.sampleRate, targetSampleRate);
-        audio.sampleRate = targetSampleRate;
-        audio.numSamples = audio.channels[0].size();
+        AudioData audio;
+        size_t fileFrames = 0;
+        if (!LoadRegion(inputPath, readStart, readEnd - readStart, audio, fileFrames)) {
+            HRAW_LOG_ERROR("Failed to load frames " << readStart << " to " << readEnd << " of " << inputPath);
+            return false;
+        }
+        audio.numSamples = readEnd - readStart;
+        if (!Resample(audio, segmentOptions, nullptr, cancel, readStart)) {
+            return false;
+        }
+        const int firstFrame = static_cast<int>(readStart * multiplier / hop);
+        if (segmentOptions.enableHFC && audio.numChannels == 2 &&
+            !ApplyHFC(audio, segmentOptions, nullptr, cancel, firstFrame)) {
+            return false;
+        }
+        
+        // Keep this segment's share of the output
+        const size_t offset = outBegin - readStart * multiplier;
+        const size_t count = outEnd - outBegin;
+        std::vector<std::vector<float>> samples(audio.channels.size());
+        for (size_t ch = 0; ch < audio.channels.size(); ++ch) {
+            const std::vector<float>& channel = audio.channels[ch];
+            if (channel.size() < offset + count) {
+                HRAW_LOG_ERROR("Segment " << index << " of " << inputPath << " came out short");
+                return false;
+            }
+            samples[ch].assign(channel.begin() + offset, channel.begin() + offset + count);
+        }
+        audio.channels.clear();
+        
+        HRAW_TRACE_SCOPE("prepare");
+        piece = writer.Prepare(std::move(samples), outBegin);
+        return true;
+    };
+    
+    // Segments are rendered at most `window` ahead of the writer, which
+    // bounds the memory they hold; within the budget if one is set
+    struct Segment {
+        AudioWriter::Piece piece;
+        bool ok = false;
+        std::atomic<bool> done{false};
+    };
+    TaskScheduler& scheduler = TaskScheduler::Shared();
+    size_t window = static_cast<size_t>(scheduler.NumThreads()) + 1;
+    if (options.memoryBudget > 0) {
+        const uint64_t segmentBytes = EstimateMemory(SEGMENT_SAMPLES / multiplier + 2 * fft, numChannels,
+                                                     sampleRate, options).inMemoryBytes;
+        window = std::max<size_t>(1, std::min<uint64_t>(window, options.memoryBudget / segmentBytes));
+    }
+    std::vector<Segment> segments(numSegments);
+    std::atomic<bool> abort{false};
+    TaskGroup tasks(scheduler);
+    size_t queuedSegments = 0;
+    
+    if (progress) progress->BeginStage(JobStage::Synthesizing, numSegments);
+    bool ok = true;
+    for (size_t index = 0; index < numSegments && ok; ++index) {
+        for (; queuedSegments < std::min(numSegments, index + window); ++queuedSegments) {
+            tasks.Run([&, next = queuedSegments]() {
+                Segment& segment = segments[next];
+                if (!abort) {
+                    HRAW_TRACE_SCOPE("segment");
+                    segment.ok = render(next, segment.piece);
+                }
+                segment.done = true;
+                scheduler.Notify();
+            });
+        }
         
-        std::cout << "After upsampling: " << audio.numSamples << " samples at " << audio.sampleRate << " Hz" << std::endl;
+        // Render others while waiting for the next one in order
+        scheduler.HelpUntil([&]() { return segments[index].done.load(); });
+        ok = segments[index].ok && writer.Write(segments[index].piece, cancel);
+        segments[index].piece = AudioWriter::Piece();
+        if (progress) progress->Advance(index + 1);
+    }
+    if (!ok) {
+        abort = true;
+    }
+    tasks.Wait();
+    
+    if (!writer.Close()) {
+        ok = false;
+    }
+    if (!ok) {
+        // Don't leave a truncated file behind
+        std::remove(outputPath.c_str());
+        if (!CancellationToken::IsCancelled(cancel)) {
+            HRAW_LOG_ERROR("Failed to process " << inputPath);
+        }
+        return false;
+    }
+    
+    HRAW_LOG_INFO("Processed audio: " << numChannels << " channels, " << writer.FramesWritten()
+                  << " samples at " << outputRate << " Hz");
+    if (progress) progress->EndStage(JobStage::Queued);
+    return true;
+}
+
+void AudioProcessor::SettleProgress(JobProgress* progress, bool success, const CancellationToken* cancel) {
+    if (!progress) return;
+    HRAW_LOG_DEBUG("Job peak tracked memory " << ToMiB(progress->PeakMemoryBytes()) << " MiB, process RSS "
+                   << ToMiB(Memory::CurrentRss()) << " MiB");
+    progress->SetMemory(0);
+    if (success) {
+        progress->EndStage(JobStage::Done);
+    } else if (CancellationToken::IsCancelled(cancel)) {
+        progress->EndStage(JobStage::Cancelled);
+    } else {
+        progress->EndStage(JobStage::Failed);
+    }
+}
+
+AudioProcessor::MemoryEstimate AudioProcessor::EstimateMemory(uint64_t numSamples, int numChannels, int sampleRate,
+                                                              const Options& options) {
+    (void)sampleRate;  // Sizes scale with the multiplier, not the rate itself
+    const uint64_t F = sizeof(float);
+    const uint64_t C = static_cast<uint64_t>(std::max(numChannels, 0));
+    const uint64_t N = numSamples;
+    const bool upsample = options.enableHFC && options.sampleRateMultiplier > 1;
+    const uint64_t M = upsample ? N * options.sampleRateMultiplier : N;
+    
+    MemoryEstimate estimate;
+    const uint64_t decoded = C * N * F;
+    estimate.inMemoryBytes = decoded;
+    estimate.lowMemoryBytes = decoded;
+    
+    if (upsample) {
+        // All sources plus all outputs, versus one channel in flight
+        estimate.inMemoryBytes = std::max(estimate.inMemoryBytes, C * N * F + C * M * F);
+        const uint64_t lastChannel = C > 0 ? (C - 1) * M * F + N * F + M * F : 0;
+        estimate.lowMemoryBytes = std::max({estimate.lowMemoryBytes, C * N * F + M * F, lastChannel});
+    }
+    
+    if (options.enableHFC && C == 2) {
+        const uint64_t hop = HFCompensation::HOPSIZE;
+        const uint64_t size = HFCompensation::FFTSIZE;
+        const uint64_t frames = M >= size ? (M - size) / hop + 1 : 0;
+        const uint64_t spectrogram = frames * (size / 2 + 1) * sizeof(std::complex<float>);
+        
+        // Left/right and mid/side overlap briefly, then mid/side sit next to
+        // both spectrograms
+        estimate.inMemoryBytes = std::max({estimate.inMemoryBytes, 4 * M * F, 2 * M * F + 2 * spectrogram});
+        
+        // In place, plus a handful of frames of scratch
+        estimate.lowMemoryBytes = std::max(estimate.lowMemoryBytes, 2 * M * F + 16 * size * F);
+    }
+    
+    // Encoding reads the channels in blocks; both paths hold the full output
+    estimate.inMemoryBytes = std::max(estimate.inMemoryBytes, C * M * F);
+    estimate.lowMemoryBytes = std::max(estimate.lowMemoryBytes, C * M * F);
+    return estimate;
+}
+
+bool AudioProcessor::HashInput(const std::string& inputPath, uint64_t& hash) {
+    HRAW_TRACE_SCOPE("hash input");
+    return Hasher::HashFile(inputPath, hash);
+}
+
+uint64_t AudioProcessor::ResultKey(uint64_t inputHash, const Options& options) {
+    // Fields go in one by one so struct padding never leaks into the key
+    Hasher hasher;
+    hasher.UpdateValue(AnalysisKey(inputHash, options));
+    if (options.enableHFC) {
+        hasher.UpdateValue(options.lowpassFreq);
+        hasher.UpdateValue(options.compressedMode);
+        hasher.UpdateValue(options.seed);
+        // Only when set, so results cached before engines existed still match
+        if (options.engine != HFCompensation::Engine::Harmonic) hasher.UpdateValue(options.engine);
+    }
+    hasher.UpdateValue(options.outputFormat.container);
+    hasher.UpdateValue(options.outputFormat.bitDepth);
+    if (!options.outputFormat.IsFloat()) hasher.UpdateValue(options.outputFormat.dither);
+    return hasher.Digest();
+}
+
+uint64_t AudioProcessor::AnalysisKey(uint64_t inputHash, const Options& options) {
+    Hasher hasher;
+    hasher.Update(HRAW_VERSION);
+    hasher.UpdateValue(OUTPUT_REVISION);
+    hasher.UpdateValue(inputHash);
+    hasher.UpdateValue(options.enableHFC);
+    if (options.enableHFC) {
+        // The other HFC settings are ignored when it's off
+        hasher.UpdateValue(options.sampleRateMultiplier);
+        hasher.UpdateValue(HFCompensation::FFTSIZE);
+        hasher.UpdateValue(HFCompensation::HOPSIZE);
+    }
+    return hasher.Digest();
+}
+
+bool AudioProcessor::Decode(const std::string& inputPath, AudioData& audio, const Options& options,
+                            JobProgress* progress, const CancellationToken* cancel) {
+    if (CancellationToken::IsCancelled(cancel)) {
+        return false;
+    }
+    
+    if (progress) progress->BeginStage(JobStage::Decoding);
+    
+    // A cached analysis makes the decode unnecessary
+    audio.analysis.reset();
+    if (analysisCache && options.enableHFC) {
+        if (!audio.hasInputHash) audio.hasInputHash = HashInput(inputPath, audio.inputHash);
+        if (audio.hasInputHash) audio.analysis = analysisCache->Find(AnalysisKey(audio.inputHash, options));
+        if (audio.analysis) {
+            const HFCompensation::Analysis& analysis = *audio.analysis;
+            audio.channels.clear();
+            audio.sampleRate = analysis.sampleRate;
+            audio.numChannels = 2;
+            audio.numSamples = 0;
+            audio.lowMemory = false;
+            HRAW_LOG_INFO("Reusing the analysis of " << inputPath);
+            if (progress) {
+                const double frames = static_cast<double>(analysis.mid.size());
+                progress->SetAudioDuration(frames * HFCompensation::HOPSIZE / analysis.sampleRate);
+                progress->SetMemory(analysis.Bytes());
+                progress->EndStage(JobStage::Queued);
+            }
+            return true;
+        }
+    }
+    
+    // Size the job from the header before committing to a decode
+    audio.lowMemory = false;
+    int probeRate = 0, probeChannels = 0;
+    size_t probeSamples = 0;
+    if (options.memoryBudget > 0 && AudioIO().ProbeFile(inputPath, probeRate, probeChannels, probeSamples)) {
+        const MemoryEstimate estimate = EstimateMemory(probeSamples, probeChannels, probeRate, options);
+        audio.lowMemory = estimate.inMemoryBytes > options.memoryBudget;
+        if (audio.lowMemory) {
+            HRAW_LOG_INFO(inputPath << " needs about " << ToMiB(estimate.inMemoryBytes) << " MiB, over the "
+                          << ToMiB(options.memoryBudget) << " MiB budget; using the low-memory path (about "
+                          << ToMiB(estimate.lowMemoryBytes) << " MiB)");
+        }
+        if (estimate.lowMemoryBytes > options.memoryBudget) {
+            HRAW_LOG_WARN(inputPath << " needs about " << ToMiB(estimate.lowMemoryBytes)
+                          << " MiB even on the low-memory path, over the " << ToMiB(options.memoryBudget)
+                          << " MiB budget");
+        }
+    }
+    
+    if (!LoadAudioFile(inputPath, audio)) {
+        HRAW_LOG_ERROR("Failed to load audio file: " << inputPath);
+        if (progress) progress->EndStage(JobStage::Queued);
+        return false;
+    }
+    
+    if (CancellationToken::IsCancelled(cancel)) {
+        audio.channels.clear();
+        return false;
+    }
+    
+    HRAW_LOG_INFO("Loaded " << inputPath << ": " << audio.numChannels << " channels, "
+                  << audio.numSamples << " samples, " << audio.sampleRate << " Hz");
+    
+    if (progress) {
+        progress->SetAudioDuration(static_cast<double>(audio.numSamples) / audio.sampleRate);
+        progress->SetMemory(ChannelBytes(audio.channels));
+        progress->EndStage(JobStage::Queued);
+    }
+    return true;
+}
+
+void AudioProcessor::Workspace::Release() {
+    std::vector<std::vector<float>>().swap(resampled);
+    std::vector<float>().swap(mid);
+    std::vector<float>().swap(side);
+    hfc.Release();
+}
+
+bool AudioProcessor::Process(AudioData& audio, const Options& options,
+                             JobProgress* progress, const CancellationToken* cancel) {
+    // With an analysis cache, stereo HFC jobs keep their analysis for reruns
+    // at other cutoffs. The low-memory path can't afford to hold one.
+    const bool keepAnalysis = analysisCache && options.enableHFC && audio.numChannels == 2 && !audio.lowMemory;
+    if (!audio.analysis && keepAnalysis && !AnalyzeHFC(audio, options, progress, cancel)) {
+        HRAW_LOG_INFO("Cancelled during analysis");
+        return false;
     }
     
-    // Process audio
-    if (enableHFC) {
-        ApplyHFC(audio, lowpassFreq, compressedMode, progressCallback);
+    if (audio.analysis) {
+        const bool synthesized = SynthesizeHFC(audio, options, options.lowpassFreq, progress, cancel);
+        audio.analysis.reset();  // The cache holds its own reference
+        if (!synthesized) {
+            HRAW_LOG_INFO("Cancelled during HFC");
+            return false;
+        }
+    } else {
+        if (!Resample(audio, options, progress, cancel, 0, workspace)) {
+            return false;
+        }
+        
+        // Process audio
+        if (options.enableHFC && !ApplyHFC(audio, options, progress, cancel, 0, workspace)) {
+            HRAW_LOG_INFO("Cancelled during HFC");
+            audio.channels.clear();
+            return false;
+        }
     }
     
     // Verify we still have data
     if (audio.channels.empty() || audio.channels[0].empty()) {
-        std::cerr << "Error: Audio data is empty after processing!" << std::endl;
+        HRAW_LOG_ERROR("Audio data is empty after processing");
+        return false;
+    }
+    
+    HRAW_LOG_INFO("Processed audio: " << audio.channels.size() << " channels, "
+                  << audio.channels[0].size() << " samples at " << audio.sampleRate << " Hz");
+    
+    if (progress) progress->EndStage(JobStage::Queued);
+    return true;
+}
+
+bool AudioProcessor::ProcessSweep(const std::string& inputPath,
+                                  const std::vector<SweepOutput>& outputs,
+                                  const Options& options,
+                                  JobProgress* progress,
+                                  const CancellationToken* cancel) {
+    AudioData audio;
+    bool success = Decode(inputPath, audio, options, progress, cancel);
+    const bool sweep = success && options.enableHFC && audio.numChannels == 2;
+    if (success && sweep && !audio.analysis) {
+        success = AnalyzeHFC(audio, options, progress, cancel);
+    } else if (success && !sweep) {
+        success = Process(audio, options, progress, cancel);
+    }
+    
+    for (size_t i = 0; success && i < outputs.size(); ++i) {
+        if (sweep) {
+            success = SynthesizeHFC(audio, options, outputs[i].lowpassFreq, progress, cancel);
+        }
+        success = success && Encode(outputs[i].outputPath, audio, options, progress, cancel);
+        if (success) {
+            HRAW_LOG_INFO("Rendered " << outputs[i].outputPath << " (lowpass " << outputs[i].lowpassFreq << " Hz)");
+        }
+    }
+    
+    audio.channels.clear();
+    audio.analysis.reset();
+    SettleProgress(progress, success, cancel);
+    return success;
+}
+
+bool AudioProcessor::RenderRegion(const std::string& inputPath,
+                                  double startSeconds,
+                                  double lengthSeconds,
+                                  const Options& options,
+                                  AudioData& audio,
+                                  JobProgress* progress,
+                                  const CancellationToken* cancel) {
+    HRAW_TRACE_SCOPE("render region");
+    AudioIO audioIO;
+    int sampleRate = 0, numChannels = 0;
+    size_t totalFrames = 0;
+    if (!audioIO.ProbeFile(inputPath, sampleRate, numChannels, totalFrames) || sampleRate <= 0) {
+        HRAW_LOG_ERROR("Failed to open audio file: " << inputPath);
+        return false;
+    }
+    
+    const size_t start = std::min(totalFrames, static_cast<size_t>(std::max(0.0, startSeconds * sampleRate)));
+    const size_t length = std::min(totalFrames - start,
+                                   static_cast<size_t>(std::max(0.0, std::ceil(lengthSeconds * sampleRate))));
+    if (length == 0) {
+        HRAW_LOG_ERROR("Region starting at " << startSeconds << " s is past the end of " << inputPath);
+        return false;
+    }
+    
+    // One FFT frame of margin at the output rate. The read starts where
+    // readStart * multiplier lands on a hop boundary, i.e. on a frame of the
+    // full render.
+    const size_t multiplier = Multiplier(options);
+    const size_t hop = HFCompensation::HOPSIZE;
+    const size_t margin = (HFCompensation::FFTSIZE + multiplier - 1) / multiplier;
+    const size_t grid = hop / std::gcd(hop, multiplier);
+    const size_t readStart = start > margin ? (start - margin) / grid * grid : 0;
+    const size_t readEnd = std::min(totalFrames, start + length + margin);
+    
+    if (progress) progress->BeginStage(JobStage::Decoding);
+    audio = AudioData();
+    if (!LoadRegion(inputPath, readStart, readEnd - readStart, audio, totalFrames)) {
+        HRAW_LOG_ERROR("Failed to load region of " << inputPath);
+        if (progress) progress->EndStage(JobStage::Queued);
         return false;
     }
+    audio.numSamples = readEnd - readStart;
+    HRAW_LOG_DEBUG("Region of " << inputPath << ": frames " << readStart << " to " << readEnd << " for "
+                   << start << " + " << length);
+    if (progress) {
+        progress->SetAudioDuration(static_cast<double>(length) / sampleRate);
+        progress->SetMemory(ChannelBytes(audio.channels));
+        progress->EndStage(JobStage::Queued);
+    }
     
-    std::cout << "Processed audio: " << audio.channels.size() << " channels, " 
-              << audio.channels[0].size() << " samples" << std::endl;
+    if (!Resample(audio, options, progress, cancel, readStart)) {
+        return false;
+    }
+    const int firstFrame = static_cast<int>(readStart * multiplier / hop);
+    if (options.enableHFC && !ApplyHFC(audio, options, progress, cancel, firstFrame)) {
+        audio.channels.clear();
+        return false;
+    }
     
-    // Save processed audio
-    if (!SaveAudioFile(outputPath, audio)) {
-        std::cerr << "Failed to save audio file: " << outputPath << std::endl;
+    // Drop the margins
+    const size_t offset = (start - readStart) * multiplier;
+    for (auto& channel : audio.channels) {
+        const size_t end = std::min(channel.size(), offset + length * multiplier);
+        const size_t begin = std::min(offset, end);
+        channel.erase(channel.begin() + end, channel.end());
+        channel.erase(channel.begin(), channel.begin() + begin);
+    }
+    audio.numSamples = audio.channels.empty() ? 0 : audio.channels[0].size();
+    if (audio.numSamples == 0) {
+        HRAW_LOG_ERROR("Region of " << inputPath << " is empty after processing");
         return false;
     }
     
+    if (progress) progress->EndStage(JobStage::Queued);
+    return true;
+}
+
+bool AudioProcessor::Encode(const std::string& outputPath, const AudioData& audio, const Options& options,
+                            JobProgress* progress, const CancellationToken* cancel) {
+    if (CancellationToken::IsCancelled(cancel)) {
+        return false;
+    }
+    
+    if (progress) {
+        progress->BeginStage(JobStage::Encoding);
+        progress->SetMemory(ChannelBytes(audio.channels));
+    }
+    if (!SaveAudioFile(outputPath, audio, options.outputFormat, cancel)) {
+        // Don't leave a truncated file behind
+        std::remove(outputPath.c_str());
+        if (!CancellationToken::IsCancelled(cancel)) {
+            HRAW_LOG_ERROR("Failed to save audio file: " << outputPath);
+        }
+        return false;
+    }
+    
+    if (progress) progress->EndStage(JobStage::Queued);
     return true;
 }
 
 bool AudioProcessor::LoadAudioFile(const std::string& path, AudioData& audio) {
+    size_t totalFrames = 0;
+    return LoadRegion(path, 0, std::numeric_limits<size_t>::max(), audio, totalFrames);
+}
+
+bool AudioProcessor::LoadRegion(const std::string& path, size_t start, size_t count, AudioData& audio,
+                                size_t& totalFrames) {
+    HRAW_TRACE_SCOPE("load");
+    audio.source = AudioIO::Map(path);
+    if (audio.source) {
+        const MappedAudioFile& source = *audio.source;
+        audio.channels.clear();
+        audio.sampleRate = source.GetSampleRate();
+        audio.numChannels = source.GetNumChannels();
+        totalFrames = source.GetNumFrames();
+        audio.numSamples = std::min(count, totalFrames - std::min(start, totalFrames));
+        return true;
+    }
     AudioIO audioIO;
-    return audioIO.LoadFile(path, audio.channels, audio.sampleRate, audio.numChannels, audio.numSamples);
+    if (!audioIO.LoadRegion(path, start, count, audio.channels, audio.sampleRate, audio.numChannels, totalFrames)) {
+        return false;
+    }
+    audio.numSamples = audio.channels.empty() ? 0 : audio.channels[0].size();
+    return true;
+}
+
+void AudioProcessor::ConvertSource(AudioData& audio, size_t inputStart) {
+    if (!audio.source) return;
+    HRAW_TRACE_SCOPE("convert");
+    audio.channels.resize(audio.numChannels);
+    std::vector<float*> dst(audio.numChannels);
+    for (int ch = 0; ch < audio.numChannels; ++ch) {
+        audio.channels[ch].resize(audio.numSamples);
+        dst[ch] = audio.channels[ch].data();
+    }
+    audio.source->ReadFrames(inputStart, audio.numSamples, dst.data());
+    audio.source.reset();
 }
 
-bool AudioProcessor::SaveAudioFile(const std::string& path, const AudioData& audio) {
+bool AudioProcessor::SaveAudioFile(const std::string& path, const AudioData& audio, const OutputFormat& format,
+                                   const CancellationToken* cancel) {
+    HRAW_TRACE_SCOPE("save");
     AudioIO audioIO;
-    return audioIO.SaveFile(path, audio.channels, audio.sampleRate);
+    return audioIO.SaveFile(path, audio.channels, audio.sampleRate, format, cancel);
 }
 
-void AudioProcessor::ApplyHFC(AudioData& audio, int lowpassFreq, bool compressedMode, 
-                             ProgressCallback progressCallback) {
-    if (audio.numChannels != 2) {
-        std::cerr << "HFC requires stereo input" << std::endl;
-        return;
+bool AudioProcessor::Resample(AudioData& audio, const Options& options,
+                              JobProgress* progress, const CancellationToken* cancel, size_t inputStart,
+                              Workspace* buffers) {
+    const int sampleRateMultiplier = options.sampleRateMultiplier;
+    
+    // For HF compensation, we upsample based on the multiplier
+    if (!options.enableHFC || sampleRateMultiplier <= 1) {
+        ConvertSource(audio, inputStart);
+        return true;
+    }
+    
+    const int targetSampleRate = audio.sampleRate * sampleRateMultiplier;
+    HRAW_LOG_DEBUG("Upsampling from " << audio.sampleRate << " Hz to " << targetSampleRate << " Hz ("
+                   << sampleRateMultiplier << "x)");
+    
+    // Upsample audio
+    if (progress) progress->BeginStage(JobStage::Resampling);
+    {
+        HRAW_TRACE_SCOPE("resample");
+        if (audio.source) {
+            // Converted block by block as it's resampled, never whole
+            auto resampled = Resampler::ResampleMultiChannel(*audio.source, inputStart, audio.numSamples,
+                                                             targetSampleRate, cancel);
+            if (progress) progress->SetMemory(ChannelBytes(resampled));
+            audio.channels = std::move(resampled);
+            audio.source.reset();
+        } else if (audio.lowMemory) {
+            // One channel at a time, dropping each source once it's resampled
+            for (auto& channel : audio.channels) {
+                std::vector<float> resampled = Resampler::Resample(channel, audio.sampleRate, targetSampleRate,
+                                                                   cancel, inputStart);
+                if (progress) progress->SetMemory(ChannelBytes(audio.channels) + ChannelBytes(resampled));
+                channel.swap(resampled);
+                if (CancellationToken::IsCancelled(cancel)) break;
+            }
+        } else if (buffers) {
+            // Into the previous job's buffers, which this job's input then
+            // replaces for the next
+            std::vector<std::vector<float>>& resampled = buffers->resampled;
+            Resampler::ResampleMultiChannel(audio.channels, audio.sampleRate, targetSampleRate, resampled,
+                                            cancel, inputStart);
+            if (progress) progress->SetMemory(ChannelBytes(audio.channels) + ChannelBytes(resampled));
+            audio.channels.swap(resampled);
+        } else {
+            auto resampled = Resampler::ResampleMultiChannel(audio.channels, audio.sampleRate, targetSampleRate,
+                                                             cancel, inputStart);
+            if (progress) progress->SetMemory(ChannelBytes(audio.channels) + ChannelBytes(resampled));
+            audio.channels = std::move(resampled);
+        }
+    }
+    if (CancellationToken::IsCancelled(cancel)) {
+        HRAW_LOG_INFO("Cancelled during upsampling");
+        audio.channels.clear();
+        return false;
+    }
+    audio.sampleRate = targetSampleRate;
+    audio.numSamples = audio.channels[0].size();
+    
+    HRAW_LOG_DEBUG("After upsampling: " << audio.numSamples << " samples at " << audio.sampleRate << " Hz");
+    return true;
+}
+
+bool AudioProcessor::AnalyzeHFC(AudioData& audio, const Options& options,
+                                JobProgress* progress, const CancellationToken* cancel) {
+    if (!Resample(audio, options, progress, cancel)) {
+        return false;
     }
     
-    // Convert to mid/side
     std::vector<float> mid, side;
     StereoToMidSide(audio.channels[0], audio.channels[1], mid, side);
+    audio.channels.clear();
+    
+    auto analysis = std::make_shared<HFCompensation::Analysis>();
+    if (!HFCompensation(options.seed).Analyze(mid, side, audio.sampleRate, *analysis, progress, cancel)) {
+        return false;
+    }
+    audio.analysis = analysis;
+    if (analysisCache && audio.hasInputHash) {
+        analysisCache->Insert(AnalysisKey(audio.inputHash, options), std::move(analysis));
+    }
+    return true;
+}
+
+bool AudioProcessor::SynthesizeHFC(AudioData& audio, const Options& options, int lowpassFreq,
+                                   JobProgress* progress, const CancellationToken* cancel) {
+    // The previous render, if any, goes first
+    audio.channels.assign(2, std::vector<float>());
+    std::vector<float>& mid = audio.channels[0];
+    std::vector<float>& side = audio.channels[1];
+    const size_t numFrames = audio.analysis->mid.size();
+    ResetOverviews(audio.analysis->sampleRate,
+                   numFrames > 0 ? (numFrames - 1) * HFCompensation::HOPSIZE + HFCompensation::FFTSIZE : 0);
+    HFCompensation hfc(options.seed);
+    hfc.SetEngine(options.engine);
+    hfc.SetOverviews(inputOverview, outputOverview);
+    if (!hfc.Synthesize(*audio.analysis, lowpassFreq, mid, side, progress, cancel)) {
+        audio.channels.clear();
+        return false;
+    }
+    if (outputOverview) outputOverview->AddSamples(mid.data(), 0, mid.size());
+    MidSideToStereoInPlace(mid, side);
+    audio.sampleRate = audio.analysis->sampleRate;
+    audio.numChannels = 2;
+    audio.numSamples = mid.size();
+    return true;
+}
+
+bool AudioProcessor::ApplyHFC(AudioData& audio, const Options& options,
+                             JobProgress* progress, const CancellationToken* cancel, int firstFrame,
+                             Workspace* buffers) {
+    const int lowpassFreq = options.lowpassFreq;
+    if (audio.numChannels != 2) {
+        HRAW_LOG_WARN("HFC requires stereo input, skipping");
+        return true;
+    }
+    
+    HFCompensation hfc(options.seed, firstFrame);
+    hfc.SetEngine(options.engine);
+    hfc.SetOverviews(inputOverview, outputOverview);
+    hfc.SetWorkspace(buffers ? &buffers->hfc : nullptr);
+    if (audio.lowMemory) {
+        // Mid/side live in the channel buffers and HFC overwrites them frame by frame
+        std::vector<float>& mid = audio.channels[0];
+        std::vector<float>& side = audio.channels[1];
+        StereoToMidSideInPlace(mid, side);
+        ResetOverviews(audio.sampleRate, mid.size());
+        if (inputOverview) inputOverview->AddSamples(mid.data(), 0, mid.size());
+        if (progress) progress->SetMemory(ChannelBytes(audio.channels));
+        if (!hfc.ProcessStreaming(mid, side, audio.sampleRate, lowpassFreq, progress, cancel)) {
+            return false;
+        }
+        if (outputOverview) outputOverview->AddSamples(mid.data(), 0, mid.size());
+        MidSideToStereoInPlace(mid, side);
+        audio.numSamples = audio.channels[0].size();
+        return true;
+    }
+    
+    // Convert to mid/side; left/right are rebuilt from them afterwards.
+    // With a workspace, every buffer keeps its storage for the next job.
+    std::vector<float> ownMid, ownSide;
+    std::vector<float>& mid = buffers ? buffers->mid : ownMid;
+    std::vector<float>& side = buffers ? buffers->side : ownSide;
+    StereoToMidSide(audio.channels[0], audio.channels[1], mid, side);
+    if (progress) progress->SetMemory(ChannelBytes(audio.channels) + ChannelBytes(mid) + ChannelBytes(side));
+    if (!buffers) {
+        std::vector<float>().swap(audio.channels[0]);
+        std::vector<float>().swap(audio.channels[1]);
+    }
     
-    std::cout << "Before HFC - Mid size: " << mid.size() << ", Side size: " << side.size() << std::endl;
+    HRAW_LOG_DEBUG("Before HFC - Mid size: " << mid.size() << ", Side size: " << side.size());
+    ResetOverviews(audio.sampleRate, mid.size());
+    if (inputOverview) inputOverview->AddSamples(mid.data(), 0, mid.size());
     
     // Apply HFC processing
-    HFCompensation hfc;
-    hfc.Process(mid, side, audio.sampleRate, lowpassFreq, compressedMode, progressCallback);
+    if (!hfc.Process(mid, side, audio.sampleRate, lowpassFreq, options.compressedMode, progress, cancel)) {
+        return false;
+    }
+    if (outputOverview) outputOverview->AddSamples(mid.data(), 0, mid.size());
     
-    std::cout << "After HFC - Mid size: " << mid.size() << ", Side size: " << side.size() << std::endl;
+    HRAW_LOG_DEBUG("After HFC - Mid size: " << mid.size() << ", Side size: " << side.size());
     
     // Convert back to stereo
     MidSideToStereo(mid, side, audio.channels[0], audio.channels[1]);
+    if (progress) progress->SetMemory(ChannelBytes(audio.channels) + ChannelBytes(mid) + ChannelBytes(side));
     
     // Update audio data size
     audio.numSamples = audio.channels[0].size();
     
-    std::cout << "After conversion - Left size: " << audio.channels[0].size() 
-              << ", Right size: " << audio.channels[1].size() << std::endl;
+    HRAW_LOG_DEBUG("After conversion - Left size: " << audio.channels[0].size()
+                   << ", Right size: " << audio.channels[1].size());
+    return true;
+}
+
+void AudioProcessor::ResetOverviews(int sampleRate, size_t numSamples) {
+    const size_t fftSize = HFCompensation::FFTSIZE;
+    const int numFrames = numSamples >= fftSize
+        ? static_cast<int>((numSamples - fftSize) / HFCompensation::HOPSIZE) + 1 : 0;
+    for (Overview* overview : {inputOverview, outputOverview}) {
+        if (overview) {
+            overview->Reset(sampleRate, numSamples, numFrames, HFCompensation::FFTSIZE, HFCompensation::HOPSIZE);
+        }
+    }
 }
 
 void AudioProcessor::StereoToMidSide(const std::vector<float>& left, 
                                     const std::vector<float>& right,
                                     std::vector<float>& mid,
                                     std::vector<float>& side) {
+    HRAW_TRACE_SCOPE("mid/side");
     size_t numSamples = left.size();
     mid.resize(numSamples);
     side.resize(numSamples);
@@ -123,6 +880,7 @@ void AudioProcessor::MidSideToStereo(const std::vector<float>& mid,
                                     const std::vector<float>& side,
                                     std::vector<float>& left,
                                     std::vector<float>& right) {
+    HRAW_TRACE_SCOPE("mid/side");
     size_t numSamples = mid.size();
     left.resize(numSamples);
     right.resize(numSamples);
@@ -131,4 +889,24 @@ void AudioProcessor::MidSideToStereo(const std::vector<float>& mid,
         left[i] = mid[i] + side[i];
         right[i] = mid[i] - side[i];
     }
-}
\ No newline at end of file
+}
+
+void AudioProcessor::StereoToMidSideInPlace(std::vector<float>& left, std::vector<float>& right) {
+    HRAW_TRACE_SCOPE("mid/side");
+    for (size_t i = 0; i < left.size(); ++i) {
+        const float l = left[i];
+        const float r = right[i];
+        left[i] = (l + r) * 0.5f;
+        right[i] = (l - r) * 0.5f;
+    }
+}
+
+void AudioProcessor::MidSideToStereoInPlace(std::vector<float>& mid, std::vector<float>& side) {
+    HRAW_TRACE_SCOPE("mid/side");
+    for (size_t i = 0; i < mid.size(); ++i) {
+        const float m = mid[i];
+        const float s = side[i];
+        mid[i] = m + s;
+        side[i] = m - s;
+    }
+}
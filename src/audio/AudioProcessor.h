@@ -1,42 +1,250 @@
 #pragma once
 
+#include "AudioIO.h"
+#include "HFCompensation.h"
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <functional>
 #include <vector>
 #include <complex>
 
+class AnalysisCache;
+class CancellationToken;
+class JobProgress;
+class MappedAudioFile;
+class Overview;
+
 class AudioProcessor {
 public:
-    using ProgressCallback = std::function<void(float)>;
+    // Per-job processing settings
+    struct Options {
+        bool enableHFC = true;
+        int lowpassFreq = 16000;
+        bool compressedMode = false;
+        int sampleRateMultiplier = 2;
+        uint32_t seed = 0;  // Fixes HFC's random variation; 0 varies per job
+        HFCompensation::Engine engine = HFCompensation::Engine::Harmonic;  // BandReplication for bulk work
+        uint64_t memoryBudget = 0;  // Bytes one job may hold before the low-memory path kicks in; 0 = no limit
+        OutputFormat outputFormat;
+    };
+    
+    // Decoded audio for one job
+    struct AudioData {
+        std::vector<std::vector<float>> channels;  // [channel][sample]
+        int sampleRate;
+        int numChannels;
+        size_t numSamples;
+        
+        // The input file's mapping, for uncompressed inputs. Loading then
+        // converts nothing: `channels` stay empty and the resampler converts
+        // each block of the input as it consumes it. Dropped once it has.
+        std::shared_ptr<const MappedAudioFile> source;
+        bool lowMemory = false;  // Process with the low-memory path; Decode sets it from the budget
+        
+        // Hash of the input file, set by whoever computes it first (see HashInput)
+        bool hasInputHash = false;
+        uint64_t inputHash = 0;
+        
+        // HFC analysis found in the analysis cache by Decode. Process then
+        // only synthesizes; `channels` stay empty until it has.
+        std::shared_ptr<const HFCompensation::Analysis> analysis;
+    };
+    
+    // Peak bytes a job holds in audio buffers and spectrograms, on the
+    // default path and on the low-memory path. The low-memory path resamples
+    // one channel at a time, converts to mid/side in place and runs HFC frame
+    // by frame; its output is bit-identical to the default path.
+    struct MemoryEstimate {
+        uint64_t inMemoryBytes = 0;
+        uint64_t lowMemoryBytes = 0;
+    };
+    
+    static MemoryEstimate EstimateMemory(uint64_t numSamples, int numChannels, int sampleRate,
+                                         const Options& options);
+    
+    // Samples per channel, and sample rate, of the output Process makes from
+    // `numSamples` per channel at `sampleRate`. 0 samples when HFC needs more
+    // input than that.
+    static size_t OutputLength(size_t numSamples, int numChannels, const Options& options);
+    static int OutputRate(int sampleRate, const Options& options);
+    
+    // Bump whenever a change alters output samples, so cached results from
+    // older builds stop matching
+    static constexpr uint32_t OUTPUT_REVISION = 1;
+    
+    // Hash of the input file's bytes. Returns false if it can't be read.
+    static bool HashInput(const std::string& inputPath, uint64_t& hash);
+    
+    // Result cache key: the input hash and every setting that affects the
+    // output (not the memory budget, which doesn't). Jobs with seed 0 share
+    // one key, so a rerun reuses the variation drawn first.
+    static uint64_t ResultKey(uint64_t inputHash, const Options& options);
+    
+    // Analysis cache key: the input hash and the settings that come before
+    // the cutoff-dependent synthesis
+    static uint64_t AnalysisKey(uint64_t inputHash, const Options& options);
+    
+    // Keep HFC analyses in `cache` (null to stop), so reprocessing a stereo
+    // file with only the cutoff changed skips straight to synthesis. The
+    // cache must outlive any job started while it is set.
+    void SetAnalysisCache(AnalysisCache* cache) { analysisCache = cache; }
+    
+    // Buffers Process keeps from one job to the next when given a
+    // workspace: the resampler's output, mid/side and HFC's STFT and
+    // spectrograms. For callers processing many in-memory buffers of
+    // similar length, such as the C API; the low-memory path and the
+    // segments ProcessFile renders in parallel don't use it. One job at a
+    // time may use it.
+    struct Workspace {
+        std::vector<std::vector<float>> resampled;
+        std::vector<float> mid, side;
+        HFCompensation::Workspace hfc;
+        
+        // Free all of it; the next job fills it again
+        void Release();
+    };
+    
+    // Null, the default, to stop. The workspace must outlive any job
+    // started while it is set.
+    void SetWorkspace(Workspace* workspace) { this->workspace = workspace; }
+    
+    // Fill `input` and `output` (either may be null) with overviews of the
+    // mid channel before and after HFC while processing. Each is reset when
+    // a job reaches HFC. Jobs resumed from a cached analysis only have the
+    // input spectrogram, not its waveform.
+    void SetOverviews(Overview* input, Overview* output) {
+        inputOverview = input;
+        outputOverview = output;
+    }
+    
+    // One output of a cutoff sweep
+    struct SweepOutput {
+        int lowpassFreq;
+        std::string outputPath;
+    };
+    
+    // Render one input at several cutoffs from a single analysis. Inputs HFC
+    // doesn't apply to (mono, or HFC off) are processed once and written to
+    // every output. Settles `progress` like ProcessFile; true only if every
+    // output was written.
+    bool ProcessSweep(const std::string& inputPath,
+                      const std::vector<SweepOutput>& outputs,
+                      const Options& options,
+                      JobProgress* progress = nullptr,
+                      const CancellationToken* cancel = nullptr);
     
     AudioProcessor();
     ~AudioProcessor();
     
-    // Main processing function
+    // Main processing function. Returns false without leaving an output
+    // file behind if `cancel` fires. Stage and progress are published to
+    // `progress`, which ends in Done, Failed or Cancelled.
+    bool ProcessFile(const std::string& inputPath,
+                    const std::string& outputPath,
+                    const Options& options,
+                    JobProgress* progress = nullptr,
+                    const CancellationToken* cancel = nullptr);
+    
+    // Pipeline stages; ProcessFile runs them back to back, BatchPipeline
+    // runs them on separate threads. Each call is independent of the others.
+    // A cancelled stage frees the job's audio and returns false. Each stage
+    // leaves `progress` Queued on success; the caller settles the outcome.
+    // Decode sizes the job from the file header first and flags it for the
+    // low-memory path if it would exceed `options.memoryBudget`. With an
+    // analysis cache set it looks the file up first and, on a hit, loads
+    // nothing.
+    bool Decode(const std::string& inputPath, AudioData& audio, const Options& options,
+                JobProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+    bool Process(AudioData& audio, const Options& options,
+                 JobProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+    bool Encode(const std::string& outputPath, const AudioData& audio, const Options& options,
+                JobProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+    
+    // Output samples per segment of a segmented render
+    static constexpr size_t SEGMENT_SAMPLES = static_cast<size_t>(1) << 20;
+    
+    // All three stages for one long input, in place of them. The output is
+    // cut into segments of SEGMENT_SAMPLES, each rendered on its own from
+    // the input it needs plus an FFT frame of margin, read with a seek, and
+    // written in order as segments finish. A single file then keeps every
+    // core busy while only a few segments are in memory, and the file is
+    // byte-identical to the one the stages write with the same seed.
+    bool ProcessFileSegmented(const std::string& inputPath, const std::string& outputPath, const Options& options,
+                              JobProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+    
+    // Whether to use ProcessFileSegmented for `inputPath`, as ProcessFile
+    // does: outputs of two segments or more, unless overviews are set.
+    // Such inputs bypass the analysis cache.
+    bool ShouldSegment(const std::string& inputPath, const Options& options) const;
+    
+    // Move `progress` to Done, Failed or Cancelled after the last stage ran
+    static void SettleProgress(JobProgress* progress, bool success, const CancellationToken* cancel);
+    
+    // Process a short excerpt the way the whole file would be, for previews.
+    // Seeks to [startSeconds, startSeconds + lengthSeconds) and reads only
+    // that plus an FFT frame of margin on each side, starting on the file's
+    // STFT frame grid so the excerpt matches that part of a full render; with
+    // a fixed seed the random variation matches too. `audio` receives the
+    // processed excerpt at the output rate, trimmed to the requested range.
+    // Doesn't touch the analysis cache.
+    bool RenderRegion(const std::string& inputPath,
+                      double startSeconds,
+                      double lengthSeconds,
+                      const Options& options,
+                      AudioData& audio,
+                      JobProgress* progress = nullptr,
+                      const CancellationToken* cancel = nullptr);
+    
+    // Convenience overload; writes 32-bit float WAV
     bool ProcessFile(const std::string& inputPath,
                     const std::string& outputPath,
                     bool enableHFC,
                     int lowpassFreq,
                     bool compressedMode,
                     int sampleRateMultiplier = 2,
-                    ProgressCallback progressCallback = nullptr);
+                    JobProgress* progress = nullptr);
     
 private:
-    // Audio data structure
-    struct AudioData {
-        std::vector<std::vector<float>> channels;  // [channel][sample]
-        int sampleRate;
-        int numChannels;
-        size_t numSamples;
-    };
+    AnalysisCache* analysisCache = nullptr;
+    Workspace* workspace = nullptr;
+    Overview* inputOverview = nullptr;
+    Overview* outputOverview = nullptr;
+    
+    // Size the overviews for a job's HFC pass over `numSamples` of mid/side
+    void ResetOverviews(int sampleRate, size_t numSamples);
     
     // Processing helpers
     bool LoadAudioFile(const std::string& path, AudioData& audio);
-    bool SaveAudioFile(const std::string& path, const AudioData& audio);
+    
+    // Frames [start, start + count) of `path`, clamped to the file, as a
+    // mapped source or, for formats that can't be mapped, decoded channels.
+    // `totalFrames` is the length of the whole file.
+    bool LoadRegion(const std::string& path, size_t start, size_t count, AudioData& audio, size_t& totalFrames);
+    
+    // Convert a mapped source into channels, for stages that need them whole
+    void ConvertSource(AudioData& audio, size_t inputStart);
+    bool SaveAudioFile(const std::string& path, const AudioData& audio, const OutputFormat& format,
+                       const CancellationToken* cancel);
+    
+    // Upsample by options.sampleRateMultiplier, if HFC is on. `inputStart`
+    // is where audio.channels, or the frames taken from audio.source, start
+    // in the file, for excerpts. Leaves the audio in `channels` either way.
+    // `buffers`, if given, is the workspace to work in; segments rendered in
+    // parallel don't share one.
+    bool Resample(AudioData& audio, const Options& options, JobProgress* progress, const CancellationToken* cancel,
+                  size_t inputStart = 0, Workspace* buffers = nullptr);
     
     // HFC processing
-    void ApplyHFC(AudioData& audio, int lowpassFreq, bool compressedMode, 
-                  ProgressCallback progressCallback);
+    bool ApplyHFC(AudioData& audio, const Options& options, JobProgress* progress, const CancellationToken* cancel,
+                  int firstFrame = 0, Workspace* buffers = nullptr);
+    
+    // ApplyHFC in two halves around audio.analysis. AnalyzeHFC resamples,
+    // analyzes and frees the channels, adding the analysis to the cache;
+    // SynthesizeHFC rebuilds the channels from it at `lowpassFreq`. The
+    // analysis is the same for every engine.
+    bool AnalyzeHFC(AudioData& audio, const Options& options, JobProgress* progress, const CancellationToken* cancel);
+    bool SynthesizeHFC(AudioData& audio, const Options& options, int lowpassFreq,
+                       JobProgress* progress, const CancellationToken* cancel);
     
     // Convert stereo to mid/side
     void StereoToMidSide(const std::vector<float>& left, 
@@ -49,4 +257,8 @@ private:
                         const std::vector<float>& side,
                         std::vector<float>& left,
                         std::vector<float>& right);
+    
+    // Same conversions, overwriting the inputs
+    void StereoToMidSideInPlace(std::vector<float>& left, std::vector<float>& right);
+    void MidSideToStereoInPlace(std::vector<float>& mid, std::vector<float>& side);
 };
\ No newline at end of file
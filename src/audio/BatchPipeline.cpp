@@ -0,0 +1,196 @@
+#include "BatchPipeline.h"
+#include "../util/CancellationToken.h"
+#include "../util/Log.h"
+#include "../util/Memory.h"
+#include "../util/ResultCache.h"
+#include "../util/SpscQueue.h"
+#include "../util/TaskScheduler.h"
+#include "../util/Telemetry.h"
+#include "../util/Trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// One file in flight between stages
+struct WorkItem {
+    size_t index = 0;
+    bool ok = false;
+    bool cached = false;  // Output restored from the result cache; nothing left to do
+    bool segmented = false;  // Long file rendered and written by its process task, not decoded here
+    bool hasKey = false;
+    uint64_t key = 0;
+    AudioProcessor::AudioData audio;
+};
+
+// A null item marks the end of the batch
+using WorkQueue = SpscQueue<std::unique_ptr<WorkItem>>;
+
+double SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+std::string BatchPipeline::Stats::Utilization() const {
+    auto percent = [this](double busy) {
+        return wallSeconds > 0.0 ? static_cast<int>(100.0 * busy / wallSeconds + 0.5) : 0;
+    };
+
+    std::stringstream ss;
+    ss << "decode " << percent(decodeSeconds) << "%, "
+       << "process " << percent(processSeconds) << "%, "
+       << "encode " << percent(encodeSeconds) << "%";
+    return ss.str();
+}
+
+BatchPipeline::BatchPipeline(AudioProcessor& processor, const AudioProcessor::Options& options,
+                             const CancellationToken* cancel, Telemetry* telemetry, ResultCache* cache)
+    : processor(processor), options(options), cancel(cancel), telemetry(telemetry), cache(cache) {
+}
+
+BatchPipeline::Stats BatchPipeline::Run(const std::vector<Job>& jobs) {
+    Stats stats;
+    if (jobs.empty()) return stats;
+
+    const bool publish = telemetry && telemetry->NumJobs() >= jobs.size();
+    auto progressFor = [&](size_t index) -> JobProgress* {
+        return publish ? &telemetry->Job(index) : nullptr;
+    };
+
+    // Files handed to the process stage and not yet taken by the encoder.
+    // Capping them at the capacity of `processed` means a process task never
+    // blocks on a push, which could deadlock if the encoder's own waits ran it.
+    TaskScheduler& scheduler = TaskScheduler::Shared();
+    const int maxUnencoded = PROCESS_SLOTS + static_cast<int>(QUEUE_DEPTH);
+    std::atomic<int> unencoded{0};
+
+    WorkQueue decoded(QUEUE_DEPTH);
+    WorkQueue processed(maxUnencoded + 1);  // + the end marker
+
+    const Clock::time_point batchStart = Clock::now();
+
+    // Each stage only writes its own busy-time counter, and the values are
+    // read after the threads are joined and the process tasks finished
+    std::thread decodeThread([&]() {
+        HRAW_TRACE_THREAD("decode");
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            Clock::time_point start = Clock::now();
+            auto item = std::make_unique<WorkItem>();
+            item->index = i;
+            if (cache && !CancellationToken::IsCancelled(cancel)) {
+                // Decode reuses the hash for the analysis cache
+                AudioProcessor::AudioData& audio = item->audio;
+                audio.hasInputHash = AudioProcessor::HashInput(jobs[i].inputPath, audio.inputHash);
+                item->hasKey = audio.hasInputHash;
+                item->key = AudioProcessor::ResultKey(audio.inputHash, options);
+                item->cached = item->hasKey && cache->Fetch(item->key, jobs[i].outputPath);
+            }
+            if (item->cached) {
+                HRAW_LOG_INFO("Reused cached result for " << jobs[i].inputPath);
+                item->ok = true;
+            } else if (processor.ShouldSegment(jobs[i].inputPath, options)) {
+                item->segmented = true;
+                item->ok = true;
+            } else {
+                item->ok = processor.Decode(jobs[i].inputPath, item->audio, options, progressFor(i), cancel);
+            }
+            stats.decodeSeconds += SecondsSince(start);
+            decoded.Push(std::move(item));
+        }
+        decoded.Push(nullptr);
+    });
+
+    std::thread encodeThread([&]() {
+        HRAW_TRACE_THREAD("encode");
+        while (std::unique_ptr<WorkItem> item = processed.Pop()) {
+            unencoded--;
+            scheduler.Notify();
+            Clock::time_point start = Clock::now();
+            const std::string& outputPath = jobs[item->index].outputPath;
+            if (item->ok && !item->cached) {
+                if (!item->segmented) {
+                    // The old output may be a hard link into the cache; write a
+                    // new file rather than truncating the cached copy
+                    if (cache) std::remove(outputPath.c_str());
+                    item->ok = processor.Encode(outputPath, item->audio, options, progressFor(item->index), cancel);
+                }
+                if (item->ok && item->hasKey) cache->Store(item->key, outputPath);
+            }
+            const size_t index = item->index;
+            const bool ok = item->ok;
+            const bool cached = item->cached;
+            item.reset();  // Free the samples before reporting
+            stats.encodeSeconds += SecondsSince(start);
+            AudioProcessor::SettleProgress(progressFor(index), ok, cancel);
+
+            if (ok) {
+                ++stats.succeeded;
+                if (cached) ++stats.cached;
+            } else if (CancellationToken::IsCancelled(cancel)) {
+                ++stats.cancelled;
+            } else {
+                ++stats.failed;
+            }
+        }
+    });
+
+    // The processing stage is fed from the calling thread and runs each file
+    // as a task, up to PROCESS_SLOTS at once. Waiting for a free slot runs
+    // the files' own frame and block tasks.
+    HRAW_TRACE_THREAD("process");
+    std::mutex processedMutex;  // `processed` has one producer at a time; guards processSeconds too
+    std::atomic<int> processing{0};
+    {
+        TaskGroup files(scheduler);
+        while (std::unique_ptr<WorkItem> item = decoded.Pop()) {
+            scheduler.HelpUntil([&]() { return processing.load() < PROCESS_SLOTS && unencoded.load() < maxUnencoded; });
+            processing++;
+            unencoded++;
+            // std::function needs a copyable task, so the item travels as a raw pointer
+            files.Run([&, raw = item.release()]() {
+                std::unique_ptr<WorkItem> item(raw);
+                Clock::time_point start = Clock::now();
+                const Job& job = jobs[item->index];
+                if (item->ok && !item->cached && item->segmented) {
+                    if (cache) std::remove(job.outputPath.c_str());  // As the encoder does
+                    item->ok = processor.ProcessFileSegmented(job.inputPath, job.outputPath, options,
+                                                              progressFor(item->index), cancel);
+                } else if (item->ok && !item->cached) {
+                    item->ok = processor.Process(item->audio, options, progressFor(item->index), cancel);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(processedMutex);
+                    stats.processSeconds += SecondsSince(start);
+                    processed.Push(std::move(item));
+                }
+                processing--;
+                scheduler.Notify();
+            });
+        }
+    }
+    processed.Push(nullptr);
+
+    decodeThread.join();
+    encodeThread.join();
+    stats.wallSeconds = SecondsSince(batchStart);
+    stats.peakRssBytes = Memory::PeakRss();
+    if (cache) cache->Save();
+
+    HRAW_LOG_INFO("Batch finished in " << std::fixed << std::setprecision(2) << stats.wallSeconds
+                  << " s; stage utilization: " << stats.Utilization() << "; peak RSS "
+                  << stats.peakRssBytes / Memory::MIB << " MiB");
+    if (cache) {
+        HRAW_LOG_INFO(stats.cached << " of " << jobs.size() << " files reused from the result cache ("
+                      << cache->NumEntries() << " entries, " << cache->SizeBytes() / Memory::MIB << " MiB)");
+    }
+    return stats;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "AudioProcessor.h"
+#include <string>
+#include <vector>
+
+class CancellationToken;
+class ResultCache;
+class Telemetry;
+
+// Runs a batch of files through AudioProcessor as three overlapping stages:
+// decode -> process -> encode, connected by bounded lock-free queues.
+// Decode and encode each have a thread; processing runs on the shared
+// TaskScheduler, two files at a time, so short files that can't keep every
+// core busy on their own overlap. While files are being processed the next
+// one is already being decoded and the previous one written, so I/O and
+// codec time hide behind the HFC stage instead of adding to it. Files long
+// enough for AudioProcessor::ProcessFileSegmented skip the decode and
+// encode stages; their process task renders and writes them in segments.
+//
+// The processor's overviews, if set, would mix the files being processed
+// at once; the processor is otherwise shared safely.
+class BatchPipeline {
+public:
+    struct Job {
+        std::string inputPath;
+        std::string outputPath;
+    };
+
+    // Time each stage spent working (as opposed to waiting on its neighbours).
+    // Processing time is summed over the files processed at once, so it can
+    // exceed the wall time.
+    struct Stats {
+        double wallSeconds = 0.0;
+        double decodeSeconds = 0.0;
+        double processSeconds = 0.0;
+        double encodeSeconds = 0.0;
+        int succeeded = 0;
+        int failed = 0;
+        int cancelled = 0;
+        int cached = 0;  // Succeeded by reusing a cached result; included in `succeeded`
+        uint64_t peakRssBytes = 0;  // Process high-water mark at the end of the batch, 0 if unknown
+
+        // "decode 12%, process 97%, encode 31%"
+        std::string Utilization() const;
+    };
+
+    // Decoded files allowed to wait between two stages. With one slot the
+    // decoder runs at most one file ahead of the processor, bounding the
+    // number of files held in memory at once.
+    static constexpr size_t QUEUE_DEPTH = 1;
+
+    // Files processed at once. Each may use options.memoryBudget.
+    static constexpr int PROCESS_SLOTS = 2;
+
+    // `cancel` is shared by every stage; once it fires, in-flight jobs stop at
+    // their next check and the remaining ones are skipped without decoding.
+    // Job i publishes to telemetry->Job(i), which the caller must have sized
+    // with BeginBatch for at least as many jobs as it passes to Run.
+    // With a `cache`, jobs whose input and settings match an earlier run
+    // restore that output instead of being decoded, and every newly written
+    // output is added to it.
+    BatchPipeline(AudioProcessor& processor, const AudioProcessor::Options& options,
+                  const CancellationToken* cancel = nullptr, Telemetry* telemetry = nullptr,
+                  ResultCache* cache = nullptr);
+
+    // Blocks until the last job has been written or skipped
+    Stats Run(const std::vector<Job>& jobs);
+
+private:
+    AudioProcessor& processor;
+    AudioProcessor::Options options;
+    const CancellationToken* cancel;
+    Telemetry* telemetry;
+    ResultCache* cache;
+};
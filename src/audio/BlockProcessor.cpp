@@ -0,0 +1,288 @@
+#include "BlockProcessor.h"
+#include "HFCompensation.h"
+#include "../dsp/Kernels.h"
+#include "../dsp/STFT.h"
+#include "../util/Log.h"
+#include "../util/SpscQueue.h"
+#include "../util/Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <random>
+
+namespace {
+
+constexpr int FFTSIZE = HFCompensation::FFTSIZE;
+constexpr int HOPSIZE = HFCompensation::HOPSIZE;
+
+constexpr int MAX_MULTIPLIER = 16;
+
+// Hops in flight beyond those one block covers: the latency's three, the
+// one being filled or played and one of slack
+constexpr int SPARE_HOPS = 5;
+
+// How long the worker sleeps when there is nothing to do. Hops arrive every
+// 10-50 ms, so this costs nothing in latency.
+constexpr auto IDLE_SLEEP = std::chrono::microseconds(500);
+
+} // namespace
+
+BlockProcessor::BlockProcessor() {
+}
+
+BlockProcessor::~BlockProcessor() {
+    Release();
+}
+
+bool BlockProcessor::Prepare(int rate, int maxBlock, int factor, int lowpassFreq, uint32_t seed,
+                             HFCompensation::Engine hfcEngine) {
+    Release();
+    if (rate <= 0 || maxBlock <= 0 || factor < 1 || factor > MAX_MULTIPLIER) {
+        HRAW_LOG_ERROR("BlockProcessor: invalid stream format (" << rate << " Hz, blocks of " << maxBlock
+                       << ", x" << factor << ")");
+        return false;
+    }
+
+    sampleRate = rate;
+    maxBlockFrames = maxBlock;
+    multiplier = factor;
+    lowpassIdx = HFCompensation::LowpassBin(rate * factor, lowpassFreq);
+    jobSeed = seed != 0 ? seed : std::random_device{}();
+    engine = hfcEngine;
+
+    // A block's output is pulled before the worker has seen its input, so
+    // the output runs one block behind. On top of that: one hop still
+    // collecting, one hop of a frame whose samples aren't final until the
+    // next frame is added, and one hop of time for the worker to run a
+    // frame, however small the next block is.
+    const int blockOutput = maxBlock * factor;
+    silenceRemaining = blockOutput + FFTSIZE + HOPSIZE;
+    latencyFrames = static_cast<int>(silenceRemaining) + factor;  // `factor`: the upsampler waits for the next input
+
+    const int numHops = (blockOutput + HOPSIZE - 1) / HOPSIZE + SPARE_HOPS;
+    hopBuffers.assign(2 * numHops, HopBuffer());
+    inputFree = std::make_unique<SpscQueue<HopBuffer*>>(numHops);
+    inputFull = std::make_unique<SpscQueue<HopBuffer*>>(numHops);
+    outputFree = std::make_unique<SpscQueue<HopBuffer*>>(numHops);
+    outputFull = std::make_unique<SpscQueue<HopBuffer*>>(numHops);
+    for (int i = 0; i < 2 * numHops; ++i) {
+        HopBuffer& hop = hopBuffers[i];
+        hop.a.assign(HOPSIZE, 0.0f);
+        hop.b.assign(HOPSIZE, 0.0f);
+        HopBuffer* pointer = &hop;
+        (i < numHops ? inputFree : outputFree)->TryPush(pointer);
+    }
+
+    previous[0] = previous[1] = 0.0f;
+    inputHop = outputHop = nullptr;
+    inputFill = outputRead = 0;
+    lostFill = lostHops = 0;
+    skipDebt = 0;
+    underrunFrames.store(0, std::memory_order_relaxed);
+    droppedFrames.store(0, std::memory_order_relaxed);
+
+    stopping.store(false, std::memory_order_relaxed);
+    worker = std::thread(&BlockProcessor::WorkerLoop, this);
+    prepared = true;
+
+    HRAW_LOG_INFO("Streaming HFC at " << rate << " Hz x" << factor << ", blocks of up to " << maxBlock
+                  << ", latency " << latencyFrames << " frames (" << LatencySeconds() * 1000.0 << " ms)");
+    return true;
+}
+
+void BlockProcessor::Release() {
+    if (worker.joinable()) {
+        stopping.store(true, std::memory_order_release);
+        worker.join();
+    }
+    prepared = false;
+    inputFree.reset();
+    inputFull.reset();
+    outputFree.reset();
+    outputFull.reset();
+    hopBuffers.clear();
+    inputHop = outputHop = nullptr;
+}
+
+double BlockProcessor::LatencySeconds() const {
+    return sampleRate > 0 ? static_cast<double>(latencyFrames) / (static_cast<double>(sampleRate) * multiplier) : 0.0;
+}
+
+bool BlockProcessor::Process(const float* const* input, float* const* output, int numFrames) {
+    if (!prepared || numFrames < 0 || numFrames > maxBlockFrames) {
+        const size_t count = static_cast<size_t>(std::max(numFrames, 0)) * multiplier;
+        std::fill(output[0], output[0] + count, 0.0f);
+        std::fill(output[1], output[1] + count, 0.0f);
+        return false;
+    }
+
+    // Each input frame closes the interval from the previous one, which is
+    // filled with `multiplier` interpolated frames starting at the previous
+    const float step = 1.0f / multiplier;
+    for (int i = 0; i < numFrames; ++i) {
+        const float left = input[0][i];
+        const float right = input[1][i];
+        for (int k = 0; k < multiplier; ++k) {
+            const float fraction = k * step;
+            const float l = previous[0] + (left - previous[0]) * fraction;
+            const float r = previous[1] + (right - previous[1]) * fraction;
+            PushFrame((l + r) * 0.5f, (l - r) * 0.5f);
+        }
+        previous[0] = left;
+        previous[1] = right;
+    }
+
+    const int outputFrames = numFrames * multiplier;
+    for (int i = 0; i < outputFrames; ++i) {
+        PullFrame(output[0][i], output[1][i]);
+    }
+    return true;
+}
+
+void BlockProcessor::PushFrame(float mid, float side) {
+    if (!inputHop && lostFill == 0 && inputFree->TryPop(inputHop)) {
+        inputHop->lostBefore = lostHops;
+        lostHops = 0;
+        inputFill = 0;
+    }
+    if (!inputHop) {
+        // Every buffer is queued for the worker. Lose this whole hop and
+        // have the worker put silence in its place, so the output keeps
+        // the input's timeline.
+        droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        if (++lostFill == HOPSIZE) {
+            lostFill = 0;
+            ++lostHops;
+        }
+        return;
+    }
+    inputHop->a[inputFill] = mid;
+    inputHop->b[inputFill] = side;
+    if (++inputFill == HOPSIZE) {
+        // Always fits: each queue holds every buffer of its half
+        inputFull->TryPush(inputHop);
+        inputHop = nullptr;
+    }
+}
+
+void BlockProcessor::PullFrame(float& left, float& right) {
+    if (silenceRemaining > 0) {
+        --silenceRemaining;
+        left = right = 0.0f;
+        return;
+    }
+    while (true) {
+        if (!outputHop) {
+            if (!outputFull->TryPop(outputHop)) {
+                underrunFrames.fetch_add(1, std::memory_order_relaxed);
+                ++skipDebt;
+                left = right = 0.0f;
+                return;
+            }
+            outputRead = 0;
+        }
+        if (skipDebt > 0) {
+            const int skipped = static_cast<int>(std::min<int64_t>(skipDebt, HOPSIZE - outputRead));
+            outputRead += skipped;
+            skipDebt -= skipped;
+        }
+        if (outputRead < HOPSIZE) {
+            left = outputHop->a[outputRead];
+            right = outputHop->b[outputRead];
+            if (++outputRead == HOPSIZE) {
+                outputFree->TryPush(outputHop);
+                outputHop = nullptr;
+            }
+            return;
+        }
+        outputFree->TryPush(outputHop);
+        outputHop = nullptr;
+    }
+}
+
+void BlockProcessor::WorkerLoop() {
+    HRAW_TRACE_THREAD("stream");
+    HFCompensation hfc(jobSeed);
+    hfc.SetEngine(engine);
+    STFT stft(FFTSIZE, HOPSIZE);
+    const std::vector<float>& window = stft.Window();
+
+    // The last FFTSIZE upsampled samples, and the overlap-add of every
+    // frame that still has samples to finish (as in ProcessStreaming)
+    std::vector<float> midHistory(FFTSIZE, 0.0f), sideHistory(FFTSIZE, 0.0f);
+    std::vector<float> midAcc(FFTSIZE, 0.0f), sideAcc(FFTSIZE, 0.0f), windowSum(FFTSIZE, 0.0f);
+    int hopsReceived = 0;
+    uint32_t frame = 0;
+
+    // Slide the history along one hop of input, or of silence for null
+    auto takeHop = [&](const HopBuffer* hop) {
+        std::copy(midHistory.begin() + HOPSIZE, midHistory.end(), midHistory.begin());
+        std::copy(sideHistory.begin() + HOPSIZE, sideHistory.end(), sideHistory.begin());
+        if (hop) {
+            std::copy(hop->a.begin(), hop->a.end(), midHistory.end() - HOPSIZE);
+            std::copy(hop->b.begin(), hop->b.end(), sideHistory.end() - HOPSIZE);
+        } else {
+            std::fill(midHistory.end() - HOPSIZE, midHistory.end(), 0.0f);
+            std::fill(sideHistory.end() - HOPSIZE, sideHistory.end(), 0.0f);
+        }
+        // The first frame starts at the stream's first sample, as in a file
+        return ++hopsReceived >= FFTSIZE / HOPSIZE;
+    };
+
+    // Hand the finished hop of the overlap-add to the audio thread; false
+    // if stopped while waiting for a buffer
+    auto emitHop = [&]() {
+        HopBuffer* out = nullptr;
+        while (!outputFree->TryPop(out)) {
+            if (stopping.load(std::memory_order_acquire)) return false;
+            std::this_thread::sleep_for(IDLE_SLEEP);
+        }
+        Kernels::DivideNonZero(midAcc.data(), windowSum.data(), HOPSIZE);
+        Kernels::DivideNonZero(sideAcc.data(), windowSum.data(), HOPSIZE);
+        for (int i = 0; i < HOPSIZE; ++i) {
+            out->a[i] = midAcc[i] + sideAcc[i];
+            out->b[i] = midAcc[i] - sideAcc[i];
+        }
+        outputFull->TryPush(out);
+
+        for (std::vector<float>* acc : {&midAcc, &sideAcc, &windowSum}) {
+            std::copy(acc->begin() + HOPSIZE, acc->end(), acc->begin());
+            std::fill(acc->end() - HOPSIZE, acc->end(), 0.0f);
+        }
+        return true;
+    };
+
+    while (!stopping.load(std::memory_order_acquire)) {
+        HopBuffer* hop = nullptr;
+        if (!inputFull->TryPop(hop)) {
+            std::this_thread::sleep_for(IDLE_SLEEP);
+            continue;
+        }
+
+        // Hops lost while this thread was behind get a hop of output each
+        // but no frame of their own, which would only put it further behind
+        for (int lost = hop->lostBefore; lost > 0; --lost) {
+            if (!takeHop(nullptr)) continue;
+            ++frame;
+            if (!emitHop()) return;
+        }
+
+        const bool frameReady = takeHop(hop);
+        inputFree->TryPush(hop);
+        if (!frameReady) continue;
+
+        HRAW_TRACE_SCOPE("stream frame");
+        std::vector<std::complex<float>> midFrame = stft.ForwardFrame(midHistory, 0);
+        std::vector<std::complex<float>> sideFrame = stft.ForwardFrame(sideHistory, 0);
+        // Frame indices only feed the per-frame seed, so wrapping is harmless
+        hfc.ProcessFrame(midFrame, sideFrame, lowpassIdx, jobSeed, static_cast<int>(frame++ & 0x7fffffff));
+
+        const std::vector<float> midOut = stft.InverseFrame(midFrame);
+        const std::vector<float> sideOut = stft.InverseFrame(sideFrame);
+        Kernels::Accumulate(midAcc.data(), midOut.data(), FFTSIZE);
+        Kernels::Accumulate(sideAcc.data(), sideOut.data(), FFTSIZE);
+        Kernels::AccumulateSquares(windowSum.data(), window.data(), FFTSIZE);
+
+        if (!emitHop()) return;
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "HFCompensation.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+template <typename T>
+class SpscQueue;
+
+// HFC on a live stereo stream, for audio callbacks (plugins, radio chains).
+//
+// Process runs on the host's audio thread and is real-time safe: it never
+// allocates, locks or waits. It only upsamples by the multiplier (linear,
+// like Resampler), splits mid/side and trades hop-sized buffers with a
+// worker thread through lock-free queues, all of them sized in Prepare.
+// The worker runs the STFT frames, the same ProcessFrame as the file path
+// and the overlap-add, and hands back finished left/right hops.
+//
+// Output is delayed by LatencyFrames(), which covers the FFT window, one
+// block and one hop of time for the worker; hosts can report it for delay
+// compensation. If the worker falls behind, the missing output is played
+// as silence and skipped later. If it falls so far behind that input finds
+// no free hop buffer, whole hops of input are lost and the worker puts
+// silence in their place. Either way the latency never drifts.
+class BlockProcessor {
+public:
+    BlockProcessor();
+    ~BlockProcessor();
+
+    BlockProcessor(const BlockProcessor&) = delete;
+    BlockProcessor& operator=(const BlockProcessor&) = delete;
+
+    // Size every buffer and start the worker for blocks of up to
+    // `maxBlockFrames` input frames. Not real-time safe; call it before
+    // streaming starts, never concurrently with Process. Calling it again
+    // restarts the stream. `seed` 0 picks a random one. BandReplication
+    // keeps the worker's cost per hop fixed, whatever the material.
+    bool Prepare(int sampleRate, int maxBlockFrames, int multiplier,
+                 int lowpassFreq = 16000, uint32_t seed = 0,
+                 HFCompensation::Engine engine = HFCompensation::Engine::Harmonic);
+
+    // Stop the worker and free the buffers; Process outputs silence until
+    // the next Prepare
+    void Release();
+
+    // Take `numFrames` stereo input frames and write numFrames * Multiplier()
+    // output frames. Blocks may be any size up to maxBlockFrames. Returns
+    // false (with silent output) if not prepared or the block is too long.
+    bool Process(const float* const* input, float* const* output, int numFrames);
+
+    bool IsPrepared() const { return prepared; }
+    int Multiplier() const { return multiplier; }
+    int OutputSampleRate() const { return sampleRate * multiplier; }
+
+    // Delay from input to output, in output frames
+    int LatencyFrames() const { return latencyFrames; }
+    double LatencySeconds() const;
+
+    // Output frames played as silence because the worker fell behind, and
+    // upsampled input frames lost (replaced by silence) because its queue was
+    // full. Both read from any thread.
+    uint64_t UnderrunFrames() const { return underrunFrames.load(std::memory_order_relaxed); }
+    uint64_t DroppedFrames() const { return droppedFrames.load(std::memory_order_relaxed); }
+
+private:
+    // One hop of two channels: mid/side on the way in, left/right on the way out
+    struct HopBuffer {
+        std::vector<float> a;
+        std::vector<float> b;
+        int lostBefore = 0;  // Input hops lost just before this one
+    };
+
+    int sampleRate = 0;
+    int multiplier = 1;
+    int maxBlockFrames = 0;
+    int lowpassIdx = 0;
+    uint32_t jobSeed = 0;
+    HFCompensation::Engine engine = HFCompensation::Engine::Harmonic;
+    int latencyFrames = 0;
+    bool prepared = false;
+
+    // Buffers are owned here and only their pointers travel the queues
+    std::vector<HopBuffer> hopBuffers;
+    std::unique_ptr<SpscQueue<HopBuffer*>> inputFree;    // Worker -> audio thread
+    std::unique_ptr<SpscQueue<HopBuffer*>> inputFull;    // Audio thread -> worker
+    std::unique_ptr<SpscQueue<HopBuffer*>> outputFree;   // Audio thread -> worker
+    std::unique_ptr<SpscQueue<HopBuffer*>> outputFull;   // Worker -> audio thread
+
+    // Audio thread state
+    float previous[2] = {0.0f, 0.0f};  // Last input frame, the upsampler's left end
+    HopBuffer* inputHop = nullptr;
+    int inputFill = 0;
+    int lostFill = 0;   // Frames of the input hop being lost
+    int lostHops = 0;   // Hops lost since the last one queued
+    HopBuffer* outputHop = nullptr;
+    int outputRead = 0;
+    int64_t silenceRemaining = 0;  // Leading silence that sets the latency
+    int64_t skipDebt = 0;          // Output owed after an underrun, skipped to stay in sync
+
+    std::atomic<uint64_t> underrunFrames{0};
+    std::atomic<uint64_t> droppedFrames{0};
+
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+
+    void PushFrame(float mid, float side);
+    void PullFrame(float& left, float& right);
+    void WorkerLoop();
+};
@@ -0,0 +1,668 @@
+#include "FlacEncoder.h"
+#include "../util/CancellationToken.h"
+#include "../util/Log.h"
+#include "../util/TaskScheduler.h"
+#include "../util/Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+constexpr int MAX_CHANNELS = 8;
+constexpr int MAX_FIXED_ORDER = 4;
+constexpr int MAX_PARTITION_ORDER = 8;
+constexpr int STREAMINFO_SIZE = 34;
+
+// Subframe channel assignments for stereo frames
+enum class ChannelMode {
+    Independent,
+    LeftSide,
+    SideRight,
+    MidSide
+};
+
+// ---------------------------------------------------------------------------
+// CRC tables
+// ---------------------------------------------------------------------------
+
+struct CrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+
+    CrcTables() {
+        for (int i = 0; i < 256; ++i) {
+            uint8_t c8 = static_cast<uint8_t>(i);
+            for (int b = 0; b < 8; ++b) {
+                c8 = (c8 & 0x80) ? static_cast<uint8_t>((c8 << 1) ^ 0x07) : static_cast<uint8_t>(c8 << 1);
+            }
+            crc8[i] = c8;
+
+            uint16_t c16 = static_cast<uint16_t>(i << 8);
+            for (int b = 0; b < 8; ++b) {
+                c16 = (c16 & 0x8000) ? static_cast<uint16_t>((c16 << 1) ^ 0x8005) : static_cast<uint16_t>(c16 << 1);
+            }
+            crc16[i] = c16;
+        }
+    }
+};
+
+const CrcTables& Crc() {
+    static const CrcTables tables;
+    return tables;
+}
+
+uint8_t Crc8(const uint8_t* data, size_t size) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; ++i) {
+        crc = Crc().crc8[crc ^ data[i]];
+    }
+    return crc;
+}
+
+uint16_t Crc16(const uint8_t* data, size_t size) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; ++i) {
+        crc = static_cast<uint16_t>((crc << 8) ^ Crc().crc16[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+// ---------------------------------------------------------------------------
+// MSB-first bit writer
+// ---------------------------------------------------------------------------
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : bytes(out) {}
+
+    void Write(uint32_t value, int bits) {
+        if (bits == 0) return;
+        if (bits < 32) value &= (1u << bits) - 1;
+        acc = (acc << bits) | value;
+        accBits += bits;
+        while (accBits >= 8) {
+            accBits -= 8;
+            bytes.push_back(static_cast<uint8_t>(acc >> accBits));
+        }
+    }
+
+    void WriteSigned(int32_t value, int bits) {
+        Write(static_cast<uint32_t>(value), bits);
+    }
+
+    // `zeros` zero bits followed by a one
+    void WriteUnary(uint32_t zeros) {
+        while (zeros >= 32) {
+            Write(0, 32);
+            zeros -= 32;
+        }
+        Write(1, static_cast<int>(zeros) + 1);
+    }
+
+    void WriteRice(int32_t value, int k) {
+        uint32_t folded = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+        WriteUnary(folded >> k);
+        Write(folded, k);
+    }
+
+    void AlignToByte() {
+        if (accBits > 0) Write(0, 8 - accBits);
+    }
+
+private:
+    std::vector<uint8_t>& bytes;
+    uint64_t acc = 0;
+    int accBits = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Subframe analysis and coding
+// ---------------------------------------------------------------------------
+
+inline uint32_t Fold(int32_t r) {
+    return (static_cast<uint32_t>(r) << 1) ^ static_cast<uint32_t>(r >> 31);
+}
+
+void ComputeResidual(const int32_t* x, int n, int order, int32_t* residual) {
+    switch (order) {
+        case 0:
+            for (int i = 0; i < n; ++i) residual[i] = x[i];
+            break;
+        case 1:
+            for (int i = 1; i < n; ++i) residual[i - 1] = x[i] - x[i - 1];
+            break;
+        case 2:
+            for (int i = 2; i < n; ++i) residual[i - 2] = x[i] - 2 * x[i - 1] + x[i - 2];
+            break;
+        case 3:
+            for (int i = 3; i < n; ++i) residual[i - 3] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+            break;
+        case 4:
+            for (int i = 4; i < n; ++i) {
+                residual[i - 4] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+            }
+            break;
+    }
+}
+
+// Pick the fixed predictor order with the smallest total absolute residual
+int BestFixedOrder(const int32_t* x, int n, uint64_t& bestSum) {
+    uint64_t sums[MAX_FIXED_ORDER + 1] = {};
+    for (int i = MAX_FIXED_ORDER; i < n; ++i) {
+        int64_t e0 = x[i];
+        int64_t e1 = e0 - x[i - 1];
+        int64_t e2 = e1 - (static_cast<int64_t>(x[i - 1]) - x[i - 2]);
+        int64_t e3 = e2 - (static_cast<int64_t>(x[i - 1]) - 2 * static_cast<int64_t>(x[i - 2]) + x[i - 3]);
+        int64_t e4 = e3 - (static_cast<int64_t>(x[i - 1]) - 3 * static_cast<int64_t>(x[i - 2]) +
+                           3 * static_cast<int64_t>(x[i - 3]) - x[i - 4]);
+        sums[0] += static_cast<uint64_t>(e0 < 0 ? -e0 : e0);
+        sums[1] += static_cast<uint64_t>(e1 < 0 ? -e1 : e1);
+        sums[2] += static_cast<uint64_t>(e2 < 0 ? -e2 : e2);
+        sums[3] += static_cast<uint64_t>(e3 < 0 ? -e3 : e3);
+        sums[4] += static_cast<uint64_t>(e4 < 0 ? -e4 : e4);
+    }
+
+    int best = 0;
+    for (int order = 1; order <= MAX_FIXED_ORDER; ++order) {
+        if (sums[order] < sums[best]) best = order;
+    }
+    bestSum = sums[best];
+    return best;
+}
+
+// Rice parameter and estimated bit cost for `count` folded values summing to `sum`
+int RiceParameter(uint64_t sum, uint32_t count, uint64_t& bits) {
+    if (count == 0) {
+        bits = 0;
+        return 0;
+    }
+    int k = 0;
+    while (k < 30 && (static_cast<uint64_t>(count) << (k + 1)) < sum) ++k;
+
+    bits = std::numeric_limits<uint64_t>::max();
+    int bestK = k;
+    for (int candidate = std::max(0, k - 1); candidate <= std::min(30, k + 1); ++candidate) {
+        uint64_t cost = static_cast<uint64_t>(count) * (candidate + 1) + (sum >> candidate);
+        if (cost < bits) {
+            bits = cost;
+            bestK = candidate;
+        }
+    }
+    return bestK;
+}
+
+// Choose a partition order and per-partition Rice parameters, then write the
+// residual section
+void WriteResidual(BitWriter& writer, const int32_t* residual, int blockSize, int order) {
+    // Folded sums at the finest usable partition order, merged pairwise for coarser orders
+    int maxOrder = 0;
+    while (maxOrder < MAX_PARTITION_ORDER && (blockSize % (2 << maxOrder)) == 0 &&
+           (blockSize >> (maxOrder + 1)) > order) {
+        ++maxOrder;
+    }
+
+    std::vector<uint64_t> sums(static_cast<size_t>(1) << maxOrder, 0);
+    {
+        const int partSize = blockSize >> maxOrder;
+        int pos = 0;
+        for (int p = 0; p < (1 << maxOrder); ++p) {
+            int count = (p == 0) ? partSize - order : partSize;
+            uint64_t sum = 0;
+            for (int i = 0; i < count; ++i) sum += Fold(residual[pos + i]);
+            sums[p] = sum;
+            pos += count;
+        }
+    }
+
+    int bestOrder = 0;
+    uint64_t bestBits = std::numeric_limits<uint64_t>::max();
+    std::vector<int> params;
+    std::vector<int> bestParams;
+    std::vector<uint64_t> levelSums = sums;
+
+    for (int partitionOrder = maxOrder; partitionOrder >= 0; --partitionOrder) {
+        const int partitions = 1 << partitionOrder;
+        const int partSize = blockSize >> partitionOrder;
+        params.assign(partitions, 0);
+        uint64_t total = 0;
+        for (int p = 0; p < partitions; ++p) {
+            uint32_t count = static_cast<uint32_t>(p == 0 ? partSize - order : partSize);
+            uint64_t bits;
+            params[p] = RiceParameter(levelSums[p], count, bits);
+            total += bits + 5;
+        }
+        if (total < bestBits) {
+            bestBits = total;
+            bestOrder = partitionOrder;
+            bestParams = params;
+        }
+        // Merge neighbouring partitions for the next coarser order
+        for (int p = 0; p < partitions / 2; ++p) {
+            levelSums[p] = levelSums[2 * p] + levelSums[2 * p + 1];
+        }
+    }
+
+    const int maxParam = *std::max_element(bestParams.begin(), bestParams.end());
+    const bool rice2 = maxParam > 14;
+    const int paramBits = rice2 ? 5 : 4;
+
+    writer.Write(rice2 ? 1 : 0, 2);
+    writer.Write(static_cast<uint32_t>(bestOrder), 4);
+
+    const int partSize = blockSize >> bestOrder;
+    int pos = 0;
+    for (int p = 0; p < (1 << bestOrder); ++p) {
+        int count = (p == 0) ? partSize - order : partSize;
+        int k = bestParams[p];
+        writer.Write(static_cast<uint32_t>(k), paramBits);
+        for (int i = 0; i < count; ++i) {
+            writer.WriteRice(residual[pos + i], k);
+        }
+        pos += count;
+    }
+}
+
+// Rough cost of a channel, used to pick the stereo decorrelation mode
+uint64_t EstimateBits(const int32_t* x, int n, int bps) {
+    uint64_t sum;
+    int order = BestFixedOrder(x, n, sum);
+    uint64_t bits;
+    RiceParameter(sum, static_cast<uint32_t>(n - order), bits);
+    return bits + static_cast<uint64_t>(order) * bps;
+}
+
+void WriteSubframe(BitWriter& writer, const int32_t* x, int n, int bps, std::vector<int32_t>& residual) {
+    // Constant blocks (digital silence) collapse to a single sample
+    bool constant = true;
+    for (int i = 1; i < n && constant; ++i) {
+        constant = x[i] == x[0];
+    }
+    if (constant) {
+        writer.Write(0, 1);
+        writer.Write(0x00, 6);
+        writer.Write(0, 1);
+        writer.WriteSigned(x[0], bps);
+        return;
+    }
+
+    uint64_t sum;
+    int order = n > MAX_FIXED_ORDER ? BestFixedOrder(x, n, sum) : 0;
+    if (n <= MAX_FIXED_ORDER) {
+        sum = 0;
+        for (int i = 0; i < n; ++i) sum += Fold(x[i]);
+    }
+
+    uint64_t riceBits;
+    RiceParameter(sum, static_cast<uint32_t>(n - order), riceBits);
+    const uint64_t verbatimBits = static_cast<uint64_t>(n) * bps;
+
+    if (riceBits + static_cast<uint64_t>(order) * bps >= verbatimBits) {
+        writer.Write(0, 1);
+        writer.Write(0x01, 6);
+        writer.Write(0, 1);
+        for (int i = 0; i < n; ++i) {
+            writer.WriteSigned(x[i], bps);
+        }
+        return;
+    }
+
+    writer.Write(0, 1);
+    writer.Write(0x08 | static_cast<uint32_t>(order), 6);
+    writer.Write(0, 1);
+    for (int i = 0; i < order; ++i) {
+        writer.WriteSigned(x[i], bps);
+    }
+
+    residual.resize(n);
+    ComputeResidual(x, n, order, residual.data());
+    WriteResidual(writer, residual.data(), n, order);
+}
+
+void WriteUtf8(BitWriter& writer, uint32_t value) {
+    if (value < 0x80) {
+        writer.Write(value, 8);
+        return;
+    }
+    int extra = value < 0x800 ? 1 : value < 0x10000 ? 2 : value < 0x200000 ? 3 : value < 0x4000000 ? 4 : 5;
+    uint32_t lead = (0xFF00u >> (extra + 1)) & 0xFF;
+    writer.Write(lead | (value >> (6 * extra)), 8);
+    for (int i = extra - 1; i >= 0; --i) {
+        writer.Write(0x80 | ((value >> (6 * i)) & 0x3F), 8);
+    }
+}
+
+// Encode one frame of planar samples; appends to `out`
+void EncodeFrame(std::vector<uint8_t>& out,
+                 const int32_t* const* channels,
+                 int numChannels,
+                 int blockSize,
+                 uint32_t frameNumber,
+                 int bps,
+                 std::vector<int32_t>& scratch,
+                 std::vector<int32_t>& residual) {
+    const size_t frameStart = out.size();
+    BitWriter writer(out);
+
+    // Stereo decorrelation: pick the cheapest of L/R, L/S, S/R and M/S
+    ChannelMode mode = ChannelMode::Independent;
+    const int32_t* sub[MAX_CHANNELS];
+    int subBps[MAX_CHANNELS];
+    for (int ch = 0; ch < numChannels; ++ch) {
+        sub[ch] = channels[ch];
+        subBps[ch] = bps;
+    }
+
+    if (numChannels == 2) {
+        scratch.resize(2 * static_cast<size_t>(blockSize));
+        int32_t* mid = scratch.data();
+        int32_t* side = scratch.data() + blockSize;
+        const int32_t* left = channels[0];
+        const int32_t* right = channels[1];
+        for (int i = 0; i < blockSize; ++i) {
+            mid[i] = (left[i] + right[i]) >> 1;
+            side[i] = left[i] - right[i];
+        }
+
+        uint64_t bitsL = EstimateBits(left, blockSize, bps);
+        uint64_t bitsR = EstimateBits(right, blockSize, bps);
+        uint64_t bitsM = EstimateBits(mid, blockSize, bps);
+        uint64_t bitsS = EstimateBits(side, blockSize, bps + 1);
+
+        uint64_t best = bitsL + bitsR;
+        if (bitsL + bitsS < best) { best = bitsL + bitsS; mode = ChannelMode::LeftSide; }
+        if (bitsS + bitsR < best) { best = bitsS + bitsR; mode = ChannelMode::SideRight; }
+        if (bitsM + bitsS < best) { best = bitsM + bitsS; mode = ChannelMode::MidSide; }
+
+        switch (mode) {
+            case ChannelMode::Independent:
+                break;
+            case ChannelMode::LeftSide:
+                sub[1] = side;
+                subBps[1] = bps + 1;
+                break;
+            case ChannelMode::SideRight:
+                sub[0] = side;
+                subBps[0] = bps + 1;
+                break;
+            case ChannelMode::MidSide:
+                sub[0] = mid;
+                sub[1] = side;
+                subBps[1] = bps + 1;
+                break;
+        }
+    }
+
+    // Frame header
+    writer.Write(0x3FFE, 14);   // Sync code
+    writer.Write(0, 1);         // Reserved
+    writer.Write(0, 1);         // Fixed block size stream
+
+    const bool fullBlock = blockSize == FlacEncoder::BLOCK_SIZE;
+    writer.Write(fullBlock ? 0x0C : 0x07, 4);  // 4096, or 16-bit size at end of header
+    writer.Write(0x00, 4);                     // Sample rate from STREAMINFO
+
+    uint32_t assignment = static_cast<uint32_t>(numChannels - 1);
+    switch (mode) {
+        case ChannelMode::LeftSide: assignment = 0x08; break;
+        case ChannelMode::SideRight: assignment = 0x09; break;
+        case ChannelMode::MidSide: assignment = 0x0A; break;
+        case ChannelMode::Independent: break;
+    }
+    writer.Write(assignment, 4);
+    writer.Write(bps == 16 ? 0x04 : 0x06, 3);
+    writer.Write(0, 1);
+    WriteUtf8(writer, frameNumber);
+    if (!fullBlock) {
+        writer.Write(static_cast<uint32_t>(blockSize - 1), 16);
+    }
+    writer.Write(Crc8(out.data() + frameStart, out.size() - frameStart), 8);
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        WriteSubframe(writer, sub[ch], blockSize, subBps[ch], residual);
+    }
+
+    writer.AlignToByte();
+    uint16_t crc = Crc16(out.data() + frameStart, out.size() - frameStart);
+    writer.Write(crc, 16);
+}
+
+void WriteStreamInfo(std::vector<uint8_t>& out,
+                     int sampleRate,
+                     int numChannels,
+                     int bps,
+                     uint64_t totalSamples,
+                     uint32_t minFrameBytes,
+                     uint32_t maxFrameBytes) {
+    BitWriter writer(out);
+    writer.Write(1, 1);                 // Last metadata block
+    writer.Write(0, 7);                 // STREAMINFO
+    writer.Write(STREAMINFO_SIZE, 24);
+
+    writer.Write(FlacEncoder::BLOCK_SIZE, 16);
+    writer.Write(FlacEncoder::BLOCK_SIZE, 16);
+    writer.Write(minFrameBytes, 24);
+    writer.Write(maxFrameBytes, 24);
+    writer.Write(static_cast<uint32_t>(sampleRate), 20);
+    writer.Write(static_cast<uint32_t>(numChannels - 1), 3);
+    writer.Write(static_cast<uint32_t>(bps - 1), 5);
+    writer.Write(static_cast<uint32_t>(totalSamples >> 32), 4);
+    writer.Write(static_cast<uint32_t>(totalSamples), 32);
+    for (int i = 0; i < 4; ++i) {
+        writer.Write(0, 32);            // MD5 not computed
+    }
+}
+
+// Quantize and encode one group: `count` samples of `src` starting at
+// stream sample groupIndex * GROUP_SAMPLES
+void EncodeGroup(FlacEncoder::Chunk& chunk,
+                 const float* const* src,
+                 int numChannels,
+                 size_t count,
+                 size_t groupIndex,
+                 int bps,
+                 SampleConvert::Dither dither) {
+    const size_t start = groupIndex * FlacEncoder::GROUP_SAMPLES;
+
+    // Each group dithers with its own deterministic sequence so groups stay independent
+    SampleConvert::DitherState state(dither, bps, static_cast<uint32_t>(0x9E3779B9u * (groupIndex + 1)));
+
+    std::vector<int32_t> interleaved(count * numChannels);
+    SampleConvert::InterleaveDithered(src, interleaved.data(), SampleConvert::Format::PCM32,
+                                      numChannels, count, state);
+
+    // Planar integer samples at the target word length
+    std::vector<int32_t> planar(count * numChannels);
+    const int shift = 32 - bps;
+    for (size_t i = 0; i < count; ++i) {
+        for (int ch = 0; ch < numChannels; ++ch) {
+            planar[ch * count + i] = interleaved[i * numChannels + ch] >> shift;
+        }
+    }
+    interleaved.clear();
+    interleaved.shrink_to_fit();
+
+    std::vector<int32_t> scratch;
+    std::vector<int32_t> residual;
+    const int32_t* frameChannels[MAX_CHANNELS];
+
+    for (size_t offset = 0; offset < count; offset += FlacEncoder::BLOCK_SIZE) {
+        int blockSize = static_cast<int>(std::min<size_t>(FlacEncoder::BLOCK_SIZE, count - offset));
+        for (int ch = 0; ch < numChannels; ++ch) {
+            frameChannels[ch] = planar.data() + ch * count + offset;
+        }
+        uint32_t frameNumber = static_cast<uint32_t>((start + offset) / FlacEncoder::BLOCK_SIZE);
+
+        size_t before = chunk.bytes.size();
+        EncodeFrame(chunk.bytes, frameChannels, numChannels, blockSize, frameNumber, bps, scratch, residual);
+        uint32_t frameBytes = static_cast<uint32_t>(chunk.bytes.size() - before);
+        chunk.minFrameBytes = std::min(chunk.minFrameBytes, frameBytes);
+        chunk.maxFrameBytes = std::max(chunk.maxFrameBytes, frameBytes);
+    }
+    chunk.numSamples += count;
+}
+
+} // namespace
+
+FlacEncoder::Chunk FlacEncoder::EncodeChunk(const float* const* channels,
+                                            int numChannels,
+                                            size_t numSamples,
+                                            size_t streamStart,
+                                            int bitDepth,
+                                            SampleConvert::Dither dither) {
+    Chunk chunk;
+    chunk.bytes.reserve(numSamples * numChannels * bitDepth / 16);
+    std::vector<const float*> src(channels, channels + numChannels);
+    for (size_t offset = 0; offset < numSamples; offset += GROUP_SAMPLES) {
+        const size_t count = std::min(GROUP_SAMPLES, numSamples - offset);
+        EncodeGroup(chunk, src.data(), numChannels, count, (streamStart + offset) / GROUP_SAMPLES, bitDepth, dither);
+        for (const float*& channel : src) channel += count;
+    }
+    return chunk;
+}
+
+FlacEncoder::Writer::~Writer() {
+    if (file) fclose(file);
+}
+
+bool FlacEncoder::Writer::Open(const std::string& path, int numChannels, int sampleRate, int bitDepth) {
+    if (numChannels < 1 || numChannels > MAX_CHANNELS) {
+        HRAW_LOG_ERROR("FLAC supports 1 to 8 channels, got " << numChannels);
+        return false;
+    }
+    if (bitDepth != 16 && bitDepth != 24) {
+        HRAW_LOG_ERROR("FLAC output supports 16 or 24 bits, got " << bitDepth);
+        return false;
+    }
+    if (sampleRate <= 0 || sampleRate >= (1 << 20)) {
+        HRAW_LOG_ERROR("Sample rate " << sampleRate << " Hz cannot be stored in FLAC");
+        return false;
+    }
+
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        HRAW_LOG_ERROR("Error creating file: " << path);
+        return false;
+    }
+    this->numChannels = numChannels;
+    this->sampleRate = sampleRate;
+    this->bitDepth = bitDepth;
+
+    // Header with a provisional STREAMINFO; the length and frame size
+    // bounds are patched in by Close
+    std::vector<uint8_t> header = {'f', 'L', 'a', 'C'};
+    WriteStreamInfo(header, sampleRate, numChannels, bitDepth, 0, 0, 0);
+    ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+    return ok;
+}
+
+bool FlacEncoder::Writer::Append(const Chunk& chunk) {
+    ok = ok && fwrite(chunk.bytes.data(), 1, chunk.bytes.size(), file) == chunk.bytes.size();
+    totalSamples += chunk.numSamples;
+    minFrameBytes = std::min(minFrameBytes, chunk.minFrameBytes);
+    maxFrameBytes = std::max(maxFrameBytes, chunk.maxFrameBytes);
+    return ok;
+}
+
+bool FlacEncoder::Writer::Close() {
+    if (!file) return false;
+    if (ok) {
+        std::vector<uint8_t> header = {'f', 'L', 'a', 'C'};
+        WriteStreamInfo(header, sampleRate, numChannels, bitDepth, totalSamples,
+                        totalSamples > 0 ? minFrameBytes : 0, maxFrameBytes);
+        ok = fseek(file, 0, SEEK_SET) == 0 &&
+             fwrite(header.data(), 1, header.size(), file) == header.size();
+    }
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    file = nullptr;
+    return ok;
+}
+
+bool FlacEncoder::EncodeFile(const std::string& path,
+                             const std::vector<std::vector<float>>& channels,
+                             int sampleRate,
+                             int bitDepth,
+                             SampleConvert::Dither dither,
+                             int numThreads,
+                             const CancellationToken* cancel) {
+    const int numChannels = static_cast<int>(channels.size());
+    Writer writer;
+    if (!writer.Open(path, numChannels, sampleRate, bitDepth)) {
+        return false;
+    }
+
+    size_t totalSamples = channels[0].size();
+    for (const auto& channel : channels) {
+        totalSamples = std::min(totalSamples, channel.size());
+    }
+    const size_t numGroups = (totalSamples + GROUP_SAMPLES - 1) / GROUP_SAMPLES;
+
+    TaskScheduler& scheduler = TaskScheduler::Shared();
+    if (numThreads <= 0) {
+        numThreads = scheduler.NumThreads();
+    }
+    
+    // Groups are queued at most `window` ahead of the writer, which bounds
+    // the amount of encoded data held in memory
+    struct EncodedGroup {
+        Chunk chunk;
+        std::atomic<bool> done{false};
+    };
+    const size_t window = static_cast<size_t>(numThreads) * 2;
+    std::vector<EncodedGroup> groups(numGroups);
+    std::atomic<bool> abort{false};
+    TaskGroup tasks(scheduler);
+    size_t queuedGroups = 0;
+    auto queueUpTo = [&](size_t limit) {
+        for (; queuedGroups < std::min(limit, numGroups); ++queuedGroups) {
+            tasks.Run([&, index = queuedGroups]() {
+                if (!abort) {
+                    HRAW_TRACE_SCOPE("flac group");
+                    const size_t start = index * GROUP_SAMPLES;
+                    std::vector<const float*> src(numChannels);
+                    for (int ch = 0; ch < numChannels; ++ch) src[ch] = channels[ch].data() + start;
+                    groups[index].chunk = EncodeChunk(src.data(), numChannels,
+                                                      std::min(GROUP_SAMPLES, totalSamples - start),
+                                                      start, bitDepth, dither);
+                }
+                groups[index].done = true;
+                scheduler.Notify();
+            });
+        }
+    };
+
+    // Write groups in stream order as they complete, encoding others while
+    // waiting for the next one
+    bool ok = true;
+    for (size_t index = 0; index < numGroups && ok; ++index) {
+        if (CancellationToken::IsCancelled(cancel)) {
+            ok = false;
+            break;
+        }
+        
+        queueUpTo(index + window);
+        scheduler.HelpUntil([&]() { return groups[index].done.load(); });
+        ok = writer.Append(groups[index].chunk);
+        groups[index].chunk = Chunk();
+    }
+
+    if (!ok) {
+        abort = true;
+    }
+    tasks.Wait();
+    if (!writer.Close()) {
+        ok = false;
+    }
+
+    if (CancellationToken::IsCancelled(cancel)) {
+        HRAW_LOG_INFO("FLAC encoding cancelled: " << path);
+    } else if (!ok) {
+        HRAW_LOG_ERROR("Error writing FLAC file: " << path);
+    }
+    return ok;
+}
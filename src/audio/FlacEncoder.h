@@ -0,0 +1,86 @@
+#pragma once
+
+#include "SampleConvert.h"
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+class CancellationToken;
+
+// In-tree FLAC encoder. Audio is split into independent groups of frames
+// that are encoded in parallel on the shared TaskScheduler and written to
+// the stream in order.
+//
+// Frames use the fixed polynomial predictors (orders 0-4) with
+// partitioned Rice residuals and per-frame stereo decorrelation. That
+// compresses somewhat worse than libFLAC's LPC modes but needs no
+// external dependency and scales with the number of cores.
+class FlacEncoder {
+public:
+    // Samples per FLAC frame
+    static constexpr int BLOCK_SIZE = 4096;
+
+    // Frames per group. Groups are encoded independently, each dithered
+    // with its own sequence, and are the unit of parallel work.
+    static constexpr int FRAMES_PER_GROUP = 32;
+    static constexpr size_t GROUP_SAMPLES = static_cast<size_t>(BLOCK_SIZE) * FRAMES_PER_GROUP;
+
+    // Encoded frames for a stretch of a stream
+    struct Chunk {
+        std::vector<uint8_t> bytes;
+        size_t numSamples = 0;
+        uint32_t minFrameBytes = std::numeric_limits<uint32_t>::max();
+        uint32_t maxFrameBytes = 0;
+    };
+
+    // Encode planar float audio to `path` at 16 or 24 bits per sample.
+    // Up to twice numThreads groups are queued ahead of the writer; <= 0
+    // uses the scheduler's thread count. `cancel` is checked between frame
+    // groups; a cancelled stream is left truncated.
+    static bool EncodeFile(const std::string& path,
+                           const std::vector<std::vector<float>>& channels,
+                           int sampleRate,
+                           int bitDepth,
+                           SampleConvert::Dither dither,
+                           int numThreads = 0,
+                           const CancellationToken* cancel = nullptr);
+
+    // Encode the `numSamples` samples of `channels` that sit at stream
+    // sample `streamStart`, a multiple of GROUP_SAMPLES. The bytes are the
+    // ones EncodeFile writes for that stretch. Safe to call from any thread.
+    static Chunk EncodeChunk(const float* const* channels,
+                             int numChannels,
+                             size_t numSamples,
+                             size_t streamStart,
+                             int bitDepth,
+                             SampleConvert::Dither dither);
+
+    // A FLAC file written chunk by chunk in stream order, for audio that
+    // isn't all in memory at once
+    class Writer {
+    public:
+        Writer() = default;
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        bool Open(const std::string& path, int numChannels, int sampleRate, int bitDepth);
+        bool Append(const Chunk& chunk);
+
+        // Fill in the stream length and frame sizes and close the file.
+        // False if anything failed since Open.
+        bool Close();
+
+    private:
+        FILE* file = nullptr;
+        bool ok = false;
+        int numChannels = 0;
+        int sampleRate = 0;
+        int bitDepth = 0;
+        uint64_t totalSamples = 0;
+        uint32_t minFrameBytes = std::numeric_limits<uint32_t>::max();
+        uint32_t maxFrameBytes = 0;
+    };
+};
@@ -0,0 +1,185 @@
+#include "FolderIngest.h"
+#include "AudioIO.h"
+#include "../util/CancellationToken.h"
+#include "../util/Log.h"
+#include "../util/Trace.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* const AUDIO_EXTENSIONS[] = {".wav", ".flac", ".ogg", ".mp3", ".aiff", ".aif", ".m4a", ".opus"};
+
+// Probing waits on the disk far more than the CPU, so use more threads than cores
+constexpr unsigned MIN_SCAN_THREADS = 8;
+
+struct WorkItem {
+    fs::path path;
+    bool isDirectory;
+};
+
+// Shared by the scan threads; everything is guarded by `mutex`
+struct ScanState {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<WorkItem> queue;
+    size_t busy = 0;  // Threads working on an item, which may queue more
+    std::unordered_set<std::string> seen;
+    FolderIngest::Result result;
+};
+
+bool IsHidden(const fs::path& path) {
+    const std::string name = path.filename().string();
+    return !name.empty() && name[0] == '.';
+}
+
+// List one directory, queueing audio files and (if recursive) subfolders
+void ListDirectory(const fs::path& directory, bool recursive, ScanState& state) {
+    std::vector<WorkItem> found;
+    std::error_code ec;
+    fs::directory_iterator it(directory, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        const fs::directory_entry& entry = *it;
+        if (IsHidden(entry.path())) continue;
+
+        std::error_code typeError;
+        if (entry.is_directory(typeError)) {
+            // Not following folder symlinks keeps cycles out of the walk
+            if (recursive && !entry.is_symlink(typeError)) found.push_back({entry.path(), true});
+        } else if (FolderIngest::HasAudioExtension(entry.path().string())) {
+            found.push_back({entry.path(), false});
+        }
+    }
+    if (ec) {
+        HRAW_LOG_WARN("Can't list " << directory.string() << ": " << ec.message());
+    }
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (WorkItem& item : found) state.queue.push_back(std::move(item));
+}
+
+void ProbeItem(const fs::path& file, ScanState& state) {
+    const std::string path = FolderIngest::NormalPath(file.string());
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.seen.insert(path).second) {
+            ++state.result.duplicates;
+            return;
+        }
+    }
+
+    AudioProbe probe;
+    std::string reason;
+    const bool ok = FolderIngest::Probe(path, probe, reason);
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (ok) {
+        state.result.files.push_back(std::move(probe));
+    } else {
+        state.result.rejected.emplace_back(path, reason);
+    }
+}
+
+void ScanWorker(bool recursive, const CancellationToken* cancel, ScanState& state) {
+    HRAW_TRACE_THREAD("ingest");
+    std::unique_lock<std::mutex> lock(state.mutex);
+    while (true) {
+        // Done once nothing is queued and nobody can queue more
+        state.wake.wait(lock, [&] { return !state.queue.empty() || state.busy == 0; });
+        if (state.queue.empty() || CancellationToken::IsCancelled(cancel)) {
+            state.wake.notify_all();
+            return;
+        }
+
+        WorkItem item = std::move(state.queue.front());
+        state.queue.pop_front();
+        ++state.busy;
+        lock.unlock();
+
+        if (item.isDirectory) {
+            ListDirectory(item.path, recursive, state);
+        } else {
+            ProbeItem(item.path, state);
+        }
+
+        lock.lock();
+        --state.busy;
+        state.wake.notify_all();
+    }
+}
+
+} // namespace
+
+bool FolderIngest::HasAudioExtension(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return std::find(std::begin(AUDIO_EXTENSIONS), std::end(AUDIO_EXTENSIONS), ext) != std::end(AUDIO_EXTENSIONS);
+}
+
+std::string FolderIngest::NormalPath(const std::string& path) {
+    return fs::path(path).lexically_normal().string();
+}
+
+bool FolderIngest::Probe(const std::string& path, AudioProbe& probe, std::string& reason) {
+    probe = AudioProbe();
+    probe.path = path;
+    if (!AudioIO().ProbeFile(path, probe.sampleRate, probe.numChannels, probe.numSamples)) {
+        reason = "unreadable or unsupported format";
+        return false;
+    }
+    if (probe.sampleRate <= 0 || probe.numChannels <= 0) {
+        reason = "invalid format in header";
+        return false;
+    }
+    if (probe.numSamples == 0) {
+        reason = "no audio";
+        return false;
+    }
+    return true;
+}
+
+FolderIngest::Result FolderIngest::Scan(const std::vector<std::string>& roots, bool recursive,
+                                        const std::unordered_set<std::string>& known,
+                                        const CancellationToken* cancel, unsigned numThreads) {
+    HRAW_TRACE_SCOPE("ingest");
+    const auto start = std::chrono::steady_clock::now();
+
+    ScanState state;
+    state.seen = known;
+    for (const std::string& root : roots) {
+        std::error_code ec;
+        // Roots are always listed, even if the walk itself isn't recursive
+        state.queue.push_back({fs::path(root), fs::is_directory(root, ec)});
+    }
+
+    if (numThreads == 0) numThreads = std::max(MIN_SCAN_THREADS, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < numThreads; ++i) {
+        threads.emplace_back(ScanWorker, recursive, cancel, std::ref(state));
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    Result& result = state.result;
+    std::sort(result.files.begin(), result.files.end(),
+              [](const AudioProbe& a, const AudioProbe& b) { return a.path < b.path; });
+    std::sort(result.rejected.begin(), result.rejected.end());
+    for (const auto& [path, reason] : result.rejected) {
+        HRAW_LOG_WARN("Skipping " << path << ": " << reason);
+    }
+
+    HRAW_LOG_INFO("Found " << result.files.size() << " audio files (" << result.rejected.size() << " rejected, "
+                  << result.duplicates << " already listed) in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start).count()
+                  << " ms");
+    return result;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class CancellationToken;
+
+// What an input's header says, read without decoding any audio
+struct AudioProbe {
+    std::string path;
+    int sampleRate = 0;
+    int numChannels = 0;
+    size_t numSamples = 0;  // Frames per channel
+
+    double DurationSeconds() const {
+        return sampleRate > 0 ? static_cast<double>(numSamples) / sampleRate : 0.0;
+    }
+};
+
+// Collects inputs for a batch from files and folders.
+//
+// Folders are walked by a pool of threads sharing one queue of directories
+// to list and files to probe, so a deep tree or a single folder with
+// thousands of files both spread across the pool. Each audio file's header
+// is opened to read its length and format; files the pipeline can't take
+// are rejected with a reason instead of failing halfway through a batch.
+// Paths are compared in lexically normal form, and each one is added once.
+class FolderIngest {
+public:
+    struct Result {
+        std::vector<AudioProbe> files;  // Sorted by path
+        std::vector<std::pair<std::string, std::string>> rejected;  // Path and reason
+        size_t duplicates = 0;
+    };
+
+    // Extensions the pipeline is willing to try
+    static bool HasAudioExtension(const std::string& path);
+
+    // The form paths are deduplicated in
+    static std::string NormalPath(const std::string& path);
+
+    // Read the header of one file. False, with `reason` set, if it can't be
+    // opened or has nothing the pipeline could process.
+    static bool Probe(const std::string& path, AudioProbe& probe, std::string& reason);
+
+    // Collect audio files under each of `roots` (folders or single files),
+    // descending into subfolders if `recursive`. Hidden entries and folder
+    // symlinks are skipped. Paths in `known` (normal form) count as
+    // duplicates. `numThreads` 0 picks a default for I/O-bound work.
+    static Result Scan(const std::vector<std::string>& roots, bool recursive,
+                       const std::unordered_set<std::string>& known,
+                       const CancellationToken* cancel = nullptr, unsigned numThreads = 0);
+};
@@ -1,262 +1,852 @@
 #include "HFCompensation.h"
+#include "Overview.h"
 #include "../dsp/STFT.h"
 #include "../dsp/FFT.h"
-#include <iostream>
+#include "../dsp/Kernels.h"
+#include "../util/CancellationToken.h"
+#include "../util/Log.h"
+#include "../util/TaskScheduler.h"
+#include "../util/Telemetry.h"
+#include "../util/Trace.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <numeric>
 #include <cmath>
 #include <random>
+#include <type_traits>
 
-HFCompensation::HFCompensation() {
+namespace {
+
+using Spectrogram = std::vector<std::vector<std::complex<float>>>;
+
+// Frames per parallel chunk at least
+constexpr size_t FRAME_GRAIN = 8;
+
+// Synthesize overlap-adds chunks that aren't neighbours at the same time,
+// which needs each sample covered by at most two frames
+static_assert(HFCompensation::FFTSIZE <= 2 * HFCompensation::HOPSIZE, "frames overlap more than one neighbour");
+
+// Drop a buffer's storage now rather than when it goes out of scope
+template <typename T>
+void Release(std::vector<T>& buffer) {
+    std::vector<T>().swap(buffer);
 }
 
-HFCompensation::~HFCompensation() {
+uint64_t Bytes(const std::vector<float>& buffer) {
+    return buffer.capacity() * sizeof(float);
 }
 
-void HFCompensation::Process(std::vector<float>& mid,
-                            std::vector<float>& side,
-                            int sampleRate,
-                            int lowpassFreq,
-                            bool compressedMode,
-                            ProgressCallback progressCallback) {
-    // Calculate lowpass frequency index
-    int lowpassIdx = static_cast<int>((FFTSIZE / 2 + 1) * (lowpassFreq / (sampleRate / 2.0f)));
-    lowpassIdx = std::max(0, std::min(lowpassIdx, FFTSIZE / 2));
+uint64_t Bytes(const Spectrogram& spectrogram) {
+    uint64_t bytes = spectrogram.capacity() * sizeof(Spectrogram::value_type);
+    for (const auto& frame : spectrogram) bytes += frame.capacity() * sizeof(std::complex<float>);
+    return bytes;
+}
+
+// Seed for one frame's random variation. Each frame depends only on the job
+// seed and its own index, so output doesn't depend on processing order.
+uint32_t FrameSeed(uint32_t seed, int frame) {
+    // splitmix64 finalizer
+    uint64_t z = (static_cast<uint64_t>(seed) << 32) | static_cast<uint32_t>(frame);
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return static_cast<uint32_t>(z);
+}
+
+// Rolling overlap-add over the FFTSIZE samples starting at the current
+// frame. Once a frame is added, its first HOPSIZE samples get no further
+// contributions and are written out; the sums match STFT::Inverse exactly.
+class OverlapAdd {
+public:
+    OverlapAdd() : midAcc(HFCompensation::FFTSIZE, 0.0f), sideAcc(HFCompensation::FFTSIZE, 0.0f),
+                   windowSum(HFCompensation::FFTSIZE, 0.0f) {
+    }
     
-    std::cout << "Processing with lowpass at " << lowpassFreq << " Hz (bin " << lowpassIdx << ")" << std::endl;
+    void Add(const std::vector<float>& midOut, const std::vector<float>& sideOut, const std::vector<float>& window) {
+        Kernels::Accumulate(midAcc.data(), midOut.data(), HFCompensation::FFTSIZE);
+        Kernels::Accumulate(sideAcc.data(), sideOut.data(), HFCompensation::FFTSIZE);
+        Kernels::AccumulateSquares(windowSum.data(), window.data(), HFCompensation::FFTSIZE);
+    }
     
-    // Perform STFT
-    STFT stft(FFTSIZE, HOPSIZE);
-    auto midStft = stft.Forward(mid);
-    auto sideStft = stft.Forward(side);
+    // Write the finished samples to mid/side at `start` and move on one
+    // hop; the last frame finishes all FFTSIZE of them
+    void Emit(std::vector<float>& mid, std::vector<float>& side, size_t start, bool last) {
+        const int count = last ? HFCompensation::FFTSIZE : HFCompensation::HOPSIZE;
+        Kernels::DivideNonZero(midAcc.data(), windowSum.data(), count);
+        Kernels::DivideNonZero(sideAcc.data(), windowSum.data(), count);
+        std::copy(midAcc.begin(), midAcc.begin() + count, mid.begin() + start);
+        std::copy(sideAcc.begin(), sideAcc.begin() + count, side.begin() + start);
+        if (last) return;
+        for (std::vector<float>* acc : {&midAcc, &sideAcc, &windowSum}) {
+            std::copy(acc->begin() + HFCompensation::HOPSIZE, acc->end(), acc->begin());
+            std::fill(acc->end() - HFCompensation::HOPSIZE, acc->end(), 0.0f);
+        }
+    }
     
-    int numFrames = midStft.size();
+    uint64_t Bytes() const {
+        return ::Bytes(midAcc) + ::Bytes(sideAcc) + ::Bytes(windowSum);
+    }
     
-    // Process each frame
-    for (int frame = 0; frame < numFrames; ++frame) {
-        if (progressCallback) {
-            progressCallback(static_cast<float>(frame) / numFrames);
+private:
+    std::vector<float> midAcc;
+    std::vector<float> sideAcc;
+    std::vector<float> windowSum;
+};
+
+// Samples Inverse produces for `numFrames` frames
+size_t OutputSize(int numFrames) {
+    return numFrames > 0 ? static_cast<size_t>(numFrames - 1) * HFCompensation::HOPSIZE + HFCompensation::FFTSIZE : 0;
+}
+
+// FFT size of a spectrum holding `bins` bins
+int FftSizeOf(size_t bins) {
+    return bins > 0 ? static_cast<int>(bins - 1) * 2 : 0;
+}
+
+// FFT size of the frames a pipeline handles: a compile-time constant for the
+// specialized sizes, so every per-bin loop has a known trip count, and the
+// frame's own size for the generic fallback (N = 0)
+template <int N>
+struct FrameSize {
+    constexpr int Fft() const { return N; }
+    constexpr int Bins() const { return N / 2 + 1; }
+};
+
+template <>
+struct FrameSize<0> {
+    int fft;
+    int Fft() const { return fft; }
+    int Bins() const { return fft / 2 + 1; }
+};
+
+// Harmonics one peak can seed
+constexpr int MAX_OVERTONES = 12;
+
+// What ProcessPeaks used to compute again for every peak: the Gaussian
+// weights over its harmonics, which only depend on how many there are, and
+// each overtone's decay. Built with the same expressions, so bit-identical.
+struct OvertoneTables {
+    float gaussian[MAX_OVERTONES][MAX_OVERTONES] = {};  // [harmonics][i]
+    double decay[MAX_OVERTONES + 2] = {};                // [k], as pow(float, int) returns
+    
+    OvertoneTables() {
+        for (int size = 1; size < MAX_OVERTONES; ++size) {
+            float sigma = size / 1.3f;
+            for (int i = 0; i < size; ++i) {
+                gaussian[size][i] = std::exp(-(i - size/2.0f) * (i - size/2.0f) / (2 * sigma * sigma));
+            }
         }
-        
-        // Get magnitude and phase
-        std::vector<float> midMag(FFTSIZE / 2 + 1);
-        std::vector<float> sideMag(FFTSIZE / 2 + 1);
-        
-        for (int i = 0; i < FFTSIZE / 2 + 1; ++i) {
-            midMag[i] = std::abs(midStft[frame][i]);
-            sideMag[i] = std::abs(sideStft[frame][i]);
+        for (int k = 2; k <= MAX_OVERTONES + 1; ++k) {
+            decay[k] = std::pow(0.7f, k - 2);
         }
-        
-        // Save original low frequency content
-        std::vector<std::complex<float>> midLowFreq(lowpassIdx);
-        std::vector<std::complex<float>> sideLowFreq(lowpassIdx);
-        for (int i = 0; i < lowpassIdx; ++i) {
-            midLowFreq[i] = midStft[frame][i];
-            sideLowFreq[i] = sideStft[frame][i];
+    }
+};
+
+const OvertoneTables& Overtones() {
+    static const OvertoneTables tables;
+    return tables;
+}
+
+// Local maxima up to bin `limit` at least `minDistance` apart, keeping the
+// lower of two close ones. Returns how many were written to `peaks`.
+template <typename Size>
+int FindPeaks(Size size, const float* magnitude, int limit, int minDistance, int* peaks) {
+    const int end = std::min(size.Bins() - 1, limit + 1);
+    int count = 0;
+    for (int i = 1; i < end; ++i) {
+        if (magnitude[i] > magnitude[i-1] && magnitude[i] > magnitude[i+1]) {
+            // Peaks come in ascending order, so only the last can be too close
+            if (count > 0 && i - peaks[count - 1] < minDistance) continue;
+            peaks[count++] = i;
         }
+    }
+    return count;
+}
+
+// Peaks that aren't within 5 bins of a harmonic of a lower kept peak. Each
+// peak only depends on lower ones, so running on a prefix of the peaks
+// gives a prefix of the result.
+template <typename Size>
+int RemoveHarmonics(Size size, const int* peaks, int count, int* filtered) {
+    int numFiltered = 0;
+    for (int p = 0; p < count; ++p) {
+        const int peak = peaks[p];
+        bool isHarmonic = false;
+        for (int f = 0; f < numFiltered && !isHarmonic; ++f) {
+            const int fundamental = filtered[f];
+            const int maxHarmonic = size.Fft() / (2 * fundamental);
+            if (maxHarmonic < 2) continue;
+            // The closest multiple k * fundamental, 2 <= k <= maxHarmonic,
+            // is one of these two
+            const int below = std::min(std::max(peak / fundamental, 2), maxHarmonic);
+            const int above = std::min(below + 1, maxHarmonic);
+            isHarmonic = std::abs(peak - fundamental * below) < 6 || std::abs(peak - fundamental * above) < 6;
+        }
+        if (!isHarmonic) {
+            filtered[numFiltered++] = peak;
+        }
+    }
+    return numFiltered;
+}
+
+// Add each peak's overtones to `rebuild`
+template <typename Size>
+void ProcessPeaks(Size size, const int* peaks, int count, const float* magnitude, float* rebuild) {
+    const OvertoneTables& tables = Overtones();
+    const int bins = size.Bins();
+    for (int p = 0; p < count; ++p) {
+        const int peak = peaks[p];
+        // Calculate how many harmonics can fit in the available spectrum
+        const int loop = std::min(MAX_OVERTONES, (size.Fft() / 2 - peak) / peak);
         
-        // Detect peaks in the lower frequencies
-        std::vector<int> midPeaks = FindPeaks(midMag);
-        std::vector<int> sidePeaks = FindPeaks(sideMag);
-        
-        // Remove harmonics
-        midPeaks = RemoveHarmonics(midPeaks);
-        sidePeaks = RemoveHarmonics(sidePeaks);
-        
-        // Filter peaks to only include those below the lowpass frequency
-        // Use more of the available range for better harmonic synthesis
-        auto filterPeaks = [lowpassIdx](std::vector<int>& peaks) {
-            peaks.erase(std::remove_if(peaks.begin(), peaks.end(),
-                       [lowpassIdx](int p) { return p > lowpassIdx; }),
-                       peaks.end());
-        };
+        // Harmonic amplitudes, normalized and weighted by a Gaussian; zero
+        // past the last one
+        float slope[MAX_OVERTONES + 1] = {};
+        int numHarmonics = 0;
+        for (int l = 1; l < loop && peak * l < bins; ++l) {
+            slope[numHarmonics++] = magnitude[peak * l];
+        }
+        if (numHarmonics == 0 || slope[0] == 0) continue;
+        const float* gaussian = tables.gaussian[numHarmonics];
+        for (int i = 0; i < numHarmonics; ++i) {
+            slope[i] = (slope[i] / 12.0f) * gaussian[i];
+        }
         
-        filterPeaks(midPeaks);
-        filterPeaks(sidePeaks);
+        // The power around the peak. The Python port tries widths 2 and 3,
+        // but both take k / 2 == 1 bin either side, so it's always 2.
+        const int width = 2;
+        const int startPower = std::max(0, peak - width / 2);
+        const int numPower = std::min(bins, peak + width / 2) - startPower;
         
+        // Synthesize overtones - start from k=2 to synthesize above the fundamental
+        for (int k = 2; k <= loop + 1; ++k) {
+            int start = peak * k - width / 2;
+            int end = peak * k + width / 2;
+            if (start < 0 || end > bins) continue;
+            
+            // Apply decreasing amplitude for higher harmonics
+            float harmonicAmp = std::abs(slope[k - 1]) * tables.decay[k];
+            for (int i = start; i < end && i - start < numPower; ++i) {
+                rebuild[i] += magnitude[startPower + i - start] * harmonicAmp;
+            }
+        }
+    }
+}
+
+// Fill `rebuild` above `lowpassIdx` with the octave below it, as spectral
+// band replication does: octave k above the cutoff is that source octave
+// stretched by 2^k, so the fine structure transposes with it, and scaled
+// by the source octave's own slope k times over, so the envelope carries on
+// falling as it did below the cutoff. One pass over the bins whatever the
+// content.
+template <typename Size>
+void ReplicateBand(Size size, const float* magnitude, int lowpassIdx, float* rebuild) {
+    const int bins = size.Bins();
+    const int octaveStart = lowpassIdx / 2;
+    if (octaveStart < 2 || lowpassIdx >= bins) return;
+    
+    // Slope per octave from the means of the source octave's halves, whose
+    // centres are about half an octave apart. Never a boost.
+    const int middle = (octaveStart + lowpassIdx) / 2;
+    float lower = 0.0f;
+    float upper = 0.0f;
+    for (int i = octaveStart; i < middle; ++i) lower += magnitude[i];
+    for (int i = middle; i < lowpassIdx; ++i) upper += magnitude[i];
+    lower /= middle - octaveStart;
+    upper /= lowpassIdx - middle;
+    const float ratio = lower > 0.0f ? upper / lower : 0.0f;
+    const float slope = std::min(1.0f, ratio * ratio);
+    
+    float gain = slope;
+    for (int first = lowpassIdx, k = 1; first < bins; first *= 2, ++k, gain *= slope) {
+        const int last = std::min(bins, first * 2);
+        for (int i = first; i < last; ++i) {
+            rebuild[i] = magnitude[i >> k] * gain;
+        }
+    }
+}
+
+// ProcessFrame for one FFT size. For N > 0 the workspaces are arrays of the
+// exact size; N = 0 sizes vectors at construction instead. Either way they
+// are reused from frame to frame, so a frame allocates nothing.
+template <int N>
+class FramePipeline {
+public:
+    explicit FramePipeline(int fftSize) : size(MakeSize(fftSize)) {
+        if constexpr (N == 0) {
+            for (auto* buffer : {&midMag, &sideMag, &midRebuild, &sideRebuild, &midSmoothed, &sideSmoothed, &fade}) {
+                buffer->resize(size.Bins());
+            }
+            for (auto* buffer : {&midPeaks, &sidePeaks, &candidates}) buffer->resize(size.Bins());
+        }
+    }
+    
+    int FftSize() const { return size.Fft(); }
+    int Bins() const { return size.Bins(); }
+    
+    // Magnitudes and peaks of both channels, looking for peaks up to bin `limit`
+    void Analyze(const std::complex<float>* mid, const std::complex<float>* side, int limit) {
+        Kernels::Magnitude(mid, midMag.data(), Bins());
+        Kernels::Magnitude(side, sideMag.data(), Bins());
+        midCount = Peaks(midMag.data(), limit, midPeaks.data());
+        sideCount = Peaks(sideMag.data(), limit, sidePeaks.data());
+    }
+    
+    // Magnitudes of both channels only, for BandReplication
+    void Analyze(const std::complex<float>* mid, const std::complex<float>* side) {
+        Kernels::Magnitude(mid, midMag.data(), Bins());
+        Kernels::Magnitude(side, sideMag.data(), Bins());
+        midCount = 0;
+        sideCount = 0;
+    }
+    
+    // Magnitudes of both channels, with peaks found earlier by Analyze
+    // without a limit; only those up to `limit` are kept
+    void Analyze(const std::complex<float>* mid, const std::complex<float>* side, int limit,
+                 const std::vector<int>& midFound, const std::vector<int>& sideFound) {
+        Kernels::Magnitude(mid, midMag.data(), Bins());
+        Kernels::Magnitude(side, sideMag.data(), Bins());
+        midCount = KeepUpTo(midFound, limit, midPeaks.data());
+        sideCount = KeepUpTo(sideFound, limit, sidePeaks.data());
+    }
+    
+    std::vector<int> MidPeaks() const { return std::vector<int>(midPeaks.begin(), midPeaks.begin() + midCount); }
+    std::vector<int> SidePeaks() const { return std::vector<int>(sidePeaks.begin(), sidePeaks.begin() + sideCount); }
+    
+    // Rebuild the bins from `lowpassIdx` up from the analysed peaks, or
+    // from the band below the cutoff
+    void Synthesize(std::complex<float>* mid, std::complex<float>* side, int lowpassIdx, uint32_t frameSeed,
+                    HFCompensation::Engine engine) {
         // Reconstruct high frequencies
-        std::vector<float> midRebuild(FFTSIZE / 2 + 1, 0);
-        std::vector<float> sideRebuild(FFTSIZE / 2 + 1, 0);
-        
-        ProcessPeaks(midPeaks, midMag, midRebuild);
-        ProcessPeaks(sidePeaks, sideMag, sideRebuild);
+        std::fill(midRebuild.begin(), midRebuild.end(), 0.0f);
+        std::fill(sideRebuild.begin(), sideRebuild.end(), 0.0f);
+        if (engine == HFCompensation::Engine::BandReplication) {
+            ReplicateBand(size, midMag.data(), lowpassIdx, midRebuild.data());
+            ReplicateBand(size, sideMag.data(), lowpassIdx, sideRebuild.data());
+        } else {
+            ProcessPeaks(size, midPeaks.data(), midCount, midMag.data(), midRebuild.data());
+            ProcessPeaks(size, sidePeaks.data(), sideCount, sideMag.data(), sideRebuild.data());
+        }
         
         // Apply spectral smoothing
-        midRebuild = FlattenSpectrum(midRebuild, 3);
-        sideRebuild = FlattenSpectrum(sideRebuild, 5);
+        Kernels::BoxSmooth(midRebuild.data(), midSmoothed.data(), Bins(), 3);
+        Kernels::BoxSmooth(sideRebuild.data(), sideSmoothed.data(), Bins(), 5);
         
         // Apply random variation for naturalness
-        std::random_device rd;
-        std::mt19937 gen(rd());
+        std::mt19937 gen(frameSeed);
         std::uniform_real_distribution<float> dist(0.15125f, 1.0f);
         
-        // Restore original low frequencies and add reconstructed high frequencies
-        for (int i = 0; i < lowpassIdx; ++i) {
-            midStft[frame][i] = midLowFreq[i];
-            sideStft[frame][i] = sideLowFreq[i];
-        }
-        
-        // Update the high frequency content
-        for (int i = lowpassIdx; i < FFTSIZE / 2 + 1; ++i) {
-            float fadeOut = std::pow(1.0f - static_cast<float>(i - lowpassIdx) / (FFTSIZE / 2 + 1 - lowpassIdx), 3);
+        // Bins below the cutoff keep their original content; update the high
+        // frequency content
+        const float* fadeOut = FadeOut(lowpassIdx);
+        for (int i = lowpassIdx; i < Bins(); ++i) {
             // Create complex numbers with magnitude and phase
-            float midPhase = std::arg(midStft[frame][i]);
-            float sidePhase = std::arg(sideStft[frame][i]);
-            midStft[frame][i] = std::polar(midRebuild[i] * dist(gen) * fadeOut, midPhase);
-            sideStft[frame][i] = std::polar(sideRebuild[i] * dist(gen) * fadeOut, sidePhase);
+            float midPhase = std::arg(mid[i]);
+            float sidePhase = std::arg(side[i]);
+            mid[i] = std::polar(midSmoothed[i] * dist(gen) * fadeOut[i], midPhase);
+            side[i] = std::polar(sideSmoothed[i] * dist(gen) * fadeOut[i], sidePhase);
         }
     }
     
-    // Inverse STFT
-    mid = stft.Inverse(midStft);
-    side = stft.Inverse(sideStft);
+    // Add the analysed frame and its rebuilt version to the spectrograms
+    void Publish(Overview* input, Overview* output, int frame,
+                 const std::complex<float>* mid, const std::complex<float>* side) {
+        if (input) input->AddFrame(frame, midMag.data(), sideMag.data(), Bins());
+        if (output) {
+            // The rebuild buffers are free again once Synthesize is done
+            Kernels::Magnitude(mid, midRebuild.data(), Bins());
+            Kernels::Magnitude(side, sideRebuild.data(), Bins());
+            output->AddFrame(frame, midRebuild.data(), sideRebuild.data(), Bins());
+        }
+    }
     
-    // Ensure output vectors have correct size
-    if (mid.empty() || side.empty()) {
-        std::cerr << "Warning: HFC produced empty output!" << std::endl;
+private:
+    template <typename T>
+    using Buffer = std::conditional_t<(N > 0), std::array<T, N / 2 + 1>, std::vector<T>>;
+    
+    static FrameSize<N> MakeSize(int fftSize) {
+        if constexpr (N == 0) {
+            return FrameSize<0>{fftSize};
+        } else {
+            return FrameSize<N>{};
+        }
     }
     
-    if (progressCallback) {
-        progressCallback(1.0f);
+    FrameSize<N> size;
+    Buffer<float> midMag, sideMag;
+    Buffer<float> midRebuild, sideRebuild;
+    Buffer<float> midSmoothed, sideSmoothed;
+    Buffer<int> midPeaks, sidePeaks, candidates;
+    int midCount = 0;
+    int sideCount = 0;
+    
+    // Fade towards Nyquist for the cutoff it was last built for
+    Buffer<float> fade;
+    int fadeLowpass = -1;
+    
+    int Peaks(const float* magnitude, int limit, int* peaks) {
+        // Detect peaks, then drop the ones that are harmonics of lower peaks
+        const int found = FindPeaks(size, magnitude, limit, 4, candidates.data());
+        return RemoveHarmonics(size, candidates.data(), found, peaks);
     }
-}
-
-std::vector<int> HFCompensation::FindPeaks(const std::vector<float>& magnitude, int minDistance) {
-    std::vector<int> peaks;
     
-    for (size_t i = 1; i < magnitude.size() - 1; ++i) {
-        // Check if it's a local maximum
-        if (magnitude[i] > magnitude[i-1] && magnitude[i] > magnitude[i+1]) {
-            // Check minimum distance from other peaks
-            bool tooClose = false;
-            for (int peak : peaks) {
-                if (std::abs(static_cast<int>(i) - peak) < minDistance) {
-                    tooClose = true;
-                    break;
-                }
-            }
-            
-            if (!tooClose) {
-                peaks.push_back(i);
+    int KeepUpTo(const std::vector<int>& found, int limit, int* peaks) const {
+        int count = 0;
+        for (int peak : found) {
+            if (peak <= limit && count < Bins()) peaks[count++] = peak;
+        }
+        return count;
+    }
+    
+    const float* FadeOut(int lowpassIdx) {
+        if (lowpassIdx != fadeLowpass) {
+            for (int i = lowpassIdx; i < Bins(); ++i) {
+                fade[i] = std::pow(1.0f - static_cast<float>(i - lowpassIdx) / (Bins() - lowpassIdx), 3);
             }
+            fadeLowpass = lowpassIdx;
         }
+        return fade.data();
     }
+};
+
+} // namespace
+
+struct HFCompensation::FrameCache {
+    std::unique_ptr<FramePipeline<1024>> size1024;
+    std::unique_ptr<FramePipeline<2048>> size2048;
+    std::unique_ptr<FramePipeline<4096>> size4096;
+    std::unique_ptr<FramePipeline<8192>> size8192;
+    std::unique_ptr<FramePipeline<0>> generic;
     
-    return peaks;
+    // Call `fn` with the pipeline for `fftSize`, creating it on first use
+    template <typename Fn>
+    void Visit(int fftSize, Fn&& fn) {
+        switch (fftSize) {
+        case 1024: return fn(Get(size1024, fftSize));
+        case 2048: return fn(Get(size2048, fftSize));
+        case 4096: return fn(Get(size4096, fftSize));
+        case 8192: return fn(Get(size8192, fftSize));
+        default:
+            if (generic && generic->FftSize() != fftSize) generic.reset();
+            return fn(Get(generic, fftSize));
+        }
+    }
+    
+    template <typename Pipeline>
+    static Pipeline& Get(std::unique_ptr<Pipeline>& pipeline, int fftSize) {
+        if (!pipeline) pipeline = std::make_unique<Pipeline>(fftSize);
+        return *pipeline;
+    }
+};
+
+HFCompensation::HFCompensation(uint32_t seed, int firstFrame)
+    : seed(seed), firstFrame(firstFrame), frameCache(std::make_unique<FrameCache>()) {
 }
 
-std::vector<int> HFCompensation::RemoveHarmonics(const std::vector<int>& peaks) {
-    std::vector<int> filtered;
+HFCompensation::~HFCompensation() {
+}
+
+HFCompensation::Workspace::Workspace() {
+}
+
+HFCompensation::Workspace::~Workspace() {
+}
+
+void HFCompensation::Workspace::Release() {
+    stft.reset();
+    ::Release(mid);
+    ::Release(side);
+    ::Release(midWindowSum);
+    ::Release(sideWindowSum);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    caches.clear();
+}
+
+std::unique_ptr<HFCompensation::FrameCache> HFCompensation::AcquireCache() {
+    if (workspace) {
+        std::lock_guard<std::mutex> lock(workspace->cacheMutex);
+        if (!workspace->caches.empty()) {
+            std::unique_ptr<FrameCache> cache = std::move(workspace->caches.back());
+            workspace->caches.pop_back();
+            return cache;
+        }
+    }
+    return std::make_unique<FrameCache>();
+}
+
+void HFCompensation::ReleaseCache(std::unique_ptr<FrameCache> cache) {
+    if (workspace) {
+        std::lock_guard<std::mutex> lock(workspace->cacheMutex);
+        workspace->caches.push_back(std::move(cache));
+    }
+}
+
+int HFCompensation::LowpassBin(int sampleRate, int lowpassFreq, int fftSize) {
+    int lowpassIdx = static_cast<int>((fftSize / 2 + 1) * (lowpassFreq / (sampleRate / 2.0f)));
+    return std::max(0, std::min(lowpassIdx, fftSize / 2));
+}
+
+bool HFCompensation::Process(std::vector<float>& mid,
+                            std::vector<float>& side,
+                            int sampleRate,
+                            int lowpassFreq,
+                            bool compressedMode,
+                            JobProgress* progress,
+                            const CancellationToken* cancel) {
+    const int lowpassIdx = LowpassBin(sampleRate, lowpassFreq);
+    HRAW_LOG_DEBUG("Processing with lowpass at " << lowpassFreq << " Hz (bin " << lowpassIdx << ")");
     
-    for (int peak : peaks) {
-        bool isHarmonic = false;
-        
-        // Check if this peak is a harmonic of any lower frequency
-        for (int fundamental : filtered) {
-            int maxHarmonic = FFTSIZE / (2 * fundamental);
-            for (int k = 2; k <= maxHarmonic; ++k) {
-                if (std::abs(peak - fundamental * k) < 6) {
-                    isHarmonic = true;
-                    break;
-                }
+    // The STFT and the buffers, from the workspace if there is one
+    std::unique_ptr<STFT> ownStft;
+    Spectrogram ownMidStft, ownSideStft;
+    std::vector<float> ownMidWindowSum, ownSideWindowSum;
+    if (workspace && !workspace->stft) {
+        workspace->stft = std::make_unique<STFT>(FFTSIZE, HOPSIZE);
+    } else if (!workspace) {
+        ownStft = std::make_unique<STFT>(FFTSIZE, HOPSIZE);
+    }
+    STFT& stft = workspace ? *workspace->stft : *ownStft;
+    Spectrogram& midStft = workspace ? workspace->mid : ownMidStft;
+    Spectrogram& sideStft = workspace ? workspace->side : ownSideStft;
+    std::vector<float>& midWindowSum = workspace ? workspace->midWindowSum : ownMidWindowSum;
+    std::vector<float>& sideWindowSum = workspace ? workspace->sideWindowSum : ownSideWindowSum;
+    
+    // Without a workspace, every buffer is dropped once it's used up
+    auto release = [&](auto& buffer) {
+        if (!workspace) Release(buffer);
+    };
+    auto cancelled = [&]() {
+        if (!CancellationToken::IsCancelled(cancel)) return false;
+        release(midStft);
+        release(sideStft);
+        mid.clear();
+        side.clear();
+        release(mid);
+        release(side);
+        return true;
+    };
+    
+    // Perform STFT
+    if (progress) progress->BeginStage(JobStage::Analyzing, 2);
+    {
+        HRAW_TRACE_SCOPE("forward stft");
+        TaskGroup group;
+        group.Run([&]() { stft.Forward(side, sideStft, cancel); });
+        stft.Forward(mid, midStft, cancel);
+        if (progress) progress->Advance(1);
+    }
+    if (progress) progress->SetMemory(Bytes(mid) + Bytes(side) + Bytes(midStft) + Bytes(sideStft));
+    if (cancelled()) {
+        return false;
+    }
+    
+    // The time-domain inputs are rebuilt from the spectrograms at the end
+    release(mid);
+    release(side);
+    
+    // A zero seed means a fresh, unrepeatable variation per job
+    const uint32_t jobSeed = seed != 0 ? seed : std::random_device{}();
+    
+    int numFrames = midStft.size();
+    if (progress) progress->BeginStage(JobStage::Synthesizing, numFrames);
+    
+    // Process each frame. Frames are independent, so ranges of them run in
+    // parallel, each with its own workspaces.
+    std::atomic<int> framesDone{0};
+    ParallelFor(0, numFrames, FRAME_GRAIN, [&](size_t first, size_t last) {
+        std::unique_ptr<FrameCache> cache = AcquireCache();
+        for (size_t frame = first; frame < last; ++frame) {
+            if (CancellationToken::IsCancelled(cancel)) {
+                break;
             }
-            if (isHarmonic) break;
-        }
-        
-        if (!isHarmonic) {
-            filtered.push_back(peak);
+            ProcessFrame(*cache, midStft[frame], sideStft[frame], lowpassIdx, jobSeed, static_cast<int>(frame));
+            
+            // A relaxed store; readers poll it at their own rate
+            if (progress) progress->Advance(++framesDone);
         }
+        ReleaseCache(std::move(cache));
+    });
+    
+    // Inverse STFT, freeing each spectrogram as soon as it has been consumed
+    if (cancelled()) {
+        return false;
+    }
+    if (progress) progress->BeginStage(JobStage::Reconstructing, 2);
+    {
+        HRAW_TRACE_SCOPE("inverse stft");
+        TaskGroup group;
+        group.Run([&]() {
+            stft.Inverse(sideStft, side, sideWindowSum, cancel);
+            release(sideStft);
+            release(sideWindowSum);
+        });
+        stft.Inverse(midStft, mid, midWindowSum, cancel);
+        release(midStft);
+        release(midWindowSum);
+        if (progress) progress->Advance(1);
+    }
+    if (cancelled()) {
+        return false;
     }
     
-    return filtered;
+    // Ensure output vectors have correct size
+    if (mid.empty() || side.empty()) {
+        HRAW_LOG_WARN("HFC produced empty output");
+    }
+    
+    if (progress) progress->EndStage(JobStage::Queued);
+    return true;
 }
 
-void HFCompensation::ProcessPeaks(const std::vector<int>& peaks,
-                                 const std::vector<float>& magnitude,
-                                 std::vector<float>& rebuild) {
-    for (int peak : peaks) {
-        Overtone ot;
-        ot.baseFreq = peak;  // Use the actual peak frequency
-        // Calculate how many harmonics can fit in the available spectrum
-        ot.loop = std::min(12, (FFTSIZE / 2 - ot.baseFreq) / ot.baseFreq);
-        
-        // Extract harmonic amplitudes
-        std::vector<float> harmonics;
-        for (int l = 1; l < ot.loop && ot.baseFreq * l < static_cast<int>(magnitude.size()); ++l) {
-            harmonics.push_back(magnitude[ot.baseFreq * l]);
-        }
-        
-        if (harmonics.empty() || harmonics[0] == 0) continue;
-        
-        // Calculate slope using Gaussian weighting
-        int gaussSize = harmonics.size();
-        std::vector<float> gaussian(gaussSize);
-        float sigma = gaussSize / 1.3f;
-        for (int i = 0; i < gaussSize; ++i) {
-            gaussian[i] = std::exp(-(i - gaussSize/2.0f) * (i - gaussSize/2.0f) / (2 * sigma * sigma));
-        }
-        
-        // Normalize harmonics and apply Gaussian
-        ot.slope.resize(ot.loop * 12);  // Extended for future overtones
-        for (size_t i = 0; i < harmonics.size() && i < ot.slope.size(); ++i) {
-            ot.slope[i] = (harmonics[i] / 12.0f) * gaussian[i % gaussian.size()];
-        }
-        
-        // Determine width
-        ot.width = 2;
-        for (int k = 2; k <= 3; ++k) {
-            if (peak - k/2 >= 0 && peak + k/2 < static_cast<int>(magnitude.size())) {
-                if (std::abs(magnitude[peak - k/2] - magnitude[peak + k/2]) < 4) {
-                    ot.width = k;
-                    break;
-                }
-            }
+bool HFCompensation::ProcessStreaming(std::vector<float>& mid,
+                                      std::vector<float>& side,
+                                      int sampleRate,
+                                      int lowpassFreq,
+                                      JobProgress* progress,
+                                      const CancellationToken* cancel) {
+    const int lowpassIdx = LowpassBin(sampleRate, lowpassFreq);
+    HRAW_LOG_DEBUG("Streaming HFC with lowpass at " << lowpassFreq << " Hz (bin " << lowpassIdx << ")");
+    
+    STFT stft(FFTSIZE, HOPSIZE);
+    const std::vector<float>& window = stft.Window();
+    const int numFrames = stft.NumFrames(mid.size());
+    const uint32_t jobSeed = seed != 0 ? seed : std::random_device{}();
+    
+    OverlapAdd overlapAdd;
+    if (progress) {
+        progress->BeginStage(JobStage::Synthesizing, numFrames);
+        progress->SetMemory(Bytes(mid) + Bytes(side) + overlapAdd.Bytes());
+    }
+    HRAW_TRACE_SCOPE("streaming hfc");
+    for (int frame = 0; frame < numFrames; ++frame) {
+        if (CancellationToken::IsCancelled(cancel)) {
+            Release(mid);
+            Release(side);
+            return false;
         }
+        if (progress) progress->Advance(frame);
         
-        // Extract power
-        int startPower = std::max(0, peak - ot.width / 2);
-        int endPower = std::min(static_cast<int>(magnitude.size()), peak + ot.width / 2);
-        ot.power.resize(endPower - startPower);
-        for (int i = startPower; i < endPower; ++i) {
-            ot.power[i - startPower] = magnitude[i];
-        }
+        // Emitted samples land before `start`, which no later frame reads
+        const size_t start = static_cast<size_t>(frame) * HOPSIZE;
+        std::vector<std::complex<float>> midFrame = stft.ForwardFrame(mid, start);
+        std::vector<std::complex<float>> sideFrame = stft.ForwardFrame(side, start);
+        ProcessFrame(midFrame, sideFrame, lowpassIdx, jobSeed, frame);
         
-        // Synthesize overtones - start from k=2 to synthesize above the fundamental
-        for (int k = 2; k <= ot.loop + 1; ++k) {
-            int start = ot.baseFreq * k - ot.width / 2;
-            int end = ot.baseFreq * k + ot.width / 2;
-            
-            if (start < 0 || end > static_cast<int>(rebuild.size())) continue;
-            
-            if (k - 1 < static_cast<int>(ot.slope.size())) {
-                // Apply decreasing amplitude for higher harmonics
-                float harmonicAmp = std::abs(ot.slope[k - 1]) * std::pow(0.7f, k - 2);
-                for (int i = start; i < end && i - start < static_cast<int>(ot.power.size()); ++i) {
-                    rebuild[i] += ot.power[i - start] * harmonicAmp;
-                }
+        overlapAdd.Add(stft.InverseFrame(midFrame), stft.InverseFrame(sideFrame), window);
+        overlapAdd.Emit(mid, side, start, frame + 1 == numFrames);
+    }
+    
+    // Same length Inverse produces
+    mid.resize(OutputSize(numFrames));
+    side.resize(OutputSize(numFrames));
+    if (mid.empty()) {
+        HRAW_LOG_WARN("HFC produced empty output");
+    }
+    
+    if (progress) progress->EndStage(JobStage::Queued);
+    return true;
+}
+
+uint64_t HFCompensation::Analysis::Bytes() const {
+    uint64_t bytes = ::Bytes(mid) + ::Bytes(side);
+    for (const auto* peaks : {&midPeaks, &sidePeaks}) {
+        bytes += peaks->capacity() * sizeof(std::vector<int>);
+        for (const auto& framePeaks : *peaks) bytes += framePeaks.capacity() * sizeof(int);
+    }
+    return bytes;
+}
+
+bool HFCompensation::Analyze(const std::vector<float>& mid,
+                             const std::vector<float>& side,
+                             int sampleRate,
+                             Analysis& analysis,
+                             JobProgress* progress,
+                             const CancellationToken* cancel) {
+    auto cancelled = [&]() {
+        if (!CancellationToken::IsCancelled(cancel)) return false;
+        analysis = Analysis();
+        return true;
+    };
+    
+    STFT stft(FFTSIZE, HOPSIZE);
+    analysis.sampleRate = sampleRate;
+    if (progress) progress->BeginStage(JobStage::Analyzing, 2);
+    {
+        HRAW_TRACE_SCOPE("forward stft");
+        TaskGroup group;
+        group.Run([&]() { analysis.side = stft.Forward(side, cancel); });
+        analysis.mid = stft.Forward(mid, cancel);
+        if (progress) progress->Advance(1);
+    }
+    if (cancelled()) {
+        return false;
+    }
+    
+    const int numFrames = analysis.mid.size();
+    analysis.midPeaks.resize(numFrames);
+    analysis.sidePeaks.resize(numFrames);
+    if (progress) progress->BeginStage(JobStage::Analyzing, numFrames);
+    HRAW_TRACE_SCOPE("peak analysis");
+    std::atomic<int> framesDone{0};
+    ParallelFor(0, numFrames, FRAME_GRAIN, [&](size_t first, size_t last) {
+        FrameCache cache;
+        for (size_t frame = first; frame < last; ++frame) {
+            if (CancellationToken::IsCancelled(cancel)) {
+                return;
             }
+            // Every peak, so any cutoff can be synthesized from them later
+            cache.Visit(FFTSIZE, [&](auto& pipeline) {
+                pipeline.Analyze(analysis.mid[frame].data(), analysis.side[frame].data(), pipeline.Bins());
+                analysis.midPeaks[frame] = pipeline.MidPeaks();
+                analysis.sidePeaks[frame] = pipeline.SidePeaks();
+            });
+            if (progress) progress->Advance(++framesDone);
         }
+    });
+    if (cancelled()) {
+        return false;
+    }
+    
+    if (progress) {
+        progress->SetMemory(Bytes(mid) + Bytes(side) + analysis.Bytes());
+        progress->EndStage(JobStage::Queued);
     }
+    return true;
 }
 
-std::vector<float> HFCompensation::FlattenSpectrum(const std::vector<float>& signal, int windowSize) {
-    std::vector<float> smoothed(signal.size());
-    int halfWindow = windowSize / 2;
+bool HFCompensation::Synthesize(const Analysis& analysis,
+                                int lowpassFreq,
+                                std::vector<float>& mid,
+                                std::vector<float>& side,
+                                JobProgress* progress,
+                                const CancellationToken* cancel) {
+    const int lowpassIdx = LowpassBin(analysis.sampleRate, lowpassFreq);
+    HRAW_LOG_DEBUG("Synthesizing with lowpass at " << lowpassFreq << " Hz (bin " << lowpassIdx << ")");
     
-    for (size_t i = 0; i < signal.size(); ++i) {
-        float sum = 0;
-        int count = 0;
-        
-        for (int j = -halfWindow; j <= halfWindow; ++j) {
-            int idx = i + j;
-            if (idx >= 0 && idx < static_cast<int>(signal.size())) {
-                sum += signal[idx];
-                count++;
+    const int numFrames = analysis.mid.size();
+    const uint32_t jobSeed = seed != 0 ? seed : std::random_device{}();
+    
+    // Frames are rebuilt from copies and overlap-added straight into the
+    // output, then normalized as STFT::Inverse does
+    mid.assign(OutputSize(numFrames), 0.0f);
+    side.assign(OutputSize(numFrames), 0.0f);
+    std::vector<float> windowSum(mid.size(), 0.0f);
+    
+    if (progress) {
+        progress->BeginStage(JobStage::Synthesizing, numFrames);
+        progress->SetMemory(analysis.Bytes() + Bytes(mid) + Bytes(side) + Bytes(windowSum));
+    }
+    
+    // Neighbouring ranges share samples, so they never run at the same time;
+    // each sample then sums the same two terms whichever range ran first
+    std::atomic<int> framesDone{0};
+    ParallelForNonAdjacent(0, numFrames, FRAME_GRAIN, [&](size_t first, size_t last) {
+        STFT stft(FFTSIZE, HOPSIZE);
+        const std::vector<float>& window = stft.Window();
+        FrameCache cache;
+        std::vector<std::complex<float>> midFrame, sideFrame;
+        for (size_t frame = first; frame < last; ++frame) {
+            if (CancellationToken::IsCancelled(cancel)) {
+                return;
             }
+            
+            midFrame = analysis.mid[frame];
+            sideFrame = analysis.side[frame];
+            cache.Visit(FftSizeOf(midFrame.size()), [&](auto& pipeline) {
+                pipeline.Analyze(midFrame.data(), sideFrame.data(), lowpassIdx,
+                                 analysis.midPeaks[frame], analysis.sidePeaks[frame]);
+                HRAW_TRACE_SCOPE("synthesis");
+                pipeline.Synthesize(midFrame.data(), sideFrame.data(), lowpassIdx,
+                                    FrameSeed(jobSeed, firstFrame + static_cast<int>(frame)), engine);
+                pipeline.Publish(inputOverview, outputOverview, static_cast<int>(frame),
+                                 midFrame.data(), sideFrame.data());
+            });
+            
+            const size_t start = frame * HOPSIZE;
+            Kernels::Accumulate(mid.data() + start, stft.InverseFrame(midFrame).data(), FFTSIZE);
+            Kernels::Accumulate(side.data() + start, stft.InverseFrame(sideFrame).data(), FFTSIZE);
+            Kernels::AccumulateSquares(windowSum.data() + start, window.data(), FFTSIZE);
+            if (progress) progress->Advance(++framesDone);
         }
-        
-        smoothed[i] = count > 0 ? sum / count : signal[i];
+    });
+    if (CancellationToken::IsCancelled(cancel)) {
+        Release(mid);
+        Release(side);
+        return false;
+    }
+    
+    Kernels::DivideNonZero(mid.data(), windowSum.data(), mid.size());
+    Kernels::DivideNonZero(side.data(), windowSum.data(), side.size());
+    
+    if (mid.empty()) {
+        HRAW_LOG_WARN("HFC produced empty output");
     }
     
+    if (progress) progress->EndStage(JobStage::Queued);
+    return true;
+}
+
+void HFCompensation::ProcessFrame(std::vector<std::complex<float>>& midFrame,
+                                  std::vector<std::complex<float>>& sideFrame,
+                                  int lowpassIdx,
+                                  uint32_t jobSeed,
+                                  int frame) {
+    ProcessFrame(*frameCache, midFrame, sideFrame, lowpassIdx, jobSeed, frame);
+}
+
+void HFCompensation::ProcessFrame(FrameCache& cache,
+                                  std::vector<std::complex<float>>& midFrame,
+                                  std::vector<std::complex<float>>& sideFrame,
+                                  int lowpassIdx,
+                                  uint32_t jobSeed,
+                                  int frame) {
+    cache.Visit(FftSizeOf(midFrame.size()), [&](auto& pipeline) {
+        if (engine == Engine::BandReplication) {
+            pipeline.Analyze(midFrame.data(), sideFrame.data());
+        } else {
+            // Peaks above the cutoff seed nothing, so don't look for them
+            HRAW_TRACE_SCOPE("peak analysis");
+            pipeline.Analyze(midFrame.data(), sideFrame.data(), lowpassIdx);
+        }
+        HRAW_TRACE_SCOPE("synthesis");
+        pipeline.Synthesize(midFrame.data(), sideFrame.data(), lowpassIdx, FrameSeed(jobSeed, firstFrame + frame),
+                            engine);
+        pipeline.Publish(inputOverview, outputOverview, frame, midFrame.data(), sideFrame.data());
+    });
+}
+
+std::vector<int> HFCompensation::FindPeaks(const std::vector<float>& magnitude, int minDistance) {
+    const FrameSize<0> size{FftSizeOf(magnitude.size())};
+    std::vector<int> peaks(magnitude.size());
+    peaks.resize(::FindPeaks(size, magnitude.data(), size.Bins(), minDistance, peaks.data()));
+    return peaks;
+}
+
+std::vector<int> HFCompensation::RemoveHarmonics(const std::vector<int>& peaks) {
+    std::vector<int> filtered(peaks.size());
+    filtered.resize(::RemoveHarmonics(FrameSize<0>{FFTSIZE}, peaks.data(), static_cast<int>(peaks.size()),
+                                      filtered.data()));
+    return filtered;
+}
+
+void HFCompensation::ProcessPeaks(const std::vector<int>& peaks,
+                                 const std::vector<float>& magnitude,
+                                 std::vector<float>& rebuild) {
+    rebuild.resize(magnitude.size());
+    const FrameSize<0> size{FftSizeOf(magnitude.size())};
+    ::ProcessPeaks(size, peaks.data(), static_cast<int>(peaks.size()), magnitude.data(), rebuild.data());
+}
+
+std::vector<float> HFCompensation::FlattenSpectrum(const std::vector<float>& signal, int windowSize) {
+    std::vector<float> smoothed(signal.size());
+    Kernels::BoxSmooth(signal.data(), smoothed.data(), signal.size(), windowSize);
     return smoothed;
-}
\ No newline at end of file
+}
+
+void HFCompensation::ReplicateBand(const std::vector<float>& magnitude, int lowpassIdx, std::vector<float>& rebuild) {
+    rebuild.assign(magnitude.size(), 0.0f);
+    const FrameSize<0> size{FftSizeOf(magnitude.size())};
+    ::ReplicateBand(size, magnitude.data(), lowpassIdx, rebuild.data());
+}
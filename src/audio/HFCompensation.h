@@ -1,55 +1,187 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <complex>
-#include <functional>
+
+class CancellationToken;
+class JobProgress;
+class Overview;
+class STFT;
 
 class HFCompensation {
+    // Per-frame workspaces, one per FFT size seen, kept between frames.
+    // Frame ranges running in parallel each bring their own.
+    struct FrameCache;
+    
 public:
-    using ProgressCallback = std::function<void(float)>;
+    // How the band above the cutoff is rebuilt
+    enum class Engine {
+        Harmonic,         // Overtones of each spectral peak; cost grows with the peaks per frame
+        BandReplication   // The octave below the cutoff transposed upward; fixed cost per bin
+    };
     
-    HFCompensation();
+    // `seed` fixes the random spectral variation so identical input gives
+    // bit-identical output; 0 picks a new seed on every Process call.
+    // `firstFrame` is the index the first STFT frame has in the whole file,
+    // so an excerpt that starts on the file's frame grid gets the same
+    // variation as the full render.
+    explicit HFCompensation(uint32_t seed = 0, int firstFrame = 0);
     ~HFCompensation();
     
-    // Main HFC processing function
-    void Process(std::vector<float>& mid,
+    // Spectrogram sinks for display: every frame's input and rebuilt
+    // spectrum is added as it's processed. Either may be null.
+    void SetOverviews(Overview* input, Overview* output) {
+        inputOverview = input;
+        outputOverview = output;
+    }
+    
+    // Harmonic unless set. Applies to every later call.
+    void SetEngine(Engine engine) { this->engine = engine; }
+    
+    // What Process keeps from one call to the next when given a workspace:
+    // the STFT with its FFT plans, both spectrograms, the overlap-add
+    // scratch and the frame workspaces. Calls on inputs no longer than an
+    // earlier one then reuse all of it instead of allocating afresh, at the
+    // cost of holding it in between. One call at a time may use it.
+    struct Workspace {
+        Workspace();
+        ~Workspace();
+        
+        // Free all of it; the next call fills it again
+        void Release();
+        
+        std::unique_ptr<STFT> stft;
+        std::vector<std::vector<std::complex<float>>> mid, side;
+        std::vector<float> midWindowSum, sideWindowSum;
+        std::mutex cacheMutex;
+        std::vector<std::unique_ptr<FrameCache>> caches;
+    };
+    
+    // Null, the default, gives every call its own buffers, freed as soon
+    // as each is used up. Applies to every later Process call.
+    void SetWorkspace(Workspace* workspace) { this->workspace = workspace; }
+    
+    // Main HFC processing function. Publishes its STFT stages and per-frame
+    // progress to `progress`. Returns false if `cancel` fired, in which case
+    // mid/side are left empty and all spectrograms are freed (or kept in
+    // the workspace). Mid and side, and ranges of frames, run in parallel
+    // on the shared TaskScheduler; the output doesn't depend on how the
+    // work was split.
+    bool Process(std::vector<float>& mid,
                  std::vector<float>& side,
                  int sampleRate,
                  int lowpassFreq,
                  bool compressedMode,
-                 ProgressCallback progressCallback = nullptr);
+                 JobProgress* progress = nullptr,
+                 const CancellationToken* cancel = nullptr);
+    
+    // Same output as Process, bit for bit, but works one frame at a time and
+    // overwrites mid/side in place. Only a few frames of scratch memory are
+    // used on top of the inputs, where Process holds two full spectrograms.
+    bool ProcessStreaming(std::vector<float>& mid,
+                          std::vector<float>& side,
+                          int sampleRate,
+                          int lowpassFreq,
+                          JobProgress* progress = nullptr,
+                          const CancellationToken* cancel = nullptr);
     
-private:
     // STFT parameters
     static constexpr int FFTSIZE = 4096;
     static constexpr int HOPSIZE = 2048;
     
-    // Overtone structure (from Python)
-    struct Overtone {
-        int width = 2;
-        float amplitude = 0;
-        int baseFreq = 0;
-        std::vector<float> slope;
-        int loop = 0;
-        std::vector<float> power;
+    // The part of HFC that doesn't depend on the cutoff: both forward STFTs
+    // and each frame's peaks
+    struct Analysis {
+        int sampleRate = 0;
+        std::vector<std::vector<std::complex<float>>> mid;   // [frame][bin]
+        std::vector<std::vector<std::complex<float>>> side;
+        std::vector<std::vector<int>> midPeaks;   // [frame], harmonics removed, not yet limited to the cutoff
+        std::vector<std::vector<int>> sidePeaks;
+        
+        uint64_t Bytes() const;
     };
     
-    // Core processing functions
-    void ProcessChannel(std::vector<std::vector<std::complex<float>>>& stftData,
-                       int lowpassIdx,
-                       bool isHarmonic);
+    // Process split in two, so a cutoff sweep or a changed cutoff only
+    // repeats the second half. Analyze leaves mid/side untouched. Synthesize
+    // only reads `analysis` and writes the result to mid/side; its output is
+    // bit-identical to Process with the same seed and cutoff. Both return
+    // false if `cancel` fired.
+    bool Analyze(const std::vector<float>& mid,
+                 const std::vector<float>& side,
+                 int sampleRate,
+                 Analysis& analysis,
+                 JobProgress* progress = nullptr,
+                 const CancellationToken* cancel = nullptr);
+    bool Synthesize(const Analysis& analysis,
+                    int lowpassFreq,
+                    std::vector<float>& mid,
+                    std::vector<float>& side,
+                    JobProgress* progress = nullptr,
+                    const CancellationToken* cancel = nullptr);
+    
+    // Per-frame kernels used by Process, exposed so the benchmarks can
+    // drive them on synthetic spectra
     
     // Peak detection and harmonic removal
     std::vector<int> FindPeaks(const std::vector<float>& magnitude, int minDistance = 4);
     std::vector<int> RemoveHarmonics(const std::vector<int>& peaks);
     
-    // Overtone synthesis
+    // Overtone synthesis; `rebuild` is the same size as `magnitude`
     void ProcessPeaks(const std::vector<int>& peaks,
                      const std::vector<float>& magnitude,
                      std::vector<float>& rebuild);
     
     // Spectral smoothing
     std::vector<float> FlattenSpectrum(const std::vector<float>& signal, int windowSize = 6);
+    
+    // BandReplication's synthesis, standing in for ProcessPeaks
+    void ReplicateBand(const std::vector<float>& magnitude, int lowpassIdx, std::vector<float>& rebuild);
+    
+    // Rebuild the band above `lowpassIdx` of one mid/side frame pair. The
+    // random variation is seeded from `jobSeed` and the frame index only.
+    // Public for callers that run their own STFT, such as BlockProcessor.
+    // FFT sizes 1024, 2048, 4096 and 8192 run a pipeline specialized for
+    // that size; any other even size gives the same result, only slower.
+    void ProcessFrame(std::vector<std::complex<float>>& midFrame,
+                      std::vector<std::complex<float>>& sideFrame,
+                      int lowpassIdx,
+                      uint32_t jobSeed,
+                      int frame);
+    
+    // Bin above which the spectrum is rebuilt
+    static int LowpassBin(int sampleRate, int lowpassFreq, int fftSize = FFTSIZE);
+    
+private:
+    uint32_t seed;
+    int firstFrame;
+    Engine engine = Engine::Harmonic;
+    Overview* inputOverview = nullptr;
+    Overview* outputOverview = nullptr;
+    Workspace* workspace = nullptr;
+    
+    std::unique_ptr<FrameCache> frameCache;
+    
+    // A frame workspace for one range of frames, from the workspace's pool
+    // if there is one, and back
+    std::unique_ptr<FrameCache> AcquireCache();
+    void ReleaseCache(std::unique_ptr<FrameCache> cache);
+    
+    void ProcessFrame(FrameCache& cache,
+                      std::vector<std::complex<float>>& midFrame,
+                      std::vector<std::complex<float>>& sideFrame,
+                      int lowpassIdx,
+                      uint32_t jobSeed,
+                      int frame);
+    
+    // Core processing functions
+    void ProcessChannel(std::vector<std::vector<std::complex<float>>>& stftData,
+                       int lowpassIdx,
+                       bool isHarmonic);
+    
+    // Spectral smoothing
     void TemporalSmoothing(std::vector<std::vector<float>>& spectrogram, int filterSize = 5);
     
     // Phase reconstruction (Griffin-Lim)
@@ -0,0 +1,309 @@
+#include "MappedAudioFile.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// WAVE_FORMAT_* tags from the fmt chunk
+constexpr uint16_t FORMAT_PCM = 0x0001;
+constexpr uint16_t FORMAT_IEEE_FLOAT = 0x0003;
+constexpr uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+
+// Wave64 chunk GUIDs share a common 12-byte tail after the four-character code
+const uint8_t W64_RIFF_GUID[16] = {'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11,
+                                   0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00};
+const uint8_t W64_GUID_TAIL[12] = {0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1,
+                                   0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+
+uint16_t ReadLE16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLE32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t ReadLE64(const uint8_t* p) {
+    return static_cast<uint64_t>(ReadLE32(p)) | (static_cast<uint64_t>(ReadLE32(p + 4)) << 32);
+}
+
+bool IsW64Chunk(const uint8_t* guid, const char* fourcc) {
+    return memcmp(guid, fourcc, 4) == 0 && memcmp(guid + 4, W64_GUID_TAIL, 12) == 0;
+}
+
+// Scalar conversion of one strided channel, for single-channel views.
+// Whole-frame reads go through the SampleConvert kernels instead.
+void ConvertStrided(const uint8_t* src, size_t stride, size_t count,
+                    MappedAudioFile::SampleFormat format, float* dst) {
+    switch (format) {
+        case MappedAudioFile::SampleFormat::PCM16: {
+            const float scale = 1.0f / 32768.0f;
+            for (size_t i = 0; i < count; ++i, src += stride) {
+                int16_t v;
+                memcpy(&v, src, sizeof(v));
+                dst[i] = v * scale;
+            }
+            break;
+        }
+        case MappedAudioFile::SampleFormat::PCM24: {
+            const float scale = 1.0f / 2147483648.0f;
+            for (size_t i = 0; i < count; ++i, src += stride) {
+                int32_t v = static_cast<int32_t>((static_cast<uint32_t>(src[0]) << 8) |
+                                                 (static_cast<uint32_t>(src[1]) << 16) |
+                                                 (static_cast<uint32_t>(src[2]) << 24));
+                dst[i] = v * scale;
+            }
+            break;
+        }
+        case MappedAudioFile::SampleFormat::PCM32: {
+            const float scale = 1.0f / 2147483648.0f;
+            for (size_t i = 0; i < count; ++i, src += stride) {
+                int32_t v;
+                memcpy(&v, src, sizeof(v));
+                dst[i] = v * scale;
+            }
+            break;
+        }
+        case MappedAudioFile::SampleFormat::Float32:
+            for (size_t i = 0; i < count; ++i, src += stride) {
+                memcpy(&dst[i], src, sizeof(float));
+            }
+            break;
+    }
+}
+
+} // namespace
+
+void MappedAudioFile::ChannelView::Read(size_t start, size_t count, float* dst) const {
+    if (start >= numFrames) return;
+    count = std::min(count, numFrames - start);
+    ConvertStrided(data + start * stride, stride, count, format, dst);
+}
+
+MappedAudioFile::MappedAudioFile() {
+}
+
+MappedAudioFile::~MappedAudioFile() {
+    Close();
+}
+
+bool MappedAudioFile::Open(const std::string& path) {
+    Close();
+
+#if defined(_WIN32) || !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    (void)path;
+    return false;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 44) {
+        close(fd);
+        return false;
+    }
+
+    mappingSize = static_cast<size_t>(st.st_size);
+    void* addr = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping keeps its own reference to the file
+
+    if (addr == MAP_FAILED) {
+        mappingSize = 0;
+        return false;
+    }
+    mapping = addr;
+
+    const uint8_t* base = static_cast<const uint8_t*>(mapping);
+    bool ok = false;
+    if (memcmp(base, "RIFF", 4) == 0 || memcmp(base, "RF64", 4) == 0) {
+        ok = ParseRiff(base, mappingSize);
+    } else if (memcmp(base, W64_RIFF_GUID, 16) == 0) {
+        ok = ParseWave64(base, mappingSize);
+    }
+
+    if (!ok) {
+        Close();
+        return false;
+    }
+
+    // Whole-file loads walk the data front to back
+    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+    return true;
+#endif
+}
+
+void MappedAudioFile::Close() {
+#if !defined(_WIN32)
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    dataStart = nullptr;
+    numFrames = 0;
+    numChannels = 0;
+    sampleRate = 0;
+}
+
+bool MappedAudioFile::ParseFormat(const uint8_t* fmt, size_t size) {
+    if (size < 16) return false;
+
+    uint16_t tag = ReadLE16(fmt);
+    numChannels = ReadLE16(fmt + 2);
+    sampleRate = static_cast<int>(ReadLE32(fmt + 4));
+    uint16_t blockAlign = ReadLE16(fmt + 12);
+    uint16_t bitsPerSample = ReadLE16(fmt + 14);
+
+    // WAVE_FORMAT_EXTENSIBLE keeps the real format in the first two bytes of the sub-format GUID
+    if (tag == FORMAT_EXTENSIBLE) {
+        if (size < 40) return false;
+        tag = ReadLE16(fmt + 24);
+    }
+
+    if (numChannels <= 0 || sampleRate <= 0) return false;
+
+    if (tag == FORMAT_PCM && bitsPerSample == 16) {
+        format = SampleFormat::PCM16;
+    } else if (tag == FORMAT_PCM && bitsPerSample == 24) {
+        format = SampleFormat::PCM24;
+    } else if (tag == FORMAT_PCM && bitsPerSample == 32) {
+        format = SampleFormat::PCM32;
+    } else if (tag == FORMAT_IEEE_FLOAT && bitsPerSample == 32) {
+        format = SampleFormat::Float32;
+    } else {
+        return false;
+    }
+
+    bytesPerSample = bitsPerSample / 8;
+    frameBytes = bytesPerSample * numChannels;
+    return blockAlign == frameBytes;
+}
+
+bool MappedAudioFile::ParseRiff(const uint8_t* base, size_t size) {
+    if (memcmp(base + 8, "WAVE", 4) != 0) return false;
+
+    const bool isRF64 = memcmp(base, "RF64", 4) == 0;
+    uint64_t rf64DataSize = 0;
+    bool haveFormat = false;
+
+    size_t pos = 12;
+    while (pos + 8 <= size) {
+        const uint8_t* chunk = base + pos;
+        uint64_t chunkSize = ReadLE32(chunk + 4);
+
+        if (memcmp(chunk, "ds64", 4) == 0) {
+            if (chunkSize < 24 || pos + 8 + 24 > size) return false;
+            rf64DataSize = ReadLE64(chunk + 16);
+        } else if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (pos + 8 + chunkSize > size || !ParseFormat(chunk + 8, chunkSize)) return false;
+            haveFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat) return false;
+            if (isRF64 && chunkSize == 0xFFFFFFFFu) {
+                chunkSize = rf64DataSize;
+            }
+            // Tolerate truncated files and streaming writers that never patched the size
+            uint64_t available = size - (pos + 8);
+            if (chunkSize > available || chunkSize == 0) {
+                chunkSize = available;
+            }
+            dataStart = chunk + 8;
+            numFrames = static_cast<size_t>(chunkSize / frameBytes);
+            return numFrames > 0;
+        }
+
+        // Chunks are word aligned
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    return false;
+}
+
+bool MappedAudioFile::ParseWave64(const uint8_t* base, size_t size) {
+    if (size < 40 || !IsW64Chunk(base + 24, "wave")) return false;
+
+    bool haveFormat = false;
+
+    // Wave64 chunk sizes include the 24-byte GUID + size header and are 8-byte aligned
+    size_t pos = 40;
+    while (pos + 24 <= size) {
+        const uint8_t* chunk = base + pos;
+        uint64_t chunkSize = ReadLE64(chunk + 16);
+        if (chunkSize < 24) return false;
+
+        if (IsW64Chunk(chunk, "fmt ")) {
+            if (pos + chunkSize > size || !ParseFormat(chunk + 24, chunkSize - 24)) return false;
+            haveFormat = true;
+        } else if (IsW64Chunk(chunk, "data")) {
+            if (!haveFormat) return false;
+            uint64_t dataSize = std::min<uint64_t>(chunkSize - 24, size - (pos + 24));
+            dataStart = chunk + 24;
+            numFrames = static_cast<size_t>(dataSize / frameBytes);
+            return numFrames > 0;
+        }
+
+        pos += (chunkSize + 7) & ~static_cast<uint64_t>(7);
+    }
+
+    return false;
+}
+
+MappedAudioFile::ChannelView MappedAudioFile::GetChannel(int channel) const {
+    ChannelView view;
+    if (!IsOpen() || channel < 0 || channel >= numChannels) return view;
+
+    view.data = dataStart + channel * bytesPerSample;
+    view.stride = frameBytes;
+    view.numFrames = numFrames;
+    view.format = format;
+    return view;
+}
+
+void MappedAudioFile::ReadFrames(size_t start, size_t count, float* const* dst) const {
+    if (!IsOpen() || start >= numFrames) return;
+    count = std::min(count, numFrames - start);
+
+    // Convert block by block so the mapped pages are faulted in just ahead
+    // of the vectorized deinterleave
+    std::vector<float*> blockDst(numChannels);
+    for (size_t offset = 0; offset < count; offset += BLOCK_FRAMES) {
+        size_t blockFrames = std::min(BLOCK_FRAMES, count - offset);
+        for (int ch = 0; ch < numChannels; ++ch) {
+            blockDst[ch] = dst[ch] + offset;
+        }
+        SampleConvert::Deinterleave(dataStart + (start + offset) * frameBytes, format,
+                                    blockDst.data(), numChannels, blockFrames);
+    }
+}
+
+void MappedAudioFile::ReleaseFrames(size_t start, size_t count) const {
+#if !defined(_WIN32)
+    if (!IsOpen() || start >= numFrames) return;
+    count = std::min(count, numFrames - start);
+
+    // madvise wants page-aligned ranges; only drop pages fully inside the range
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(dataStart + start * frameBytes);
+    uintptr_t end = reinterpret_cast<uintptr_t>(dataStart + (start + count) * frameBytes);
+    begin = (begin + pageSize - 1) & ~(pageSize - 1);
+    end &= ~(pageSize - 1);
+    if (end > begin) {
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+    }
+#else
+    (void)start;
+    (void)count;
+#endif
+}
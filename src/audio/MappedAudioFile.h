@@ -0,0 +1,71 @@
+#pragma once
+
+#include "SampleConvert.h"
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of an uncompressed WAV, RF64 or Sony Wave64 file.
+// Sample data stays in the page cache; frames are converted to float in
+// blocks only when a caller asks for them.
+class MappedAudioFile {
+public:
+    using SampleFormat = SampleConvert::Format;
+
+    // Strided view of one channel inside the mapped data chunk
+    struct ChannelView {
+        const uint8_t* data = nullptr;  // First sample of this channel
+        size_t stride = 0;              // Bytes between consecutive frames
+        size_t numFrames = 0;
+        SampleFormat format = SampleFormat::PCM16;
+
+        // Convert frames [start, start + count) to float
+        void Read(size_t start, size_t count, float* dst) const;
+    };
+
+    // Frames converted per block when reading
+    static constexpr size_t BLOCK_FRAMES = 4096;
+
+    MappedAudioFile();
+    ~MappedAudioFile();
+
+    MappedAudioFile(const MappedAudioFile&) = delete;
+    MappedAudioFile& operator=(const MappedAudioFile&) = delete;
+
+    // Map the file; returns false for anything that is not uncompressed
+    // PCM16/24/32 or float32 WAV/RF64/W64 so callers can fall back to libsndfile
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return mapping != nullptr; }
+
+    int GetSampleRate() const { return sampleRate; }
+    int GetNumChannels() const { return numChannels; }
+    size_t GetNumFrames() const { return numFrames; }
+    SampleFormat GetSampleFormat() const { return format; }
+
+    ChannelView GetChannel(int channel) const;
+
+    // Convert frames [start, start + count) of every channel into planar buffers
+    void ReadFrames(size_t start, size_t count, float* const* dst) const;
+
+    // Tell the kernel the given frame range will not be read again
+    void ReleaseFrames(size_t start, size_t count) const;
+
+private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+
+    const uint8_t* dataStart = nullptr;
+    size_t frameBytes = 0;
+    size_t bytesPerSample = 0;
+
+    int sampleRate = 0;
+    int numChannels = 0;
+    size_t numFrames = 0;
+    SampleFormat format = SampleFormat::PCM16;
+
+    // Header parsers; fill in the fields above from the mapped bytes
+    bool ParseRiff(const uint8_t* base, size_t size);
+    bool ParseWave64(const uint8_t* base, size_t size);
+    bool ParseFormat(const uint8_t* fmt, size_t size);
+};
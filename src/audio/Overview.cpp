@@ -0,0 +1,229 @@
+#include "Overview.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Level 0 caps; each level above holds half as many entries
+constexpr size_t MAX_BUCKETS = 1 << 20;
+constexpr size_t MAX_COLUMNS = 1 << 16;
+
+// Finest waveform detail kept; closer zooms show whole buckets
+constexpr size_t MIN_SAMPLES_PER_BUCKET = 16;
+
+// Samples summarized per lock in AddSamples, so a reader never waits long
+constexpr size_t SAMPLE_CHUNK = 1 << 18;
+
+size_t CeilDiv(size_t a, size_t b) {
+    return (a + b - 1) / b;
+}
+
+template <typename T>
+void BuildLevels(std::vector<std::vector<T>>& levels, size_t entries, size_t entrySize, T value) {
+    levels.clear();
+    if (entries == 0) return;
+    while (true) {
+        levels.emplace_back(entries * entrySize, value);
+        if (entries == 1) break;
+        entries = CeilDiv(entries, 2);
+    }
+}
+
+// Coarsest level whose entries are no longer than `seconds`
+int LevelFor(double entrySeconds, double seconds, size_t numLevels) {
+    int level = 0;
+    while (level + 1 < static_cast<int>(numLevels) && entrySeconds * 2.0 <= seconds) {
+        entrySeconds *= 2.0;
+        ++level;
+    }
+    return level;
+}
+
+// Entries of a level covering [t0, t1), clamped to the level; false if none
+bool EntryRange(double t0, double t1, double entrySeconds, size_t numEntries, size_t& first, size_t& last) {
+    if (numEntries == 0 || t1 <= 0.0 || entrySeconds <= 0.0) return false;
+    const double begin = std::max(0.0, t0 / entrySeconds);
+    const double end = t1 / entrySeconds;
+    if (begin >= static_cast<double>(numEntries)) return false;
+    first = static_cast<size_t>(begin);
+    last = std::min(numEntries - 1, std::max(first, static_cast<size_t>(std::ceil(end)) - 1));
+    return true;
+}
+
+int8_t Quantize(float sample) {
+    const float scaled = std::round(std::clamp(sample, -1.0f, 1.0f) * 127.0f);
+    return static_cast<int8_t>(scaled);
+}
+
+Overview::Bucket Merge(Overview::Bucket a, Overview::Bucket b) {
+    return {std::min(a.min, b.min), std::max(a.max, b.max)};
+}
+
+} // namespace
+
+void Overview::Reset(int rate, size_t samples, int numFrames, int fft, int hop) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sampleRate = rate;
+    numSamples = samples;
+    // A Hann window halves the FFT's gain, and a sine splits between +-f
+    fullScale = static_cast<float>(fft) / 4.0f;
+    frameSeconds = rate > 0 ? static_cast<double>(hop) / rate : 0.0;
+    frameOffsetSeconds = rate > 0 ? 0.5 * (fft - hop) / rate : 0.0;
+
+    samplesPerBucket = std::max(MIN_SAMPLES_PER_BUCKET, CeilDiv(samples, MAX_BUCKETS));
+    BuildLevels(waveform, CeilDiv(samples, samplesPerBucket), 1, Bucket());
+
+    const size_t frames = static_cast<size_t>(std::max(numFrames, 0));
+    framesPerColumn = static_cast<int>(std::max<size_t>(1, CeilDiv(frames, MAX_COLUMNS)));
+    BuildLevels(spectrum, CeilDiv(frames, framesPerColumn), SPECTRUM_ROWS, uint8_t(0));
+}
+
+void Overview::AddSamples(const float* samples, size_t start, size_t count) {
+    std::vector<Bucket> local;
+    size_t spb;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        spb = samplesPerBucket;
+        count = start < numSamples ? std::min(count, numSamples - start) : 0;
+    }
+
+    // Summarize outside the lock, then merge a chunk at a time
+    for (size_t offset = 0; offset < count; offset += SAMPLE_CHUNK) {
+        const size_t begin = start + offset;
+        const size_t end = start + std::min(count, offset + SAMPLE_CHUNK);
+        const size_t firstBucket = begin / spb;
+        local.assign((end - 1) / spb - firstBucket + 1, Bucket());
+        for (size_t i = begin; i < end; ++i) {
+            Bucket& bucket = local[i / spb - firstBucket];
+            const int8_t value = Quantize(samples[i - start]);
+            bucket.min = std::min(bucket.min, value);
+            bucket.max = std::max(bucket.max, value);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (waveform.empty() || samplesPerBucket != spb || firstBucket + local.size() > waveform[0].size()) {
+            return;  // Reset meanwhile
+        }
+        for (size_t i = 0; i < local.size(); ++i) {
+            Bucket& bucket = waveform[0][firstBucket + i];
+            bucket = Merge(bucket, local[i]);
+        }
+        PropagateWaveform(firstBucket, firstBucket + local.size() - 1);
+    }
+}
+
+void Overview::AddFrame(int frame, const float* magnitudeA, const float* magnitudeB, size_t numBins) {
+    if (numBins == 0 || frame < 0) return;
+
+    // Loudest bin in each row, then one log per row
+    float rowPower[SPECTRUM_ROWS] = {};
+    for (size_t bin = 0; bin < numBins; ++bin) {
+        const size_t row = bin * SPECTRUM_ROWS / numBins;
+        const float power = magnitudeA[bin] * magnitudeA[bin] + magnitudeB[bin] * magnitudeB[bin];
+        rowPower[row] = std::max(rowPower[row], power);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const size_t column = static_cast<size_t>(frame) / framesPerColumn;
+    if (spectrum.empty() || column * SPECTRUM_ROWS >= spectrum[0].size()) return;
+
+    uint8_t* values = &spectrum[0][column * SPECTRUM_ROWS];
+    const float referencePower = fullScale * fullScale;
+    for (int row = 0; row < SPECTRUM_ROWS; ++row) {
+        if (rowPower[row] <= 0.0f) continue;
+        const float db = 10.0f * std::log10(rowPower[row] / referencePower);
+        if (db < FLOOR_DB) continue;
+        const float scaled = 1.0f + 254.0f * std::min(1.0f, 1.0f - db / FLOOR_DB);
+        values[row] = std::max(values[row], static_cast<uint8_t>(scaled));
+    }
+    PropagateSpectrum(column);
+}
+
+double Overview::DurationSeconds() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sampleRate > 0 ? static_cast<double>(numSamples) / sampleRate : 0.0;
+}
+
+int Overview::SampleRate() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sampleRate;
+}
+
+bool Overview::ReadWaveform(double startSeconds, double secondsPerColumn, int numColumns,
+                            std::vector<Bucket>& columns) const {
+    columns.assign(std::max(numColumns, 0), Bucket());
+    std::lock_guard<std::mutex> lock(mutex);
+    if (waveform.empty() || sampleRate <= 0) return false;
+
+    const double bucketSeconds = static_cast<double>(samplesPerBucket) / sampleRate;
+    const int level = LevelFor(bucketSeconds, secondsPerColumn, waveform.size());
+    const std::vector<Bucket>& buckets = waveform[level];
+    const double entrySeconds = bucketSeconds * (size_t(1) << level);
+    for (int i = 0; i < numColumns; ++i) {
+        const double t0 = startSeconds + i * secondsPerColumn;
+        size_t first, last;
+        if (!EntryRange(t0, t0 + secondsPerColumn, entrySeconds, buckets.size(), first, last)) continue;
+        for (size_t b = first; b <= last; ++b) columns[i] = Merge(columns[i], buckets[b]);
+    }
+    return true;
+}
+
+bool Overview::ReadSpectrum(double startSeconds, double secondsPerColumn, int numColumns,
+                            std::vector<uint8_t>& columns) const {
+    columns.assign(static_cast<size_t>(std::max(numColumns, 0)) * SPECTRUM_ROWS, 0);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (spectrum.empty()) return false;
+
+    const double columnSeconds = frameSeconds * framesPerColumn;
+    const int level = LevelFor(columnSeconds, secondsPerColumn, spectrum.size());
+    const std::vector<uint8_t>& values = spectrum[level];
+    const size_t numEntries = values.size() / SPECTRUM_ROWS;
+    const double entrySeconds = columnSeconds * (size_t(1) << level);
+    for (int i = 0; i < numColumns; ++i) {
+        const double t0 = startSeconds + i * secondsPerColumn - frameOffsetSeconds;
+        size_t first, last;
+        if (!EntryRange(t0, t0 + secondsPerColumn, entrySeconds, numEntries, first, last)) continue;
+        uint8_t* out = &columns[static_cast<size_t>(i) * SPECTRUM_ROWS];
+        for (size_t c = first; c <= last; ++c) {
+            const uint8_t* in = &values[c * SPECTRUM_ROWS];
+            for (int row = 0; row < SPECTRUM_ROWS; ++row) out[row] = std::max(out[row], in[row]);
+        }
+    }
+    return true;
+}
+
+uint64_t Overview::Bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t bytes = 0;
+    for (const auto& level : waveform) bytes += level.size() * sizeof(Bucket);
+    for (const auto& level : spectrum) bytes += level.size();
+    return bytes;
+}
+
+void Overview::PropagateWaveform(size_t first, size_t last) {
+    for (size_t level = 1; level < waveform.size(); ++level) {
+        const std::vector<Bucket>& below = waveform[level - 1];
+        first /= 2;
+        last /= 2;
+        for (size_t b = first; b <= last; ++b) {
+            Bucket merged = below[2 * b];
+            if (2 * b + 1 < below.size()) merged = Merge(merged, below[2 * b + 1]);
+            waveform[level][b] = merged;
+        }
+    }
+}
+
+void Overview::PropagateSpectrum(size_t column) {
+    for (size_t level = 1; level < spectrum.size(); ++level) {
+        const std::vector<uint8_t>& below = spectrum[level - 1];
+        const size_t belowColumns = below.size() / SPECTRUM_ROWS;
+        column /= 2;
+        uint8_t* out = &spectrum[level][column * SPECTRUM_ROWS];
+        const uint8_t* left = &below[2 * column * SPECTRUM_ROWS];
+        for (int row = 0; row < SPECTRUM_ROWS; ++row) out[row] = left[row];
+        if (2 * column + 1 < belowColumns) {
+            const uint8_t* right = left + SPECTRUM_ROWS;
+            for (int row = 0; row < SPECTRUM_ROWS; ++row) out[row] = std::max(out[row], right[row]);
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Zoomable overview of one signal for display: a min/max waveform and a
+// log-magnitude spectrogram, each kept as a pyramid of levels that halve the
+// time resolution of the one below. Level 0 is capped in size, so memory
+// stays bounded however long the file is (about 20 MiB at most), and any
+// zoom is drawn from the level closest to one column per pixel, so reading
+// a view costs the same at every zoom.
+//
+// Producers fill it in while the UI reads it, so every call takes a short
+// lock. Samples and frames may arrive in any order and from several threads;
+// each one merges into its column and the columns above it. Parts not filled
+// in yet read as silence.
+class Overview {
+public:
+    // Frequency rows of the spectrogram, 0 Hz to Nyquist, linearly spaced
+    static constexpr int SPECTRUM_ROWS = 128;
+
+    // Spectrogram values: 0 is silence or not yet filled, 1..255 maps
+    // FLOOR_DB..0 dBFS
+    static constexpr float FLOOR_DB = -120.0f;
+
+    // Peak range of a stretch of samples, scaled to +-127. An empty bucket
+    // has min > max.
+    struct Bucket {
+        int8_t min = 127;
+        int8_t max = -127;
+    };
+
+    // Clear and size for `numSamples` at `sampleRate`, analysed as
+    // `numFrames` STFT frames of `fftSize` every `hopSize` samples
+    void Reset(int sampleRate, size_t numSamples, int numFrames, int fftSize, int hopSize);
+
+    // Merge samples [start, start + count) into the waveform
+    void AddSamples(const float* samples, size_t start, size_t count);
+
+    // Merge one STFT frame into the spectrogram. Two magnitude spectra, such
+    // as mid and side, are combined by power.
+    void AddFrame(int frame, const float* magnitudeA, const float* magnitudeB, size_t numBins);
+
+    double DurationSeconds() const;
+    int SampleRate() const;
+
+    // The view [startSeconds, startSeconds + numColumns * secondsPerColumn)
+    // as one bucket per column. Returns false if nothing was sized yet.
+    bool ReadWaveform(double startSeconds, double secondsPerColumn, int numColumns,
+                      std::vector<Bucket>& columns) const;
+
+    // The same view of the spectrogram, SPECTRUM_ROWS values per column
+    // (lowest frequency first)
+    bool ReadSpectrum(double startSeconds, double secondsPerColumn, int numColumns,
+                      std::vector<uint8_t>& columns) const;
+
+    // Bytes held by both pyramids
+    uint64_t Bytes() const;
+
+private:
+    mutable std::mutex mutex;
+    int sampleRate = 0;
+    size_t numSamples = 0;
+    float fullScale = 1.0f;        // Magnitude of a full-scale sine
+    size_t samplesPerBucket = 1;   // At waveform level 0
+    int framesPerColumn = 1;       // At spectrum level 0
+    double frameSeconds = 0.0;     // STFT hop
+    double frameOffsetSeconds = 0.0;  // From a frame's start to the stretch it represents
+    std::vector<std::vector<Bucket>> waveform;     // [level][bucket]
+    std::vector<std::vector<uint8_t>> spectrum;    // [level][column * SPECTRUM_ROWS + row]
+
+    // Recompute level > 0 entries above level-0 entries [first, last]
+    void PropagateWaveform(size_t first, size_t last);
+    void PropagateSpectrum(size_t column);
+};
@@ -1,49 +1,233 @@
 #include "Resampler.h"
+#include "MappedAudioFile.h"
+#include "../dsp/Kernels.h"
+#include "../util/CancellationToken.h"
+#include "../util/TaskScheduler.h"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 
-std::vector<float> Resampler::Resample(const std::vector<float>& input, 
-                                       int inputSampleRate, 
-                                       int outputSampleRate) {
-    if (inputSampleRate == outputSampleRate) {
-        return input;
-    }
+namespace {
+
+// Output samples between cancellation checks, and per parallel block
+constexpr size_t CANCEL_CHECK_INTERVAL = 65536;
+
+// Where the outputs for input samples [inputStart, inputStart + inputSize)
+// of a longer signal fall
+struct Span {
+    double ratio = 1.0;
+    size_t outputStart = 0;  // Index of the first output in the whole signal
+    size_t outputSize = 0;
+    size_t interiorEnd = 0;  // Outputs before this have a source sample on both sides
+};
+
+Span PlanSpan(size_t inputStart, size_t inputSize, int inputSampleRate, int outputSampleRate) {
+    Span span;
+    span.ratio = static_cast<double>(outputSampleRate) / inputSampleRate;
     
-    double ratio = static_cast<double>(outputSampleRate) / inputSampleRate;
-    size_t outputSize = static_cast<size_t>(input.size() * ratio);
-    std::vector<float> output(outputSize);
+    // Outputs are numbered as in the whole signal: the first one is the
+    // first whose position falls on or after inputStart
+    span.outputStart = static_cast<size_t>(std::ceil(inputStart * span.ratio));
+    while (static_cast<size_t>(span.outputStart / span.ratio) < inputStart) {
+        ++span.outputStart;
+    }
+    const size_t outputEnd = static_cast<size_t>((inputStart + inputSize) * span.ratio);
+    span.outputSize = outputEnd > span.outputStart ? outputEnd - span.outputStart : 0;
     
-    // Simple linear interpolation
-    for (size_t i = 0; i < outputSize; ++i) {
-        double srcIndex = i / ratio;
+    span.interiorEnd = span.outputSize;
+    while (span.interiorEnd > 0 &&
+           static_cast<size_t>((span.outputStart + span.interiorEnd - 1) / span.ratio) + 1 >= inputStart + inputSize) {
+        --span.interiorEnd;
+    }
+    return span;
+}
+
+// Input sample at or before output `position`, as the kernels compute it
+size_t SourceIndex(size_t position, double ratio) {
+    return static_cast<size_t>(static_cast<double>(position) / ratio);
+}
+
+// The outputs from `span.interiorEnd` on, at or past the final input
+// sample. `input` holds input samples from `first` to the end.
+void ResampleTail(const Span& span, const float* input, size_t first, size_t inputStart, size_t inputSize,
+                  float* output) {
+    for (size_t i = span.interiorEnd; i < span.outputSize; ++i) {
+        double srcIndex = (span.outputStart + i) / span.ratio;
         size_t srcIdx = static_cast<size_t>(srcIndex);
         double fraction = srcIndex - srcIdx;
+        const size_t local = srcIdx - first;
+        srcIdx -= inputStart;
         
-        if (srcIdx < input.size() - 1) {
+        if (srcIdx < inputSize - 1) {
             // Linear interpolation between two samples
-            output[i] = input[srcIdx] * (1.0 - fraction) + input[srcIdx + 1] * fraction;
-        } else if (srcIdx < input.size()) {
+            output[i] = input[local] * (1.0 - fraction) + input[local + 1] * fraction;
+        } else if (srcIdx < inputSize) {
             // Last sample
-            output[i] = input[srcIdx];
+            output[i] = input[local];
         } else {
             // Beyond input range (shouldn't happen)
             output[i] = 0.0f;
         }
     }
-    
+}
+
+} // namespace
+
+std::vector<float> Resampler::Resample(const std::vector<float>& input, 
+                                       int inputSampleRate, 
+                                       int outputSampleRate,
+                                       const CancellationToken* cancel,
+                                       size_t inputStart) {
+    std::vector<float> output;
+    if (!Resample(input, inputSampleRate, outputSampleRate, output, cancel, inputStart)) {
+        return {};
+    }
     return output;
 }
 
 std::vector<std::vector<float>> Resampler::ResampleMultiChannel(
     const std::vector<std::vector<float>>& channels,
     int inputSampleRate,
-    int outputSampleRate) {
+    int outputSampleRate,
+    const CancellationToken* cancel,
+    size_t inputStart) {
     
     std::vector<std::vector<float>> output;
-    output.reserve(channels.size());
+    if (!ResampleMultiChannel(channels, inputSampleRate, outputSampleRate, output, cancel, inputStart)) {
+        return {};
+    }
+    return output;
+}
+
+bool Resampler::Resample(const std::vector<float>& input,
+                         int inputSampleRate,
+                         int outputSampleRate,
+                         std::vector<float>& output,
+                         const CancellationToken* cancel,
+                         size_t inputStart) {
+    if (inputSampleRate == outputSampleRate) {
+        output = input;
+        return true;
+    }
+    
+    const Span span = PlanSpan(inputStart, input.size(), inputSampleRate, outputSampleRate);
+    output.resize(span.outputSize);
+    
+    // Simple linear interpolation. Every output before `interiorEnd` has a
+    // source sample on both sides and goes through the vector kernel.
+    // Blocks are independent, so they run in parallel
+    const size_t numBlocks = (span.interiorEnd + CANCEL_CHECK_INTERVAL - 1) / CANCEL_CHECK_INTERVAL;
+    std::atomic<bool> cancelled{false};
+    ParallelFor(0, numBlocks, 1, [&](size_t firstBlock, size_t lastBlock) {
+        for (size_t block = firstBlock; block < lastBlock; ++block) {
+            if (CancellationToken::IsCancelled(cancel)) {
+                cancelled = true;
+                return;
+            }
+            const size_t begin = block * CANCEL_CHECK_INTERVAL;
+            const size_t count = std::min(CANCEL_CHECK_INTERVAL, span.interiorEnd - begin);
+            Kernels::ResampleLinear(input.data(), inputStart, input.size(), span.ratio, span.outputStart + begin,
+                                    output.data() + begin, count);
+        }
+    });
+    if (cancelled) {
+        return false;
+    }
+    
+    ResampleTail(span, input.data(), inputStart, inputStart, input.size(), output.data());
+    return true;
+}
+
+bool Resampler::ResampleMultiChannel(const std::vector<std::vector<float>>& channels,
+                                     int inputSampleRate,
+                                     int outputSampleRate,
+                                     std::vector<std::vector<float>>& output,
+                                     const CancellationToken* cancel,
+                                     size_t inputStart) {
+    // One task per channel; each splits into blocks of its own
+    output.resize(channels.size());
+    TaskGroup group;
+    for (size_t ch = 1; ch < channels.size(); ++ch) {
+        group.Run([&, ch]() {
+            Resample(channels[ch], inputSampleRate, outputSampleRate, output[ch], cancel, inputStart);
+        });
+    }
+    if (!channels.empty()) {
+        Resample(channels[0], inputSampleRate, outputSampleRate, output[0], cancel, inputStart);
+    }
+    group.Wait();
+    return !CancellationToken::IsCancelled(cancel);
+}
+
+std::vector<std::vector<float>> Resampler::ResampleMultiChannel(
+    const MappedAudioFile& source,
+    size_t inputStart,
+    size_t inputSize,
+    int outputSampleRate,
+    const CancellationToken* cancel) {
+    
+    const int numChannels = source.GetNumChannels();
+    const int inputSampleRate = source.GetSampleRate();
+    inputStart = std::min(inputStart, source.GetNumFrames());
+    inputSize = std::min(inputSize, source.GetNumFrames() - inputStart);
+    std::vector<std::vector<float>> output(numChannels);
+    
+    if (inputSampleRate == outputSampleRate) {
+        std::vector<float*> dst(numChannels);
+        for (int ch = 0; ch < numChannels; ++ch) {
+            output[ch].resize(inputSize);
+            dst[ch] = output[ch].data();
+        }
+        source.ReadFrames(inputStart, inputSize, dst.data());
+        return output;
+    }
+    
+    const Span span = PlanSpan(inputStart, inputSize, inputSampleRate, outputSampleRate);
+    for (auto& channel : output) channel.resize(span.outputSize);
+    
+    // Each block converts just the input it interpolates from, every
+    // channel in one pass over the mapped frames, and resamples it from
+    // there; the input is never converted whole
+    const size_t numBlocks = (span.interiorEnd + CANCEL_CHECK_INTERVAL - 1) / CANCEL_CHECK_INTERVAL;
+    std::atomic<bool> cancelled{false};
+    ParallelFor(0, numBlocks, 1, [&](size_t firstBlock, size_t lastBlock) {
+        std::vector<std::vector<float>> converted(numChannels);
+        std::vector<float*> dst(numChannels);
+        for (size_t block = firstBlock; block < lastBlock; ++block) {
+            if (CancellationToken::IsCancelled(cancel)) {
+                cancelled = true;
+                return;
+            }
+            const size_t begin = block * CANCEL_CHECK_INTERVAL;
+            const size_t count = std::min(CANCEL_CHECK_INTERVAL, span.interiorEnd - begin);
+            const size_t first = SourceIndex(span.outputStart + begin, span.ratio);
+            const size_t frames = SourceIndex(span.outputStart + begin + count - 1, span.ratio) + 2 - first;
+            for (int ch = 0; ch < numChannels; ++ch) {
+                converted[ch].resize(frames);
+                dst[ch] = converted[ch].data();
+            }
+            source.ReadFrames(first, frames, dst.data());
+            for (int ch = 0; ch < numChannels; ++ch) {
+                Kernels::ResampleLinear(converted[ch].data(), first, frames, span.ratio, span.outputStart + begin,
+                                        output[ch].data() + begin, count);
+            }
+        }
+    });
+    if (cancelled) {
+        return {};
+    }
     
-    for (const auto& channel : channels) {
-        output.push_back(Resample(channel, inputSampleRate, outputSampleRate));
+    // The few outputs at the end read from the last interpolated sample on
+    const size_t inputEnd = inputStart + inputSize;
+    const size_t tailFirst = span.interiorEnd < span.outputSize
+        ? std::min(SourceIndex(span.outputStart + span.interiorEnd, span.ratio), inputEnd) : inputEnd;
+    std::vector<std::vector<float>> tail(numChannels, std::vector<float>(inputEnd - tailFirst));
+    std::vector<float*> dst(numChannels);
+    for (int ch = 0; ch < numChannels; ++ch) dst[ch] = tail[ch].data();
+    source.ReadFrames(tailFirst, inputEnd - tailFirst, dst.data());
+    for (int ch = 0; ch < numChannels; ++ch) {
+        ResampleTail(span, tail[ch].data(), tailFirst, inputStart, inputSize, output[ch].data());
     }
     
     return output;
-}
\ No newline at end of file
+}
@@ -1,20 +1,60 @@
 #ifndef RESAMPLER_H
 #define RESAMPLER_H
 
+#include <cstddef>
 #include <vector>
 
+class CancellationToken;
+class MappedAudioFile;
+
 class Resampler {
 public:
-    // Simple linear interpolation resampler
+    // Simple linear interpolation resampler. Returns an empty vector if
+    // `cancel` fires part way through.
+    //
+    // `input` may be an excerpt of a longer signal starting at its sample
+    // `inputStart`. Outputs are then interpolated at the same positions as
+    // for the whole signal, so they match its output bit for bit, except
+    // the last few, which lack the input samples after the excerpt.
     static std::vector<float> Resample(const std::vector<float>& input, 
                                       int inputSampleRate, 
-                                      int outputSampleRate);
+                                      int outputSampleRate,
+                                      const CancellationToken* cancel = nullptr,
+                                      size_t inputStart = 0);
     
     // Resample multiple channels
     static std::vector<std::vector<float>> ResampleMultiChannel(
         const std::vector<std::vector<float>>& channels,
         int inputSampleRate,
-        int outputSampleRate);
+        int outputSampleRate,
+        const CancellationToken* cancel = nullptr,
+        size_t inputStart = 0);
+    
+    // The same into `output`, reusing its storage from an earlier call.
+    // False if `cancel` fired, leaving `output` incomplete.
+    static bool Resample(const std::vector<float>& input,
+                         int inputSampleRate,
+                         int outputSampleRate,
+                         std::vector<float>& output,
+                         const CancellationToken* cancel = nullptr,
+                         size_t inputStart = 0);
+    static bool ResampleMultiChannel(const std::vector<std::vector<float>>& channels,
+                                     int inputSampleRate,
+                                     int outputSampleRate,
+                                     std::vector<std::vector<float>>& output,
+                                     const CancellationToken* cancel = nullptr,
+                                     size_t inputStart = 0);
+    
+    // Resample frames [inputStart, inputStart + inputSize) of a mapped file,
+    // converting only the frames each output block interpolates from as it
+    // goes. Same output as converting those frames first and resampling
+    // them with ResampleMultiChannel.
+    static std::vector<std::vector<float>> ResampleMultiChannel(
+        const MappedAudioFile& source,
+        size_t inputStart,
+        size_t inputSize,
+        int outputSampleRate,
+        const CancellationToken* cancel = nullptr);
 };
 
 #endif // RESAMPLER_H
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "SampleConvert.h"
+#include "../dsp/Kernels.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Frames per tile: conversion and channel shuffling both run on a tile while
+// it is still in L1, so the source is read from memory only once
+constexpr size_t TILE_FRAMES = 256;
+constexpr int MAX_TILE_CHANNELS = 8;
+
+} // namespace
+
+SampleConvert::DitherState::DitherState(Dither mode, int bits, uint32_t seed)
+    : mode(mode), bits(std::min(std::max(bits, 8), 24)) {
+    // xorshift32 must never be seeded with zero
+    for (int lane = 0; lane < 4; ++lane) {
+        uint32_t s = seed + 0x6D2B79F5u * (lane + 1);
+        rng[lane] = s != 0 ? s : 0x1234567u;
+    }
+}
+
+size_t SampleConvert::BytesPerSample(Format format) {
+    switch (format) {
+        case Format::PCM16: return 2;
+        case Format::PCM24: return 3;
+        case Format::PCM32: return 4;
+        case Format::Float32: return 4;
+    }
+    return 4;
+}
+
+void SampleConvert::ToFloat(const void* src, Format format, float* dst, size_t count) {
+    switch (format) {
+        case Format::PCM16: Kernels::Int16ToFloat(static_cast<const int16_t*>(src), dst, count); break;
+        case Format::PCM24: Kernels::Int24ToFloat(static_cast<const uint8_t*>(src), dst, count); break;
+        case Format::PCM32: Kernels::Int32ToFloat(static_cast<const int32_t*>(src), dst, count); break;
+        case Format::Float32: memcpy(dst, src, count * sizeof(float)); break;
+    }
+}
+
+void SampleConvert::FromFloat(const float* src, void* dst, Format format, size_t count) {
+    switch (format) {
+        case Format::PCM16: Kernels::FloatToInt16(src, static_cast<int16_t*>(dst), count); break;
+        case Format::PCM24: Kernels::FloatToInt24(src, static_cast<uint8_t*>(dst), count); break;
+        case Format::PCM32: Kernels::FloatToInt32(src, static_cast<int32_t*>(dst), count); break;
+        case Format::Float32: memcpy(dst, src, count * sizeof(float)); break;
+    }
+}
+
+void SampleConvert::Deinterleave(const void* src,
+                                 Format format,
+                                 float* const* dst,
+                                 int numChannels,
+                                 size_t numFrames) {
+    if (numChannels <= 0 || numFrames == 0) return;
+
+    if (format == Format::Float32) {
+        Kernels::Deinterleave(static_cast<const float*>(src), dst, numChannels, numFrames);
+        return;
+    }
+
+    // Integer input: convert a tile to float, then shuffle it out to the channels
+    if (numChannels > MAX_TILE_CHANNELS) {
+        // Rare layouts; convert per channel through the strided scalar path
+        const uint8_t* bytes = static_cast<const uint8_t*>(src);
+        const size_t sampleBytes = BytesPerSample(format);
+        float sample;
+        for (size_t i = 0; i < numFrames; ++i) {
+            for (int ch = 0; ch < numChannels; ++ch) {
+                ToFloat(bytes + (i * numChannels + ch) * sampleBytes, format, &sample, 1);
+                dst[ch][i] = sample;
+            }
+        }
+        return;
+    }
+
+    alignas(16) float tile[TILE_FRAMES * MAX_TILE_CHANNELS];
+    float* tileDst[MAX_TILE_CHANNELS];
+    const uint8_t* bytes = static_cast<const uint8_t*>(src);
+    const size_t frameBytes = BytesPerSample(format) * numChannels;
+
+    for (size_t start = 0; start < numFrames; start += TILE_FRAMES) {
+        size_t count = std::min(TILE_FRAMES, numFrames - start);
+        ToFloat(bytes + start * frameBytes, format, tile, count * numChannels);
+        for (int ch = 0; ch < numChannels; ++ch) {
+            tileDst[ch] = dst[ch] + start;
+        }
+        Kernels::Deinterleave(tile, tileDst, numChannels, count);
+    }
+}
+
+void SampleConvert::Interleave(const float* const* src,
+                               void* dst,
+                               Format format,
+                               int numChannels,
+                               size_t numFrames) {
+    if (numChannels <= 0 || numFrames == 0) return;
+
+    if (format == Format::Float32) {
+        Kernels::Interleave(src, static_cast<float*>(dst), numChannels, numFrames);
+        return;
+    }
+
+    uint8_t* bytes = static_cast<uint8_t*>(dst);
+    const size_t sampleBytes = BytesPerSample(format);
+
+    if (numChannels > MAX_TILE_CHANNELS) {
+        for (size_t i = 0; i < numFrames; ++i) {
+            for (int ch = 0; ch < numChannels; ++ch) {
+                FromFloat(&src[ch][i], bytes + (i * numChannels + ch) * sampleBytes, format, 1);
+            }
+        }
+        return;
+    }
+
+    alignas(16) float tile[TILE_FRAMES * MAX_TILE_CHANNELS];
+    const float* tileSrc[MAX_TILE_CHANNELS];
+    const size_t frameBytes = sampleBytes * numChannels;
+
+    for (size_t start = 0; start < numFrames; start += TILE_FRAMES) {
+        size_t count = std::min(TILE_FRAMES, numFrames - start);
+        for (int ch = 0; ch < numChannels; ++ch) {
+            tileSrc[ch] = src[ch] + start;
+        }
+        Kernels::Interleave(tileSrc, tile, numChannels, count);
+        FromFloat(tile, bytes + start * frameBytes, format, count * numChannels);
+    }
+}
+
+void SampleConvert::InterleaveDithered(const float* const* src,
+                                       void* dst,
+                                       Format format,
+                                       int numChannels,
+                                       size_t numFrames,
+                                       DitherState& state) {
+    if (numChannels <= 0 || numFrames == 0) return;
+
+    if (state.error.size() != static_cast<size_t>(numChannels)) {
+        state.error.assign(numChannels, 0.0f);
+    }
+
+    uint8_t* bytes = static_cast<uint8_t*>(dst);
+    const size_t frameBytes = BytesPerSample(format) * numChannels;
+    const bool integer = format != Format::Float32;
+
+    // Layouts wider than a tile go one frame at a time through a scratch frame
+    const bool wide = numChannels > MAX_TILE_CHANNELS;
+    const size_t tileFrames = wide ? 1 : TILE_FRAMES;
+    alignas(16) float tile[TILE_FRAMES * MAX_TILE_CHANNELS];
+    std::vector<float> wideFrame(wide ? numChannels : 0);
+    float* tileData = wide ? wideFrame.data() : tile;
+    const float* tileSrc[MAX_TILE_CHANNELS];
+
+    for (size_t start = 0; start < numFrames; start += tileFrames) {
+        size_t count = std::min(tileFrames, numFrames - start);
+        size_t samples = count * numChannels;
+
+        if (wide) {
+            for (int ch = 0; ch < numChannels; ++ch) {
+                tileData[ch] = src[ch][start];
+            }
+        } else {
+            for (int ch = 0; ch < numChannels; ++ch) {
+                tileSrc[ch] = src[ch] + start;
+            }
+            Kernels::Interleave(tileSrc, tileData, numChannels, count);
+        }
+
+        Kernels::Sanitize(tileData, samples, state.nanCount, state.clipCount);
+        if (integer) {
+            if (state.mode == Dither::NoiseShaped) {
+                Kernels::NoiseShape(tileData, count, numChannels, state.bits, state.rng, state.error.data());
+            } else {
+                Kernels::Quantize(tileData, samples, state.bits, state.mode != Dither::None, state.rng);
+            }
+        }
+
+        FromFloat(tileData, bytes + start * frameBytes, format, samples);
+    }
+}
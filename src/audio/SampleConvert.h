@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Vectorized (de)interleave kernels fused with PCM <-> float conversion.
+// Channel counts 1, 2, 4, 6 and 8 get dedicated paths; anything else uses a
+// generic strided loop. The kernels are the dispatched ones in
+// dsp/Kernels.h, so they use the best instruction set the CPU has.
+class SampleConvert {
+public:
+    // Interleaved sample encodings; PCM24 is packed little-endian 3-byte samples
+    enum class Format {
+        PCM16,
+        PCM24,
+        PCM32,
+        Float32
+    };
+
+    // Dither applied when reducing float to integer PCM
+    enum class Dither {
+        None,
+        TPDF,         // Triangular PDF, +/-1 LSB
+        NoiseShaped   // TPDF plus first-order error feedback
+    };
+
+    // Quantizer state for one output stream; carried across blocks so the
+    // dither sequence and noise-shaping error stay continuous
+    struct DitherState {
+        Dither mode = Dither::TPDF;
+        int bits = 24;                // Word length the dither and rounding target
+        uint32_t rng[4];              // One xorshift32 generator per SIMD lane
+        std::vector<float> error;     // Noise-shaping feedback, one per channel
+
+        // Sample statistics gathered while converting
+        size_t nanCount = 0;
+        size_t clipCount = 0;
+
+        DitherState(Dither mode, int bits, uint32_t seed = 0x9E3779B9u);
+    };
+
+    static size_t BytesPerSample(Format format);
+
+    // Interleaved samples in `format` -> planar float in [-1, 1)
+    static void Deinterleave(const void* src,
+                             Format format,
+                             float* const* dst,
+                             int numChannels,
+                             size_t numFrames);
+
+    // Planar float -> interleaved samples in `format`. Integer formats are
+    // clamped to full scale and rounded to nearest.
+    static void Interleave(const float* const* src,
+                           void* dst,
+                           Format format,
+                           int numChannels,
+                           size_t numFrames);
+
+    // Planar float -> interleaved `format` for file output, in one tiled pass:
+    // NaNs are zeroed, samples clamped to [-1, 1], then dithered and rounded to
+    // `state.bits` for integer formats. Float32 output is only sanitized.
+    static void InterleaveDithered(const float* const* src,
+                                   void* dst,
+                                   Format format,
+                                   int numChannels,
+                                   size_t numFrames,
+                                   DitherState& state);
+
+    // Contiguous conversions used by the kernels above
+    static void ToFloat(const void* src, Format format, float* dst, size_t count);
+    static void FromFloat(const float* src, void* dst, Format format, size_t count);
+};
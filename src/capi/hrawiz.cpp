@@ -0,0 +1,336 @@
+#include "hrawiz.h"
+#include "../audio/AudioProcessor.h"
+#include "../dsp/Kernels.h"
+#include "../util/CancellationToken.h"
+#include "../util/Log.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <string>
+
+struct hraw_context {
+    AudioProcessor processor;
+    AudioProcessor::Options options;
+    CancellationToken cancel;
+    std::string error;
+
+    // Input staging and processing buffers, and the processor's resampler,
+    // mid/side and HFC buffers and FFT plans, kept between calls so a
+    // context reaches a steady size instead of allocating per call
+    AudioProcessor::AudioData audio;
+    AudioProcessor::Workspace workspace;
+};
+
+namespace {
+
+constexpr int MAX_MULTIPLIER = 16;
+
+// Where hraw_context_create reports, having no context to keep it in
+thread_local std::string createError;
+
+// A library shouldn't talk on stderr unless asked: warnings and errors
+// only, unless HRAW_LOG_LEVEL says otherwise
+void InitLogging() {
+    static const bool initialized = []() {
+        LogLevel level = LogLevel::Warn;
+        Log::ParseLevel(std::getenv("HRAW_LOG_LEVEL"), level);
+        Log::SetLevel(level);
+        return true;
+    }();
+    (void)initialized;
+}
+
+// Overlay the fields a caller built against an older header knows about
+// onto the defaults
+bool ReadSettings(const hraw_settings* in, hraw_settings& settings, std::string& error) {
+    hraw_default_settings(&settings);
+    if (!in) return true;
+    if (in->size < offsetof(hraw_settings, enable_hfc) + sizeof(in->enable_hfc)) {
+        error = "hraw_settings.size isn't set; initialize settings with hraw_default_settings";
+        return false;
+    }
+    std::memcpy(&settings, in, std::min<size_t>(in->size, sizeof(settings)));
+    settings.size = sizeof(settings);
+    return true;
+}
+
+bool ToOptions(const hraw_settings& settings, AudioProcessor::Options& options, std::string& error) {
+    if (settings.lowpass_hz <= 0) {
+        error = "lowpass_hz must be positive";
+        return false;
+    }
+    if (settings.rate_multiplier < 1 || settings.rate_multiplier > MAX_MULTIPLIER) {
+        error = "rate_multiplier must be between 1 and 16";
+        return false;
+    }
+
+    options = AudioProcessor::Options();
+    options.enableHFC = settings.enable_hfc != 0;
+    options.lowpassFreq = settings.lowpass_hz;
+    options.sampleRateMultiplier = settings.rate_multiplier;
+    options.seed = settings.seed;
+
+    switch (settings.engine) {
+    case HRAW_ENGINE_HARMONIC: options.engine = HFCompensation::Engine::Harmonic; break;
+    case HRAW_ENGINE_BAND_REPLICATION: options.engine = HFCompensation::Engine::BandReplication; break;
+    default:
+        error = "Unknown engine " + std::to_string(settings.engine);
+        return false;
+    }
+
+    OutputFormat& format = options.outputFormat;
+    switch (settings.file_format) {
+    case HRAW_FORMAT_WAV_FLOAT: format.container = OutputFormat::Container::WAV; format.bitDepth = 32; break;
+    case HRAW_FORMAT_WAV_16: format.container = OutputFormat::Container::WAV; format.bitDepth = 16; break;
+    case HRAW_FORMAT_WAV_24: format.container = OutputFormat::Container::WAV; format.bitDepth = 24; break;
+    case HRAW_FORMAT_FLAC_16: format.container = OutputFormat::Container::FLAC; format.bitDepth = 16; break;
+    case HRAW_FORMAT_FLAC_24: format.container = OutputFormat::Container::FLAC; format.bitDepth = 24; break;
+    default:
+        error = "Unknown file format " + std::to_string(settings.file_format);
+        return false;
+    }
+    return true;
+}
+
+hraw_status Fail(hraw_context* ctx, hraw_status status, const std::string& message) {
+    ctx->error = message;
+    return status;
+}
+
+// Run `body` on `ctx` with a fresh error and cancel flag, turning anything
+// it throws into a status; no exception may cross the C boundary
+template <typename Fn>
+hraw_status Guarded(hraw_context* ctx, Fn&& body) {
+    ctx->error.clear();
+    ctx->cancel.Reset();
+    try {
+        return body();
+    } catch (const std::bad_alloc&) {
+        ctx->audio = AudioProcessor::AudioData();
+        ctx->workspace.Release();
+        return Fail(ctx, HRAW_ERROR_OUT_OF_MEMORY, "Out of memory");
+    } catch (const std::exception& e) {
+        return Fail(ctx, HRAW_ERROR_PROCESSING, e.what());
+    } catch (...) {
+        return Fail(ctx, HRAW_ERROR_PROCESSING, "Unknown error");
+    }
+}
+
+hraw_status CheckInput(hraw_context* ctx, bool buffersGiven, int numChannels, size_t numFrames, int sampleRate) {
+    if (!buffersGiven) {
+        return Fail(ctx, HRAW_ERROR_INVALID_ARGUMENT, "Input and output buffers must not be null");
+    }
+    if (numChannels < 1) {
+        return Fail(ctx, HRAW_ERROR_INVALID_ARGUMENT, "num_channels must be at least 1");
+    }
+    if (sampleRate <= 0) {
+        return Fail(ctx, HRAW_ERROR_INVALID_ARGUMENT, "sample_rate must be positive");
+    }
+    if (numFrames == 0) {
+        return Fail(ctx, HRAW_ERROR_INVALID_ARGUMENT, "num_frames must not be 0");
+    }
+    return HRAW_OK;
+}
+
+hraw_status CheckCapacity(hraw_context* ctx, size_t expected, size_t capacity) {
+    if (expected == 0) {
+        return Fail(ctx, HRAW_ERROR_PROCESSING, "Input is shorter than one HFC frame");
+    }
+    if (capacity < expected) {
+        return Fail(ctx, HRAW_ERROR_BUFFER_TOO_SMALL, "Output needs " + std::to_string(expected) + " frames");
+    }
+    return HRAW_OK;
+}
+
+// Process ctx->audio, already filled with the input, and check that the
+// result has `expected` frames per channel
+hraw_status Run(hraw_context* ctx, size_t expected) {
+    AudioProcessor::AudioData& audio = ctx->audio;
+    audio.lowMemory = false;
+    audio.hasInputHash = false;
+    audio.analysis.reset();
+
+    if (!ctx->processor.Process(audio, ctx->options, nullptr, &ctx->cancel)) {
+        if (ctx->cancel.IsCancelled()) return Fail(ctx, HRAW_ERROR_CANCELLED, "Cancelled");
+        return Fail(ctx, HRAW_ERROR_PROCESSING, "Processing failed");
+    }
+    for (const auto& channel : audio.channels) {
+        if (channel.size() != expected) {
+            return Fail(ctx, HRAW_ERROR_PROCESSING, "Output length doesn't match hraw_output_frames");
+        }
+    }
+    return HRAW_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+int hraw_api_version(void) {
+    return HRAW_API_VERSION;
+}
+
+const char* hraw_version(void) {
+    return HRAW_VERSION;
+}
+
+void hraw_default_settings(hraw_settings* settings) {
+    if (!settings) return;
+    const AudioProcessor::Options defaults;
+    std::memset(settings, 0, sizeof(*settings));
+    settings->size = sizeof(*settings);
+    settings->enable_hfc = defaults.enableHFC ? 1 : 0;
+    settings->lowpass_hz = defaults.lowpassFreq;
+    settings->rate_multiplier = defaults.sampleRateMultiplier;
+    settings->seed = defaults.seed;
+    settings->engine = HRAW_ENGINE_HARMONIC;
+    settings->file_format = HRAW_FORMAT_WAV_FLOAT;
+}
+
+hraw_context* hraw_context_create(const hraw_settings* settings) {
+    InitLogging();
+    createError.clear();
+    try {
+        hraw_settings resolved;
+        AudioProcessor::Options options;
+        if (!ReadSettings(settings, resolved, createError) || !ToOptions(resolved, options, createError)) {
+            return nullptr;
+        }
+        hraw_context* ctx = new hraw_context;
+        ctx->options = options;
+        ctx->processor.SetWorkspace(&ctx->workspace);
+        return ctx;
+    } catch (const std::bad_alloc&) {
+        createError = "Out of memory";
+        return nullptr;
+    }
+}
+
+void hraw_context_destroy(hraw_context* ctx) {
+    delete ctx;
+}
+
+hraw_status hraw_context_configure(hraw_context* ctx, const hraw_settings* settings) {
+    if (!ctx) return HRAW_ERROR_INVALID_ARGUMENT;
+    return Guarded(ctx, [&]() {
+        hraw_settings resolved;
+        AudioProcessor::Options options;
+        if (!ReadSettings(settings, resolved, ctx->error) || !ToOptions(resolved, options, ctx->error)) {
+            return HRAW_ERROR_INVALID_ARGUMENT;
+        }
+        ctx->options = options;
+        return HRAW_OK;
+    });
+}
+
+size_t hraw_output_frames(const hraw_context* ctx, size_t num_frames, int num_channels) {
+    if (!ctx) return 0;
+    return AudioProcessor::OutputLength(num_frames, num_channels, ctx->options);
+}
+
+int hraw_output_rate(const hraw_context* ctx, int sample_rate) {
+    if (!ctx) return 0;
+    return AudioProcessor::OutputRate(sample_rate, ctx->options);
+}
+
+hraw_status hraw_process_planar(hraw_context* ctx, const float* const* in, int num_channels, size_t num_frames,
+                                int sample_rate, float* const* out, size_t out_capacity, size_t* out_frames) {
+    if (!ctx) return HRAW_ERROR_INVALID_ARGUMENT;
+    return Guarded(ctx, [&]() {
+        hraw_status status = CheckInput(ctx, in && out, num_channels, num_frames, sample_rate);
+        if (status != HRAW_OK) return status;
+        for (int c = 0; c < num_channels; ++c) {
+            if (!in[c] || !out[c]) return Fail(ctx, HRAW_ERROR_INVALID_ARGUMENT, "Channel buffers must not be null");
+        }
+
+        const size_t expected = AudioProcessor::OutputLength(num_frames, num_channels, ctx->options);
+        if (out_frames) *out_frames = expected;
+        status = CheckCapacity(ctx, expected, out_capacity);
+        if (status != HRAW_OK) return status;
+
+        AudioProcessor::AudioData& audio = ctx->audio;
+        audio.channels.resize(num_channels);
+        for (int c = 0; c < num_channels; ++c) {
+            audio.channels[c].assign(in[c], in[c] + num_frames);
+        }
+        audio.sampleRate = sample_rate;
+        audio.numChannels = num_channels;
+        audio.numSamples = num_frames;
+
+        status = Run(ctx, expected);
+        if (status != HRAW_OK) return status;
+        for (int c = 0; c < num_channels; ++c) {
+            std::copy(audio.channels[c].begin(), audio.channels[c].end(), out[c]);
+        }
+        return HRAW_OK;
+    });
+}
+
+hraw_status hraw_process_interleaved(hraw_context* ctx, const float* in, int num_channels, size_t num_frames,
+                                     int sample_rate, float* out, size_t out_capacity, size_t* out_frames) {
+    if (!ctx) return HRAW_ERROR_INVALID_ARGUMENT;
+    return Guarded(ctx, [&]() {
+        hraw_status status = CheckInput(ctx, in && out, num_channels, num_frames, sample_rate);
+        if (status != HRAW_OK) return status;
+
+        const size_t expected = AudioProcessor::OutputLength(num_frames, num_channels, ctx->options);
+        if (out_frames) *out_frames = expected;
+        status = CheckCapacity(ctx, expected, out_capacity);
+        if (status != HRAW_OK) return status;
+
+        AudioProcessor::AudioData& audio = ctx->audio;
+        const size_t stride = static_cast<size_t>(num_channels);
+        audio.channels.resize(num_channels);
+        for (auto& channel : audio.channels) channel.resize(num_frames);
+        if (num_channels == 2) {
+            Kernels::Deinterleave2(in, audio.channels[0].data(), audio.channels[1].data(), num_frames);
+        } else {
+            for (size_t c = 0; c < stride; ++c) {
+                float* channel = audio.channels[c].data();
+                for (size_t i = 0; i < num_frames; ++i) channel[i] = in[i * stride + c];
+            }
+        }
+        audio.sampleRate = sample_rate;
+        audio.numChannels = num_channels;
+        audio.numSamples = num_frames;
+
+        status = Run(ctx, expected);
+        if (status != HRAW_OK) return status;
+        if (num_channels == 2) {
+            Kernels::Interleave2(audio.channels[0].data(), audio.channels[1].data(), out, expected);
+        } else {
+            for (size_t c = 0; c < stride; ++c) {
+                const float* channel = audio.channels[c].data();
+                for (size_t i = 0; i < expected; ++i) out[i * stride + c] = channel[i];
+            }
+        }
+        return HRAW_OK;
+    });
+}
+
+hraw_status hraw_process_file(hraw_context* ctx, const char* input_path, const char* output_path) {
+    if (!ctx) return HRAW_ERROR_INVALID_ARGUMENT;
+    return Guarded(ctx, [&]() {
+        if (!input_path || !output_path) {
+            return Fail(ctx, HRAW_ERROR_INVALID_ARGUMENT, "Paths must not be null");
+        }
+        if (!ctx->processor.ProcessFile(input_path, output_path, ctx->options, nullptr, &ctx->cancel)) {
+            if (ctx->cancel.IsCancelled()) return Fail(ctx, HRAW_ERROR_CANCELLED, "Cancelled");
+            return Fail(ctx, HRAW_ERROR_IO, std::string("Could not process ") + input_path + " into " + output_path);
+        }
+        return HRAW_OK;
+    });
+}
+
+void hraw_cancel(hraw_context* ctx) {
+    if (ctx) ctx->cancel.Cancel();
+}
+
+const char* hraw_last_error(const hraw_context* ctx) {
+    return ctx ? ctx->error.c_str() : createError.c_str();
+}
+
+} // extern "C"
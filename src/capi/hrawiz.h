@@ -0,0 +1,130 @@
+#ifndef HRAWIZ_H
+#define HRAWIZ_H
+
+/*
+ * C interface to the HRAudioWizard processor, for embedding it in other
+ * programs (libhrawiz). Audio goes in and out as float buffers the caller
+ * owns; a context keeps the processor, its FFT plans and its working
+ * buffers (resampled audio, mid/side, spectrograms) between calls, so
+ * processing many buffers no longer than the first with one context
+ * allocates little after it. The buffers stay allocated until the context
+ * is destroyed.
+ *
+ * A context is used by one thread at a time; use one per thread to process
+ * in parallel. hraw_cancel may be called from any thread. Every call that
+ * can fail returns an hraw_status and leaves a message for
+ * hraw_last_error. Nothing here throws or calls exit().
+ *
+ * The ABI only grows: functions and status codes are never removed or
+ * changed, and new settings are appended to hraw_settings, whose `size`
+ * field tells the library which ones the caller knows.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(HRAW_CAPI_BUILD)
+#define HRAW_API __declspec(dllexport)
+#else
+#define HRAW_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__) || defined(__clang__)
+#define HRAW_API __attribute__((visibility("default")))
+#else
+#define HRAW_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Version of this header; compare with hraw_api_version() at runtime */
+#define HRAW_API_VERSION 1
+
+typedef enum hraw_status {
+    HRAW_OK = 0,
+    HRAW_ERROR_INVALID_ARGUMENT = 1, /* Null pointer, bad channel count, rate or setting */
+    HRAW_ERROR_BUFFER_TOO_SMALL = 2, /* Output capacity below hraw_output_frames; nothing written */
+    HRAW_ERROR_PROCESSING = 3,       /* Processing failed, e.g. input too short for HFC */
+    HRAW_ERROR_CANCELLED = 4,        /* hraw_cancel stopped the call */
+    HRAW_ERROR_IO = 5,               /* A file couldn't be read or written */
+    HRAW_ERROR_OUT_OF_MEMORY = 6
+} hraw_status;
+
+typedef enum hraw_engine {
+    HRAW_ENGINE_HARMONIC = 0,          /* Harmonic overtone synthesis */
+    HRAW_ENGINE_BAND_REPLICATION = 1   /* Faster, fixed cost per frame, for bulk work */
+} hraw_engine;
+
+typedef enum hraw_file_format {
+    HRAW_FORMAT_WAV_FLOAT = 0,
+    HRAW_FORMAT_WAV_16 = 1,
+    HRAW_FORMAT_WAV_24 = 2,
+    HRAW_FORMAT_FLAC_16 = 3,
+    HRAW_FORMAT_FLAC_24 = 4
+} hraw_file_format;
+
+typedef struct hraw_settings {
+    uint32_t size;            /* sizeof(hraw_settings); set by hraw_default_settings */
+    int enable_hfc;           /* Nonzero to synthesize high frequencies; HFC needs stereo */
+    int lowpass_hz;           /* Cutoff above which content is synthesized */
+    int rate_multiplier;      /* Output rate over input rate, 1 to 16; only with HFC */
+    uint32_t seed;            /* Fixes HFC's random variation; 0 varies per call */
+    int engine;               /* hraw_engine */
+    int file_format;          /* hraw_file_format, for hraw_process_file only */
+} hraw_settings;
+
+typedef struct hraw_context hraw_context;
+
+/* HRAW_API_VERSION of the library, and its release as "major.minor.patch" */
+HRAW_API int hraw_api_version(void);
+HRAW_API const char* hraw_version(void);
+
+/* The settings the application starts with */
+HRAW_API void hraw_default_settings(hraw_settings* settings);
+
+/* A context with `settings`, or the defaults if null. Returns null if the
+ * settings are invalid or memory runs out. */
+HRAW_API hraw_context* hraw_context_create(const hraw_settings* settings);
+HRAW_API void hraw_context_destroy(hraw_context* ctx);
+
+/* Settings for the calls that follow on `ctx` */
+HRAW_API hraw_status hraw_context_configure(hraw_context* ctx, const hraw_settings* settings);
+
+/* Frames (samples per channel) and sample rate of the output of
+ * `num_frames` input frames at `sample_rate`, with the context's settings.
+ * Size output buffers with this; it is 0 when HFC needs more input. */
+HRAW_API size_t hraw_output_frames(const hraw_context* ctx, size_t num_frames, int num_channels);
+HRAW_API int hraw_output_rate(const hraw_context* ctx, int sample_rate);
+
+/* Process `num_frames` frames of `num_channels` channels at `sample_rate`.
+ * Planar buffers are one pointer per channel; interleaved ones hold
+ * frames one after another. Output goes to the caller's buffers, which
+ * must hold `out_capacity` frames per channel and may not overlap the
+ * input. `out_frames` (may be null) receives hraw_output_frames. */
+HRAW_API hraw_status hraw_process_planar(hraw_context* ctx, const float* const* in, int num_channels,
+                                         size_t num_frames, int sample_rate, float* const* out,
+                                         size_t out_capacity, size_t* out_frames);
+HRAW_API hraw_status hraw_process_interleaved(hraw_context* ctx, const float* in, int num_channels,
+                                              size_t num_frames, int sample_rate, float* out,
+                                              size_t out_capacity, size_t* out_frames);
+
+/* Process a file into another, in the context's file format. Long inputs
+ * are processed in segments on all cores without being held in memory. */
+HRAW_API hraw_status hraw_process_file(hraw_context* ctx, const char* input_path, const char* output_path);
+
+/* Stop the call running on `ctx`, which then returns HRAW_ERROR_CANCELLED.
+ * Has no effect on calls started afterwards. */
+HRAW_API void hraw_cancel(hraw_context* ctx);
+
+/* Message for the last failed call on `ctx`, valid until the next call on
+ * it; "" if none failed. With a null `ctx`, the last failed
+ * hraw_context_create on this thread. */
+HRAW_API const char* hraw_last_error(const hraw_context* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HRAWIZ_H */
@@ -1,4 +1,5 @@
 #include "FFT.h"
+#include "Kernels.h"
 #include <kiss_fft.h>
 #include <cstring>
 #include <algorithm>
@@ -10,6 +11,7 @@ FFT::FFT(int size) : fftSize(size) {
     
     // Pre-allocate buffers
     complexBuffer.resize(fftSize);
+    spectrumBuffer.resize(fftSize);
     realBuffer.resize(fftSize);
 }
 
@@ -24,30 +26,34 @@ FFT::~FFT() {
 }
 
 std::vector<std::complex<float>> FFT::Forward(const std::vector<float>& input) {
+    // Only the positive frequencies (including DC and Nyquist), so a
+    // spectrogram holding thousands of frames stays at half the FFT size
+    std::vector<std::complex<float>> output(fftSize / 2 + 1);
+    Forward(input.data(), input.size(), output.data());
+    return output;
+}
+
+std::vector<float> FFT::Inverse(const std::vector<std::complex<float>>& input) {
+    std::vector<float> output(fftSize);
+    Inverse(input.data(), input.size(), output.data());
+    return output;
+}
+
+void FFT::Forward(const float* input, size_t count, std::complex<float>* output) {
     // Prepare input buffer
-    for (int i = 0; i < fftSize; ++i) {
-        if (i < static_cast<int>(input.size())) {
-            complexBuffer[i] = std::complex<float>(input[i], 0.0f);
-        } else {
-            complexBuffer[i] = std::complex<float>(0.0f, 0.0f);
-        }
-    }
+    const size_t used = std::min(count, static_cast<size_t>(fftSize));
+    Kernels::RealToComplex(input, complexBuffer.data(), used);
+    std::fill(complexBuffer.begin() + used, complexBuffer.end(), std::complex<float>(0.0f, 0.0f));
     
     // Perform FFT
-    std::vector<std::complex<float>> output(fftSize);
-    kiss_fft(fwdCfg, 
-             reinterpret_cast<const kiss_fft_cpx*>(complexBuffer.data()),
-             reinterpret_cast<kiss_fft_cpx*>(output.data()));
-    
-    // Return only positive frequencies (including DC and Nyquist)
-    output.resize(fftSize / 2 + 1);
-    return output;
+    Kernels::Fft(fwdCfg, complexBuffer.data(), spectrumBuffer.data());
+    std::copy(spectrumBuffer.begin(), spectrumBuffer.begin() + fftSize / 2 + 1, output);
 }
 
-std::vector<float> FFT::Inverse(const std::vector<std::complex<float>>& input) {
+void FFT::Inverse(const std::complex<float>* input, size_t count, float* output) {
     // Prepare full spectrum (mirror negative frequencies)
     for (int i = 0; i < fftSize / 2 + 1; ++i) {
-        if (i < static_cast<int>(input.size())) {
+        if (i < static_cast<int>(count)) {
             complexBuffer[i] = input[i];
         } else {
             complexBuffer[i] = std::complex<float>(0.0f, 0.0f);
@@ -60,17 +66,9 @@ std::vector<float> FFT::Inverse(const std::vector<std::complex<float>>& input) {
     }
     
     // Perform inverse FFT
-    std::vector<std::complex<float>> tempOutput(fftSize);
-    kiss_fft(invCfg,
-             reinterpret_cast<const kiss_fft_cpx*>(complexBuffer.data()),
-             reinterpret_cast<kiss_fft_cpx*>(tempOutput.data()));
+    Kernels::Fft(invCfg, complexBuffer.data(), spectrumBuffer.data());
     
     // Extract real part and normalize
-    std::vector<float> output(fftSize);
     float scale = 1.0f / fftSize;
-    for (int i = 0; i < fftSize; ++i) {
-        output[i] = tempOutput[i].real() * scale;
-    }
-    
-    return output;
-}
\ No newline at end of file
+    Kernels::RealPartScaled(spectrumBuffer.data(), scale, output, fftSize);
+}
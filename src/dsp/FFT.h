@@ -19,6 +19,15 @@ public:
     // Inverse FFT - complex to real
     std::vector<float> Inverse(const std::vector<std::complex<float>>& input);
     
+    // The same into caller memory, allocating nothing. Forward reads
+    // `count` samples (zero-padded to the FFT size) and writes
+    // fftSize / 2 + 1 bins; Inverse reads `count` bins and writes fftSize
+    // samples.
+    void Forward(const float* input, size_t count, std::complex<float>* output);
+    void Inverse(const std::complex<float>* input, size_t count, float* output);
+    
+    int Size() const { return fftSize; }
+    
 private:
     int fftSize;
     kiss_fft_cfg fwdCfg;
@@ -26,5 +35,6 @@ private:
     
     // Pre-allocated buffers
     std::vector<std::complex<float>> complexBuffer;
+    std::vector<std::complex<float>> spectrumBuffer;
     std::vector<float> realBuffer;
 };
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct kiss_fft_state;
+
+// Entry points of one kernel build (see Kernels.h). Complex arrays are
+// passed as interleaved re/im floats so the builds need no std templates.
+struct KernelTable {
+    void (*magnitude)(const float* in, float* out, size_t count);
+    void (*multiply)(const float* a, const float* b, float* out, size_t count);
+    void (*accumulate)(float* acc, const float* in, size_t count);
+    void (*accumulateSquares)(float* acc, const float* in, size_t count);
+    void (*divideNonZero)(float* x, const float* d, size_t count);
+    void (*boxSmooth)(const float* in, float* out, size_t count, int halfWindow);
+    void (*resampleLinear)(const float* in, int inFirst, double ratio, size_t first, float* out, size_t count);
+    void (*realToComplex)(const float* in, float* out, size_t count);
+    void (*realPartScaled)(const float* in, float scale, float* out, size_t count);
+    void (*deinterleave2)(const float* src, float* left, float* right, size_t numFrames);
+    void (*interleave2)(const float* left, const float* right, float* dst, size_t numFrames);
+    void (*deinterleave)(const float* src, float* const* dst, int numChannels, size_t numFrames);
+    void (*interleave)(const float* const* src, float* dst, int numChannels, size_t numFrames);
+    void (*int16ToFloat)(const int16_t* src, float* dst, size_t count);
+    void (*int24ToFloat)(const uint8_t* src, float* dst, size_t count);
+    void (*int32ToFloat)(const int32_t* src, float* dst, size_t count);
+    void (*floatToInt16)(const float* src, int16_t* dst, size_t count);
+    void (*floatToInt24)(const float* src, uint8_t* dst, size_t count);
+    void (*floatToInt32)(const float* src, int32_t* dst, size_t count);
+    void (*sanitize)(float* tile, size_t count, size_t* nanCount, size_t* clipCount);
+    void (*quantize)(float* tile, size_t count, int bits, bool dither, uint32_t* rng);
+    void (*noiseShape)(float* tile, size_t numFrames, int numChannels, int bits, uint32_t* rng, float* error);
+    void (*fft)(kiss_fft_state* plan, const float* in, float* out);
+};
+
+// One per build; null when the compiler wasn't given that instruction set
+const KernelTable* ScalarKernels();
+const KernelTable* Sse42Kernels();
+const KernelTable* Avx2Kernels();
+const KernelTable* Avx512Kernels();
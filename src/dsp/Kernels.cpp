@@ -0,0 +1,230 @@
+#include "Kernels.h"
+#include "KernelTable.h"
+#include "../util/Log.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+// The scalar build lives here, compiled with the project's default flags
+#define HRAW_KERNEL_NAMESPACE scalar
+#include "KernelsImpl.h"
+
+const KernelTable* ScalarKernels() {
+    return &scalar::TABLE;
+}
+
+namespace {
+
+constexpr Kernels::Isa ALL_ISAS[] = {Kernels::Isa::AVX512, Kernels::Isa::AVX2, Kernels::Isa::SSE42,
+                                     Kernels::Isa::Scalar};
+
+const KernelTable* Build(Kernels::Isa isa) {
+    switch (isa) {
+    case Kernels::Isa::SSE42: return Sse42Kernels();
+    case Kernels::Isa::AVX2: return Avx2Kernels();
+    case Kernels::Isa::AVX512: return Avx512Kernels();
+    default: return ScalarKernels();
+    }
+}
+
+bool CpuHas(Kernels::Isa isa) {
+    if (isa == Kernels::Isa::Scalar) return true;
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    // These also check that the OS saves the wider registers
+    __builtin_cpu_init();
+    switch (isa) {
+    case Kernels::Isa::SSE42: return __builtin_cpu_supports("sse4.2");
+    case Kernels::Isa::AVX2: return __builtin_cpu_supports("avx2");
+    case Kernels::Isa::AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+               __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+    default: return false;
+    }
+#else
+    return false;
+#endif
+}
+
+bool Available(Kernels::Isa isa) {
+    return Build(isa) != nullptr && CpuHas(isa);
+}
+
+Kernels::Isa InitialIsa() {
+    const Kernels::Isa best = Kernels::Best();
+    if (const char* forced = std::getenv("HRAW_SIMD")) {
+        Kernels::Isa isa;
+        if (!Kernels::Parse(forced, isa)) {
+            HRAW_LOG_WARN("Unknown HRAW_SIMD value '" << forced << "', using " << Kernels::Name(best));
+        } else if (!Available(isa)) {
+            HRAW_LOG_WARN("HRAW_SIMD=" << forced << " isn't supported here, using " << Kernels::Name(best));
+        } else {
+            HRAW_LOG_INFO("DSP kernels: " << Kernels::Name(isa) << " (forced by HRAW_SIMD)");
+            return isa;
+        }
+        return best;
+    }
+    HRAW_LOG_DEBUG("DSP kernels: " << Kernels::Name(best));
+    return best;
+}
+
+std::atomic<Kernels::Isa>& ActiveIsa() {
+    static std::atomic<Kernels::Isa> active{InitialIsa()};
+    return active;
+}
+
+} // namespace
+
+Kernels::Isa Kernels::Active() {
+    return ActiveIsa().load(std::memory_order_relaxed);
+}
+
+Kernels::Isa Kernels::Best() {
+    for (Isa isa : ALL_ISAS) {
+        if (Available(isa)) return isa;
+    }
+    return Isa::Scalar;
+}
+
+bool Kernels::Force(Isa isa) {
+    if (!Available(isa)) {
+        HRAW_LOG_WARN("DSP kernels: " << Name(isa) << " isn't supported here, staying on " << Name(Active()));
+        return false;
+    }
+    ActiveIsa().store(isa, std::memory_order_relaxed);
+    HRAW_LOG_INFO("DSP kernels: " << Name(isa));
+    return true;
+}
+
+const char* Kernels::Name(Isa isa) {
+    switch (isa) {
+    case Isa::SSE42: return "sse4.2";
+    case Isa::AVX2: return "avx2";
+    case Isa::AVX512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+bool Kernels::Parse(const std::string& name, Isa& isa) {
+    if (name == "scalar") {
+        isa = Isa::Scalar;
+    } else if (name == "sse4.2" || name == "sse42") {
+        isa = Isa::SSE42;
+    } else if (name == "avx2") {
+        isa = Isa::AVX2;
+    } else if (name == "avx512") {
+        isa = Isa::AVX512;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const KernelTable& Kernels::Table() {
+    return *Build(Active());
+}
+
+void Kernels::Magnitude(const std::complex<float>* in, float* out, size_t count) {
+    Table().magnitude(reinterpret_cast<const float*>(in), out, count);
+}
+
+void Kernels::Multiply(const float* a, const float* b, float* out, size_t count) {
+    Table().multiply(a, b, out, count);
+}
+
+void Kernels::Accumulate(float* acc, const float* in, size_t count) {
+    Table().accumulate(acc, in, count);
+}
+
+void Kernels::AccumulateSquares(float* acc, const float* in, size_t count) {
+    Table().accumulateSquares(acc, in, count);
+}
+
+void Kernels::DivideNonZero(float* x, const float* d, size_t count) {
+    Table().divideNonZero(x, d, count);
+}
+
+void Kernels::BoxSmooth(const float* in, float* out, size_t count, int windowSize) {
+    Table().boxSmooth(in, out, count, windowSize / 2);
+}
+
+void Kernels::ResampleLinear(const float* in, size_t inFirst, size_t inSize, double ratio, size_t first,
+                             float* out, size_t count) {
+    if (inFirst + inSize <= static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        Table().resampleLinear(in, static_cast<int>(inFirst), ratio, first, out, count);
+        return;
+    }
+    // Past the int32 indices the kernels use; about 13 hours at 44.1 kHz
+    for (size_t i = 0; i < count; ++i) {
+        const double srcIndex = static_cast<double>(first + i) / ratio;
+        const size_t srcIdx = static_cast<size_t>(srcIndex);
+        const double fraction = srcIndex - srcIdx;
+        const size_t local = srcIdx - inFirst;
+        out[i] = static_cast<float>(in[local] * (1.0 - fraction) + in[local + 1] * fraction);
+    }
+}
+
+void Kernels::RealToComplex(const float* in, std::complex<float>* out, size_t count) {
+    Table().realToComplex(in, reinterpret_cast<float*>(out), count);
+}
+
+void Kernels::RealPartScaled(const std::complex<float>* in, float scale, float* out, size_t count) {
+    Table().realPartScaled(reinterpret_cast<const float*>(in), scale, out, count);
+}
+
+void Kernels::Deinterleave2(const float* src, float* left, float* right, size_t numFrames) {
+    Table().deinterleave2(src, left, right, numFrames);
+}
+
+void Kernels::Interleave2(const float* left, const float* right, float* dst, size_t numFrames) {
+    Table().interleave2(left, right, dst, numFrames);
+}
+
+void Kernels::Deinterleave(const float* src, float* const* dst, int numChannels, size_t numFrames) {
+    Table().deinterleave(src, dst, numChannels, numFrames);
+}
+
+void Kernels::Interleave(const float* const* src, float* dst, int numChannels, size_t numFrames) {
+    Table().interleave(src, dst, numChannels, numFrames);
+}
+
+void Kernels::Int16ToFloat(const int16_t* src, float* dst, size_t count) {
+    Table().int16ToFloat(src, dst, count);
+}
+
+void Kernels::Int24ToFloat(const uint8_t* src, float* dst, size_t count) {
+    Table().int24ToFloat(src, dst, count);
+}
+
+void Kernels::Int32ToFloat(const int32_t* src, float* dst, size_t count) {
+    Table().int32ToFloat(src, dst, count);
+}
+
+void Kernels::FloatToInt16(const float* src, int16_t* dst, size_t count) {
+    Table().floatToInt16(src, dst, count);
+}
+
+void Kernels::FloatToInt24(const float* src, uint8_t* dst, size_t count) {
+    Table().floatToInt24(src, dst, count);
+}
+
+void Kernels::FloatToInt32(const float* src, int32_t* dst, size_t count) {
+    Table().floatToInt32(src, dst, count);
+}
+
+void Kernels::Sanitize(float* x, size_t count, size_t& nanCount, size_t& clipCount) {
+    Table().sanitize(x, count, &nanCount, &clipCount);
+}
+
+void Kernels::Quantize(float* x, size_t count, int bits, bool dither, uint32_t rng[4]) {
+    Table().quantize(x, count, bits, dither, rng);
+}
+
+void Kernels::NoiseShape(float* frames, size_t numFrames, int numChannels, int bits, uint32_t rng[4],
+                         float* error) {
+    Table().noiseShape(frames, numFrames, numChannels, bits, rng, error);
+}
+
+void Kernels::Fft(kiss_fft_state* plan, const std::complex<float>* in, std::complex<float>* out) {
+    Table().fft(plan, reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out));
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct KernelTable;
+struct kiss_fft_state;
+
+// The hot loops of the pipeline (FFT butterflies, windowing, magnitudes,
+// overlap-add, spectral smoothing, resampling, sample conversion), built
+// once per instruction set and picked at startup from what the CPU
+// supports, so one portable binary runs at close to native speed anywhere.
+// All builds give bit-identical results, so output doesn't depend on the
+// machine and a build can be checked against references from another.
+//
+// Set HRAW_SIMD=scalar|sse4.2|avx2|avx512 to force a build, e.g. to
+// benchmark one against another; an unsupported choice falls back to the
+// best available with a warning.
+class Kernels {
+public:
+    enum class Isa {
+        Scalar,  // Whatever the compiler targets by default (SSE2 on x86-64)
+        SSE42,
+        AVX2,
+        AVX512   // F, BW, DQ and VL
+    };
+
+    // Build in use; chosen on first use
+    static Isa Active();
+
+    // Fastest build this CPU can run
+    static Isa Best();
+
+    // Switch builds. False, leaving the active one, if this CPU or this
+    // binary doesn't have `isa`.
+    static bool Force(Isa isa);
+
+    static const char* Name(Isa isa);
+    static bool Parse(const std::string& name, Isa& isa);
+
+    // out[i] = |in[i]|, identical to std::abs
+    static void Magnitude(const std::complex<float>* in, float* out, size_t count);
+
+    // out[i] = a[i] * b[i]; out may be a or b
+    static void Multiply(const float* a, const float* b, float* out, size_t count);
+
+    // acc[i] += in[i]
+    static void Accumulate(float* acc, const float* in, size_t count);
+
+    // acc[i] += in[i]^2
+    static void AccumulateSquares(float* acc, const float* in, size_t count);
+
+    // x[i] /= d[i] wherever d[i] > 0
+    static void DivideNonZero(float* x, const float* d, size_t count);
+
+    // Mean over `windowSize / 2` bins either side, fewer at the edges
+    static void BoxSmooth(const float* in, float* out, size_t count, int windowSize);
+
+    // out[i] = the signal linearly interpolated at (first + i) / ratio,
+    // where `in` holds its `inSize` samples from sample `inFirst` on. Every
+    // position must have a sample after it in `in`.
+    static void ResampleLinear(const float* in, size_t inFirst, size_t inSize, double ratio, size_t first,
+                               float* out, size_t count);
+
+    // Real samples to complex with zero imaginary parts, and back scaled
+    static void RealToComplex(const float* in, std::complex<float>* out, size_t count);
+    static void RealPartScaled(const std::complex<float>* in, float scale, float* out, size_t count);
+
+    // Interleaved stereo float <-> planar
+    static void Deinterleave2(const float* src, float* left, float* right, size_t numFrames);
+    static void Interleave2(const float* left, const float* right, float* dst, size_t numFrames);
+
+    // Interleaved float <-> planar for any channel count
+    static void Deinterleave(const float* src, float* const* dst, int numChannels, size_t numFrames);
+    static void Interleave(const float* const* src, float* dst, int numChannels, size_t numFrames);
+
+    // PCM <-> float in [-1, 1); PCM24 is packed little-endian 3-byte
+    // samples. To PCM clamps to full scale and rounds to nearest.
+    static void Int16ToFloat(const int16_t* src, float* dst, size_t count);
+    static void Int24ToFloat(const uint8_t* src, float* dst, size_t count);
+    static void Int32ToFloat(const int32_t* src, float* dst, size_t count);
+    static void FloatToInt16(const float* src, int16_t* dst, size_t count);
+    static void FloatToInt24(const float* src, uint8_t* dst, size_t count);
+    static void FloatToInt32(const float* src, int32_t* dst, size_t count);
+
+    // Zero NaNs and clamp to [-1, 1], counting both
+    static void Sanitize(float* x, size_t count, size_t& nanCount, size_t& clipCount);
+
+    // Round to a `bits` grid, optionally with TPDF dither drawn from the
+    // four xorshift32 states in `rng`, leaving exact multiples of one LSB
+    static void Quantize(float* x, size_t count, int bits, bool dither, uint32_t rng[4]);
+
+    // Quantize interleaved frames with first-order error feedback carried in
+    // `error`, one per channel
+    static void NoiseShape(float* frames, size_t numFrames, int numChannels, int bits, uint32_t rng[4],
+                           float* error);
+
+    // KissFFT transform of `plan`'s size with a plan from kiss_fft_alloc;
+    // the butterflies are compiled per instruction set like the rest
+    static void Fft(kiss_fft_state* plan, const std::complex<float>* in, std::complex<float>* out);
+
+private:
+    static const KernelTable& Table();
+};
@@ -0,0 +1,16 @@
+// AVX2 build of the kernels; CMake compiles this file with -mavx2
+#include "KernelTable.h"
+
+#if defined(__AVX2__)
+#define HRAW_KERNEL_NAMESPACE avx2
+#include "KernelsImpl.h"
+
+const KernelTable* Avx2Kernels() {
+    return &avx2::TABLE;
+}
+#else
+// Not an x86 build, or a compiler without the flag
+const KernelTable* Avx2Kernels() {
+    return nullptr;
+}
+#endif
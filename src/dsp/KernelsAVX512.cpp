@@ -0,0 +1,16 @@
+// AVX-512 build of the kernels; CMake compiles this file with -mavx512f/bw/dq/vl
+#include "KernelTable.h"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512DQ__) && defined(__AVX512VL__)
+#define HRAW_KERNEL_NAMESPACE avx512
+#include "KernelsImpl.h"
+
+const KernelTable* Avx512Kernels() {
+    return &avx512::TABLE;
+}
+#else
+// Not an x86 build, or a compiler without the flag
+const KernelTable* Avx512Kernels() {
+    return nullptr;
+}
+#endif
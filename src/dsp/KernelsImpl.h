@@ -0,0 +1,628 @@
+// Kernel bodies, included once per instruction set by Kernels.cpp and the
+// Kernels<ISA>.cpp files with HRAW_KERNEL_NAMESPACE set; each build gets
+// its vector code from the compiler flags of the file including it.
+//
+// Keep these to plain loops on raw pointers (and intrinsics, which are never
+// emitted out of line). An inline function or template
+// from a header (std::min, std::complex, ...) instantiated here would be a
+// weak symbol the linker may pick for the whole program, putting AVX-512
+// code into callers on CPUs without it.
+//
+// Every kernel does the same float operations in the same order as the
+// scalar code it replaced, so all builds are bit-identical; only
+// element-wise work is vectorized, never a reduction.
+
+#include "KernelTable.h"
+#include "KissFFT.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifndef HRAW_KERNEL_NAMESPACE
+#error "Define HRAW_KERNEL_NAMESPACE before including KernelsImpl.h"
+#endif
+
+namespace HRAW_KERNEL_NAMESPACE {
+namespace {
+
+void Magnitude(const float* in, float* out, size_t count) {
+    // Same result as std::abs(std::complex<float>), which glibc computes in
+    // double, but vectorizable
+    for (size_t i = 0; i < count; ++i) {
+        const double re = in[2 * i];
+        const double im = in[2 * i + 1];
+        out[i] = static_cast<float>(std::sqrt(re * re + im * im));
+    }
+}
+
+void Multiply(const float* a, const float* b, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = a[i] * b[i];
+}
+
+void Accumulate(float* acc, const float* in, size_t count) {
+    for (size_t i = 0; i < count; ++i) acc[i] += in[i];
+}
+
+void AccumulateSquares(float* acc, const float* in, size_t count) {
+    for (size_t i = 0; i < count; ++i) acc[i] += in[i] * in[i];
+}
+
+void DivideNonZero(float* x, const float* d, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        // Dividing by 1 instead of skipping leaves x exact and the loop
+        // branch-free, so it vectorizes
+        x[i] /= d[i] > 0.0f ? d[i] : 1.0f;
+    }
+}
+
+void BoxSmoothEdge(const float* in, float* out, size_t count, int halfWindow, size_t i) {
+    float sum = 0;
+    int used = 0;
+    for (int j = -halfWindow; j <= halfWindow; ++j) {
+        const int64_t idx = static_cast<int64_t>(i) + j;
+        if (idx >= 0 && idx < static_cast<int64_t>(count)) {
+            sum += in[idx];
+            used++;
+        }
+    }
+    out[i] = used > 0 ? sum / used : in[i];
+}
+
+void BoxSmooth(const float* in, float* out, size_t count, int halfWindow) {
+    const size_t h = static_cast<size_t>(halfWindow);
+    if (count <= 2 * h) {
+        for (size_t i = 0; i < count; ++i) BoxSmoothEdge(in, out, count, halfWindow, i);
+        return;
+    }
+
+    // Interior: add one tap across all bins at a time, in the same order
+    // (starting from 0) a per-bin loop would, so each bin sums identically
+    const size_t first = h;
+    const size_t last = count - h;
+    float* interior = out + first;
+    const size_t n = last - first;
+    for (size_t i = 0; i < n; ++i) interior[i] = 0.0f;
+    for (int j = -halfWindow; j <= halfWindow; ++j) {
+        const float* tap = in + (static_cast<int64_t>(first) + j);
+        for (size_t i = 0; i < n; ++i) interior[i] += tap[i];
+    }
+    const float taps = static_cast<float>(2 * halfWindow + 1);
+    for (size_t i = 0; i < n; ++i) interior[i] /= taps;
+
+    for (size_t i = 0; i < first; ++i) BoxSmoothEdge(in, out, count, halfWindow, i);
+    for (size_t i = last; i < count; ++i) BoxSmoothEdge(in, out, count, halfWindow, i);
+}
+
+void ResampleLinear(const float* in, int inFirst, double ratio, size_t first, float* out, size_t count) {
+    // Indices fit in int32 (Kernels checks), which vector units can convert to
+    size_t i = 0;
+#if defined(__AVX2__)
+    // Compilers won't vectorize the indexed loads themselves. Same double
+    // operations as below, four at a time; positions are exact in double.
+    const __m256d vRatio = _mm256_set1_pd(ratio);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d lanes = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+    const __m128i vInFirst = _mm_set1_epi32(inFirst);
+    for (; i + 4 <= count; i += 4) {
+        const __m256d pos = _mm256_add_pd(_mm256_set1_pd(static_cast<double>(first + i)), lanes);
+        const __m256d srcIndex = _mm256_div_pd(pos, vRatio);
+        const __m128i srcIdx = _mm256_cvttpd_epi32(srcIndex);
+        const __m256d fraction = _mm256_sub_pd(srcIndex, _mm256_cvtepi32_pd(srcIdx));
+        const __m128i local = _mm_sub_epi32(srcIdx, vInFirst);
+        const __m256d a = _mm256_cvtps_pd(_mm_i32gather_ps(in, local, 4));
+        const __m256d b = _mm256_cvtps_pd(_mm_i32gather_ps(in + 1, local, 4));
+        const __m256d mixed = _mm256_add_pd(_mm256_mul_pd(a, _mm256_sub_pd(one, fraction)),
+                                            _mm256_mul_pd(b, fraction));
+        _mm_storeu_ps(out + i, _mm256_cvtpd_ps(mixed));
+    }
+#endif
+    for (; i < count; ++i) {
+        const double srcIndex = static_cast<double>(first + i) / ratio;
+        const int32_t srcIdx = static_cast<int32_t>(srcIndex);
+        const double fraction = srcIndex - srcIdx;
+        const int32_t local = srcIdx - inFirst;
+        out[i] = static_cast<float>(in[local] * (1.0 - fraction) + in[local + 1] * fraction);
+    }
+}
+
+void RealToComplex(const float* in, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[2 * i] = in[i];
+        out[2 * i + 1] = 0.0f;
+    }
+}
+
+void RealPartScaled(const float* in, float scale, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = in[2 * i] * scale;
+}
+
+// ---------------------------------------------------------------------------
+// Sample conversion (SampleConvert): channel shuffles, PCM <-> float, and
+// the sanitize and dither passes of file output
+// ---------------------------------------------------------------------------
+
+constexpr float PCM16_SCALE = 32768.0f;
+constexpr float PCM32_SCALE = 2147483648.0f;
+constexpr float PCM24_SCALE = 8388608.0f;
+
+// Largest float below 2^31; 1.0f * 2^31 would overflow int32
+constexpr float PCM32_MAX = 2147483520.0f;
+
+void Deinterleave2(const float* src, float* left, float* right, size_t numFrames) {
+    size_t i = 0;
+#if defined(__SSE2__) && !defined(__AVX2__)
+    // With AVX2 the compiler's code for the plain loop is faster
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128 a = _mm_loadu_ps(src + 2 * i);      // L0 R0 L1 R1
+        __m128 b = _mm_loadu_ps(src + 2 * i + 4);  // L2 R2 L3 R3
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= numFrames; i += 4) {
+        float32x4x2_t lr = vld2q_f32(src + 2 * i);
+        vst1q_f32(left + i, lr.val[0]);
+        vst1q_f32(right + i, lr.val[1]);
+    }
+#endif
+    for (; i < numFrames; ++i) {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+void Interleave2(const float* left, const float* right, float* dst, size_t numFrames) {
+    size_t i = 0;
+#if defined(__SSE2__) && !defined(__AVX2__)
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= numFrames; i += 4) {
+        float32x4x2_t lr = {{vld1q_f32(left + i), vld1q_f32(right + i)}};
+        vst2q_f32(dst + 2 * i, lr);
+    }
+#endif
+    for (; i < numFrames; ++i) {
+        dst[2 * i] = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+// 4 and 8 channels: 4x4 transposes of four frames at a time
+template <int C>
+void DeinterleaveQuad(const float* src, float* const* dst, size_t numFrames) {
+    static_assert(C % 4 == 0, "quad kernel needs a multiple of four channels");
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= numFrames; i += 4) {
+        for (int g = 0; g < C; g += 4) {
+            __m128 r0 = _mm_loadu_ps(src + (i + 0) * C + g);
+            __m128 r1 = _mm_loadu_ps(src + (i + 1) * C + g);
+            __m128 r2 = _mm_loadu_ps(src + (i + 2) * C + g);
+            __m128 r3 = _mm_loadu_ps(src + (i + 3) * C + g);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(dst[g + 0] + i, r0);
+            _mm_storeu_ps(dst[g + 1] + i, r1);
+            _mm_storeu_ps(dst[g + 2] + i, r2);
+            _mm_storeu_ps(dst[g + 3] + i, r3);
+        }
+    }
+#endif
+    for (; i < numFrames; ++i) {
+        for (int ch = 0; ch < C; ++ch) {
+            dst[ch][i] = src[i * C + ch];
+        }
+    }
+}
+
+template <int C>
+void InterleaveQuad(const float* const* src, float* dst, size_t numFrames) {
+    static_assert(C % 4 == 0, "quad kernel needs a multiple of four channels");
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= numFrames; i += 4) {
+        for (int g = 0; g < C; g += 4) {
+            __m128 r0 = _mm_loadu_ps(src[g + 0] + i);
+            __m128 r1 = _mm_loadu_ps(src[g + 1] + i);
+            __m128 r2 = _mm_loadu_ps(src[g + 2] + i);
+            __m128 r3 = _mm_loadu_ps(src[g + 3] + i);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(dst + (i + 0) * C + g, r0);
+            _mm_storeu_ps(dst + (i + 1) * C + g, r1);
+            _mm_storeu_ps(dst + (i + 2) * C + g, r2);
+            _mm_storeu_ps(dst + (i + 3) * C + g, r3);
+        }
+    }
+#endif
+    for (; i < numFrames; ++i) {
+        for (int ch = 0; ch < C; ++ch) {
+            dst[i * C + ch] = src[ch][i];
+        }
+    }
+}
+
+// 5.1: a 4x4 transpose for the first four channels of four frames, and the
+// last two channels gathered as 64-bit pairs and split with one shuffle each
+void DeinterleaveSix(const float* src, float* const* dst, size_t numFrames) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= numFrames; i += 4) {
+        const float* f = src + i * 6;
+        __m128 r0 = _mm_loadu_ps(f);
+        __m128 r1 = _mm_loadu_ps(f + 6);
+        __m128 r2 = _mm_loadu_ps(f + 12);
+        __m128 r3 = _mm_loadu_ps(f + 18);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(dst[0] + i, r0);
+        _mm_storeu_ps(dst[1] + i, r1);
+        _mm_storeu_ps(dst[2] + i, r2);
+        _mm_storeu_ps(dst[3] + i, r3);
+        // 4 5 of frames 0 and 1, then of frames 2 and 3
+        __m128 a = _mm_loadh_pi(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(f + 4))),
+                                reinterpret_cast<const __m64*>(f + 10));
+        __m128 b = _mm_loadh_pi(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(f + 16))),
+                                reinterpret_cast<const __m64*>(f + 22));
+        _mm_storeu_ps(dst[4] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(dst[5] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+    for (; i < numFrames; ++i) {
+        for (int ch = 0; ch < 6; ++ch) {
+            dst[ch][i] = src[i * 6 + ch];
+        }
+    }
+}
+
+void InterleaveSix(const float* const* src, float* dst, size_t numFrames) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= numFrames; i += 4) {
+        float* f = dst + i * 6;
+        __m128 r0 = _mm_loadu_ps(src[0] + i);
+        __m128 r1 = _mm_loadu_ps(src[1] + i);
+        __m128 r2 = _mm_loadu_ps(src[2] + i);
+        __m128 r3 = _mm_loadu_ps(src[3] + i);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(f, r0);
+        _mm_storeu_ps(f + 6, r1);
+        _mm_storeu_ps(f + 12, r2);
+        _mm_storeu_ps(f + 18, r3);
+        __m128 c4 = _mm_loadu_ps(src[4] + i);
+        __m128 c5 = _mm_loadu_ps(src[5] + i);
+        __m128 lo = _mm_unpacklo_ps(c4, c5);  // 4 5 of frames 0 and 1
+        __m128 hi = _mm_unpackhi_ps(c4, c5);  // 4 5 of frames 2 and 3
+        _mm_storel_pi(reinterpret_cast<__m64*>(f + 4), lo);
+        _mm_storeh_pi(reinterpret_cast<__m64*>(f + 10), lo);
+        _mm_storel_pi(reinterpret_cast<__m64*>(f + 16), hi);
+        _mm_storeh_pi(reinterpret_cast<__m64*>(f + 22), hi);
+    }
+#endif
+    for (; i < numFrames; ++i) {
+        for (int ch = 0; ch < 6; ++ch) {
+            dst[i * 6 + ch] = src[ch][i];
+        }
+    }
+}
+
+void Deinterleave(const float* src, float* const* dst, int numChannels, size_t numFrames) {
+    switch (numChannels) {
+        case 1: memcpy(dst[0], src, numFrames * sizeof(float)); break;
+        case 2: Deinterleave2(src, dst[0], dst[1], numFrames); break;
+        case 4: DeinterleaveQuad<4>(src, dst, numFrames); break;
+        case 6: DeinterleaveSix(src, dst, numFrames); break;
+        case 8: DeinterleaveQuad<8>(src, dst, numFrames); break;
+        default:
+            for (size_t i = 0; i < numFrames; ++i) {
+                for (int ch = 0; ch < numChannels; ++ch) {
+                    dst[ch][i] = src[i * numChannels + ch];
+                }
+            }
+            break;
+    }
+}
+
+void Interleave(const float* const* src, float* dst, int numChannels, size_t numFrames) {
+    switch (numChannels) {
+        case 1: memcpy(dst, src[0], numFrames * sizeof(float)); break;
+        case 2: Interleave2(src[0], src[1], dst, numFrames); break;
+        case 4: InterleaveQuad<4>(src, dst, numFrames); break;
+        case 6: InterleaveSix(src, dst, numFrames); break;
+        case 8: InterleaveQuad<8>(src, dst, numFrames); break;
+        default:
+            for (size_t i = 0; i < numFrames; ++i) {
+                for (int ch = 0; ch < numChannels; ++ch) {
+                    dst[i * numChannels + ch] = src[ch][i];
+                }
+            }
+            break;
+    }
+}
+
+void Int16ToFloat(const int16_t* src, float* dst, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 wide = _mm256_set1_ps(1.0f / PCM16_SCALE);
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), wide));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(1.0f / PCM16_SCALE);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // Sign-extend by unpacking into the high half and shifting back down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t scale = vdupq_n_f32(1.0f / PCM16_SCALE);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = src[i] * (1.0f / PCM16_SCALE);
+    }
+}
+
+void Int24ToFloat(const uint8_t* src, float* dst, size_t count) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // Move each 3-byte sample into the top of a 32-bit lane; the low byte is zero
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m128 scale = _mm_set1_ps(1.0f / PCM32_SCALE);
+    // Each load reads 16 bytes but consumes 12, so stop while a full load still fits
+    for (; i + 6 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i));
+        __m128i s = _mm_shuffle_epi8(v, shuffle);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(s), scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        const uint8_t* p = src + 3 * i;
+        int32_t v = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) |
+                                         (static_cast<uint32_t>(p[1]) << 16) |
+                                         (static_cast<uint32_t>(p[2]) << 24));
+        dst[i] = v * (1.0f / PCM32_SCALE);
+    }
+}
+
+void Int32ToFloat(const int32_t* src, float* dst, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 wide = _mm256_set1_ps(1.0f / PCM32_SCALE);
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), wide));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(1.0f / PCM32_SCALE);
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = src[i] * (1.0f / PCM32_SCALE);
+    }
+}
+
+// Clamps are written out rather than with std::min/max (see the top)
+inline float Clamp(float v, float lo, float hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+void FloatToInt16(const float* src, int16_t* dst, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(PCM16_SCALE);
+    const __m128 lo = _mm_set1_ps(-PCM16_SCALE);
+    const __m128 hi = _mm_set1_ps(PCM16_SCALE - 1.0f);
+    for (; i + 8 <= count; i += 8) {
+        // cvtps rounds to nearest under the default MXCSR rounding mode
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lo), hi);
+        __m128i a32 = _mm_cvtps_epi32(a);
+        __m128i b32 = _mm_cvtps_epi32(b);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a32, b32));
+    }
+#endif
+    for (; i < count; ++i) {
+        float v = Clamp(src[i] * PCM16_SCALE, -PCM16_SCALE, PCM16_SCALE - 1.0f);
+        dst[i] = static_cast<int16_t>(lrintf(v));
+    }
+}
+
+void FloatToInt24(const float* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        float v = Clamp(src[i] * PCM24_SCALE, -PCM24_SCALE, PCM24_SCALE - 1.0f);
+        int32_t s = static_cast<int32_t>(lrintf(v));
+        dst[3 * i + 0] = static_cast<uint8_t>(s);
+        dst[3 * i + 1] = static_cast<uint8_t>(s >> 8);
+        dst[3 * i + 2] = static_cast<uint8_t>(s >> 16);
+    }
+}
+
+void FloatToInt32(const float* src, int32_t* dst, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(PCM32_SCALE);
+    const __m128 lo = _mm_set1_ps(-PCM32_SCALE);
+    const __m128 hi = _mm_set1_ps(PCM32_MAX);
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_cvtps_epi32(v));
+    }
+#endif
+    for (; i < count; ++i) {
+        float v = Clamp(src[i] * PCM32_SCALE, -PCM32_SCALE, PCM32_MAX);
+        dst[i] = static_cast<int32_t>(lrintf(v));
+    }
+}
+
+inline uint32_t XorShift32(uint32_t& x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// Uniform [0, 1) from the top 23 bits of a random word
+inline float UniformFromBits(uint32_t bits) {
+    uint32_t u = (bits >> 9) | 0x3F800000u;
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f - 1.0f;
+}
+
+void SanitizeTile(float* tile, size_t count, size_t* nanCount, size_t* clipCount) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(tile + i);
+        __m128 ordered = _mm_cmpord_ps(x, x);
+        *nanCount += __builtin_popcount(~_mm_movemask_ps(ordered) & 0xF);
+        x = _mm_and_ps(x, ordered);
+        __m128 over = _mm_cmpgt_ps(_mm_and_ps(x, absMask), one);
+        *clipCount += __builtin_popcount(_mm_movemask_ps(over));
+        _mm_storeu_ps(tile + i, _mm_min_ps(_mm_max_ps(x, minusOne), one));
+    }
+#endif
+    for (; i < count; ++i) {
+        float x = tile[i];
+        if (x != x) {
+            x = 0.0f;
+            ++*nanCount;
+        } else if (x > 1.0f || x < -1.0f) {
+            x = x > 0.0f ? 1.0f : -1.0f;
+            ++*clipCount;
+        }
+        tile[i] = x;
+    }
+}
+
+// Round to the `bits` grid with optional TPDF dither, leaving exact
+// multiples of one LSB so the final integer conversion is lossless. Every
+// x86 build runs the same four-lane loop, one generator per lane, so the
+// dither sequence doesn't depend on the build.
+void QuantizeTile(float* tile, size_t count, int bits, bool dither, uint32_t* rng) {
+    const float scale = static_cast<float>(1 << (bits - 1));
+    const float lsb = 1.0f / scale;
+    const float qMin = -scale;
+    const float qMax = scale - 1.0f;
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 vScale = _mm_set1_ps(scale);
+    const __m128 vLsb = _mm_set1_ps(lsb);
+    const __m128 vMin = _mm_set1_ps(qMin);
+    const __m128 vMax = _mm_set1_ps(qMax);
+    const __m128 vOne = _mm_set1_ps(1.0f);
+    const __m128i exponent = _mm_set1_epi32(0x3F800000);
+    __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rng));
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(tile + i), vScale);
+        if (dither) {
+            __m128 u[2];
+            for (__m128& draw : u) {
+                lanes = _mm_xor_si128(lanes, _mm_slli_epi32(lanes, 13));
+                lanes = _mm_xor_si128(lanes, _mm_srli_epi32(lanes, 17));
+                lanes = _mm_xor_si128(lanes, _mm_slli_epi32(lanes, 5));
+                draw = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(lanes, 9), exponent)), vOne);
+            }
+            v = _mm_add_ps(v, _mm_sub_ps(u[0], u[1]));
+        }
+        v = _mm_min_ps(_mm_max_ps(v, vMin), vMax);
+        __m128 q = _mm_cvtepi32_ps(_mm_cvtps_epi32(v));
+        _mm_storeu_ps(tile + i, _mm_mul_ps(q, vLsb));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rng), lanes);
+#endif
+    for (; i < count; ++i) {
+        float v = tile[i] * scale;
+        if (dither) {
+            v += UniformFromBits(XorShift32(rng[0])) - UniformFromBits(XorShift32(rng[0]));
+        }
+        v = Clamp(v, qMin, qMax);
+        tile[i] = nearbyintf(v) * lsb;
+    }
+}
+
+// First-order error feedback pushes the requantization noise towards
+// Nyquist. The feedback loop is serial per channel, so this runs frame by
+// frame with the channels of each frame side by side.
+void NoiseShapeTile(float* tile, size_t numFrames, int numChannels, int bits, uint32_t* rng, float* error) {
+    const float scale = static_cast<float>(1 << (bits - 1));
+    const float lsb = 1.0f / scale;
+    const float qMin = -scale;
+    const float qMax = scale - 1.0f;
+
+    for (size_t f = 0; f < numFrames; ++f) {
+        float* frame = tile + f * numChannels;
+        for (int ch = 0; ch < numChannels; ++ch) {
+            float v = frame[ch] * scale - error[ch];
+            float d = UniformFromBits(XorShift32(rng[ch & 3])) - UniformFromBits(XorShift32(rng[ch & 3]));
+            float q = nearbyintf(Clamp(v + d, qMin, qMax));
+            // Bound the feedback so a clipped sample cannot destabilize the loop
+            error[ch] = Clamp(q - v, -4.0f, 4.0f);
+            frame[ch] = q * lsb;
+        }
+    }
+}
+
+// KissFFT built with this file's flags (KissFFT<ISA>.c)
+void Fft(kiss_fft_state* plan, const float* in, float* out) {
+    HRAW_KISS_NAME(hraw_kiss_fft, HRAW_KERNEL_NAMESPACE)(plan, reinterpret_cast<const kiss_fft_cpx*>(in),
+                                                         reinterpret_cast<kiss_fft_cpx*>(out));
+}
+
+} // namespace
+
+const KernelTable TABLE = {
+    Magnitude,
+    Multiply,
+    Accumulate,
+    AccumulateSquares,
+    DivideNonZero,
+    BoxSmooth,
+    ResampleLinear,
+    RealToComplex,
+    RealPartScaled,
+    Deinterleave2,
+    Interleave2,
+    Deinterleave,
+    Interleave,
+    Int16ToFloat,
+    Int24ToFloat,
+    Int32ToFloat,
+    FloatToInt16,
+    FloatToInt24,
+    FloatToInt32,
+    SanitizeTile,
+    QuantizeTile,
+    NoiseShapeTile,
+    Fft,
+};
+
+} // namespace HRAW_KERNEL_NAMESPACE
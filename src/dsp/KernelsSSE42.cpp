@@ -0,0 +1,16 @@
+// SSE4.2 build of the kernels; CMake compiles this file with -msse4.2
+#include "KernelTable.h"
+
+#if defined(__SSE4_2__)
+#define HRAW_KERNEL_NAMESPACE sse42
+#include "KernelsImpl.h"
+
+const KernelTable* Sse42Kernels() {
+    return &sse42::TABLE;
+}
+#else
+// Not an x86 build, or a compiler without the flag
+const KernelTable* Sse42Kernels() {
+    return nullptr;
+}
+#endif
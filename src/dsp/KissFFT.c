@@ -0,0 +1,4 @@
+// Default build of KissFFT's transform, compiled with the kernels'
+// floating-point flags so it rounds like the others
+#define HRAW_KISS_ISA scalar
+#include "KissFFTImpl.h"
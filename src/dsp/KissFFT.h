@@ -0,0 +1,22 @@
+#pragma once
+
+// KissFFT's transform, compiled once per instruction set like the kernels
+// (KissFFT.c and the KissFFT<ISA>.c files) and reached through
+// Kernels::Fft. Every build takes a plan from kiss_fft_alloc.
+#include <kiss_fft.h>
+
+#define HRAW_KISS_PASTE(name, isa) name##_##isa
+#define HRAW_KISS_NAME(name, isa) HRAW_KISS_PASTE(name, isa)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void hraw_kiss_fft_scalar(kiss_fft_cfg cfg, const kiss_fft_cpx* fin, kiss_fft_cpx* fout);
+void hraw_kiss_fft_sse42(kiss_fft_cfg cfg, const kiss_fft_cpx* fin, kiss_fft_cpx* fout);
+void hraw_kiss_fft_avx2(kiss_fft_cfg cfg, const kiss_fft_cpx* fin, kiss_fft_cpx* fout);
+void hraw_kiss_fft_avx512(kiss_fft_cfg cfg, const kiss_fft_cpx* fin, kiss_fft_cpx* fout);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+// AVX2 build of KissFFT's transform; CMake compiles this file with -mavx2.
+// Elsewhere it is one more default build, which nothing calls.
+#define HRAW_KISS_ISA avx2
+#include "KissFFTImpl.h"
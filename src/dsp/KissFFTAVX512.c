@@ -0,0 +1,4 @@
+// AVX-512 build of KissFFT's transform; CMake compiles this file with -mavx512f/bw/dq/vl.
+// Elsewhere it is one more default build, which nothing calls.
+#define HRAW_KISS_ISA avx512
+#include "KissFFTImpl.h"
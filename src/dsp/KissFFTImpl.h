@@ -0,0 +1,17 @@
+// KissFFT's sources, included once per instruction set by KissFFT.c and
+// the KissFFT<ISA>.c files with HRAW_KISS_ISA set. Its public functions
+// get the suffix so the builds link side by side; the layout of a plan
+// doesn't change, so one from kiss_fft_alloc works with every build.
+#include "KissFFT.h"
+
+#ifndef HRAW_KISS_ISA
+#error "Define HRAW_KISS_ISA before including KissFFTImpl.h"
+#endif
+
+#define kiss_fft HRAW_KISS_NAME(hraw_kiss_fft, HRAW_KISS_ISA)
+#define kiss_fft_stride HRAW_KISS_NAME(hraw_kiss_fft_stride, HRAW_KISS_ISA)
+#define kiss_fft_alloc HRAW_KISS_NAME(hraw_kiss_fft_alloc, HRAW_KISS_ISA)
+#define kiss_fft_cleanup HRAW_KISS_NAME(hraw_kiss_fft_cleanup, HRAW_KISS_ISA)
+#define kiss_fft_next_fast_size HRAW_KISS_NAME(hraw_kiss_fft_next_fast_size, HRAW_KISS_ISA)
+
+#include <kiss_fft.c>
@@ -0,0 +1,4 @@
+// SSE4.2 build of KissFFT's transform; CMake compiles this file with -msse4.2.
+// Elsewhere it is one more default build, which nothing calls.
+#define HRAW_KISS_ISA sse42
+#include "KissFFTImpl.h"
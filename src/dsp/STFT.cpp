@@ -1,8 +1,29 @@
 #include "STFT.h"
 #include "FFT.h"
+#include "Kernels.h"
+#include "../util/CancellationToken.h"
+#include "../util/TaskScheduler.h"
+#include <atomic>
 #include <cmath>
 #include <algorithm>
 
+namespace {
+
+// Frames per parallel chunk at least; one frame is tens of microseconds
+constexpr size_t FRAME_GRAIN = 16;
+
+// Samples per chunk when normalizing the overlap-add
+constexpr size_t SAMPLE_GRAIN = 65536;
+
+} // namespace
+
+struct STFT::FrameFft {
+    explicit FrameFft(int fftSize) : fft(fftSize), frame(fftSize) {}
+    
+    FFT fft;
+    std::vector<float> frame;
+};
+
 STFT::STFT(int fftSize, int hopSize) 
     : fftSize(fftSize), hopSize(hopSize) {
     fft = std::make_unique<FFT>(fftSize);
@@ -22,69 +43,167 @@ void STFT::CreateWindow() {
 
 std::vector<float> STFT::ApplyWindow(const std::vector<float>& frame) {
     std::vector<float> windowed(frame.size());
-    for (size_t i = 0; i < frame.size(); ++i) {
-        windowed[i] = frame[i] * window[i];
-    }
+    Kernels::Multiply(frame.data(), window.data(), windowed.data(), frame.size());
     return windowed;
 }
 
-std::vector<std::vector<std::complex<float>>> STFT::Forward(const std::vector<float>& signal) {
-    int numFrames = (signal.size() - fftSize) / hopSize + 1;
-    std::vector<std::vector<std::complex<float>>> spectrogram(numFrames);
-    
-    for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx) {
-        int startIdx = frameIdx * hopSize;
-        
-        // Extract frame
-        std::vector<float> frame(fftSize);
-        for (int i = 0; i < fftSize; ++i) {
-            if (startIdx + i < static_cast<int>(signal.size())) {
-                frame[i] = signal[startIdx + i];
-            } else {
-                frame[i] = 0.0f; // Zero padding
-            }
+int STFT::NumFrames(size_t length) const {
+    if (length < static_cast<size_t>(fftSize)) {
+        return 0;
+    }
+    return static_cast<int>((length - fftSize) / hopSize) + 1;
+}
+
+std::unique_ptr<STFT::FrameFft> STFT::AcquireFft() {
+    {
+        std::lock_guard<std::mutex> lock(fftPoolMutex);
+        if (!fftPool.empty()) {
+            std::unique_ptr<FrameFft> fft = std::move(fftPool.back());
+            fftPool.pop_back();
+            return fft;
+        }
+    }
+    return std::make_unique<FrameFft>(fftSize);
+}
+
+void STFT::ReleaseFft(std::unique_ptr<FrameFft> fft) {
+    std::lock_guard<std::mutex> lock(fftPoolMutex);
+    fftPool.push_back(std::move(fft));
+}
+
+std::vector<std::complex<float>> STFT::ForwardFrame(const std::vector<float>& signal, size_t start) {
+    return ForwardFrame(*fft, signal, start);
+}
+
+std::vector<std::complex<float>> STFT::ForwardFrame(FFT& fft, const std::vector<float>& signal, size_t start) {
+    // Extract frame
+    std::vector<float> frame(fftSize);
+    for (int i = 0; i < fftSize; ++i) {
+        if (start + i < signal.size()) {
+            frame[i] = signal[start + i];
+        } else {
+            frame[i] = 0.0f; // Zero padding
         }
-        
-        // Apply window
-        frame = ApplyWindow(frame);
-        
-        // Perform FFT
-        spectrogram[frameIdx] = fft->Forward(frame);
     }
     
+    // Apply window
+    frame = ApplyWindow(frame);
+    
+    // Perform FFT
+    return fft.Forward(frame);
+}
+
+std::vector<float> STFT::InverseFrame(const std::vector<std::complex<float>>& spectrum) {
+    return InverseFrame(*fft, spectrum);
+}
+
+std::vector<float> STFT::InverseFrame(FFT& fft, const std::vector<std::complex<float>>& spectrum) {
+    // Perform inverse FFT, then window for overlap-add
+    std::vector<float> frame = fft.Inverse(spectrum);
+    Kernels::Multiply(frame.data(), window.data(), frame.data(), fftSize);
+    return frame;
+}
+
+std::vector<std::vector<std::complex<float>>> STFT::Forward(const std::vector<float>& signal,
+                                                            const CancellationToken* cancel) {
+    std::vector<std::vector<std::complex<float>>> spectrogram;
+    if (!Forward(signal, spectrogram, cancel)) {
+        return {};
+    }
     return spectrogram;
 }
 
-std::vector<float> STFT::Inverse(const std::vector<std::vector<std::complex<float>>>& spectrogram) {
-    if (spectrogram.empty()) {
+std::vector<float> STFT::Inverse(const std::vector<std::vector<std::complex<float>>>& spectrogram,
+                                 const CancellationToken* cancel) {
+    std::vector<float> output, windowSum;
+    if (!Inverse(spectrogram, output, windowSum, cancel)) {
         return {};
     }
+    return output;
+}
+
+bool STFT::Forward(const std::vector<float>& signal,
+                   std::vector<std::vector<std::complex<float>>>& spectrogram,
+                   const CancellationToken* cancel) {
+    int numFrames = NumFrames(signal.size());
+    spectrogram.resize(numFrames);
+    
+    // Frames are independent; each chunk has its own FFT. Same arithmetic
+    // as ForwardFrame, in the frames' own storage.
+    std::atomic<bool> cancelled{false};
+    ParallelFor(0, numFrames, FRAME_GRAIN, [&](size_t first, size_t last) {
+        std::unique_ptr<FrameFft> chunkFft = AcquireFft();
+        for (size_t frameIdx = first; frameIdx < last; ++frameIdx) {
+            if (CancellationToken::IsCancelled(cancel)) {
+                cancelled = true;
+                break;
+            }
+            const size_t start = frameIdx * hopSize;
+            const size_t used = std::min(static_cast<size_t>(fftSize), signal.size() - start);
+            Kernels::Multiply(signal.data() + start, window.data(), chunkFft->frame.data(), used);
+            spectrogram[frameIdx].resize(fftSize / 2 + 1);
+            chunkFft->fft.Forward(chunkFft->frame.data(), used, spectrogram[frameIdx].data());
+        }
+        ReleaseFft(std::move(chunkFft));
+    });
+    return !cancelled;
+}
+
+bool STFT::Inverse(const std::vector<std::vector<std::complex<float>>>& spectrogram,
+                   std::vector<float>& output,
+                   std::vector<float>& windowSum,
+                   const CancellationToken* cancel) {
+    if (spectrogram.empty()) {
+        output.clear();
+        return true;
+    }
     
     int numFrames = spectrogram.size();
     int outputSize = (numFrames - 1) * hopSize + fftSize;
-    std::vector<float> output(outputSize, 0.0f);
-    std::vector<float> windowSum(outputSize, 0.0f);
+    output.assign(outputSize, 0.0f);
+    windowSum.assign(outputSize, 0.0f);
     
-    for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx) {
-        // Perform inverse FFT
-        std::vector<float> frame = fft->Inverse(spectrogram[frameIdx]);
-        
-        // Apply window and overlap-add
-        int startIdx = frameIdx * hopSize;
-        for (int i = 0; i < fftSize; ++i) {
-            if (startIdx + i < outputSize) {
-                output[startIdx + i] += frame[i] * window[i];
-                windowSum[startIdx + i] += window[i] * window[i];
+    std::atomic<bool> cancelled{false};
+    auto overlapAdd = [&](size_t first, size_t last) {
+        std::unique_ptr<FrameFft> chunkFft = AcquireFft();
+        float* frame = chunkFft->frame.data();
+        for (size_t frameIdx = first; frameIdx < last; ++frameIdx) {
+            if (CancellationToken::IsCancelled(cancel)) {
+                cancelled = true;
+                break;
             }
+            
+            // As InverseFrame: inverse FFT, then window for overlap-add
+            const std::vector<std::complex<float>>& spectrum = spectrogram[frameIdx];
+            chunkFft->fft.Inverse(spectrum.data(), spectrum.size(), frame);
+            Kernels::Multiply(frame, window.data(), frame, fftSize);
+            
+            // Overlap-add
+            int startIdx = static_cast<int>(frameIdx) * hopSize;
+            const size_t count = std::min(fftSize, outputSize - startIdx);
+            Kernels::Accumulate(output.data() + startIdx, frame, count);
+            Kernels::AccumulateSquares(windowSum.data() + startIdx, window.data(), count);
         }
+        ReleaseFft(std::move(chunkFft));
+    };
+    
+    // With at most two frames over any sample, chunks that aren't neighbours
+    // never touch the same samples, and each sample's two terms sum the same
+    // in either order, so the result is bit-identical to one pass in order
+    if (2 * hopSize >= fftSize) {
+        ParallelForNonAdjacent(0, numFrames, FRAME_GRAIN, overlapAdd);
+    } else {
+        overlapAdd(0, numFrames);
+    }
+    if (cancelled) {
+        output.clear();
+        return false;
     }
     
     // Normalize by window sum to maintain amplitude
-    for (int i = 0; i < outputSize; ++i) {
-        if (windowSum[i] > 0.0f) {
-            output[i] /= windowSum[i];
-        }
-    }
+    ParallelFor(0, outputSize, SAMPLE_GRAIN, [&](size_t first, size_t last) {
+        Kernels::DivideNonZero(output.data() + first, windowSum.data() + first, last - first);
+    });
     
-    return output;
-}
\ No newline at end of file
+    return true;
+}
@@ -3,19 +3,56 @@
 #include <vector>
 #include <complex>
 #include <memory>
+#include <mutex>
 
 class FFT;
+class CancellationToken;
 
 class STFT {
 public:
     STFT(int fftSize, int hopSize);
     ~STFT();
     
-    // Forward STFT - returns complex spectrogram
-    std::vector<std::vector<std::complex<float>>> Forward(const std::vector<float>& signal);
+    // Forward STFT - returns complex spectrogram. Checks `cancel` once per
+    // frame and returns an empty spectrogram if it fires. Forward and
+    // Inverse split the frames across the shared TaskScheduler and may be
+    // called from several threads at once.
+    std::vector<std::vector<std::complex<float>>> Forward(const std::vector<float>& signal,
+                                                          const CancellationToken* cancel = nullptr);
     
-    // Inverse STFT - returns time-domain signal
-    std::vector<float> Inverse(const std::vector<std::vector<std::complex<float>>>& spectrogram);
+    // Inverse STFT - returns time-domain signal, or empty if cancelled
+    std::vector<float> Inverse(const std::vector<std::vector<std::complex<float>>>& spectrogram,
+                               const CancellationToken* cancel = nullptr);
+    
+    // The same into the caller's buffers, reusing their storage (and each
+    // frame's) from an earlier call; false if cancelled. `windowSum` is
+    // scratch for the overlap-add normalization.
+    bool Forward(const std::vector<float>& signal,
+                 std::vector<std::vector<std::complex<float>>>& spectrogram,
+                 const CancellationToken* cancel = nullptr);
+    bool Inverse(const std::vector<std::vector<std::complex<float>>>& spectrogram,
+                 std::vector<float>& output,
+                 std::vector<float>& windowSum,
+                 const CancellationToken* cancel = nullptr);
+    
+    // Single-frame building blocks. Forward and Inverse do the same
+    // arithmetic, so callers working a frame at a time get bit-identical
+    // results.
+    
+    // Number of frames Forward produces for `length` samples
+    int NumFrames(size_t length) const;
+    
+    // Windowed FFT of the frame starting at sample `start`
+    std::vector<std::complex<float>> ForwardFrame(const std::vector<float>& signal, size_t start);
+    
+    // Inverse FFT of one frame, windowed and ready to overlap-add. Inverse
+    // divides each output sample by the summed squared window of every
+    // frame that covers it.
+    std::vector<float> InverseFrame(const std::vector<std::complex<float>>& spectrum);
+    
+    int FftSize() const { return fftSize; }
+    int HopSize() const { return hopSize; }
+    const std::vector<float>& Window() const { return window; }
     
 private:
     int fftSize;
@@ -25,7 +62,17 @@ private:
     // Window function (Hann window)
     std::vector<float> window;
     
+    // FFTs with a frame of scratch each, for the frame ranges Forward and
+    // Inverse run in parallel, kept for the next call
+    struct FrameFft;
+    std::mutex fftPoolMutex;
+    std::vector<std::unique_ptr<FrameFft>> fftPool;
+    
     // Helper functions
     void CreateWindow();
     std::vector<float> ApplyWindow(const std::vector<float>& frame);
+    std::unique_ptr<FrameFft> AcquireFft();
+    void ReleaseFft(std::unique_ptr<FrameFft> fft);
+    std::vector<std::complex<float>> ForwardFrame(FFT& fft, const std::vector<float>& signal, size_t start);
+    std::vector<float> InverseFrame(FFT& fft, const std::vector<std::complex<float>>& spectrum);
 };
\ No newline at end of file
@@ -0,0 +1,248 @@
+#include "DirectoryModel.h"
+#include "../util/Log.h"
+#include "../util/Trace.h"
+#include <algorithm>
+#include <cctype>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Directories whose listings are kept; older ones are read again on revisit
+constexpr size_t MAX_CACHED_DIRECTORIES = 32;
+
+// How often the current directory's write time is checked
+constexpr std::chrono::seconds REVALIDATE_INTERVAL(2);
+
+std::string ToLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string SizeLabel(uintmax_t size) {
+    if (size < 1024) return std::to_string(size) + " B";
+    if (size < 1024 * 1024) return std::to_string(size / 1024) + " KB";
+    return std::to_string(size / (1024 * 1024)) + " MB";
+}
+
+} // namespace
+
+DirectoryModel::DirectoryModel() {
+    worker = std::thread(&DirectoryModel::WorkerLoop, this);
+}
+
+DirectoryModel::~DirectoryModel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ++generation;  // Abandon a read in progress
+    wake.notify_one();
+    worker.join();
+}
+
+void DirectoryModel::SetPath(const fs::path& newPath) {
+    if (newPath == path && (listing || pending)) return;
+    path = newPath;
+
+    auto it = cache.find(path.string());
+    if (it != cache.end()) {
+        it->second->lastUse = ++clock;
+        Show(it->second);
+    } else {
+        Show(nullptr);
+    }
+    Schedule(false);
+}
+
+void DirectoryModel::Refresh() {
+    Schedule(true);
+}
+
+void DirectoryModel::Update() {
+    std::vector<Result> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.swap(results);
+    }
+
+    for (Result& result : finished) {
+        if (result.listing) {
+            // Listings of directories left meanwhile are still worth keeping
+            Insert(result.path.string(), result.listing);
+            if (result.path == path) Show(result.listing);
+        }
+        if (result.generation == generation.load()) {
+            pending = false;
+            lastCheck = Clock::now();
+        }
+    }
+
+    if (!pending && Clock::now() - lastCheck >= REVALIDATE_INTERVAL) {
+        Schedule(false);
+    }
+}
+
+void DirectoryModel::SetExtensionFilter(const std::vector<std::string>& extensions) {
+    extensionFilter.clear();
+    for (const auto& extension : extensions) extensionFilter.push_back(ToLower(extension));
+    ApplyFilter(false);
+}
+
+void DirectoryModel::SetNameFilter(const std::string& text) {
+    std::string lower = ToLower(text);
+    if (lower == nameFilter) return;
+
+    // Anything matching the new text also matched the old one
+    const bool narrowed = lower.find(nameFilter) != std::string::npos;
+    nameFilter = std::move(lower);
+    ApplyFilter(narrowed);
+}
+
+bool DirectoryModel::IsLoading() const {
+    return !listing;
+}
+
+const std::string& DirectoryModel::GetError() const {
+    static const std::string none;
+    return listing ? listing->error : none;
+}
+
+void DirectoryModel::Schedule(bool force) {
+    auto next = std::make_unique<Request>();
+    next->path = path;
+    next->cached = force ? nullptr : listing;
+    next->generation = ++generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request = std::move(next);
+    }
+    wake.notify_one();
+    pending = true;
+    lastCheck = Clock::now();
+}
+
+void DirectoryModel::Show(std::shared_ptr<const Listing> newListing) {
+    listing = std::move(newListing);
+    ApplyFilter(false);
+}
+
+void DirectoryModel::Insert(const std::string& key, std::shared_ptr<Listing> newListing) {
+    newListing->lastUse = ++clock;
+    cache[key] = std::move(newListing);
+
+    // The listing on screen is held by `listing` even if evicted here
+    while (cache.size() > MAX_CACHED_DIRECTORIES) {
+        auto oldest = cache.begin();
+        for (auto it = cache.begin(); it != cache.end(); ++it) {
+            if (it->second->lastUse < oldest->second->lastUse) oldest = it;
+        }
+        cache.erase(oldest);
+    }
+}
+
+void DirectoryModel::ApplyFilter(bool narrowed) {
+    if (!listing) {
+        visible.clear();
+        return;
+    }
+
+    if (narrowed) {
+        visible.erase(std::remove_if(visible.begin(), visible.end(),
+                                     [this](size_t index) { return !Matches(listing->entries[index]); }),
+                      visible.end());
+        return;
+    }
+
+    visible.clear();
+    for (size_t i = 0; i < listing->entries.size(); ++i) {
+        if (Matches(listing->entries[i])) visible.push_back(i);
+    }
+}
+
+bool DirectoryModel::Matches(const Entry& entry) const {
+    if (!entry.isDirectory && !extensionFilter.empty() &&
+        std::find(extensionFilter.begin(), extensionFilter.end(), entry.extension) == extensionFilter.end()) {
+        return false;
+    }
+    return nameFilter.empty() || entry.lowerName.find(nameFilter) != std::string::npos;
+}
+
+void DirectoryModel::WorkerLoop() {
+    while (true) {
+        std::unique_ptr<Request> next;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || request; });
+            if (stopping) return;
+            next = std::move(request);
+        }
+
+        Result result;
+        result.path = next->path;
+        result.generation = next->generation;
+
+        // Adding, removing or renaming an entry updates the directory's write time
+        std::error_code ec;
+        const auto modified = fs::last_write_time(next->path, ec);
+        if (!next->cached || ec || next->cached->modified != modified) {
+            result.listing = Read(next->path, next->generation);
+            if (!result.listing) continue;  // Superseded
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+    }
+}
+
+std::shared_ptr<DirectoryModel::Listing> DirectoryModel::Read(const fs::path& directory,
+                                                              uint64_t requestGeneration) {
+    HRAW_TRACE_SCOPE("list directory");
+    const auto start = Clock::now();
+    auto result = std::make_shared<Listing>();
+
+    std::error_code ec;
+    result->modified = fs::last_write_time(directory, ec);
+    fs::directory_iterator it;
+    if (!ec) it = fs::directory_iterator(directory, fs::directory_options::skip_permission_denied, ec);
+
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (generation.load() != requestGeneration) return nullptr;
+
+        const fs::directory_entry& item = *it;
+        Entry entry;
+        entry.name = item.path().filename().string();
+        if (entry.name.empty() || entry.name[0] == '.') continue;  // Hidden
+
+        std::error_code typeError;
+        if (item.is_directory(typeError)) {
+            entry.isDirectory = true;
+            entry.label = "[DIR] " + entry.name;
+        } else if (item.is_regular_file(typeError)) {
+            std::error_code sizeError;
+            const uintmax_t size = item.file_size(sizeError);
+            entry.label = sizeError ? entry.name : entry.name + " (" + SizeLabel(size) + ")";
+            entry.extension = ToLower(item.path().extension().string());
+        } else {
+            continue;
+        }
+        entry.lowerName = ToLower(entry.name);
+        result->entries.push_back(std::move(entry));
+    }
+    if (ec) {
+        result->error = ec.message();
+        HRAW_LOG_WARN("Can't list " << directory.string() << ": " << result->error);
+    }
+
+    // Sorted once here instead of on every frame
+    std::sort(result->entries.begin(), result->entries.end(), [](const Entry& a, const Entry& b) {
+        if (a.isDirectory != b.isDirectory) return a.isDirectory;
+        return a.name < b.name;
+    });
+
+    HRAW_LOG_DEBUG("Listed " << result->entries.size() << " entries of " << directory.string() << " in "
+                   << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count()
+                   << " ms");
+    return result;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Directory listings for FileDialog, enumerated off the UI thread.
+//
+// Each directory is read once on a background thread, sorted (directories
+// first, then by name) and cached by path. Revisiting a directory shows the
+// cached listing at once while the worker compares the directory's write
+// time and re-reads it only if entries were added, removed or renamed. The
+// current directory is revalidated the same way every couple of seconds.
+//
+// Filters produce a list of indices into the sorted listing, so the dialog
+// can draw just the visible rows. Narrowing the name filter (typing another
+// character) only rescans the rows that matched before.
+//
+// All methods are called from the UI thread.
+class DirectoryModel {
+public:
+    struct Entry {
+        std::string name;
+        std::string label;      // What the dialog shows, with "[DIR] " or the size
+        std::string lowerName;  // For the name filter
+        std::string extension;  // Lowercase, with the dot
+        bool isDirectory = false;
+    };
+
+    DirectoryModel();
+    ~DirectoryModel();
+
+    DirectoryModel(const DirectoryModel&) = delete;
+    DirectoryModel& operator=(const DirectoryModel&) = delete;
+
+    // Show `path`, from the cache if it was read before
+    void SetPath(const std::filesystem::path& path);
+    const std::filesystem::path& GetPath() const { return path; }
+
+    // Re-read the current directory even if its write time is unchanged
+    void Refresh();
+
+    // Call once per frame: takes finished listings and schedules revalidation
+    void Update();
+
+    // Lowercase extensions with the dot; empty shows every file
+    void SetExtensionFilter(const std::vector<std::string>& extensions);
+
+    // Case-insensitive substring of the name; empty shows everything
+    void SetNameFilter(const std::string& text);
+
+    // True until the first listing of the current path arrives
+    bool IsLoading() const;
+
+    // Why the current directory couldn't be read, if it couldn't
+    const std::string& GetError() const;
+
+    size_t NumVisible() const { return visible.size(); }
+    const Entry& GetVisible(size_t index) const { return listing->entries[visible[index]]; }
+
+    // Every entry of the current directory, before filtering
+    size_t NumEntries() const { return listing ? listing->entries.size() : 0; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Listing {
+        std::filesystem::file_time_type modified;
+        std::vector<Entry> entries;
+        std::string error;
+        uint64_t lastUse = 0;
+    };
+
+    struct Request {
+        std::filesystem::path path;
+        std::shared_ptr<const Listing> cached;  // Null or forced: always re-read
+        uint64_t generation = 0;
+    };
+
+    struct Result {
+        std::filesystem::path path;
+        std::shared_ptr<Listing> listing;  // Null: the cached listing is still current
+        uint64_t generation = 0;
+    };
+
+    std::filesystem::path path;
+    std::shared_ptr<const Listing> listing;
+    std::unordered_map<std::string, std::shared_ptr<Listing>> cache;
+    uint64_t clock = 0;
+    bool pending = false;
+    Clock::time_point lastCheck;
+
+    std::vector<std::string> extensionFilter;
+    std::string nameFilter;
+    std::vector<size_t> visible;
+
+    // Worker state, guarded by `mutex`
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::unique_ptr<Request> request;
+    std::vector<Result> results;
+    bool stopping = false;
+    std::atomic<uint64_t> generation{0};
+    std::thread worker;
+
+    void Schedule(bool force);
+    void Show(std::shared_ptr<const Listing> newListing);
+    void Insert(const std::string& key, std::shared_ptr<Listing> newListing);
+    void ApplyFilter(bool narrowed);
+    bool Matches(const Entry& entry) const;
+
+    void WorkerLoop();
+    std::shared_ptr<Listing> Read(const std::filesystem::path& directory, uint64_t requestGeneration);
+};
@@ -1,50 +1,40 @@
 #include "FileDialog.h"
 #include <imgui.h>
-#include <algorithm>
-#include <cctype>
+#include <cstdlib>
 
 namespace fs = std::filesystem;
 
 FileDialog::FileDialog() {
-    // Start in the user's home directory
-    currentPath = fs::path(getenv("HOME"));
-    
     // Default audio file extensions
-    extensionFilter = {".wav", ".flac", ".ogg", ".mp3", ".aiff", ".aif", ".m4a"};
+    model.SetExtensionFilter({".wav", ".flac", ".ogg", ".mp3", ".aiff", ".aif", ".m4a"});
+    
+    // Start in the user's home directory
+    const char* home = std::getenv("HOME");
+    model.SetPath(fs::path(home ? home : "."));
 }
 
 FileDialog::~FileDialog() {
 }
 
 void FileDialog::SetExtensionFilter(const std::vector<std::string>& extensions) {
-    extensionFilter = extensions;
-}
-
-bool FileDialog::HasValidExtension(const fs::path& path) const {
-    if (extensionFilter.empty()) return true;
-    
-    std::string ext = path.extension().string();
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-    
-    for (const auto& filter : extensionFilter) {
-        std::string filterLower = filter;
-        std::transform(filterLower.begin(), filterLower.end(), filterLower.begin(), ::tolower);
-        if (ext == filterLower) return true;
-    }
-    return false;
+    model.SetExtensionFilter(extensions);
 }
 
 void FileDialog::NavigateTo(const fs::path& path) {
-    if (fs::exists(path) && fs::is_directory(path)) {
-        currentPath = path;
-    }
+    // The model reports a path that can't be listed; no blocking stat here
+    model.SetPath(path);
 }
 
-void FileDialog::Show(bool* p_open, std::function<void(const std::string&)> onFileSelected) {
+void FileDialog::Show(bool* p_open, std::function<void(const std::string&)> onFileSelected,
+                      std::function<void(const std::string&)> onFolderSelected) {
     if (!*p_open) return;
     
+    model.Update();
+    
     ImGui::SetNextWindowSize(ImVec2(700, 450), ImGuiCond_FirstUseEver);
     if (ImGui::Begin("Select Audio File", p_open)) {
+        const fs::path& currentPath = model.GetPath();
+        
         // Path bar
         ImGui::Text("Path: %s", currentPath.string().c_str());
         ImGui::Separator();
@@ -53,57 +43,48 @@ void FileDialog::Show(bool* p_open, std::function<void(const std::string&)> onFi
         if (ImGui::Button("..")) {
             NavigateTo(currentPath.parent_path());
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Refresh")) {
+            model.Refresh();
+        }
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(200);
+        if (ImGui::InputText("Filter", nameFilter, sizeof(nameFilter))) {
+            model.SetNameFilter(nameFilter);
+        }
+        if (!model.IsLoading()) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("%zu of %zu", model.NumVisible(), model.NumEntries());
+        }
         
         // File list
         ImGui::BeginChild("FileList", ImVec2(0, -ImGui::GetFrameHeightWithSpacing()));
         
-        try {
-            std::vector<fs::directory_entry> entries;
-            
-            // Collect and sort entries
-            for (const auto& entry : fs::directory_iterator(currentPath)) {
-                entries.push_back(entry);
-            }
-            
-            // Sort directories first, then files
-            std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
-                if (a.is_directory() != b.is_directory()) {
-                    return a.is_directory();
-                }
-                return a.path().filename() < b.path().filename();
-            });
-            
-            // Display entries
-            for (const auto& entry : entries) {
-                const auto& path = entry.path();
-                std::string filename = path.filename().string();
-                
-                // Skip hidden files
-                if (filename[0] == '.') continue;
+        if (model.IsLoading()) {
+            ImGui::TextDisabled("Loading...");
+        } else if (!model.GetError().empty()) {
+            ImGui::TextColored(ImVec4(1, 0, 0, 1), "Error: %s", model.GetError().c_str());
+        }
+        
+        // Only the rows in view are drawn. Navigation waits until the loop
+        // is done since it replaces the rows being iterated.
+        fs::path navigateTarget;
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(model.NumVisible()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                const DirectoryModel::Entry& entry = model.GetVisible(i);
+                const fs::path path = currentPath / entry.name;
                 
-                if (entry.is_directory()) {
-                    // Directory
-                    std::string label = "[DIR] " + filename;
-                    if (ImGui::Selectable(label.c_str(), false, ImGuiSelectableFlags_AllowDoubleClick)) {
+                if (entry.isDirectory) {
+                    if (ImGui::Selectable(entry.label.c_str(), false, ImGuiSelectableFlags_AllowDoubleClick)) {
                         if (ImGui::IsMouseDoubleClicked(0)) {
-                            NavigateTo(path);
+                            navigateTarget = path;
                         }
                     }
-                } else if (entry.is_regular_file() && HasValidExtension(path)) {
+                } else {
                     // Audio file
-                    std::string label = filename;
-                    
-                    // Add file size
-                    auto size = entry.file_size();
-                    if (size < 1024) {
-                        label += " (" + std::to_string(size) + " B)";
-                    } else if (size < 1024 * 1024) {
-                        label += " (" + std::to_string(size / 1024) + " KB)";
-                    } else {
-                        label += " (" + std::to_string(size / (1024 * 1024)) + " MB)";
-                    }
-                    
-                    if (ImGui::Selectable(label.c_str(), path.string() == selectedFile, ImGuiSelectableFlags_AllowDoubleClick)) {
+                    if (ImGui::Selectable(entry.label.c_str(), path.string() == selectedFile, ImGuiSelectableFlags_AllowDoubleClick)) {
                         selectedFile = path.string();
                         if (ImGui::IsMouseDoubleClicked(0)) {
                             onFileSelected(selectedFile);
@@ -112,12 +93,15 @@ void FileDialog::Show(bool* p_open, std::function<void(const std::string&)> onFi
                     }
                 }
             }
-        } catch (const std::exception& e) {
-            ImGui::TextColored(ImVec4(1, 0, 0, 1), "Error: %s", e.what());
         }
+        clipper.End();
         
         ImGui::EndChild();
         
+        if (!navigateTarget.empty()) {
+            NavigateTo(navigateTarget);
+        }
+        
         ImGui::Separator();
         
         // Selected file and buttons
@@ -132,6 +116,14 @@ void FileDialog::Show(bool* p_open, std::function<void(const std::string&)> onFi
             ImGui::SameLine();
         }
         
+        if (onFolderSelected) {
+            if (ImGui::Button("Add Folder")) {
+                onFolderSelected(currentPath.string());
+                *p_open = false;
+            }
+            ImGui::SameLine();
+        }
+        
         if (ImGui::Button("Cancel")) {
             *p_open = false;
         }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "DirectoryModel.h"
 #include <string>
 #include <vector>
 #include <filesystem>
@@ -10,20 +11,19 @@ public:
     FileDialog();
     ~FileDialog();
     
-    // Show the file dialog window
-    void Show(bool* p_open, std::function<void(const std::string&)> onFileSelected);
+    // Show the file dialog window. With `onFolderSelected` the dialog also
+    // offers to add the whole current folder.
+    void Show(bool* p_open, std::function<void(const std::string&)> onFileSelected,
+              std::function<void(const std::string&)> onFolderSelected = nullptr);
     
     // Set the file extensions to filter
     void SetExtensionFilter(const std::vector<std::string>& extensions);
     
 private:
-    std::filesystem::path currentPath;
-    std::vector<std::string> extensionFilter;
+    DirectoryModel model;
     std::string selectedFile;
-    
-    // Helper to check if a file has a valid extension
-    bool HasValidExtension(const std::filesystem::path& path) const;
+    char nameFilter[256] = "";
     
     // Navigate to a directory
     void NavigateTo(const std::filesystem::path& path);
-};
\ No newline at end of file
+};
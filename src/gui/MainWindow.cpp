@@ -1,23 +1,141 @@
 #include "MainWindow.h"
 #include "FileDialog.h"
 #include "../audio/AudioProcessor.h"
+#include "../audio/BatchPipeline.h"
+#include "../audio/AnalysisCache.h"
+#include "../audio/HFCompensation.h"
+#include "../util/Log.h"
+#include "../util/Memory.h"
+#include "../util/ResultCache.h"
 #include <imgui.h>
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <sstream>
+#include <unordered_set>
 
 namespace fs = std::filesystem;
 
+namespace {
+
+struct OutputFormatChoice {
+    OutputFormat::Container container;
+    int bitDepth;
+};
+
+const char* const OUTPUT_FORMAT_LABELS[] = {
+    "WAV 32-bit float", "WAV 24-bit", "WAV 16-bit", "FLAC 24-bit", "FLAC 16-bit"
+};
+
+const OutputFormatChoice OUTPUT_FORMATS[] = {
+    {OutputFormat::Container::WAV, 32},
+    {OutputFormat::Container::WAV, 24},
+    {OutputFormat::Container::WAV, 16},
+    {OutputFormat::Container::FLAC, 24},
+    {OutputFormat::Container::FLAC, 16},
+};
+
+const char* const DITHER_LABELS[] = {"None", "TPDF", "Noise shaped"};
+
+// In HFCompensation::Engine order
+const char* const ENGINE_LABELS[] = {"Harmonic", "Band replication (fast)"};
+
+// Share of installed memory one file may use when no budget is set. Up to
+// three files are in flight at once (decode, process, encode).
+constexpr uint64_t AUTO_BUDGET_DIVISOR = 4;
+
+// Seconds between process RSS samples
+constexpr double RSS_SAMPLE_INTERVAL = 0.5;
+
+// Longest region the preview renders, in seconds
+constexpr float MAX_PREVIEW_LENGTH = 60.0f;
+
+// Share of installed memory kept analyses may use before they're spilled or dropped
+constexpr uint64_t ANALYSIS_CACHE_DIVISOR = 8;
+
+// Inspector layout: pixels per drawn column and strip heights
+constexpr float INSPECT_COLUMN_WIDTH = 2.0f;
+constexpr float INSPECT_WAVEFORM_HEIGHT = 60.0f;
+constexpr float INSPECT_SPECTRUM_HEIGHT = 160.0f;
+
+// Inspector zoom per mouse wheel notch, and the closest zoom in seconds
+constexpr double INSPECT_ZOOM_STEP = 1.25;
+constexpr double INSPECT_MIN_VIEW = 0.05;
+
+// Spectrogram palette: black through blue and red to yellow
+ImU32 HeatColor(uint8_t value) {
+    const float v = value / 255.0f;
+    const float r = std::clamp(v * 3.0f - 1.0f, 0.0f, 1.0f);
+    const float g = std::clamp(v * 3.0f - 2.0f, 0.0f, 1.0f);
+    const float b = std::clamp(v < 0.5f ? v * 2.0f : 2.0f - v * 2.0f, 0.0f, 1.0f);
+    return IM_COL32(static_cast<int>(r * 255), static_cast<int>(g * 255), static_cast<int>(b * 255), 255);
+}
+
+// Batch progress needed before a time estimate is shown
+constexpr float ETA_MIN_PROGRESS = 0.02f;
+
+// 205 -> "3:25", 3723 -> "1:02:03"
+std::string FormatDuration(double seconds) {
+    const long total = static_cast<long>(seconds + 0.5);
+    char text[32];
+    if (total >= 3600) {
+        std::snprintf(text, sizeof(text), "%ld:%02ld:%02ld", total / 3600, total / 60 % 60, total % 60);
+    } else {
+        std::snprintf(text, sizeof(text), "%ld:%02ld", total / 60, total % 60);
+    }
+    return text;
+}
+
+// One input of a cutoff sweep and the file for each cutoff
+struct SweepJob {
+    std::string inputPath;
+    std::vector<AudioProcessor::SweepOutput> outputs;
+};
+
+// "14000, 16000" -> {14000, 16000}, sorted and without duplicates; entries
+// that aren't positive numbers are skipped
+std::vector<int> ParseCutoffs(const char* text) {
+    std::vector<int> cutoffs;
+    std::stringstream ss(text);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        const int cutoff = std::atoi(token.c_str());
+        if (cutoff > 0) cutoffs.push_back(cutoff);
+    }
+    std::sort(cutoffs.begin(), cutoffs.end());
+    cutoffs.erase(std::unique(cutoffs.begin(), cutoffs.end()), cutoffs.end());
+    return cutoffs;
+}
+
+} // namespace
+
 MainWindow::MainWindow() {
     audioProcessor = std::make_unique<AudioProcessor>();
     fileDialog = std::make_unique<FileDialog>();
 }
 
 MainWindow::~MainWindow() {
+    // Don't keep the process alive finishing a batch nobody will see
+    cancelToken.Cancel();
     if (processingThread && processingThread->joinable()) {
         processingThread->join();
     }
+    previewCancel.Cancel();
+    if (previewThread && previewThread->joinable()) {
+        previewThread->join();
+    }
+    ingestCancel.Cancel();
+    if (ingestThread && ingestThread->joinable()) {
+        ingestThread->join();
+    }
+    inspectCancel.Cancel();
+    if (inspectThread && inspectThread->joinable()) {
+        inspectThread->join();
+    }
 }
 
 void MainWindow::Draw() {
@@ -42,6 +160,8 @@ void MainWindow::Draw() {
     ImGui::Separator();
     DrawSettingsSection();
     ImGui::Separator();
+    DrawPreviewSection();
+    ImGui::Separator();
     DrawProcessingSection();
     ImGui::EndChild();
     
@@ -53,6 +173,8 @@ void MainWindow::Draw() {
     if (showFileDialog) {
         fileDialog->Show(&showFileDialog, [this](const std::string& path) {
             AddFile(path);
+        }, [this](const std::string& path) {
+            AddFolder(path);
         });
     }
 }
@@ -102,31 +224,48 @@ void MainWindow::DrawDropTarget() {
 void MainWindow::DrawFileSection() {
     ImGui::Text("Input Files");
     
-    // File list
+    if (ingestThread && !ingestRunning.load(std::memory_order_acquire)) {
+        FinishIngest();
+    }
+    
+    // File list; a whole library can be listed, so only visible rows are drawn
     ImGui::BeginChild("FileList", ImVec2(-1, 150), true);
     
-    for (size_t i = 0; i < inputFiles.size(); i++) {
-        std::string label = std::to_string(i + 1) + ". " + GetFileNameFromPath(inputFiles[i]);
-        
-        // Add a remove button for each file
-        std::string buttonId = "X##" + std::to_string(i);
-        if (ImGui::SmallButton(buttonId.c_str())) {
-            inputFiles.erase(inputFiles.begin() + i);
-            statusMessage = "Removed file";
-            break;
+    size_t removeIndex = inputFiles.size();
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(inputFiles.size()));
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            const size_t i = static_cast<size_t>(row);
+            std::string label = std::to_string(i + 1) + ". " + GetFileNameFromPath(inputFiles[i]);
+            auto info = inputInfo.find(inputFiles[i]);
+            if (info != inputInfo.end()) {
+                label += " (" + FormatDuration(info->second.DurationSeconds()) + ")";
+            }
+            
+            // Add a remove button for each file
+            std::string buttonId = "X##" + std::to_string(i);
+            if (ImGui::SmallButton(buttonId.c_str())) {
+                removeIndex = i;
+            }
+            ImGui::SameLine();
+            
+            ImGui::Text("%s", label.c_str());
         }
-        ImGui::SameLine();
-        
-        ImGui::Text("%s", label.c_str());
     }
+    clipper.End();
     
     // Show drag & drop hint if empty
-    if (inputFiles.empty()) {
-        ImGui::TextDisabled("Click 'Add Files' to select audio files");
+    if (inputFiles.empty() && !ingestRunning) {
+        ImGui::TextDisabled("Click 'Add Files' to select audio files or a folder");
     }
     
     ImGui::EndChild();
     
+    if (removeIndex < inputFiles.size()) {
+        RemoveFile(removeIndex);
+    }
+    
     // Buttons
     if (ImGui::Button("Add Files", ImVec2(100, 0))) {
         showFileDialog = true;
@@ -136,7 +275,13 @@ void MainWindow::DrawFileSection() {
         ClearFiles();
     }
     ImGui::SameLine();
-    ImGui::Text("%zu files selected", inputFiles.size());
+    ImGui::Checkbox("Include Subfolders", &recursiveIngest);
+    ImGui::SameLine();
+    if (ingestRunning) {
+        ImGui::Text("Scanning folder...");
+    } else {
+        ImGui::Text("%zu files selected", inputFiles.size());
+    }
 }
 
 void MainWindow::DrawSettingsSection() {
@@ -148,6 +293,16 @@ void MainWindow::DrawSettingsSection() {
         ImGui::Indent();
         ImGui::SliderInt("Lowpass Frequency (Hz)", &lowpassFreq, 6000, 192000);
         
+        ImGui::Checkbox("Sweep Cutoffs", &sweepEnabled);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Render each file once per cutoff, analyzing it only once\n"
+                              "Outputs are named <file>_enhanced_lp<cutoff>");
+        }
+        if (sweepEnabled) {
+            ImGui::SameLine();
+            ImGui::InputText("Cutoffs (Hz)", sweepCutoffs, sizeof(sweepCutoffs));
+        }
+        
         // Sample rate multiplier as a slider
         ImGui::SliderInt("Sample Rate Multiplier", &sampleRateMultiplier, 1, 16);
         if (ImGui::IsItemHovered()) {
@@ -157,24 +312,363 @@ void MainWindow::DrawSettingsSection() {
         // Show the resulting sample rate
         ImGui::TextDisabled("(Output will be input sample rate × %d)", sampleRateMultiplier);
         
+        ImGui::Combo("Engine", &engineIndex, ENGINE_LABELS, IM_ARRAYSIZE(ENGINE_LABELS));
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Harmonic synthesizes overtones of every spectral peak\n"
+                              "Band replication copies the octave below the cutoff upward at a fixed,\n"
+                              "much lower cost, for bulk archival work");
+        }
+        
         ImGui::Checkbox("Compressed Source Mode", &compressedMode);
         if (ImGui::IsItemHovered()) {
             ImGui::SetTooltip("Optimized settings for heavily compressed audio sources");
         }
         ImGui::Unindent();
     }
+    
+    ImGui::Combo("Output Format", &outputFormatIndex, OUTPUT_FORMAT_LABELS, IM_ARRAYSIZE(OUTPUT_FORMAT_LABELS));
+    if (OUTPUT_FORMATS[outputFormatIndex].bitDepth < 32) {
+        ImGui::Combo("Dither", &ditherIndex, DITHER_LABELS, IM_ARRAYSIZE(DITHER_LABELS));
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Applied when reducing to integer samples\nNoise shaped moves the dither noise towards Nyquist");
+        }
+    }
+    
+    ImGui::InputInt("Memory Budget per File (MiB)", &memoryBudgetMiB, 256, 1024);
+    memoryBudgetMiB = std::max(0, memoryBudgetMiB);
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Files that would need more are processed with a low-memory path\n"
+                          "The output is the same, only the memory use differs\n"
+                          "0 uses a quarter of installed memory");
+    }
+    
+    ImGui::Checkbox("Keep Analysis Between Runs", &keepAnalysis);
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Reprocessing a file with only the cutoff changed skips loading,\n"
+                          "upsampling and analysis; uses up to an eighth of installed memory\n"
+                          "Long files are rendered in segments and never kept");
+    }
+    if (keepAnalysis) {
+        ImGui::SameLine();
+        ImGui::Checkbox("Spill to Disk", &spillAnalysis);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Analyses that don't fit in memory go to a temporary folder instead of being dropped");
+        }
+    }
+    
+    ImGui::Checkbox("Reuse Unchanged Results", &reuseResults);
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Files already processed with the same settings are restored from the cache\n"
+                          "instead of being processed again");
+    }
+    ImGui::SameLine();
+    if (processing) ImGui::BeginDisabled();
+    if (ImGui::SmallButton("Clear Cache")) {
+        if (!resultCache) resultCache = std::make_unique<ResultCache>(ResultCache::DefaultDirectory());
+        resultCache->Clear();
+        resultCache->Save();
+        statusMessage = "Result cache cleared";
+    }
+    if (processing) ImGui::EndDisabled();
+}
+
+void MainWindow::DrawPreviewSection() {
+    ImGui::Text("Preview");
+    
+    // Pick up a finished render
+    if (previewThread && !previewRunning.load(std::memory_order_acquire)) {
+        previewThread->join();
+        previewThread.reset();
+        statusMessage = previewStatus;
+    }
+    
+    if (inputFiles.empty()) {
+        ImGui::TextDisabled("Add a file to preview a region of it");
+        return;
+    }
+    
+    previewFileIndex = std::clamp(previewFileIndex, 0, static_cast<int>(inputFiles.size()) - 1);
+    const std::string previewName = GetFileNameFromPath(inputFiles[previewFileIndex]);
+    if (ImGui::BeginCombo("File", previewName.c_str())) {
+        for (size_t i = 0; i < inputFiles.size(); ++i) {
+            std::string label = GetFileNameFromPath(inputFiles[i]) + "##preview" + std::to_string(i);
+            if (ImGui::Selectable(label.c_str(), static_cast<int>(i) == previewFileIndex)) {
+                previewFileIndex = static_cast<int>(i);
+            }
+        }
+        ImGui::EndCombo();
+    }
+    
+    ImGui::DragFloat("Start (s)", &previewStart, 0.5f, 0.0f, 24.0f * 3600.0f, "%.1f");
+    previewStart = std::max(0.0f, previewStart);
+    ImGui::SliderFloat("Length (s)", &previewLength, 1.0f, MAX_PREVIEW_LENGTH, "%.1f");
+    
+    const bool busy = previewRunning.load(std::memory_order_acquire);
+    if (busy) ImGui::BeginDisabled();
+    if (ImGui::Button("Render Preview", ImVec2(150, 0))) {
+        RenderPreview();
+    }
+    if (busy) ImGui::EndDisabled();
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Processes only this region with the current settings and writes it,\n"
+                          "with the untouched original for comparison, to the temp folder");
+    }
+    if (busy) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("Rendering...");
+    }
+    
+    ImGui::SameLine();
+    if (ImGui::Button("Inspect Spectrum", ImVec2(150, 0))) {
+        InspectFile();
+    }
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Processes the whole file in the background and shows its spectrum\n"
+                          "before and after HFC as it goes");
+    }
+    
+    if (!inspectFile.empty()) {
+        DrawInspector();
+    }
+}
+
+void MainWindow::DrawInspector() {
+    if (inspectThread && !inspectRunning.load(std::memory_order_acquire)) {
+        inspectThread->join();
+        inspectThread.reset();
+    }
+    
+    ImGui::RadioButton("Before HFC", &inspectView, 0);
+    ImGui::SameLine();
+    ImGui::RadioButton("After HFC", &inspectView, 1);
+    ImGui::SameLine();
+    
+    const Overview& overview = inspectView == 1 ? inspectOutput : inspectInput;
+    const double duration = overview.DurationSeconds();
+    if (inspectRunning) {
+        const JobStage stage = inspectProgress.Stage();
+        ImGui::TextDisabled("%s: %s %.0f%%", GetFileNameFromPath(inspectFile).c_str(), JobStageName(stage),
+                            inspectProgress.StageProgress() * 100.0f);
+    } else {
+        ImGui::TextDisabled("%s", GetFileNameFromPath(inspectFile).c_str());
+    }
+    if (duration <= 0.0) {
+        if (!inspectRunning) ImGui::TextDisabled("Nothing to show; HFC needs a stereo file");
+        return;
+    }
+    
+    if (inspectViewLength <= 0.0 || inspectViewLength > duration) {
+        inspectViewLength = duration;
+    }
+    ImGui::Text("%s - %s of %s", FormatDuration(inspectViewStart).c_str(),
+                FormatDuration(inspectViewStart + inspectViewLength).c_str(), FormatDuration(duration).c_str());
+    
+    // One canvas for both strips; wheel zooms around the cursor, dragging
+    // pans and a double-click moves the preview start there
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float width = std::max(ImGui::GetContentRegionAvail().x, 2 * INSPECT_COLUMN_WIDTH);
+    ImGui::InvisibleButton("InspectCanvas", ImVec2(width, INSPECT_WAVEFORM_HEIGHT + INSPECT_SPECTRUM_HEIGHT));
+    const ImGuiIO& io = ImGui::GetIO();
+    const double cursorTime = inspectViewStart + (io.MousePos.x - origin.x) / width * inspectViewLength;
+    if (ImGui::IsItemHovered() && io.MouseWheel != 0.0f) {
+        const double length = std::clamp(inspectViewLength * std::pow(INSPECT_ZOOM_STEP, -io.MouseWheel),
+                                         std::min(INSPECT_MIN_VIEW, duration), duration);
+        inspectViewStart = cursorTime - (cursorTime - inspectViewStart) * length / inspectViewLength;
+        inspectViewLength = length;
+    }
+    if (ImGui::IsItemActive() && ImGui::IsMouseDragging(0)) {
+        inspectViewStart -= io.MouseDelta.x / width * inspectViewLength;
+    }
+    if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
+        previewStart = static_cast<float>(std::max(0.0, cursorTime));
+    }
+    inspectViewStart = std::clamp(inspectViewStart, 0.0, duration - inspectViewLength);
+    
+    // Only as many columns as fit; the overview picks the matching level
+    const int numColumns = static_cast<int>(width / INSPECT_COLUMN_WIDTH);
+    const double secondsPerColumn = inspectViewLength / numColumns;
+    overview.ReadWaveform(inspectViewStart, secondsPerColumn, numColumns, inspectWaveform);
+    overview.ReadSpectrum(inspectViewStart, secondsPerColumn, numColumns, inspectSpectrum);
+    
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    const float waveTop = origin.y;
+    const float specTop = origin.y + INSPECT_WAVEFORM_HEIGHT;
+    const float specBottom = specTop + INSPECT_SPECTRUM_HEIGHT;
+    draw->AddRectFilled(origin, ImVec2(origin.x + width, specBottom), IM_COL32(0, 0, 0, 255));
+    
+    const float waveCenter = waveTop + INSPECT_WAVEFORM_HEIGHT * 0.5f;
+    const float waveScale = (INSPECT_WAVEFORM_HEIGHT * 0.5f - 1.0f) / 127.0f;
+    const float rowHeight = INSPECT_SPECTRUM_HEIGHT / Overview::SPECTRUM_ROWS;
+    for (int i = 0; i < numColumns; ++i) {
+        const float x0 = origin.x + i * INSPECT_COLUMN_WIDTH;
+        const float x1 = x0 + INSPECT_COLUMN_WIDTH;
+        
+        const Overview::Bucket bucket = inspectWaveform[i];
+        if (bucket.min <= bucket.max) {
+            draw->AddRectFilled(ImVec2(x0, waveCenter - bucket.max * waveScale),
+                                ImVec2(x1, waveCenter - bucket.min * waveScale + 1.0f), IM_COL32(110, 190, 255, 255));
+        }
+        
+        // Runs of rows with the same shade become one rectangle
+        const uint8_t* rows = &inspectSpectrum[static_cast<size_t>(i) * Overview::SPECTRUM_ROWS];
+        int row = 0;
+        while (row < Overview::SPECTRUM_ROWS) {
+            const int shade = rows[row] >> 3;
+            int end = row + 1;
+            while (end < Overview::SPECTRUM_ROWS && (rows[end] >> 3) == shade) ++end;
+            if (shade > 0) {
+                draw->AddRectFilled(ImVec2(x0, specBottom - end * rowHeight), ImVec2(x1, specBottom - row * rowHeight),
+                                    HeatColor(static_cast<uint8_t>(shade << 3)));
+            }
+            row = end;
+        }
+    }
+    
+    // The current cutoff, to check it against what's in the material
+    const int nyquist = overview.SampleRate() / 2;
+    if (nyquist > 0 && lowpassFreq < nyquist) {
+        const float y = specBottom - INSPECT_SPECTRUM_HEIGHT * lowpassFreq / nyquist;
+        draw->AddLine(ImVec2(origin.x, y), ImVec2(origin.x + width, y), IM_COL32(255, 255, 255, 160));
+    }
+}
+
+void MainWindow::InspectFile() {
+    if (inputFiles.empty()) return;
+    inspectCancel.Cancel();
+    if (inspectThread && inspectThread->joinable()) {
+        inspectThread->join();
+    }
+    
+    inspectFile = inputFiles[previewFileIndex];
+    inspectViewStart = 0.0;
+    inspectViewLength = 0.0;
+    inspectInput.Reset(0, 0, 0, HFCompensation::FFTSIZE, HFCompensation::HOPSIZE);
+    inspectOutput.Reset(0, 0, 0, HFCompensation::FFTSIZE, HFCompensation::HOPSIZE);
+    
+    // Its own processor, so it can run beside a batch; the output is dropped
+    AudioProcessor::Options options = GetProcessingOptions();
+    options.enableHFC = true;
+    const std::string inputPath = inspectFile;
+    inspectCancel.Reset();
+    inspectRunning.store(true, std::memory_order_release);
+    inspectThread = std::make_unique<std::thread>([this, inputPath, options]() {
+        AudioProcessor processor;
+        processor.SetOverviews(&inspectInput, &inspectOutput);
+        AudioProcessor::AudioData audio;
+        const bool ok = processor.Decode(inputPath, audio, options, &inspectProgress, &inspectCancel) &&
+                        processor.Process(audio, options, &inspectProgress, &inspectCancel);
+        if (!ok && !inspectCancel.IsCancelled()) {
+            HRAW_LOG_WARN("Couldn't inspect " << inputPath);
+        }
+        inspectRunning.store(false, std::memory_order_release);
+    });
+}
+
+void MainWindow::RenderPreview() {
+    if (previewRunning || inputFiles.empty()) return;
+    if (previewThread && previewThread->joinable()) {
+        previewThread->join();
+    }
+    
+    const std::string inputPath = inputFiles[previewFileIndex];
+    const AudioProcessor::Options options = GetProcessingOptions();
+    const double start = previewStart;
+    const double length = previewLength;
+    
+    std::error_code ec;
+    const fs::path tempDir = fs::temp_directory_path(ec);
+    const std::string previewPath = (tempDir / (std::string("hrawiz_preview") + options.outputFormat.Extension())).string();
+    const std::string originalPath =
+        (tempDir / (std::string("hrawiz_preview_original") + options.outputFormat.Extension())).string();
+    
+    previewCancel.Reset();
+    previewRunning.store(true, std::memory_order_release);
+    statusMessage = "Rendering preview...";
+    
+    previewThread = std::make_unique<std::thread>([this, inputPath, options, start, length, previewPath,
+                                                   originalPath]() {
+        const auto began = std::chrono::steady_clock::now();
+        AudioProcessor::Options originalOptions = options;
+        originalOptions.enableHFC = false;
+        
+        AudioProcessor::AudioData audio;
+        const bool ok =
+            audioProcessor->RenderRegion(inputPath, start, length, options, audio, nullptr, &previewCancel) &&
+            audioProcessor->Encode(previewPath, audio, options, nullptr, &previewCancel) &&
+            audioProcessor->RenderRegion(inputPath, start, length, originalOptions, audio, nullptr, &previewCancel) &&
+            audioProcessor->Encode(originalPath, audio, originalOptions, nullptr, &previewCancel);
+        
+        std::stringstream ss;
+        if (ok) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+            ss << "Preview written to " << previewPath << " (original: " << originalPath << ") in "
+               << static_cast<int>(seconds * 1000.0 + 0.5) << " ms";
+        } else {
+            ss << "Preview failed for " << GetFileNameFromPath(inputPath);
+        }
+        previewStatus = ss.str();
+        previewRunning.store(false, std::memory_order_release);
+    });
 }
 
 void MainWindow::DrawProcessingSection() {
     ImGui::Text("Processing");
     
-    // Show current file being processed
-    if (processing && !currentProcessingFile.empty()) {
-        ImGui::Text("Processing: %s", GetFileNameFromPath(currentProcessingFile).c_str());
+    // Workers only publish telemetry; all UI state is updated here
+    if (processing && telemetry.IsFinished()) {
+        OnProcessingComplete();
+    }
+    
+    if (processing) {
+        progress = telemetry.BatchProgress();
+        
+        const double now = ImGui::GetTime();
+        if (now - rssSampleTime >= RSS_SAMPLE_INTERVAL) {
+            processRss = Memory::CurrentRss();
+            rssSampleTime = now;
+        }
+        if (processRss > 0) {
+            ImGui::Text("Memory: %llu MiB resident",
+                        static_cast<unsigned long long>(processRss / Memory::MIB));
+        }
+        
+        // One line per job that is actively being worked on
+        for (size_t i = 0; i < telemetry.NumJobs(); ++i) {
+            const JobProgress& job = telemetry.Job(i);
+            const JobStage stage = job.Stage();
+            if (stage == JobStage::Queued || stage == JobStage::Done ||
+                stage == JobStage::Failed || stage == JobStage::Cancelled) {
+                continue;
+            }
+            
+            std::string name = GetFileNameFromPath(batchFiles[i]);
+            const unsigned long long memoryMiB = job.MemoryBytes() / Memory::MIB;
+            if (stage == JobStage::Synthesizing) {
+                ImGui::Text("%s: %s %.0f%% (%.0f frames/s, %.1fx realtime, %llu MiB)", name.c_str(),
+                            JobStageName(stage), job.StageProgress() * 100.0f, job.UnitsPerSecond(),
+                            job.RealtimeFactor(), memoryMiB);
+            } else {
+                ImGui::Text("%s: %s (%llu MiB)", name.c_str(), JobStageName(stage), memoryMiB);
+            }
+        }
+        
+        if (!cancelToken.IsCancelled()) {
+            std::stringstream ss;
+            ss << "Processing... " << telemetry.CountInStage(JobStage::Done) << "/" << telemetry.NumJobs()
+               << " files done";
+            if (size_t failed = telemetry.CountInStage(JobStage::Failed)) {
+                ss << ", " << failed << " failed";
+            }
+            if (progress >= ETA_MIN_PROGRESS) {
+                const double elapsed = ImGui::GetTime() - batchStartTime;
+                ss << ", about " << FormatDuration(elapsed * (1.0 - progress) / progress) << " left";
+            }
+            statusMessage = ss.str();
+        }
     }
     
     // Progress bar
-    ImGui::ProgressBar(progress.load(), ImVec2(-1, 0));
+    ImGui::ProgressBar(progress, ImVec2(-1, 0));
     
     // Process button
     bool canProcess = !inputFiles.empty() && !processing;
@@ -193,8 +687,8 @@ void MainWindow::DrawProcessingSection() {
     if (processing) {
         ImGui::SameLine();
         if (ImGui::Button("Cancel", ImVec2(100, 30))) {
-            // TODO: Implement cancellation
-            statusMessage = "Cancellation not yet implemented";
+            cancelToken.Cancel();
+            statusMessage = "Cancelling...";
         }
     }
 }
@@ -204,19 +698,29 @@ void MainWindow::DrawStatusBar() {
     ImGui::Text("Status: %s", statusMessage.c_str());
 }
 
-void MainWindow::AddFile(const std::string& path) {
-    if (!IsAudioFile(path)) {
+void MainWindow::AddFile(const std::string& selectedPath) {
+    const std::string path = FolderIngest::NormalPath(selectedPath);
+    if (!FolderIngest::HasAudioExtension(path)) {
         statusMessage = "Not a valid audio file: " + GetFileNameFromPath(path);
         return;
     }
     
     // Check if file already exists in the list
-    if (std::find(inputFiles.begin(), inputFiles.end(), path) != inputFiles.end()) {
+    if (inputInfo.count(path)) {
         statusMessage = "File already in list: " + GetFileNameFromPath(path);
         return;
     }
     
+    // Rejected now rather than failing partway through a batch
+    AudioProbe probe;
+    std::string reason;
+    if (!FolderIngest::Probe(path, probe, reason)) {
+        statusMessage = "Can't use " + GetFileNameFromPath(path) + ": " + reason;
+        return;
+    }
+    
     inputFiles.push_back(path);
+    inputInfo.emplace(path, std::move(probe));
     statusMessage = "Added: " + GetFileNameFromPath(path);
 }
 
@@ -224,14 +728,78 @@ void MainWindow::AddFiles() {
     showFileDialog = true;
 }
 
+void MainWindow::AddFolder(const std::string& path) {
+    if (ingestRunning) {
+        statusMessage = "Still scanning the previous folder";
+        return;
+    }
+    if (ingestThread && ingestThread->joinable()) {
+        ingestThread->join();
+    }
+    
+    // Headers are probed in parallel off the UI thread; FinishIngest merges the result
+    std::unordered_set<std::string> known;
+    for (const auto& [file, info] : inputInfo) known.insert(file);
+    ingestCancel.Reset();
+    ingestRunning = true;
+    statusMessage = "Scanning " + path + "...";
+    const bool recursive = recursiveIngest;
+    ingestThread = std::make_unique<std::thread>([this, path, recursive, known = std::move(known)]() {
+        ingestResult = FolderIngest::Scan({path}, recursive, known, &ingestCancel);
+        ingestRunning.store(false, std::memory_order_release);
+    });
+}
+
+void MainWindow::FinishIngest() {
+    ingestThread->join();
+    ingestThread.reset();
+    
+    // Files listed by hand while the scan ran may show up again
+    size_t added = 0;
+    size_t duplicates = ingestResult.duplicates;
+    for (AudioProbe& probe : ingestResult.files) {
+        std::string path = probe.path;
+        if (inputInfo.emplace(path, std::move(probe)).second) {
+            inputFiles.push_back(std::move(path));
+            ++added;
+        } else {
+            ++duplicates;
+        }
+    }
+    
+    std::stringstream ss;
+    ss << "Added " << added << " files";
+    if (!ingestResult.rejected.empty()) {
+        ss << ", skipped " << ingestResult.rejected.size() << " unusable (see log)";
+    }
+    if (duplicates > 0) {
+        ss << ", " << duplicates << " already listed";
+    }
+    statusMessage = ss.str();
+    ingestResult = FolderIngest::Result();
+}
+
+void MainWindow::RemoveFile(size_t index) {
+    inputInfo.erase(inputFiles[index]);
+    inputFiles.erase(inputFiles.begin() + index);
+    statusMessage = "Removed file";
+}
+
 void MainWindow::ClearFiles() {
     inputFiles.clear();
+    inputInfo.clear();
     statusMessage = "File list cleared";
 }
 
 void MainWindow::ProcessFiles() {
     if (inputFiles.empty() || processing) return;
     
+    const std::vector<int> cutoffs = sweepEnabled && enableHFC ? ParseCutoffs(sweepCutoffs) : std::vector<int>();
+    if (sweepEnabled && enableHFC && cutoffs.empty()) {
+        statusMessage = "Enter at least one sweep cutoff";
+        return;
+    }
+    
     // Make sure previous thread is finished
     if (processingThread && processingThread->joinable()) {
         processingThread->join();
@@ -240,72 +808,134 @@ void MainWindow::ProcessFiles() {
     processing = true;
     progress = 0.0f;
     statusMessage = "Processing...";
+    cancelToken.Reset();
     
-    // Process files in a separate thread
-    processingThread = std::make_unique<std::thread>([this]() {
-        int totalFiles = inputFiles.size();
-        int successCount = 0;
-        
-        for (int i = 0; i < totalFiles; i++) {
-            // Update current file being processed
-            currentProcessingFile = inputFiles[i];
-            
-            // Generate output path
-            fs::path inputPath(inputFiles[i]);
-            fs::path outputPath = inputPath.parent_path() / 
-                (inputPath.stem().string() + "_enhanced" + inputPath.extension().string());
-            
-            statusMessage = "Processing: " + GetFileNameFromPath(inputFiles[i]);
-            
-            // Call the audio processor
-            bool success = audioProcessor->ProcessFile(
-                inputFiles[i],
-                outputPath.string(),
-                enableHFC,
-                lowpassFreq,
-                compressedMode,
-                sampleRateMultiplier,
-                [this, i, totalFiles](float fileProgress) {
-                    // Update overall progress
-                    float overallProgress = (i + fileProgress) / totalFiles;
-                    progress = overallProgress;
-                }
-            );
-            
-            if (success) {
-                successCount++;
-                statusMessage = "Completed: " + GetFileNameFromPath(inputFiles[i]);
-            } else {
-                statusMessage = "Error processing: " + GetFileNameFromPath(inputFiles[i]);
+    // Settings are captured when the batch starts so the UI can change them freely
+    const AudioProcessor::Options options = GetProcessingOptions();
+    
+    // Analyses outlive batches; a change of spill setting starts a new cache
+    audioProcessor->SetAnalysisCache(nullptr);
+    if (!keepAnalysis) {
+        analysisCache.reset();
+    } else if (!analysisCache || analysisCacheSpills != spillAnalysis) {
+        analysisCache = std::make_unique<AnalysisCache>(
+            Memory::PhysicalBytes() / ANALYSIS_CACHE_DIVISOR,
+            spillAnalysis ? AnalysisCache::DefaultSpillDirectory() : std::string());
+        analysisCacheSpills = spillAnalysis;
+    }
+    audioProcessor->SetAnalysisCache(analysisCache.get());
+    
+    // The worker only sees the jobs and the telemetry slots sized here
+    // Jobs are weighted by their probed length so progress and the time
+    // estimate track work rather than file count
+    batchFiles = inputFiles;
+    batchSweepCount = cutoffs.size();
+    batchStartTime = ImGui::GetTime();
+    std::vector<double> jobCosts;
+    for (const auto& file : inputFiles) {
+        auto info = inputInfo.find(file);
+        jobCosts.push_back(info != inputInfo.end() ? static_cast<double>(info->second.numSamples) : 0.0);
+    }
+    telemetry.BeginBatch(jobCosts);
+    
+    if (!cutoffs.empty()) {
+        std::vector<SweepJob> sweeps;
+        for (const auto& file : inputFiles) {
+            fs::path inputPath(file);
+            SweepJob sweep{file, {}};
+            for (int cutoff : cutoffs) {
+                fs::path outputPath = inputPath.parent_path() /
+                    (inputPath.stem().string() + "_enhanced_lp" + std::to_string(cutoff) +
+                     options.outputFormat.Extension());
+                sweep.outputs.push_back({cutoff, outputPath.string()});
             }
+            sweeps.push_back(std::move(sweep));
         }
         
-        // Final status
-        std::stringstream ss;
-        ss << "Processing complete! " << successCount << "/" << totalFiles << " files processed successfully";
-        statusMessage = ss.str();
-        currentProcessingFile.clear();
-        
-        OnProcessingComplete();
+        // Files one after another; each is analyzed once and synthesized per cutoff
+        processingThread = std::make_unique<std::thread>([this, options, sweeps]() {
+            const auto start = std::chrono::steady_clock::now();
+            BatchPipeline::Stats stats;
+            for (size_t i = 0; i < sweeps.size(); ++i) {
+                if (audioProcessor->ProcessSweep(sweeps[i].inputPath, sweeps[i].outputs, options,
+                                                 &telemetry.Job(i), &cancelToken)) {
+                    ++stats.succeeded;
+                } else if (cancelToken.IsCancelled()) {
+                    ++stats.cancelled;
+                } else {
+                    ++stats.failed;
+                }
+            }
+            stats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            batchStats = stats;
+            telemetry.FinishBatch();
+        });
+        return;
+    }
+    
+    // Output paths are fixed up front; the list itself stays with the UI thread
+    std::vector<BatchPipeline::Job> jobs;
+    for (const auto& file : inputFiles) {
+        fs::path inputPath(file);
+        fs::path outputPath = inputPath.parent_path() / 
+            (inputPath.stem().string() + "_enhanced" + options.outputFormat.Extension());
+        jobs.push_back({file, outputPath.string()});
+    }
+    
+    if (reuseResults && !resultCache) {
+        resultCache = std::make_unique<ResultCache>(ResultCache::DefaultDirectory());
+    }
+    ResultCache* cache = reuseResults ? resultCache.get() : nullptr;
+    
+    // Decode, HFC and encode overlap across files on the pipeline's threads
+    processingThread = std::make_unique<std::thread>([this, options, jobs, cache]() {
+        BatchPipeline pipeline(*audioProcessor, options, &cancelToken, &telemetry, cache);
+        batchStats = pipeline.Run(jobs);
+        telemetry.FinishBatch();
     });
 }
 
 void MainWindow::OnProcessingComplete() {
+    if (processingThread && processingThread->joinable()) {
+        processingThread->join();
+    }
+    
+    // Final status
+    std::stringstream ss;
+    const size_t totalFiles = batchFiles.size();
+    if (batchStats.cancelled > 0) {
+        ss << "Cancelled. " << batchStats.succeeded << "/" << totalFiles << " files were completed";
+    } else if (batchSweepCount > 0) {
+        ss << "Sweep complete! " << batchStats.succeeded << "/" << totalFiles << " files rendered at "
+           << batchSweepCount << " cutoffs";
+    } else {
+        ss << "Processing complete! " << batchStats.succeeded << "/" << totalFiles
+           << " files processed successfully (" << batchStats.Utilization() << ")";
+        if (batchStats.cached > 0) {
+            ss << ", " << batchStats.cached << " reused from cache";
+        }
+    }
+    statusMessage = ss.str();
+    
     processing = false;
     progress = 1.0f;
 }
 
+AudioProcessor::Options MainWindow::GetProcessingOptions() const {
+    AudioProcessor::Options options;
+    options.enableHFC = enableHFC;
+    options.lowpassFreq = lowpassFreq;
+    options.compressedMode = compressedMode;
+    options.sampleRateMultiplier = sampleRateMultiplier;
+    options.engine = static_cast<HFCompensation::Engine>(engineIndex);
+    options.outputFormat.container = OUTPUT_FORMATS[outputFormatIndex].container;
+    options.outputFormat.bitDepth = OUTPUT_FORMATS[outputFormatIndex].bitDepth;
+    options.outputFormat.dither = static_cast<SampleConvert::Dither>(ditherIndex);
+    options.memoryBudget = memoryBudgetMiB > 0 ? static_cast<uint64_t>(memoryBudgetMiB) * Memory::MIB
+                                               : Memory::PhysicalBytes() / AUTO_BUDGET_DIVISOR;
+    return options;
+}
+
 std::string MainWindow::GetFileNameFromPath(const std::string& path) const {
     return fs::path(path).filename().string();
 }
-
-bool MainWindow::IsAudioFile(const std::string& path) const {
-    static const std::vector<std::string> audioExtensions = {
-        ".wav", ".flac", ".ogg", ".mp3", ".aiff", ".aif", ".m4a", ".opus"
-    };
-    
-    std::string ext = fs::path(path).extension().string();
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-    
-    return std::find(audioExtensions.begin(), audioExtensions.end(), ext) != audioExtensions.end();
-}
\ No newline at end of file
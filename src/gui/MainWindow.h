@@ -6,9 +6,17 @@
 #include <thread>
 #include <atomic>
 #include <functional>
+#include <unordered_map>
+#include "../audio/AudioProcessor.h"
+#include "../audio/BatchPipeline.h"
+#include "../audio/FolderIngest.h"
+#include "../audio/Overview.h"
+#include "../util/CancellationToken.h"
+#include "../util/Telemetry.h"
 
-class AudioProcessor;
+class AnalysisCache;
 class FileDialog;
+class ResultCache;
 
 class MainWindow {
 public:
@@ -20,22 +28,80 @@ public:
 private:
     // UI State
     std::vector<std::string> inputFiles;
+    std::unordered_map<std::string, AudioProbe> inputInfo;  // Header of each input; also the duplicate check
+    bool recursiveIngest = true;   // Folders are added with their subfolders
     std::string outputDirectory;
     bool showFileDialog = false;
     bool processing = false;
-    std::atomic<float> progress{0.0f};
+    float progress = 0.0f;
     std::string statusMessage = "Ready";
-    std::string currentProcessingFile;
     
     // Processing settings
     bool enableHFC = true;
     bool compressedMode = false;
     int lowpassFreq = 16000;
     int sampleRateMultiplier = 2;  // 2x, 3x, 4x, etc.
+    int engineIndex = 0;           // Harmonic, band replication
+    int outputFormatIndex = 0;     // Index into the output format table in MainWindow.cpp
+    int ditherIndex = 1;           // None, TPDF, noise shaped
+    int memoryBudgetMiB = 0;       // Per file; 0 uses a share of installed memory
+    bool reuseResults = true;      // Restore unchanged jobs from the result cache
+    bool keepAnalysis = true;      // Keep HFC analyses so a changed cutoff only reruns synthesis
+    bool spillAnalysis = false;    // Move analyses that don't fit in memory to disk
+    bool sweepEnabled = false;     // Render every file at each cutoff in sweepCutoffs
+    char sweepCutoffs[128] = "14000, 16000, 18000, 20000";
     
     // Audio processor
     std::unique_ptr<AudioProcessor> audioProcessor;
     std::unique_ptr<std::thread> processingThread;
+    CancellationToken cancelToken;  // Reset at the start of each batch
+    std::unique_ptr<ResultCache> resultCache;  // Opened on first use
+    std::unique_ptr<AnalysisCache> analysisCache;  // Recreated when spilling is toggled
+    bool analysisCacheSpills = false;
+    
+    // Current batch; the worker writes batchStats before FinishBatch and
+    // otherwise only touches the telemetry
+    Telemetry telemetry;
+    std::vector<std::string> batchFiles;
+    BatchPipeline::Stats batchStats;
+    size_t batchSweepCount = 0;  // Cutoffs per file in a sweep, 0 for a normal batch
+    double batchStartTime = 0.0;  // ImGui::GetTime() when the batch started
+    
+    // Process RSS, resampled a couple of times a second while processing
+    uint64_t processRss = 0;
+    double rssSampleTime = -1.0;
+    
+    // Region preview. The preview thread writes previewStatus before
+    // clearing previewRunning; the UI reads it after.
+    int previewFileIndex = 0;      // Into inputFiles
+    float previewStart = 0.0f;     // Seconds
+    float previewLength = 10.0f;
+    std::unique_ptr<std::thread> previewThread;
+    std::atomic<bool> previewRunning{false};
+    CancellationToken previewCancel;
+    std::string previewStatus;
+    
+    // Spectrum inspector. The inspect thread processes the whole file with
+    // overviews attached; the UI draws whatever has been filled in so far.
+    Overview inspectInput;
+    Overview inspectOutput;
+    std::unique_ptr<std::thread> inspectThread;
+    std::atomic<bool> inspectRunning{false};
+    CancellationToken inspectCancel;
+    JobProgress inspectProgress;
+    std::string inspectFile;
+    int inspectView = 1;             // 0 before HFC, 1 after
+    double inspectViewStart = 0.0;   // Seconds
+    double inspectViewLength = 0.0;  // Seconds; 0 until the file's length is known
+    std::vector<Overview::Bucket> inspectWaveform;  // Scratch for the visible columns
+    std::vector<uint8_t> inspectSpectrum;
+    
+    // Folder ingest. The ingest thread writes ingestResult before clearing
+    // ingestRunning; the UI merges it after.
+    std::unique_ptr<std::thread> ingestThread;
+    std::atomic<bool> ingestRunning{false};
+    CancellationToken ingestCancel;
+    FolderIngest::Result ingestResult;
     
     // File dialog
     std::unique_ptr<FileDialog> fileDialog;
@@ -44,6 +110,8 @@ private:
     void DrawMenuBar();
     void DrawFileSection();
     void DrawSettingsSection();
+    void DrawPreviewSection();
+    void DrawInspector();
     void DrawProcessingSection();
     void DrawStatusBar();
     void DrawDropTarget();
@@ -51,11 +119,16 @@ private:
     // File handling
     void AddFile(const std::string& path);
     void AddFiles();
+    void AddFolder(const std::string& path);
+    void FinishIngest();
+    void RemoveFile(size_t index);
     void ClearFiles();
     void ProcessFiles();
     void OnProcessingComplete();
+    void RenderPreview();
+    void InspectFile();
     
     // Helpers
+    AudioProcessor::Options GetProcessingOptions() const;
     std::string GetFileNameFromPath(const std::string& path) const;
-    bool IsAudioFile(const std::string& path) const;
 };
\ No newline at end of file
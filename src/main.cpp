@@ -1,4 +1,3 @@
-#include <iostream>
 #include <memory>
 #include <string>
 
@@ -9,16 +8,25 @@
 #include <GLFW/glfw3.h>
 
 #include "gui/MainWindow.h"
+#include "util/Log.h"
+#include "util/Trace.h"
+#include <cstdlib>
 
 static void glfw_error_callback(int error, const char* description) {
-    fprintf(stderr, "GLFW Error %d: %s\n", error, description);
+    HRAW_LOG_ERROR("GLFW Error " << error << ": " << description);
 }
 
 int main(int argc, char* argv[]) {
+    // HRAW_LOG_LEVEL=debug brings back the per-stage detail
+    LogLevel logLevel;
+    if (Log::ParseLevel(std::getenv("HRAW_LOG_LEVEL"), logLevel)) {
+        Log::SetLevel(logLevel);
+    }
+
     // Setup GLFW
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
+        HRAW_LOG_ERROR("Failed to initialize GLFW");
         return 1;
     }
 
@@ -34,7 +42,7 @@ int main(int argc, char* argv[]) {
     // Create window with graphics context
     GLFWwindow* window = glfwCreateWindow(1000, 700, "HRAudioWizard", nullptr, nullptr);
     if (window == nullptr) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
+        HRAW_LOG_ERROR("Failed to create GLFW window");
         glfwTerminate();
         return 1;
     }
@@ -92,5 +100,16 @@ int main(int argc, char* argv[]) {
     glfwDestroyWindow(window);
     glfwTerminate();
 
+    // Trace builds dump their timings once the last batch has been stopped
+    mainWindow.reset();
+    if (Trace::ENABLED) {
+        const char* tracePath = std::getenv("HRAW_TRACE_FILE");
+        const std::string path = tracePath ? tracePath : "hrawiz_trace.json";
+        if (Trace::WriteChromeTrace(path)) {
+            HRAW_LOG_INFO("Wrote trace to " << path);
+        }
+        HRAW_LOG_INFO("Trace summary:\n" << Trace::Summary());
+    }
+
     return 0;
 }
\ No newline at end of file
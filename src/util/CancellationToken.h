@@ -0,0 +1,22 @@
+#pragma once
+
+#include <atomic>
+
+// Cooperative cancellation flag shared between the UI and worker threads.
+// Long-running loops poll it at block or frame granularity and bail out,
+// releasing their buffers on the way. Functions take it as an optional
+// pointer; nullptr means "cannot be cancelled".
+class CancellationToken {
+public:
+    void Cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    void Reset() { cancelled.store(false, std::memory_order_relaxed); }
+    bool IsCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+    // Null-safe check for optional tokens
+    static bool IsCancelled(const CancellationToken* token) {
+        return token && token->IsCancelled();
+    }
+
+private:
+    std::atomic<bool> cancelled{false};
+};
@@ -0,0 +1,130 @@
+#include "Hash.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+constexpr size_t FILE_CHUNK = 1 << 20;
+
+inline uint64_t RotateLeft(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+// Little-endian loads; memcpy keeps them alignment-safe
+inline uint64_t Read64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t Read32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t Round(uint64_t lane, uint64_t input) {
+    lane += input * PRIME2;
+    lane = RotateLeft(lane, 31);
+    return lane * PRIME1;
+}
+
+inline uint64_t MergeRound(uint64_t hash, uint64_t lane) {
+    hash ^= Round(0, lane);
+    return hash * PRIME1 + PRIME4;
+}
+
+} // namespace
+
+Hasher::Hasher(uint64_t seed) : seed(seed) {
+    lanes[0] = seed + PRIME1 + PRIME2;
+    lanes[1] = seed + PRIME2;
+    lanes[2] = seed;
+    lanes[3] = seed - PRIME1;
+}
+
+void Hasher::Update(const void* data, size_t length) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    totalLength += length;
+
+    // Top up a partial stripe first
+    if (buffered > 0) {
+        const size_t take = std::min(length, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, p, take);
+        buffered += take;
+        p += take;
+        length -= take;
+        if (buffered < sizeof(buffer)) return;
+        for (int i = 0; i < 4; ++i) lanes[i] = Round(lanes[i], Read64(buffer + 8 * i));
+        buffered = 0;
+    }
+
+    while (length >= 32) {
+        for (int i = 0; i < 4; ++i) lanes[i] = Round(lanes[i], Read64(p + 8 * i));
+        p += 32;
+        length -= 32;
+    }
+
+    std::memcpy(buffer, p, length);
+    buffered = length;
+}
+
+uint64_t Hasher::Digest() const {
+    uint64_t hash;
+    if (totalLength >= 32) {
+        hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) +
+               RotateLeft(lanes[3], 18);
+        for (int i = 0; i < 4; ++i) hash = MergeRound(hash, lanes[i]);
+    } else {
+        hash = seed + PRIME5;
+    }
+    hash += totalLength;
+
+    const unsigned char* p = buffer;
+    size_t remaining = buffered;
+    for (; remaining >= 8; p += 8, remaining -= 8) {
+        hash ^= Round(0, Read64(p));
+        hash = RotateLeft(hash, 27) * PRIME1 + PRIME4;
+    }
+    if (remaining >= 4) {
+        hash ^= static_cast<uint64_t>(Read32(p)) * PRIME1;
+        hash = RotateLeft(hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+        remaining -= 4;
+    }
+    for (; remaining > 0; ++p, --remaining) {
+        hash ^= *p * PRIME5;
+        hash = RotateLeft(hash, 11) * PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+bool Hasher::HashFile(const std::string& path, uint64_t& hash) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    Hasher hasher;
+    std::vector<unsigned char> chunk(FILE_CHUNK);
+    size_t read;
+    while ((read = std::fread(chunk.data(), 1, chunk.size(), file)) > 0) {
+        hasher.Update(chunk.data(), read);
+    }
+    const bool ok = !std::ferror(file);
+    std::fclose(file);
+    if (ok) hash = hasher.Digest();
+    return ok;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Streaming 64-bit xxHash (XXH64). Fast enough to fingerprint whole audio
+// files in a fraction of the time it takes to decode them; not meant to
+// resist deliberate collisions.
+class Hasher {
+public:
+    explicit Hasher(uint64_t seed = 0);
+
+    void Update(const void* data, size_t length);
+    void Update(const std::string& text) { Update(text.data(), text.size()); }
+
+    // Mix in a value's bytes; for integers and other plain values
+    template <typename T>
+    void UpdateValue(const T& value) { Update(&value, sizeof(value)); }
+
+    // Hash of everything added so far; more can be added afterwards
+    uint64_t Digest() const;
+
+    // Hash a whole file's bytes. Returns false if it can't be read.
+    static bool HashFile(const std::string& path, uint64_t& hash);
+
+private:
+    uint64_t lanes[4];
+    unsigned char buffer[32];
+    size_t buffered = 0;
+    uint64_t totalLength = 0;
+    uint64_t seed;
+};
@@ -0,0 +1,181 @@
+#include "Log.h"
+#include "SpscQueue.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Records per thread ring; a burst larger than this before the sink wakes
+// drops Debug/Info records
+constexpr size_t RING_RECORDS = 1024;
+constexpr auto SINK_INTERVAL = std::chrono::milliseconds(5);
+
+struct Record {
+    int64_t timeNs = 0;
+    int tid = 0;
+    LogLevel level = LogLevel::Info;
+    std::string message;
+};
+
+struct Ring {
+    SpscQueue<Record> queue{RING_RECORDS};
+    std::atomic<bool> owned{true};       // Cleared when the producing thread exits
+    std::atomic<size_t> dropped{0};
+};
+
+int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Registry {
+    std::mutex mutex;        // Guards `rings`; taken once per thread and per drain
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::mutex drainMutex;   // Keeps each ring single-consumer
+    std::once_flag sinkStarted;
+    std::atomic<int> nextTid{0};
+    const int64_t epochNs = NowNs();
+};
+
+// Deliberately leaked so the sink thread and the exit flush never see it destroyed
+Registry& GetRegistry() {
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+void Drain() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> drainLock(registry.drainMutex);
+
+    // Rings are never freed, so they can be read after dropping the lock
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto& ring : registry.rings) rings.push_back(ring.get());
+    }
+
+    std::vector<Record> records;
+    size_t dropped = 0;
+    Record record;
+    for (Ring* ring : rings) {
+        while (ring->queue.TryPop(record)) records.push_back(std::move(record));
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    if (records.empty() && dropped == 0) return;
+
+    std::stable_sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+        return a.timeNs < b.timeNs;
+    });
+
+    std::string out;
+    char prefix[48];
+    for (const Record& r : records) {
+        std::snprintf(prefix, sizeof(prefix), "[%10.3f t%d] %-5s ",
+                      (r.timeNs - registry.epochNs) / 1e9, r.tid, LogLevelName(r.level));
+        out += prefix;
+        out += r.message;
+        out += '\n';
+    }
+    if (dropped > 0) {
+        out += "[log] " + std::to_string(dropped) + " records dropped\n";
+    }
+    std::fwrite(out.data(), 1, out.size(), stderr);
+    std::fflush(stderr);
+}
+
+void SinkLoop() {
+    for (;;) {
+        Drain();
+        std::this_thread::sleep_for(SINK_INTERVAL);
+    }
+}
+
+void StartSink() {
+    std::thread(SinkLoop).detach();
+    std::atexit(Log::Flush);
+}
+
+// Hands the ring back for reuse when its thread exits
+struct RingHandle {
+    Ring* ring = nullptr;
+    int tid = 0;
+
+    ~RingHandle() {
+        if (ring) ring->owned.store(false, std::memory_order_release);
+    }
+};
+
+RingHandle& LocalRing() {
+    thread_local RingHandle handle;
+    if (!handle.ring) {
+        Registry& registry = GetRegistry();
+        std::call_once(registry.sinkStarted, StartSink);
+        handle.tid = registry.nextTid.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        // Batches spawn fresh worker threads; recycle rings from exited ones
+        for (const auto& ring : registry.rings) {
+            bool owned = false;
+            if (ring->owned.compare_exchange_strong(owned, true, std::memory_order_acq_rel)) {
+                handle.ring = ring.get();
+                return handle;
+            }
+        }
+        registry.rings.push_back(std::make_unique<Ring>());
+        handle.ring = registry.rings.back().get();
+    }
+    return handle;
+}
+
+} // namespace
+
+const char* LogLevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Warn: return "WARN";
+        case LogLevel::Error: return "ERROR";
+        case LogLevel::Off: return "OFF";
+    }
+    return "?";
+}
+
+bool Log::ParseLevel(const char* text, LogLevel& level) {
+    if (!text) return false;
+    for (LogLevel candidate : {LogLevel::Debug, LogLevel::Info, LogLevel::Warn, LogLevel::Error, LogLevel::Off}) {
+        const char* name = LogLevelName(candidate);
+        size_t i = 0;
+        while (name[i] && text[i] && std::tolower(static_cast<unsigned char>(text[i])) ==
+                                         std::tolower(static_cast<unsigned char>(name[i]))) {
+            ++i;
+        }
+        if (!name[i] && !text[i]) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Log::Write(LogLevel level, std::string message) {
+    RingHandle& local = LocalRing();
+    Record record{NowNs(), local.tid, level, std::move(message)};
+    if (local.ring->queue.TryPush(record)) return;
+
+    if (level >= LogLevel::Warn) {
+        local.ring->queue.Push(std::move(record));
+    } else {
+        local.ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Log::Flush() {
+    Drain();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+enum class LogLevel : uint8_t {
+    Debug,  // Per-stage detail: buffer sizes, formats, sample dumps
+    Info,   // One or two lines per job
+    Warn,
+    Error,
+    Off
+};
+
+const char* LogLevelName(LogLevel level);
+
+// Leveled, asynchronous diagnostics.
+//
+// Each thread appends records to its own lock-free ring. A background
+// thread merges the rings in timestamp order and writes them to stderr,
+// so workers never contend on a stream lock or wait on a flush. Below the
+// threshold the HRAW_LOG_* macros cost one relaxed load: the message
+// expression is not evaluated at all.
+//
+// A full ring drops Debug and Info records, counting them, and makes Warn
+// and Error wait for the sink instead.
+class Log {
+public:
+    static bool Enabled(LogLevel level) {
+        return level >= threshold.load(std::memory_order_relaxed);
+    }
+
+    static void SetLevel(LogLevel level) { threshold.store(level, std::memory_order_relaxed); }
+    static LogLevel Level() { return threshold.load(std::memory_order_relaxed); }
+
+    // Accepts "debug", "info", "warn", "error" or "off"
+    static bool ParseLevel(const char* text, LogLevel& level);
+
+    // Queue a record. Prefer the macros, which skip formatting when disabled.
+    static void Write(LogLevel level, std::string message);
+
+    // Block until everything queued so far has been written. Also runs at exit.
+    static void Flush();
+
+private:
+    static inline std::atomic<LogLevel> threshold{LogLevel::Info};
+};
+
+#define HRAW_LOG(level, message)                                         \
+    do {                                                                 \
+        if (Log::Enabled(level)) {                                       \
+            std::ostringstream hrawLogStream;                            \
+            hrawLogStream << message;                                    \
+            Log::Write(level, hrawLogStream.str());                      \
+        }                                                                \
+    } while (0)
+
+#define HRAW_LOG_DEBUG(message) HRAW_LOG(LogLevel::Debug, message)
+#define HRAW_LOG_INFO(message) HRAW_LOG(LogLevel::Info, message)
+#define HRAW_LOG_WARN(message) HRAW_LOG(LogLevel::Warn, message)
+#define HRAW_LOG_ERROR(message) HRAW_LOG(LogLevel::Error, message)
@@ -0,0 +1,103 @@
+#include "Memory.h"
+
+#if defined(__linux__)
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#include <sys/sysctl.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(__linux__)
+// Value of a "Key:   1234 kB" line in /proc/self/status, in bytes
+uint64_t ReadStatusKb(const char* key) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) return 0;
+
+    const size_t keyLength = strlen(key);
+    char line[256];
+    uint64_t bytes = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, key, keyLength) == 0) {
+            bytes = strtoull(line + keyLength, nullptr, 10) * 1024;
+            break;
+        }
+    }
+    fclose(file);
+    return bytes;
+}
+#endif
+
+} // namespace
+
+uint64_t Memory::CurrentRss() {
+#if defined(__linux__)
+    return ReadStatusKb("VmRSS:");
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) !=
+        KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+#else
+    return 0;
+#endif
+}
+
+uint64_t Memory::PeakRss() {
+#if defined(__linux__)
+    return ReadStatusKb("VmHWM:");
+#elif defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss);  // Already bytes on macOS
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+bool Memory::ResetPeakRss() {
+#if defined(__linux__)
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (!file) return false;
+    const bool ok = fputs("5", file) >= 0;
+    return fclose(file) == 0 && ok;
+#else
+    return false;
+#endif
+}
+
+uint64_t Memory::PhysicalBytes() {
+#if defined(__APPLE__)
+    uint64_t bytes = 0;
+    size_t size = sizeof(bytes);
+    int mib[2] = {CTL_HW, HW_MEMSIZE};
+    return sysctl(mib, 2, &bytes, &size, nullptr, 0) == 0 ? bytes : 0;
+#elif defined(_WIN32)
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    return GlobalMemoryStatusEx(&status) ? status.ullTotalPhys : 0;
+#else
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || pageSize <= 0) return 0;
+    return static_cast<uint64_t>(pages) * static_cast<uint64_t>(pageSize);
+#endif
+}
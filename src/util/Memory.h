@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Process-wide memory readings. Each returns 0 where the platform offers
+// no cheap way to get the number.
+class Memory {
+public:
+    // Resident set size right now
+    static uint64_t CurrentRss();
+
+    // High-water mark of the resident set size
+    static uint64_t PeakRss();
+
+    // Restart the high-water mark so the next PeakRss covers only what runs
+    // after this call. Returns false where that isn't supported.
+    static bool ResetPeakRss();
+
+    // Installed physical memory
+    static uint64_t PhysicalBytes();
+
+    static constexpr uint64_t MIB = 1024 * 1024;
+};
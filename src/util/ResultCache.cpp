@@ -0,0 +1,249 @@
+#include "ResultCache.h"
+#include "Log.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint32_t INDEX_MAGIC = 0x43575248;  // "HRWC"
+constexpr uint32_t INDEX_VERSION = 1;
+constexpr const char* INDEX_NAME = "index.bin";
+
+struct IndexHeader {
+    uint32_t magic = INDEX_MAGIC;
+    uint32_t version = INDEX_VERSION;
+    uint64_t clock = 0;
+    uint64_t count = 0;
+};
+
+struct IndexRecord {
+    uint64_t key;
+    uint64_t bytes;
+    int64_t modified;
+    uint64_t lastUse;
+};
+
+int64_t ModifiedTime(const fs::path& path, std::error_code& ec) {
+    return static_cast<int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+}
+
+// Hard link `from` to `to`, falling back to a copy across filesystems
+bool LinkOrCopy(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+    fs::remove(to, ec);
+    fs::create_hard_link(from, to, ec);
+    if (!ec) return true;
+    ec.clear();
+    fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+    return !ec;
+}
+
+} // namespace
+
+ResultCache::ResultCache(std::string directory, uint64_t capacityBytes)
+    : directory(std::move(directory)), capacity(capacityBytes) {
+    std::error_code ec;
+    fs::create_directories(this->directory, ec);
+    if (ec) {
+        HRAW_LOG_WARN("Can't create result cache directory " << this->directory << ": " << ec.message());
+    }
+    Load();
+}
+
+ResultCache::~ResultCache() {
+    Save();
+}
+
+std::string ResultCache::DefaultDirectory() {
+#if defined(_WIN32)
+    if (const char* local = std::getenv("LOCALAPPDATA")) {
+        return (fs::path(local) / "hrawiz").string();
+    }
+#else
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return (fs::path(xdg) / "hrawiz").string();
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return (fs::path(home) / ".cache" / "hrawiz").string();
+    }
+#endif
+    std::error_code ec;
+    return (fs::temp_directory_path(ec) / "hrawiz-cache").string();
+}
+
+std::string ResultCache::EntryPath(uint64_t key) const {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return (fs::path(directory) / name).string();
+}
+
+std::string ResultCache::IndexPath() const {
+    return (fs::path(directory) / INDEX_NAME).string();
+}
+
+bool ResultCache::Fetch(uint64_t key, const std::string& outputPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) return false;
+
+    // The copy may share an inode with an output someone has since edited
+    const fs::path entryPath = EntryPath(key);
+    std::error_code sizeError, timeError;
+    const uint64_t bytes = fs::file_size(entryPath, sizeError);
+    const int64_t modified = ModifiedTime(entryPath, timeError);
+    if (sizeError || timeError || bytes != it->second.bytes || modified != it->second.modified) {
+        HRAW_LOG_DEBUG("Dropping stale cache entry " << entryPath.string());
+        Remove(key);
+        return false;
+    }
+
+    // Already in place, e.g. rerunning a folder whose outputs are untouched
+    std::error_code ec;
+    if (!fs::equivalent(entryPath, outputPath, ec) && !LinkOrCopy(entryPath, outputPath)) {
+        HRAW_LOG_WARN("Failed to restore cached result to " << outputPath);
+        return false;
+    }
+
+    it->second.lastUse = ++clock;
+    dirty = true;
+    return true;
+}
+
+bool ResultCache::Store(uint64_t key, const std::string& outputPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entries.count(key)) Remove(key);
+
+    const fs::path entryPath = EntryPath(key);
+    if (!LinkOrCopy(outputPath, entryPath)) {
+        HRAW_LOG_WARN("Failed to add " << outputPath << " to the result cache");
+        return false;
+    }
+
+    std::error_code sizeError, timeError;
+    Entry entry;
+    entry.bytes = fs::file_size(entryPath, sizeError);
+    entry.modified = ModifiedTime(entryPath, timeError);
+    entry.lastUse = ++clock;
+    if (sizeError || timeError) {
+        fs::remove(entryPath, sizeError);
+        return false;
+    }
+
+    entries[key] = entry;
+    totalBytes += entry.bytes;
+    dirty = true;
+    Evict();
+    return true;
+}
+
+bool ResultCache::Save() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!dirty) return true;
+
+    IndexHeader header;
+    header.clock = clock;
+    header.count = entries.size();
+    std::vector<IndexRecord> records;
+    records.reserve(entries.size());
+    for (const auto& [key, entry] : entries) {
+        records.push_back({key, entry.bytes, entry.modified, entry.lastUse});
+    }
+
+    // Write aside and rename so a crash never leaves a torn index
+    const std::string indexPath = IndexPath();
+    const std::string tempPath = indexPath + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        HRAW_LOG_WARN("Can't write result cache index " << tempPath);
+        return false;
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && !records.empty()) {
+        ok = std::fwrite(records.data(), sizeof(IndexRecord), records.size(), file) == records.size();
+    }
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code ec;
+    if (ok) fs::rename(tempPath, indexPath, ec);
+    if (!ok || ec) {
+        fs::remove(tempPath, ec);
+        HRAW_LOG_WARN("Failed to save result cache index " << indexPath);
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+void ResultCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!entries.empty()) Remove(entries.begin()->first);
+}
+
+size_t ResultCache::NumEntries() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+uint64_t ResultCache::SizeBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalBytes;
+}
+
+void ResultCache::Load() {
+    std::error_code ec;
+    const uint64_t fileBytes = fs::file_size(IndexPath(), ec);
+    FILE* file = ec ? nullptr : std::fopen(IndexPath().c_str(), "rb");
+    if (!file) return;  // First run
+
+    IndexHeader header;
+    std::vector<IndexRecord> records;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == INDEX_MAGIC &&
+              header.version == INDEX_VERSION &&
+              fileBytes == sizeof(header) + header.count * sizeof(IndexRecord);
+    if (ok) {
+        records.resize(header.count);
+        ok = std::fread(records.data(), sizeof(IndexRecord), records.size(), file) == records.size();
+    }
+    std::fclose(file);
+
+    if (!ok) {
+        // Orphaned copies are overwritten as their keys come back
+        HRAW_LOG_WARN("Ignoring unreadable result cache index " << IndexPath());
+        dirty = true;
+        return;
+    }
+
+    clock = header.clock;
+    for (const IndexRecord& record : records) {
+        entries[record.key] = {record.bytes, record.modified, record.lastUse};
+        totalBytes += record.bytes;
+    }
+    HRAW_LOG_DEBUG("Result cache " << directory << ": " << entries.size() << " entries, "
+                   << totalBytes / (1024 * 1024) << " MiB");
+    Evict();
+}
+
+void ResultCache::Remove(uint64_t key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) return;
+    std::error_code ec;
+    fs::remove(EntryPath(key), ec);
+    totalBytes -= it->second.bytes;
+    entries.erase(it);
+    dirty = true;
+}
+
+void ResultCache::Evict() {
+    while (totalBytes > capacity && !entries.empty()) {
+        auto oldest = entries.begin();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->second.lastUse < oldest->second.lastUse) oldest = it;
+        }
+        Remove(oldest->first);
+    }
+}
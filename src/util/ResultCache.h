@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Content-addressed store of finished output files.
+//
+// Each entry maps a 64-bit key, which the caller derives from everything
+// that determines the output, to a copy of that output kept in the cache
+// directory. Copies are hard links to the file that was written wherever
+// the filesystem allows, so a cached result costs no extra disk space while
+// the original output still exists.
+//
+// The index is a small binary file next to the copies, loaded on
+// construction and written by Save. Once the copies exceed the capacity the
+// least recently used ones are evicted. All methods are thread-safe.
+class ResultCache {
+public:
+    static constexpr uint64_t DEFAULT_CAPACITY = 8ULL << 30;
+
+    // Creates `directory` if needed and loads its index
+    explicit ResultCache(std::string directory, uint64_t capacityBytes = DEFAULT_CAPACITY);
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Per-user cache location: $XDG_CACHE_HOME/hrawiz, ~/.cache/hrawiz,
+    // %LOCALAPPDATA%\hrawiz, or a directory under the system temp dir
+    static std::string DefaultDirectory();
+
+    // If `key` is cached, place its output at `outputPath` (replacing any
+    // file there) and return true. Stale or missing copies are dropped.
+    bool Fetch(uint64_t key, const std::string& outputPath);
+
+    // Record the file just written to `outputPath` as the result for `key`
+    bool Store(uint64_t key, const std::string& outputPath);
+
+    // Write the index if it changed since it was loaded or last saved
+    bool Save();
+
+    // Drop every entry and its copy
+    void Clear();
+
+    size_t NumEntries() const;
+    uint64_t SizeBytes() const;
+
+private:
+    struct Entry {
+        uint64_t bytes = 0;
+        int64_t modified = 0;  // Write time of the copy; a mismatch means it was edited in place
+        uint64_t lastUse = 0;  // Value of `clock` when last fetched or stored
+    };
+
+    std::string directory;
+    uint64_t capacity;
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    uint64_t clock = 0;
+    uint64_t totalBytes = 0;
+    bool dirty = false;
+
+    std::string EntryPath(uint64_t key) const;
+    std::string IndexPath() const;
+    void Load();
+    void Remove(uint64_t key);
+    void Evict();
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Bounded single-producer / single-consumer lock-free ring buffer.
+// TryPush/TryPop never block; Push/Pop back off (spin, yield, then sleep)
+// until space or an item is available, which suits stage handoffs that
+// happen a few times per second rather than per sample.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : slots(capacity > 0 ? capacity : 1) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t Capacity() const { return slots.size(); }
+
+    // Producer side
+    bool TryPush(T& item) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= slots.size()) {
+            return false;
+        }
+        slots[t % slots.size()] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    void Push(T item) {
+        for (int attempt = 0; !TryPush(item); ++attempt) {
+            Backoff(attempt);
+        }
+    }
+
+    // Consumer side
+    bool TryPop(T& item) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(slots[h % slots.size()]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    T Pop() {
+        T item;
+        for (int attempt = 0; !TryPop(item); ++attempt) {
+            Backoff(attempt);
+        }
+        return item;
+    }
+
+private:
+    static void Backoff(int attempt) {
+        if (attempt < 64) {
+            // Busy spin; the other side is usually about to finish
+        } else if (attempt < 128) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    }
+
+    std::vector<T> slots;
+    alignas(64) std::atomic<size_t> head{0};  // Next slot to pop, owned by the consumer
+    alignas(64) std::atomic<size_t> tail{0};  // Next slot to push, owned by the producer
+};
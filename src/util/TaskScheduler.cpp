@@ -0,0 +1,289 @@
+#include "TaskScheduler.h"
+#include "Log.h"
+#include "Trace.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Which pool, and which of its workers, the current thread is
+thread_local const TaskScheduler* currentScheduler = nullptr;
+thread_local int currentWorker = -1;
+
+// Where threads outside the pool start looking for work to steal
+thread_local unsigned stealOffset = 0;
+
+struct Cpu {
+    int id;
+    int node;
+};
+
+// "0-3,8,10-11" -> 0 1 2 3 8 10 11
+std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        const size_t dash = range.find('-');
+        const int first = std::atoi(range.c_str());
+        const int last = dash != std::string::npos ? std::atoi(range.c_str() + dash + 1) : first;
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// CPUs this process may run on, ordered node by node. Empty where threads
+// can't be pinned.
+std::vector<Cpu> PlacementCpus() {
+    std::vector<Cpu> cpus;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return cpus;
+
+    // NUMA nodes as the kernel lists them; a machine without any is one node
+    std::vector<int> nodeOf(CPU_SETSIZE, 0);
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator("/sys/devices/system/node", ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4) continue;
+        const int node = std::atoi(name.c_str() + 4);
+        std::ifstream file(entry.path() / "cpulist");
+        std::string list;
+        if (!std::getline(file, list)) continue;
+        for (int cpu : ParseCpuList(list)) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) nodeOf[cpu] = node;
+        }
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) cpus.push_back({cpu, nodeOf[cpu]});
+    }
+    std::stable_sort(cpus.begin(), cpus.end(), [](const Cpu& a, const Cpu& b) { return a.node < b.node; });
+#endif
+    return cpus;
+}
+
+void PinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        HRAW_LOG_WARN("Could not pin a task worker to CPU " << cpu);
+    }
+#else
+    (void)cpu;
+#endif
+}
+
+TaskScheduler::Config ConfigFromEnvironment() {
+    TaskScheduler::Config config;
+    if (const char* threads = std::getenv("HRAW_THREADS")) {
+        config.numThreads = std::max(0, std::atoi(threads));
+    }
+    if (const char* pin = std::getenv("HRAW_PIN_THREADS")) {
+        config.pinThreads = std::string(pin) == "1";
+    }
+    return config;
+}
+
+// Settings for the shared pool, and whether it has started. Leaked like the
+// pool itself, whose workers may still be asleep during static destruction.
+struct SharedState {
+    std::mutex mutex;
+    bool started = false;
+    bool configured = false;
+    TaskScheduler::Config config;
+};
+
+SharedState& GetSharedState() {
+    static SharedState* state = new SharedState;
+    return *state;
+}
+
+} // namespace
+
+TaskScheduler::TaskScheduler(const Config& config) {
+    int numThreads = config.numThreads > 0 ? config.numThreads
+                                           : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const int numWorkers = numThreads - 1;
+
+    const std::vector<Cpu> cpus = config.pinThreads ? PlacementCpus() : std::vector<Cpu>();
+    if (config.pinThreads && cpus.empty()) {
+        HRAW_LOG_WARN("Thread pinning isn't supported here; task workers float");
+    }
+
+    for (int i = 0; i < numWorkers; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+        if (!cpus.empty()) workers[i]->node = cpus[i % cpus.size()].node;
+    }
+
+    // Steal from the rest of the own node first, each worker starting just
+    // past itself so thieves spread over victims
+    for (int i = 0; i < numWorkers; ++i) {
+        std::vector<int>& victims = workers[i]->victims;
+        for (bool sameNode : {true, false}) {
+            for (int step = 1; step < numWorkers; ++step) {
+                const int victim = (i + step) % numWorkers;
+                if ((workers[victim]->node == workers[i]->node) == sameNode) victims.push_back(victim);
+            }
+        }
+    }
+
+    for (int i = 0; i < numWorkers; ++i) {
+        const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()].id;
+        workers[i]->thread = std::thread(&TaskScheduler::WorkerLoop, this, i, cpu);
+    }
+    HRAW_LOG_DEBUG("Task scheduler: " << numThreads << " threads" << (cpus.empty() ? "" : ", pinned"));
+}
+
+TaskScheduler::~TaskScheduler() {
+    stopping = true;
+    Notify();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+TaskScheduler& TaskScheduler::Shared() {
+    static TaskScheduler* shared = []() {
+        SharedState& state = GetSharedState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.started = true;
+        return new TaskScheduler(state.configured ? state.config : ConfigFromEnvironment());
+    }();
+    return *shared;
+}
+
+bool TaskScheduler::Configure(const Config& config) {
+    SharedState& state = GetSharedState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.started) {
+        HRAW_LOG_WARN("The task scheduler is already running; thread settings are unchanged");
+        return false;
+    }
+    state.config = config;
+    state.configured = true;
+    return true;
+}
+
+void TaskScheduler::HelpUntil(const std::function<bool()>& done) {
+    const int self = currentScheduler == this ? currentWorker : -1;
+    while (!done()) {
+        if (TryRun(self)) continue;
+
+        // Nothing to run; sleep until a task is queued or `done` may have changed
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers++;
+        wake.wait(lock, [&]() { return done() || queued.load() > 0; });
+        sleepers--;
+    }
+}
+
+void TaskScheduler::Notify() {
+    // Taking the lock orders this after any sleeper's last check
+    if (sleepers.load() == 0) return;
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wake.notify_all();
+}
+
+void TaskScheduler::Submit(Task task) {
+    const int self = currentScheduler == this ? currentWorker : -1;
+    if (self >= 0) {
+        std::lock_guard<std::mutex> lock(workers[self]->mutex);
+        workers[self]->tasks.push_back(std::move(task));
+    } else {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        injection.push_back(std::move(task));
+    }
+    queued++;
+    if (sleepers.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+bool TaskScheduler::TryPop(std::deque<Task>& tasks, std::mutex& mutex, bool newest, Task& task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty()) return false;
+    if (newest) {
+        task = std::move(tasks.back());
+        tasks.pop_back();
+    } else {
+        task = std::move(tasks.front());
+        tasks.pop_front();
+    }
+    queued--;
+    return true;
+}
+
+bool TaskScheduler::TryRun(int self) {
+    Task task;
+    bool found = false;
+    if (self >= 0) {
+        // Own work newest first, then new work from outside, then steal
+        found = TryPop(workers[self]->tasks, workers[self]->mutex, true, task) ||
+                TryPop(injection, injectionMutex, false, task);
+        for (size_t i = 0; !found && i < workers[self]->victims.size(); ++i) {
+            Worker& victim = *workers[workers[self]->victims[i]];
+            found = TryPop(victim.tasks, victim.mutex, false, task);
+        }
+    } else {
+        found = TryPop(injection, injectionMutex, false, task);
+        const size_t numWorkers = workers.size();
+        const unsigned start = stealOffset++;
+        for (size_t i = 0; !found && i < numWorkers; ++i) {
+            Worker& victim = *workers[(start + i) % numWorkers];
+            found = TryPop(victim.tasks, victim.mutex, false, task);
+        }
+    }
+    if (found) Execute(task);
+    return found;
+}
+
+void TaskScheduler::Execute(Task& task) {
+    task.body();
+    task.body = nullptr;  // Release captures before the group sees the task finish
+    if (task.group->pending.fetch_sub(1) == 1) {
+        // The group may be destroyed as soon as its waiter sees this
+        Notify();
+    }
+}
+
+void TaskScheduler::WorkerLoop(int index, int cpu) {
+    currentScheduler = this;
+    currentWorker = index;
+    if (cpu >= 0) PinCurrentThread(cpu);
+    HRAW_TRACE_THREAD("task worker");
+
+    while (!stopping.load()) {
+        if (TryRun(index)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers++;
+        wake.wait(lock, [&]() { return stopping.load() || queued.load() > 0; });
+        sleepers--;
+    }
+}
+
+void TaskGroup::Run(std::function<void()> task) {
+    pending++;
+    scheduler.Submit({std::move(task), this});
+}
+
+void TaskGroup::Wait() {
+    if (pending.load() == 0) return;
+    scheduler.HelpUntil([this]() { return pending.load() == 0; });
+}
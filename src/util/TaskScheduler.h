@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+// The one thread pool every layer runs its parallel work on: batch files,
+// the mid/side pair, STFT frame ranges, resampler blocks, FLAC frame groups.
+// Sharing it keeps nested parallelism from oversubscribing the machine, so
+// one long file and a thousand short ones both keep every core busy.
+//
+// Each worker owns a deque. Tasks spawned on a worker go to the back of its
+// own deque and it takes them back from there, newest first; idle workers
+// steal the oldest from the front of someone else's, which tends to be the
+// biggest piece of work left. Threads outside the pool queue to a shared
+// injection deque. Waiting for a TaskGroup runs queued tasks instead of
+// blocking, so fork/join nests to any depth without deadlocking.
+//
+// Tasks must not throw.
+class TaskScheduler {
+public:
+    struct Config {
+        // Threads working on tasks, counting the one that waits on a group,
+        // so the pool starts numThreads - 1 workers. 0 uses one per
+        // hardware thread; 1 runs every task on the thread that waits.
+        int numThreads = 0;
+
+        // Pin each worker to one CPU (Linux only). CPUs are handed out node
+        // by node, so neighbouring workers share a NUMA node, and workers
+        // steal from their own node before going to another.
+        bool pinThreads = false;
+    };
+
+    explicit TaskScheduler(const Config& config);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // The process-wide pool, started on first use from the last Configure,
+    // else from HRAW_THREADS (a thread count) and HRAW_PIN_THREADS=1
+    static TaskScheduler& Shared();
+
+    // Settings for Shared(). Only works before its first use; returns false
+    // with a warning afterwards.
+    static bool Configure(const Config& config);
+
+    // Threads that run tasks, including a waiting caller
+    int NumThreads() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Run tasks until `done` returns true. Whatever makes it true must call
+    // Notify afterwards, or a caller with nothing left to run may sleep
+    // through it. TaskGroup::Wait is built on this.
+    void HelpUntil(const std::function<bool()>& done);
+    void Notify();
+
+private:
+    friend class TaskGroup;
+
+    struct Task {
+        std::function<void()> body;
+        TaskGroup* group;
+    };
+
+    struct Worker {
+        std::mutex mutex;          // Guards `tasks`
+        std::deque<Task> tasks;
+        int node = 0;              // NUMA node of its CPU, 0 if not pinned
+        std::vector<int> victims;  // Workers to steal from, own node first
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex injectionMutex;  // Guards `injection`
+    std::deque<Task> injection;
+
+    // Tasks queued anywhere, and threads asleep waiting for one
+    std::atomic<int> queued{0};
+    std::atomic<int> sleepers{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping{false};
+
+    void Submit(Task task);
+    bool TryRun(int self);
+    bool TryPop(std::deque<Task>& tasks, std::mutex& mutex, bool newest, Task& task);
+    void Execute(Task& task);
+    void WorkerLoop(int index, int cpu);
+};
+
+// A set of tasks to wait for together. Tasks may add more tasks to their
+// own group or start nested groups.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskScheduler& scheduler = TaskScheduler::Shared()) : scheduler(scheduler) {}
+    ~TaskGroup() { Wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void Run(std::function<void()> task);
+
+    // Returns once every task run so far has finished, running queued tasks
+    // (of any group) in the meantime
+    void Wait();
+
+    TaskScheduler& Scheduler() const { return scheduler; }
+
+private:
+    friend class TaskScheduler;
+
+    TaskScheduler& scheduler;
+    std::atomic<int> pending{0};
+};
+
+// Run body(chunkBegin, chunkEnd) over [begin, end) split into chunks of at
+// least `grain` items, a few per thread so stealing can even out uneven
+// chunks. The calling thread takes the first chunk itself.
+template <typename Fn>
+void ParallelFor(size_t begin, size_t end, size_t grain, Fn&& body,
+                 TaskScheduler& scheduler = TaskScheduler::Shared()) {
+    if (begin >= end) return;
+    const size_t count = end - begin;
+    const size_t maxChunks = static_cast<size_t>(scheduler.NumThreads()) * 4;
+    const size_t numChunks = std::min(maxChunks, std::max<size_t>(1, count / std::max<size_t>(grain, 1)));
+    if (numChunks <= 1) {
+        body(begin, end);
+        return;
+    }
+
+    TaskGroup group(scheduler);
+    auto chunkStart = [&](size_t chunk) { return begin + count * chunk / numChunks; };
+    for (size_t chunk = 1; chunk < numChunks; ++chunk) {
+        group.Run([&body, first = chunkStart(chunk), last = chunkStart(chunk + 1)]() { body(first, last); });
+    }
+    body(begin, chunkStart(1));
+    group.Wait();
+}
+
+// ParallelFor where neighbouring chunks never run at the same time: the even
+// ones run first, then the odd ones. For loops whose items also touch their
+// neighbours' data, such as overlap-add, as long as no item reaches past
+// the next one.
+template <typename Fn>
+void ParallelForNonAdjacent(size_t begin, size_t end, size_t grain, Fn&& body,
+                            TaskScheduler& scheduler = TaskScheduler::Shared()) {
+    if (begin >= end) return;
+    const size_t count = end - begin;
+    const size_t maxChunks = static_cast<size_t>(scheduler.NumThreads()) * 8;
+    const size_t numChunks = std::min(maxChunks, std::max<size_t>(1, count / std::max<size_t>(grain, 1)));
+    auto chunkStart = [&](size_t chunk) { return begin + count * chunk / numChunks; };
+    for (size_t parity = 0; parity < 2; ++parity) {
+        ParallelFor(0, (numChunks + 1 - parity) / 2, 1, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                const size_t chunk = 2 * i + parity;
+                body(chunkStart(chunk), chunkStart(chunk + 1));
+            }
+        }, scheduler);
+    }
+}
@@ -0,0 +1,156 @@
+#include "Telemetry.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+struct StageSpan {
+    const char* name;
+    float begin;  // Share of the whole job done when the stage starts
+    float end;
+};
+
+// Indexed by JobStage. The shares follow where time goes in a typical HFC
+// job, so a single progress bar moves at a roughly even pace.
+const StageSpan STAGES[] = {
+    {"Queued", 0.0f, 0.0f},
+    {"Decoding", 0.0f, 0.05f},
+    {"Resampling", 0.05f, 0.10f},
+    {"Analyzing", 0.10f, 0.15f},
+    {"Synthesizing", 0.15f, 0.90f},
+    {"Reconstructing", 0.90f, 0.95f},
+    {"Encoding", 0.95f, 1.0f},
+    {"Done", 1.0f, 1.0f},
+    {"Failed", 1.0f, 1.0f},
+    {"Cancelled", 1.0f, 1.0f},
+};
+
+const StageSpan& Span(JobStage stage) {
+    return STAGES[static_cast<size_t>(stage)];
+}
+
+bool IsTerminal(JobStage stage) {
+    return stage == JobStage::Done || stage == JobStage::Failed || stage == JobStage::Cancelled;
+}
+
+} // namespace
+
+const char* JobStageName(JobStage stage) {
+    return Span(stage).name;
+}
+
+int64_t JobProgress::NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void JobProgress::BeginStage(JobStage newStage, uint64_t total) {
+    CloseStage();
+    workDone.store(0, std::memory_order_relaxed);
+    workTotal.store(total, std::memory_order_relaxed);
+    stageStartNs.store(NowNs(), std::memory_order_relaxed);
+    stage.store(newStage, std::memory_order_relaxed);
+}
+
+void JobProgress::EndStage(JobStage next) {
+    CloseStage();
+    stage.store(next, std::memory_order_relaxed);
+}
+
+void JobProgress::SetMemory(uint64_t bytes) {
+    // Only the owning worker writes, so load-compare-store is enough
+    memoryBytes.store(bytes, std::memory_order_relaxed);
+    if (bytes > peakMemoryBytes.load(std::memory_order_relaxed)) {
+        peakMemoryBytes.store(bytes, std::memory_order_relaxed);
+    }
+    std::atomic<uint64_t>& stagePeak = stagePeakMemory[static_cast<size_t>(Stage())];
+    if (bytes > stagePeak.load(std::memory_order_relaxed)) {
+        stagePeak.store(bytes, std::memory_order_relaxed);
+    }
+}
+
+uint64_t JobProgress::StagePeakMemory(JobStage stage) const {
+    return stagePeakMemory[static_cast<size_t>(stage)].load(std::memory_order_relaxed);
+}
+
+void JobProgress::CloseStage() {
+    const JobStage current = Stage();
+    if (current != JobStage::Queued && !IsTerminal(current)) {
+        busyNs.fetch_add(NowNs() - stageStartNs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        queuedProgress.store(Span(current).end, std::memory_order_relaxed);
+    }
+}
+
+void JobProgress::SetAudioDuration(double seconds) {
+    audioMicros.store(static_cast<uint64_t>(std::max(0.0, seconds) * 1e6), std::memory_order_relaxed);
+}
+
+float JobProgress::StageProgress() const {
+    const uint64_t total = workTotal.load(std::memory_order_relaxed);
+    if (total == 0) return 0.0f;
+    const uint64_t done = workDone.load(std::memory_order_relaxed);
+    return std::min(1.0f, static_cast<float>(done) / static_cast<float>(total));
+}
+
+float JobProgress::Progress() const {
+    const JobStage current = Stage();
+    if (current == JobStage::Queued) {
+        return queuedProgress.load(std::memory_order_relaxed);
+    }
+    const StageSpan& span = Span(current);
+    return span.begin + (span.end - span.begin) * StageProgress();
+}
+
+double JobProgress::UnitsPerSecond() const {
+    const JobStage current = Stage();
+    if (current == JobStage::Queued || IsTerminal(current)) return 0.0;
+
+    const double elapsed = (NowNs() - stageStartNs.load(std::memory_order_relaxed)) * 1e-9;
+    return elapsed > 0.0 ? workDone.load(std::memory_order_relaxed) / elapsed : 0.0;
+}
+
+double JobProgress::RealtimeFactor() const {
+    int64_t busy = busyNs.load(std::memory_order_relaxed);
+    const JobStage current = Stage();
+    if (current != JobStage::Queued && !IsTerminal(current)) {
+        busy += NowNs() - stageStartNs.load(std::memory_order_relaxed);
+    }
+    const uint64_t audio = audioMicros.load(std::memory_order_relaxed);
+    return busy > 0 ? (audio * 1e3) / static_cast<double>(busy) : 0.0;
+}
+
+void Telemetry::BeginBatch(size_t count) {
+    jobs = std::make_unique<JobProgress[]>(count);
+    numJobs = count;
+    weights.clear();
+    finished.store(false, std::memory_order_relaxed);
+}
+
+void Telemetry::BeginBatch(const std::vector<double>& jobCosts) {
+    BeginBatch(jobCosts.size());
+
+    // A job of unknown cost would read as free; fall back to equal weights
+    double total = 0.0;
+    for (double cost : jobCosts) {
+        if (!(cost > 0.0)) return;
+        total += cost;
+    }
+    for (double cost : jobCosts) weights.push_back(static_cast<float>(cost / total));
+}
+
+float Telemetry::BatchProgress() const {
+    if (numJobs == 0) return 0.0f;
+    float sum = 0.0f;
+    for (size_t i = 0; i < numJobs; ++i) {
+        sum += weights.empty() ? jobs[i].Progress() : jobs[i].Progress() * weights[i];
+    }
+    return weights.empty() ? sum / numJobs : std::min(1.0f, sum);
+}
+
+size_t Telemetry::CountInStage(JobStage stage) const {
+    size_t count = 0;
+    for (size_t i = 0; i < numJobs; ++i) {
+        if (jobs[i].Stage() == stage) ++count;
+    }
+    return count;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Stage a job is currently in
+enum class JobStage : uint8_t {
+    Queued,          // Waiting for a worker, or between pipeline stages
+    Decoding,
+    Resampling,
+    Analyzing,       // Forward STFT
+    Synthesizing,    // HFC frame loop
+    Reconstructing,  // Inverse STFT
+    Encoding,
+    Done,
+    Failed,
+    Cancelled
+};
+
+const char* JobStageName(JobStage stage);
+
+// Progress of one job. Written by whichever worker owns the job at the
+// moment, read by anyone at any rate. Every field is an independent relaxed
+// atomic, so publishing costs a plain store; a reader can briefly see a new
+// stage with the previous stage's counters, which only matters for display.
+class JobProgress {
+public:
+    // Enter `stage`, which will report `total` units of work (0 if unknown).
+    // Time spent in the previous stage is added to the job's busy time.
+    void BeginStage(JobStage stage, uint64_t total = 0);
+
+    // Units of work finished in the current stage
+    void Advance(uint64_t done) { workDone.store(done, std::memory_order_relaxed); }
+
+    // Stop the clock on the current stage and park the job in `next`
+    void EndStage(JobStage next = JobStage::Queued);
+
+    // Duration of the input, used for the realtime factor
+    void SetAudioDuration(double seconds);
+
+    JobStage Stage() const { return stage.load(std::memory_order_relaxed); }
+
+    // Fraction of the current stage done, or 0 if the stage has no known total
+    float StageProgress() const;
+
+    // Rough fraction of the whole job done, weighted by typical stage cost
+    float Progress() const;
+
+    // Work units per second in the current stage (STFT frames while synthesizing)
+    double UnitsPerSecond() const;
+
+    // Seconds of audio handled per second spent working on this job
+    double RealtimeFactor() const;
+    
+    // Bytes held in the job's audio buffers and spectrograms, reported by
+    // whichever stage owns them whenever the live set changes. The peak is
+    // kept overall and per stage.
+    void SetMemory(uint64_t bytes);
+    uint64_t MemoryBytes() const { return memoryBytes.load(std::memory_order_relaxed); }
+    uint64_t PeakMemoryBytes() const { return peakMemoryBytes.load(std::memory_order_relaxed); }
+    uint64_t StagePeakMemory(JobStage stage) const;
+
+private:
+    static int64_t NowNs();
+
+    // Fold the running stage into busyNs; only the owning worker calls this
+    void CloseStage();
+
+    std::atomic<JobStage> stage{JobStage::Queued};
+    std::atomic<uint64_t> workDone{0};
+    std::atomic<uint64_t> workTotal{0};
+    std::atomic<int64_t> stageStartNs{0};
+    std::atomic<int64_t> busyNs{0};          // Time spent in finished stages
+    std::atomic<uint64_t> audioMicros{0};
+    std::atomic<float> queuedProgress{0.0f}; // Job progress reported while Queued
+    std::atomic<uint64_t> memoryBytes{0};
+    std::atomic<uint64_t> peakMemoryBytes{0};
+    std::atomic<uint64_t> stagePeakMemory[static_cast<size_t>(JobStage::Cancelled) + 1] = {};
+};
+
+// Progress surface for a batch: one JobProgress slot per job plus a
+// completion flag. The owner sizes it with BeginBatch before starting any
+// worker; after that workers only write their job's slot.
+class Telemetry {
+public:
+    // Not safe against concurrent readers; call from the reading thread
+    void BeginBatch(size_t numJobs);
+
+    // As above, one job per entry of `jobCosts`: the expected work of each
+    // job (e.g. its input frames), which weights it in BatchProgress
+    void BeginBatch(const std::vector<double>& jobCosts);
+
+    // Called by the worker once the last job has settled. Everything the
+    // worker wrote before this call is visible to a reader that has seen
+    // IsFinished() return true.
+    void FinishBatch() { finished.store(true, std::memory_order_release); }
+    bool IsFinished() const { return finished.load(std::memory_order_acquire); }
+
+    size_t NumJobs() const { return numJobs; }
+    JobProgress& Job(size_t index) { return jobs[index]; }
+    const JobProgress& Job(size_t index) const { return jobs[index]; }
+
+    // Job progress across the batch, weighted by cost if costs were given
+    float BatchProgress() const;
+
+    // Number of jobs currently in `stage`
+    size_t CountInStage(JobStage stage) const;
+
+private:
+    std::unique_ptr<JobProgress[]> jobs;
+    size_t numJobs = 0;
+    std::vector<float> weights;  // Per job, summing to 1; empty for equal weights
+    std::atomic<bool> finished{false};
+};
@@ -0,0 +1,227 @@
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+struct Event {
+    const char* name;
+    int64_t startNs;
+    int64_t endNs;
+};
+
+// Events per buffer chunk. Chunks are never moved once published, so a
+// reader can walk them while the owning thread keeps appending.
+constexpr size_t CHUNK_EVENTS = 4096;
+
+struct Chunk {
+    Event events[CHUNK_EVENTS];
+    std::atomic<size_t> count{0};
+    std::atomic<Chunk*> next{nullptr};
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    std::atomic<const char*> threadName{nullptr};
+    Chunk head;
+    Chunk* tail = &head;  // Only touched by the owning thread
+
+    ~ThreadBuffer() {
+        ReleaseChunks();
+    }
+
+    void Append(const Event& event) {
+        size_t n = tail->count.load(std::memory_order_relaxed);
+        if (n == CHUNK_EVENTS) {
+            Chunk* chunk = new Chunk;
+            tail->next.store(chunk, std::memory_order_release);
+            tail = chunk;
+            n = 0;
+        }
+        tail->events[n] = event;
+        tail->count.store(n + 1, std::memory_order_release);
+    }
+
+    void ReleaseChunks() {
+        Chunk* chunk = head.next.load(std::memory_order_acquire);
+        while (chunk) {
+            Chunk* next = chunk->next.load(std::memory_order_acquire);
+            delete chunk;
+            chunk = next;
+        }
+        head.next.store(nullptr, std::memory_order_relaxed);
+        head.count.store(0, std::memory_order_relaxed);
+        tail = &head;
+    }
+};
+
+int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Registry {
+    std::mutex mutex;  // Guards `buffers`; taken once per thread and by exports
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    const int64_t epochNs = NowNs();
+};
+
+// Deliberately leaked so buffers stay valid for thread_local pointers that
+// outlive static destruction at exit
+Registry& GetRegistry() {
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+ThreadBuffer& LocalBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = registry.buffers.back().get();
+        buffer->tid = static_cast<int>(registry.buffers.size());
+    }
+    return *buffer;
+}
+
+struct ThreadEvents {
+    int tid;
+    const char* threadName;
+    std::vector<Event> events;
+};
+
+// Copy out everything published so far
+std::vector<ThreadEvents> Snapshot() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::vector<ThreadEvents> threads;
+    for (const auto& buffer : registry.buffers) {
+        ThreadEvents thread{buffer->tid, buffer->threadName.load(std::memory_order_relaxed), {}};
+        for (const Chunk* chunk = &buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            const size_t count = chunk->count.load(std::memory_order_acquire);
+            thread.events.insert(thread.events.end(), chunk->events, chunk->events + count);
+        }
+        threads.push_back(std::move(thread));
+    }
+    return threads;
+}
+
+void WriteJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') out << '\\';
+        out << *c;
+    }
+    out << '"';
+}
+
+} // namespace
+
+Trace::Scope::Scope(const char* name) : name(name), startNs(NowNs()) {
+}
+
+Trace::Scope::~Scope() {
+    LocalBuffer().Append({name, startNs, NowNs()});
+}
+
+void Trace::SetThreadName(const char* name) {
+    LocalBuffer().threadName.store(name, std::memory_order_relaxed);
+}
+
+bool Trace::WriteChromeTrace(const std::string& path) {
+    const int64_t epochNs = GetRegistry().epochNs;
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    auto separator = [&]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (const ThreadEvents& thread : Snapshot()) {
+        if (thread.threadName) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.tid
+                << ",\"args\":{\"name\":";
+            WriteJsonString(out, thread.threadName);
+            out << "}}";
+        }
+        // Complete ("X") events with microsecond timestamps
+        for (const Event& event : thread.events) {
+            separator();
+            out << "{\"name\":";
+            WriteJsonString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.tid
+                << ",\"ts\":" << (event.startNs - epochNs) / 1000.0
+                << ",\"dur\":" << (event.endNs - event.startNs) / 1000.0 << "}";
+        }
+    }
+    out << "\n]}\n";
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    const std::string json = out.str();
+    bool ok = fwrite(json.data(), 1, json.size(), file) == json.size();
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+std::string Trace::Summary() {
+    struct Totals {
+        size_t count = 0;
+        int64_t totalNs = 0;
+        int64_t maxNs = 0;
+    };
+
+    std::map<std::string, Totals> byName;
+    for (const ThreadEvents& thread : Snapshot()) {
+        for (const Event& event : thread.events) {
+            Totals& totals = byName[event.name];
+            const int64_t duration = event.endNs - event.startNs;
+            ++totals.count;
+            totals.totalNs += duration;
+            totals.maxNs = std::max(totals.maxNs, duration);
+        }
+    }
+
+    // Most expensive first
+    std::vector<std::pair<std::string, Totals>> rows(byName.begin(), byName.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.totalNs > b.second.totalNs;
+    });
+
+    std::ostringstream out;
+    out << std::left << std::setw(20) << "Scope" << std::right
+        << std::setw(8) << "Count" << std::setw(12) << "Total ms"
+        << std::setw(12) << "Mean ms" << std::setw(12) << "Max ms" << "\n";
+    out << std::fixed << std::setprecision(2);
+    for (const auto& row : rows) {
+        const Totals& totals = row.second;
+        out << std::left << std::setw(20) << row.first << std::right
+            << std::setw(8) << totals.count
+            << std::setw(12) << totals.totalNs / 1e6
+            << std::setw(12) << totals.totalNs / 1e6 / totals.count
+            << std::setw(12) << totals.maxNs / 1e6 << "\n";
+    }
+    return out.str();
+}
+
+void Trace::Clear() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& buffer : registry.buffers) {
+        buffer->ReleaseChunks();
+    }
+}
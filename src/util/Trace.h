@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Scoped wall-clock timers for profiling where time goes inside a job.
+//
+// Configure with -DHRAW_ENABLE_TRACE=ON to compile them in. Otherwise the
+// HRAW_TRACE_* macros expand to nothing and the export functions produce
+// an empty trace.
+//
+// Each thread records into its own append-only buffer, so recording an
+// event costs two clock reads and a store with no locking. Buffers are
+// kept after their thread exits, and the export functions can run while
+// workers are still recording.
+class Trace {
+public:
+#if defined(HRAW_ENABLE_TRACE) && HRAW_ENABLE_TRACE
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    // Records [construction, destruction) under `name`, which must be a
+    // string literal or otherwise outlive the trace
+    class Scope {
+    public:
+        explicit Scope(const char* name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        int64_t startNs;
+    };
+
+    // Label the calling thread in exported traces
+    static void SetThreadName(const char* name);
+
+    // Write every recorded event as Chrome trace-event JSON, loadable in
+    // Perfetto or chrome://tracing
+    static bool WriteChromeTrace(const std::string& path);
+
+    // Per-name count, total, mean and max as an aligned text table
+    static std::string Summary();
+
+    // Drop all recorded events. Only call when no thread is recording.
+    static void Clear();
+};
+
+#if defined(HRAW_ENABLE_TRACE) && HRAW_ENABLE_TRACE
+#define HRAW_TRACE_CONCAT_INNER(a, b) a##b
+#define HRAW_TRACE_CONCAT(a, b) HRAW_TRACE_CONCAT_INNER(a, b)
+#define HRAW_TRACE_SCOPE(name) Trace::Scope HRAW_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define HRAW_TRACE_THREAD(name) Trace::SetThreadName(name)
+#else
+#define HRAW_TRACE_SCOPE(name) ((void)0)
+#define HRAW_TRACE_THREAD(name) ((void)0)
+#endif